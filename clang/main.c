@@ -15,26 +15,28 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <poll.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <pthread.h>
 
 // FFI dispatch function pointer - set up after includes
 // Uses void* to avoid type dependency issues with include order
 static void* (*omni_ffi_dispatch_fn)(void*) = 0;
 
-// Counter for debugging
-static unsigned long omni_hook_calls = 0;
-static unsigned long omni_ffi_tag_counts[20] = {0};  // Count by tag C00-C16
+// Reducer thread of the caller (0 = main; see omnilisp/eval/reducer.c)
+static __thread unsigned int omni_reducer_tid = 0;
+
+// Profiler event sink, set while --profile is recording (omnilisp/eval/profile.c)
+static void (*omni_profile_fn)(unsigned long) = 0;
+
+// Constructor-entry telemetry (no-op unless built with -DOMNI_TELEMETRY)
+#include "omnilisp/eval/telemetry.c"
 
 // FFI dispatch hook - called from wnf when encountering C02 constructors
 // Uses unsigned long (same size as Term/u64) to avoid type issues
 static inline unsigned long omni_ffi_dispatch_hook_wrapper(unsigned long t) {
-  omni_hook_calls++;
-
-  // Count by tag (C00-C16 are tags 24-40)
-  // Tag at bits 56-62, ext at bits 32-55
-  unsigned char tag = (t >> 56) & 0x7F;
-  if (tag >= 24 && tag <= 40) {
-    omni_ffi_tag_counts[tag - 24]++;
-  }
+  omni_telemetry_record(omni_reducer_tid, t);
+  if (omni_profile_fn) omni_profile_fn(t);
 
   if (omni_ffi_dispatch_fn) {
     return (unsigned long)omni_ffi_dispatch_fn((void*)t);
@@ -53,11 +55,26 @@ static inline unsigned long omni_ffi_dispatch_hook_wrapper(unsigned long t) {
 
 // Include OmniLisp components
 #include "omnilisp/nick/omnilisp.c"
+#include "omnilisp/load/image.c"
+#include "omnilisp/load/deps.c"
+#include "omnilisp/eval/reducer.c"
+#include "omnilisp/eval/profile.c"
+#include "omnilisp/heap/checkpoint.c"
+#include "omnilisp/eval/stats.c"
 #include "omnilisp/ffi/handle.c"
+#include "omnilisp/ffi/registry.c"
+#include "omnilisp/ffi/buffer.c"
+#include "omnilisp/ffi/pstring.c"
 #include "omnilisp/ffi/io.c"
+#include "omnilisp/ffi/stream.c"
 #include "omnilisp/ffi/datetime.c"
 #include "omnilisp/ffi/json.c"
+#include "omnilisp/ffi/signature.c"
+#include "omnilisp/ffi/dynlib.c"
 #include "omnilisp/ffi/thread_pool.c"
+#include "omnilisp/ffi/uring.c"
+#include "omnilisp/ffi/vectorized.c"
+#include "omnilisp/print/writer.c"
 #include "omnilisp/parse/_.c"
 #include "omnilisp/compile/_.c"
 
@@ -68,82 +85,13 @@ static inline unsigned long omni_ffi_dispatch_hook_wrapper(unsigned long t) {
 // Debug flag for FFI dispatch
 static int omni_ffi_debug = 0;  // Disabled
 
-// Count how many C02 nodes we see
-static unsigned long omni_c02_count = 0;
-
-// Track unique ext values seen
-static u32 unique_exts[1000];
-static u32 unique_ext_counts[1000];
-static u32 unique_ext_count = 0;
-
-static void track_ext(u32 ext) {
-  for (u32 i = 0; i < unique_ext_count; i++) {
-    if (unique_exts[i] == ext) {
-      unique_ext_counts[i]++;
-      return;
-    }
-  }
-  if (unique_ext_count < 1000) {
-    unique_exts[unique_ext_count] = ext;
-    unique_ext_counts[unique_ext_count] = 1;
-    unique_ext_count++;
-  }
-}
-
-// Counter for all constructor entries
-static unsigned long omni_ctr_enter_count = 0;
-
-// Tag counts for all constructors
-static unsigned long omni_tag_counts[17] = {0};  // C00-C16
-static unsigned long omni_ext_per_tag[17][100];  // Up to 100 unique exts per tag
-static unsigned long omni_ext_count_per_tag[17][100];
-static unsigned int omni_unique_ext_per_tag[17];
-
-static void track_constructor(u8 tag, u32 ext) {
-  int idx = tag - C00;
-  if (idx < 0 || idx > 16) return;
-  omni_tag_counts[idx]++;
-
-  // Track unique exts for this tag
-  for (unsigned int i = 0; i < omni_unique_ext_per_tag[idx]; i++) {
-    if (omni_ext_per_tag[idx][i] == ext) {
-      omni_ext_count_per_tag[idx][i]++;
-      return;
-    }
-  }
-  if (omni_unique_ext_per_tag[idx] < 100) {
-    int n = omni_unique_ext_per_tag[idx]++;
-    omni_ext_per_tag[idx][n] = ext;
-    omni_ext_count_per_tag[idx][n] = 1;
-  }
-}
-
 // Actual FFI dispatch function (now that types are available)
 static void* omni_ffi_dispatch_impl(void* term_ptr) {
   Term t = (Term)term_ptr;
   u8 tag = term_tag(t);
 
-  // Track ALL constructor entries (C00-C16, tags 24-40)
-  if (tag >= C00 && tag <= C16) {
-    omni_ctr_enter_count++;
-    u32 ext = term_ext(t);
-    track_constructor(tag, ext);
-
-    // Track C02 specifically for unique ext summary
-    if (tag == C02) {
-      omni_c02_count++;
-      track_ext(ext);
-    }
-
-    // Log first 20 constructor entries
-    if (omni_ffi_debug && omni_ctr_enter_count <= 20) {
-      fprintf(stderr, "[CTR ENTER] C%02d ext=%u%s\n", tag - C00, ext,
-              ext == OMNI_NAM_FFI ? " <-- FFI!" : "");
-    }
-  }
-
-  // Check if this is an FFI node: C02 with ext == OMNI_NAM_FFI
-  if (tag == C02 && term_ext(t) == OMNI_NAM_FFI) {
+  // Check if this is an FFI node: #FFI, or one of the async forms
+  if ((tag == C02 || tag == C01) && omni_ffi_is_node(t)) {
     if (omni_ffi_debug) {
       fprintf(stderr, "[FFI] Dispatching FFI node\n");
     }
@@ -182,6 +130,14 @@ typedef struct {
   const char *file;    // Input file
   const char *expr;    // Expression to evaluate
   const char *output;  // -o: Output file
+  const char *image;        // --image: Runtime image to map (rebuilt if stale)
+  const char *build_image;  // --build-image: Write runtime image and exit
+  int shake_runtime;        // --shake-runtime: Load only the definitions the program reaches
+  const char *batch;        // --batch: JSONL manifest of jobs to evaluate
+  int threads;              // -j: Reducer threads (0 = OMNI_THREADS or 1)
+  const char *profile;      // --profile: Folded-stack profile output
+  const char *stats_json;   // --stats-json: Phase timings as JSON
+  int ffi_workers;          // --ffi-workers: FFI pool threads (0 = $OMNI_FFI_WORKERS or cores)
 } OmniOptions;
 
 // Global flag for graceful shutdown
@@ -213,6 +169,14 @@ fn void print_usage(const char *prog) {
   printf("  -s, --stats       Show execution statistics\n");
   printf("  -C, --collapse N  Set collapse limit (default: 10)\n");
   printf("  -t, --typecheck   Enable compile-time type checking\n");
+  printf("  -j, --jobs N      Reduce with N threads (default: $OMNI_THREADS or 1)\n");
+  printf("  --image FILE      Map runtime image FILE (rebuilt if missing/stale)\n");
+  printf("  --build-image FILE  Write runtime image to FILE and exit\n");
+  printf("  --shake-runtime   Load only the runtime definitions the program reaches (-j 1)\n");
+  printf("  --batch FILE      Evaluate JSONL jobs {\"id\",\"source\"} (- for stdin)\n");
+  printf("  --profile FILE    Write folded stacks to FILE (interactions), FILE.time (us)\n");
+  printf("  --stats-json FILE Write phase timings as JSON to FILE (- for stdout)\n");
+  printf("  --ffi-workers N   Run async FFI calls on N threads (default: $OMNI_FFI_WORKERS or cores)\n");
   printf("\n");
   printf("Examples:\n");
   printf("  %s program.ol           Run OmniLisp program\n", prog);
@@ -221,6 +185,9 @@ fn void print_usage(const char *prog) {
   printf("  %s -S 5555              Start server on port 5555\n", prog);
   printf("  %s -c -o out.hvm4 in.ol Compile to HVM4\n", prog);
   printf("  %s -p program.ol        Show parse tree\n", prog);
+  printf("  %s --build-image rt.img  Snapshot the loaded runtime\n", prog);
+  printf("  %s --image rt.img -e \"(+ 1 2)\"  Start from the snapshot\n", prog);
+  printf("  %s --batch jobs.jsonl     One result line per job\n", prog);
   printf("\n");
   printf("Socket Protocol (for editor integration):\n");
   printf("  Send: expression followed by newline\n");
@@ -234,6 +201,17 @@ fn void print_version(void) {
   printf("Built on HVM4 runtime\n");
 }
 
+// Long-only options
+enum {
+  OPT_IMAGE = 256,
+  OPT_BUILD_IMAGE,
+  OPT_SHAKE_RUNTIME,
+  OPT_BATCH,
+  OPT_PROFILE,
+  OPT_STATS_JSON,
+  OPT_FFI_WORKERS,
+};
+
 fn OmniOptions parse_options(int argc, char *argv[]) {
   OmniOptions opts = {0};
   opts.collapse = 10;
@@ -252,13 +230,21 @@ fn OmniOptions parse_options(int argc, char *argv[]) {
     {"collapse",    required_argument, 0, 'C'},
     {"term-print",  no_argument,       0, 'T'},
     {"typecheck",   no_argument,       0, 't'},
+    {"jobs",        required_argument, 0, 'j'},
+    {"image",       required_argument, 0, OPT_IMAGE},
+    {"build-image", required_argument, 0, OPT_BUILD_IMAGE},
+    {"shake-runtime", no_argument,     0, OPT_SHAKE_RUNTIME},
+    {"batch",       required_argument, 0, OPT_BATCH},
+    {"profile",     required_argument, 0, OPT_PROFILE},
+    {"stats-json",  required_argument, 0, OPT_STATS_JSON},
+    {"ffi-workers", required_argument, 0, OPT_FFI_WORKERS},
     {0, 0, 0, 0}
   };
 
   int opt;
   int opt_index = 0;
 
-  while ((opt = getopt_long(argc, argv, "hvpce:iS:o:dsC:Tt", long_options, &opt_index)) != -1) {
+  while ((opt = getopt_long(argc, argv, "hvpce:iS:o:dsC:Ttj:", long_options, &opt_index)) != -1) {
     switch (opt) {
       case 'h': opts.help = 1; break;
       case 'v': opts.version = 1; break;
@@ -273,6 +259,14 @@ fn OmniOptions parse_options(int argc, char *argv[]) {
       case 'C': opts.collapse = atoi(optarg); break;
       case 'T': opts.hvm4_print = 1; break;
       case 't': opts.type_check = 1; break;
+      case 'j': opts.threads = atoi(optarg); break;
+      case OPT_IMAGE: opts.image = optarg; break;
+      case OPT_BUILD_IMAGE: opts.build_image = optarg; break;
+      case OPT_SHAKE_RUNTIME: opts.shake_runtime = 1; break;
+      case OPT_BATCH: opts.batch = optarg; break;
+      case OPT_PROFILE: opts.profile = optarg; break;
+      case OPT_STATS_JSON: opts.stats_json = optarg; break;
+      case OPT_FFI_WORKERS: opts.ffi_workers = atoi(optarg); break;
       default: opts.help = 1; break;
     }
   }
@@ -383,70 +377,118 @@ fn void print_ast(Term t) {
 // User-Friendly Value Printing for REPL
 // =============================================================================
 
-fn void omni_print_value_to(FILE *out, Term t);
+// The printer pulls the result: each field is reduced to WNF only when it
+// is reached, so output starts before the whole value is normal and a long
+// list never has to be fully normalized before its first element is shown.
+
+fn Term omni_reduce_with_ffi(Term t);
+fn void omni_print_value_to(OmniWriter *out, Term t);
+fn Term omni_spark_ffi_eval(Term args);
+fn Term omni_spark_ffi_length(Term args);
+
+// While set, reduction omni_print_force does is summed here, to be charged
+// to the eval phase rather than to printing
+static OmniPhaseMark *g_print_pulled = NULL;
+
+// Reduce the heap slot at loc to WNF in place and return it
+fn Term omni_print_force(u32 loc) {
+  Term t = HEAP[loc];
+  if (term_tag(t) == NUM) return t;
+  OmniPhaseMark *pulled = g_print_pulled;
+  OmniPhaseMark m;
+  if (pulled) {
+    g_print_pulled = NULL;
+    omni_phase_begin(&m);
+  }
+  t = omni_reduce_with_ffi(t);
+  if (pulled) {
+    omni_phase_piece(&m, pulled);
+    g_print_pulled = pulled;
+  }
+  HEAP[loc] = t;
+  return t;
+}
 
-// Check if a list is all CHR characters (a string)
-static int is_chr_list(Term t) {
-  while (term_tag(t) >= C00 && term_tag(t) <= C16) {
-    if (term_ext(t) == OMNI_NAM_NIL) return 1;  // Empty or end of list
-    if (term_ext(t) != OMNI_NAM_CON) return 0;  // Not a cons cell
-    u32 loc = term_val(t);
-    Term head = HEAP[loc];
-    if (term_tag(head) < C00 || term_tag(head) > C16) return 0;
-    if (term_ext(head) != OMNI_NAM_CHR) return 0;  // Head is not CHR
-    t = HEAP[loc + 1];  // Continue with tail
+// Write the escaped form of a string character
+fn void omni_print_code_to(OmniWriter *out, u32 code) {
+  if (code >= 32 && code < 127) {
+    if (code == '"' || code == '\\') omni_writer_putc(out, '\\');
+    omni_writer_putc(out, (char)code);
+  } else {
+    omni_writer_printf(out, "\\x%02x", code);
   }
-  return 0;  // Improper list
 }
 
-fn void omni_print_list_to(FILE *out, Term t) {
-  // Check if it's a string (list of all CHR)
-  if (is_chr_list(t)) {
-    fprintf(out, "\"");
-    while (term_tag(t) >= C00 && term_tag(t) <= C16 && term_ext(t) == OMNI_NAM_CON) {
-      u32 loc = term_val(t);
-      Term head = HEAP[loc];
-      // Get char code
-      u32 chr_loc = term_val(head);
-      Term chr_val = HEAP[chr_loc];
-      u32 code = term_tag(chr_val) == NUM ? term_val(chr_val) : 0;
-      if (code >= 32 && code < 127) {
-        if (code == '"' || code == '\\') fprintf(out, "\\");
-        fprintf(out, "%c", (char)code);
-      } else {
-        fprintf(out, "\\x%02x", code);
-      }
-      t = HEAP[loc + 1];
+// Write the escaped form of a #CHR{code} string element
+fn void omni_print_chr_to(OmniWriter *out, Term chr) {
+  Term chr_val = omni_print_force(term_val(chr));
+  omni_print_code_to(out, term_tag(chr_val) == NUM ? term_val(chr_val) : 0);
+}
+
+// A packed string prints like the char list it stands for
+fn void omni_print_pstr_to(OmniWriter *out, Term t) {
+  OmniBuf *b = omni_pstr_acquire(t);
+  omni_writer_putc(out, '"');
+  size_t i = 0;
+  while (b && i < b->len) omni_print_code_to(out, omni_pstr_decode(b->data, b->len, &i));
+  omni_writer_putc(out, '"');
+  omni_buf_release(b);
+}
+
+fn void omni_print_list_to(OmniWriter *out, Term t) {
+  // A list of all CHR is a string. That is only known at its end, so the
+  // escaped characters are held back until then; the first non-CHR element
+  // turns it back into an ordinary list.
+  Term start = t;
+  OmniWriter chars;
+  omni_writer_mem(&chars);
+  int is_str = 1;
+  while (term_tag(t) >= C00 && term_tag(t) <= C16 && term_ext(t) == OMNI_NAM_CON) {
+    u32 loc = term_val(t);
+    Term head = omni_print_force(loc);
+    if (term_tag(head) < C00 || term_tag(head) > C16 || term_ext(head) != OMNI_NAM_CHR) {
+      is_str = 0;
+      break;
     }
-    fprintf(out, "\"");
+    omni_print_chr_to(&chars, head);
+    t = omni_print_force(loc + 1);
+  }
+  if (is_str && term_tag(t) >= C00 && term_tag(t) <= C16 && term_ext(t) == OMNI_NAM_NIL) {
+    omni_writer_putc(out, '"');
+    omni_writer_put(out, chars.buf, chars.len);
+    omni_writer_putc(out, '"');
+    omni_writer_close(&chars);
     return;
   }
+  omni_writer_close(&chars);
 
-  fprintf(out, "(");
+  // Cells scanned above are already reduced; walk again from the start
+  omni_writer_putc(out, '(');
   int first = 1;
+  t = start;
   while (term_tag(t) == C02 && term_ext(t) == OMNI_NAM_CON) {
     u32 loc = term_val(t);
-    if (!first) fprintf(out, " ");
+    if (!first) omni_writer_putc(out, ' ');
     first = 0;
-    omni_print_value_to(out, HEAP[loc]);
-    t = HEAP[loc + 1];
+    omni_print_value_to(out, omni_print_force(loc));
+    t = omni_print_force(loc + 1);
   }
   // Check for improper list
   if (!(term_tag(t) == C00 && term_ext(t) == OMNI_NAM_NIL)) {
-    fprintf(out, " . ");
+    omni_writer_puts(out, " . ");
     omni_print_value_to(out, t);
   }
-  fprintf(out, ")");
+  omni_writer_putc(out, ')');
 }
 
-fn void omni_print_value_to(FILE *out, Term t) {
+fn void omni_print_value_to(OmniWriter *out, Term t) {
   u32 tag = term_tag(t);
   u32 ext = term_ext(t);
   u32 val = term_val(t);
 
   // Raw number
   if (tag == NUM) {
-    fprintf(out, "%u", val);
+    omni_writer_printf(out, "%u", val);
     return;
   }
 
@@ -454,9 +496,9 @@ fn void omni_print_value_to(FILE *out, Term t) {
   if (tag >= C00 && tag <= C16) {
     // #Cst{n} or #Lit{n} - integer literal
     if (ext == OMNI_NAM_CST || ext == OMNI_NAM_LIT) {
-      Term inner = HEAP[val];
+      Term inner = omni_print_force(val);
       if (term_tag(inner) == NUM) {
-        fprintf(out, "%u", term_val(inner));
+        omni_writer_printf(out, "%u", term_val(inner));
       } else {
         omni_print_value_to(out, inner);
       }
@@ -466,91 +508,84 @@ fn void omni_print_value_to(FILE *out, Term t) {
     // #Fix{hi, lo, scale} - fixed-point number
     if (ext == OMNI_NAM_FIX) {
       // Get hi, lo, scale
-      Term hi_term = HEAP[val];
-      Term lo_term = HEAP[val + 1];
-      Term scale_term = HEAP[val + 2];
+      Term hi_term = omni_print_force(val);
+      Term lo_term = omni_print_force(val + 1);
+      Term scale_term = omni_print_force(val + 2);
 
       u32 hi = term_tag(hi_term) == NUM ? term_val(hi_term) : 0;
       u32 lo = term_tag(lo_term) == NUM ? term_val(lo_term) : 0;
       u32 scale = term_tag(scale_term) == NUM ? term_val(scale_term) : 0;
 
-      // Check if negative (hi >= 2^31)
-      int is_negative = (hi >= 2147483648u);
+      // hi:lo is a two's complement 64-bit mantissa
+      int64_t m = (int64_t)(((u64)hi << 32) | lo);
+      const char *sign = m < 0 ? "-" : "";
+      u64 abs_val = m < 0 ? (u64)0 - (u64)m : (u64)m;
 
-      if (scale == 0) {
+      if (scale == 0 || scale > 19) {
         // Integer
-        if (is_negative) {
-          // Two's complement: negate lo
-          u64 abs_val = (u64)4294967296ULL - (u64)lo;
-          fprintf(out, "-%llu", (unsigned long long)abs_val);
-        } else {
-          fprintf(out, "%u", lo);
-        }
+        omni_writer_printf(out, "%s%llu", sign, (unsigned long long)abs_val);
       } else {
         // Decimal - compute divisor
-        u32 divisor = 1;
+        u64 divisor = 1;
         for (u32 i = 0; i < scale; i++) divisor *= 10;
 
-        if (is_negative) {
-          u64 abs_val = (u64)4294967296ULL - (u64)lo;
-          u64 int_part = abs_val / divisor;
-          u64 frac_part = abs_val % divisor;
-          fprintf(out, "-%llu.%0*llu", (unsigned long long)int_part, scale, (unsigned long long)frac_part);
-        } else {
-          u32 int_part = lo / divisor;
-          u32 frac_part = lo % divisor;
-          fprintf(out, "%u.%0*u", int_part, scale, frac_part);
-        }
+        u64 int_part = abs_val / divisor;
+        u64 frac_part = abs_val % divisor;
+        omni_writer_printf(out, "%s%llu.%0*llu", sign, (unsigned long long)int_part, (int)scale, (unsigned long long)frac_part);
       }
       return;
     }
 
     // #True{} - boolean true
     if (ext == OMNI_NAM_TRUE) {
-      fprintf(out, "true");
+      omni_writer_puts(out, "true");
       return;
     }
 
     // #Fals{} - boolean false
     if (ext == OMNI_NAM_FALS) {
-      fprintf(out, "false");
+      omni_writer_puts(out, "false");
       return;
     }
 
     // #Noth{} - nothing
     if (ext == OMNI_NAM_NOTH) {
-      fprintf(out, "nothing");
+      omni_writer_puts(out, "nothing");
+      return;
+    }
+
+    // #PStr{n} - packed string
+    if (ext == OMNI_NAM_PSTR) {
+      omni_print_pstr_to(out, t);
       return;
     }
 
     // #NIL{} - empty list
     if (ext == OMNI_NAM_NIL) {
-      fprintf(out, "()");
+      omni_writer_puts(out, "()");
       return;
     }
 
     // #Arr{len, data} - array
     if (ext == OMNI_NAM_ARR) {
       // Array: #Arr{len, data} where data is a list
-      Term data_term = HEAP[val + 1];  // Skip len, get data
-      fprintf(out, "[");
+      Term data_term = omni_print_force(val + 1);  // Skip len, get data
+      omni_writer_putc(out, '[');
       int first = 1;
       Term cur = data_term;
       while (term_tag(cur) >= C00 && term_tag(cur) <= C16) {
         if (term_ext(cur) == OMNI_NAM_NIL) break;
         if (term_ext(cur) == OMNI_NAM_CON) {
           u32 cur_val = term_val(cur);
-          Term head = HEAP[cur_val];
-          Term tail = HEAP[cur_val + 1];
-          if (!first) fprintf(out, " ");
+          if (!first) omni_writer_putc(out, ' ');
           first = 0;
-          omni_print_value_to(out, head);
-          cur = tail;
+          omni_print_value_to(out, omni_print_force(cur_val));
+          cur = omni_print_force(cur_val + 1);
         } else {
           break;
         }
       }
-      fprintf(out, "]");
+      omni_writer_putc(out, ']');
       return;
     }
 
@@ -562,110 +597,109 @@ fn void omni_print_value_to(FILE *out, Term t) {
 
     // #Dict{entries} - dictionary
     if (ext == OMNI_NAM_DICT) {
-      Term entries = HEAP[val];
-      fprintf(out, "#{");
+      Term entries = omni_print_force(val);
+      omni_writer_puts(out, "#{");
       int first = 1;
       Term cur = entries;
       while (term_tag(cur) >= C00 && term_tag(cur) <= C16) {
         if (term_ext(cur) == OMNI_NAM_NIL) break;
         if (term_ext(cur) == OMNI_NAM_CON) {
           u32 cur_val = term_val(cur);
-          Term pair = HEAP[cur_val];
-          Term tail = HEAP[cur_val + 1];
+          Term pair = omni_print_force(cur_val);
           // Each pair is (key . (value . nil)) - matching runtime format
           if (term_tag(pair) >= C00 && term_tag(pair) <= C16 && term_ext(pair) == OMNI_NAM_CON) {
             u32 pair_val = term_val(pair);
-            Term key = HEAP[pair_val];
-            Term val_cell = HEAP[pair_val + 1];
+            Term key = omni_print_force(pair_val);
+            Term val_cell = omni_print_force(pair_val + 1);
             // val_cell should be (value . nil)
             if (term_tag(val_cell) >= C00 && term_tag(val_cell) <= C16 && term_ext(val_cell) == OMNI_NAM_CON) {
-              Term value = HEAP[term_val(val_cell)];
-              if (!first) fprintf(out, " ");
+              Term value = omni_print_force(term_val(val_cell));
+              if (!first) omni_writer_putc(out, ' ');
               first = 0;
               omni_print_value_to(out, key);
-              fprintf(out, " ");
+              omni_writer_putc(out, ' ');
               omni_print_value_to(out, value);
             }
           }
-          cur = tail;
+          cur = omni_print_force(cur_val + 1);
         } else {
           break;
         }
       }
-      fprintf(out, "}");
+      omni_writer_putc(out, '}');
       return;
     }
 
     // #Sym{nick} - symbol
     if (ext == OMNI_NAM_SYM) {
-      Term nick_term = HEAP[val];
+      Term nick_term = omni_print_force(val);
       u32 nick = term_tag(nick_term) == NUM ? term_val(nick_term) : term_ext(nick_term);
       // Try symbol table lookup first (for hashed symbols)
       const char *sym_name = omni_symtab_lookup(nick);
       if (sym_name) {
-        fprintf(out, "%s", sym_name);
+        omni_writer_puts(out, sym_name);
       } else {
         // Fall back to nick decoding
         char name[64];
         nick_to_str(nick, name, sizeof(name));
-        fprintf(out, "%s", name);
+        omni_writer_puts(out, name);
       }
       return;
     }
 
     // #Str{...} - string (nick-encoded)
     if (ext == OMNI_NAM_STR) {
-      Term str_nick = HEAP[val];
+      Term str_nick = omni_print_force(val);
       if (term_tag(str_nick) == NUM) {
         char str[256];
         nick_to_str(term_val(str_nick), str, sizeof(str));
-        fprintf(out, "\"%s\"", str);
+        omni_writer_printf(out, "\"%s\"", str);
       } else {
-        fprintf(out, "\"...\"");
+        omni_writer_puts(out, "\"...\"");
       }
       return;
     }
 
     // #Lam{body} - lambda
     if (ext == OMNI_NAM_LAM) {
-      fprintf(out, "<lambda>");
+      omni_writer_puts(out, "<lambda>");
       return;
     }
 
     // #Clo{env, body} - closure
     if (ext == OMNI_NAM_CLO) {
-      fprintf(out, "<closure>");
+      omni_writer_puts(out, "<closure>");
       return;
     }
 
     // #CloR{marker, body} - recursive closure
     if (ext == OMNI_NAM_CLOR) {
-      fprintf(out, "<function>");
+      omni_writer_puts(out, "<function>");
       return;
     }
 
     // #Meth{...} - method
     if (ext == OMNI_NAM_METH) {
-      fprintf(out, "<method>");
+      omni_writer_puts(out, "<method>");
       return;
     }
 
     // #GFun{name, methods} - generic function
     if (ext == OMNI_NAM_GFUN) {
-      fprintf(out, "<function>");
+      omni_writer_puts(out, "<function>");
       return;
     }
 
     // #Prnt{msg} - print result (show the value)
     if (ext == OMNI_NAM_PRNT || ext == OMNI_NAM_PRNL) {
-      omni_print_value_to(out, HEAP[val]);
+      omni_print_value_to(out, omni_print_force(val));
       return;
     }
 
     // #Err{msg} - error
     if (ext == OMNI_NAM_ERR) {
-      fprintf(out, "Error: ");
-      omni_print_value_to(out, HEAP[val]);
+      omni_writer_puts(out, "Error: ");
+      omni_print_value_to(out, omni_print_force(val));
       return;
     }
 
@@ -673,16 +707,16 @@ fn void omni_print_value_to(FILE *out, Term t) {
     char name[16];
     nick_to_str(ext, name, sizeof(name));
 
-    fprintf(out, "#%s", name);
+    omni_writer_printf(out, "#%s", name);
     if (tag > C00) {
-      fprintf(out, "{");
+      omni_writer_putc(out, '{');
       u32 arity = tag - C00;
       for (u32 i = 0; i < arity && i < 3; i++) {
-        if (i > 0) fprintf(out, ", ");
-        omni_print_value_to(out, HEAP[val + i]);
+        if (i > 0) omni_writer_puts(out, ", ");
+        omni_print_value_to(out, omni_print_force(val + i));
       }
-      if (arity > 3) fprintf(out, ", ...");
-      fprintf(out, "}");
+      if (arity > 3) omni_writer_puts(out, ", ...");
+      omni_writer_putc(out, '}');
     }
     return;
   }
@@ -691,25 +725,30 @@ fn void omni_print_value_to(FILE *out, Term t) {
   if (tag == REF) {
     char *name = TABLE[ext];
     if (name) {
-      fprintf(out, "%s", name);
+      omni_writer_puts(out, name);
     } else {
-      fprintf(out, "@%u", ext);
+      omni_writer_printf(out, "@%u", ext);
     }
     return;
   }
 
   // Variables
   if (tag == VAR) {
-    fprintf(out, "v%u", val);
+    omni_writer_printf(out, "v%u", val);
     return;
   }
 
   // Default
-  fprintf(out, "<%u:%u:%u>", tag, ext, val);
+  omni_writer_printf(out, "<%u:%u:%u>", tag, ext, val);
 }
 
 fn void omni_print_value(Term t) {
-  omni_print_value_to(stdout, t);
+  // Anything already in stdio's buffer goes first
+  fflush(stdout);
+  OmniWriter out;
+  omni_writer_fd(&out, STDOUT_FILENO);
+  omni_print_value_to(&out, t);
+  omni_writer_close(&out);
 }
 
 // =============================================================================
@@ -749,106 +788,115 @@ fn char* omni_find_runtime_file(const char *filename) {
   return NULL;
 }
 
+// Runtime sources, in load order, with what each one is required for
+static const char *OMNI_RUNTIME_FILES[] = {
+  "prelude.hvm4",
+  "runtime.hvm4",
+  "types.hvm4",
+  "kinds.hvm4",
+};
+static const char *OMNI_RUNTIME_FILE_ROLES[] = {
+  "required for evaluation",
+  "required for evaluation",
+  "required for type system",
+  "required for higher-kinded types",
+};
+#define OMNI_RUNTIME_FILE_COUNT 4
+
+// Runtime image path (--image); NULL parses the sources every run
+static const char *g_runtime_image = NULL;
+static int g_runtime_image_rebuild = 0;  // --build-image: ignore existing image
+
+// --shake-runtime: parse only the reachable closure, the rest on demand.
+// Off by default: every definition is parsed up front. Honoured with a
+// single reducer thread only, where an on-demand parse cannot race one.
+static int g_runtime_shake = 0;
+
+// --stats-json: where run_evaluate writes its phase timings (- for stdout)
+static const char *g_stats_json = NULL;
+
 // Load runtime.hvm4 into the HVM4 book
-// Loads lib/prelude.hvm4 and lib/runtime.hvm4 definitions
+// Loads lib/prelude.hvm4, runtime.hvm4, types.hvm4 and kinds.hvm4 definitions.
+// With --image, maps the snapshot when it matches the sources and otherwise
+// parses them and rewrites the image. Without an image only the definitions
+// reachable from @omni_eval are parsed; the rest load on demand (load/deps.c).
 fn int omni_load_runtime(void) {
   if (g_runtime_loaded) return 0;  // Already loaded
 
-  // Find and load prelude.hvm4
-  char *prelude_path = omni_find_runtime_file("prelude.hvm4");
-  if (!prelude_path) {
-    fprintf(stderr, "Error: Could not find lib/prelude.hvm4 (required for evaluation)\n");
-    return 1;
-  }
-
-  char *prelude_src = sys_file_read(prelude_path);
-  if (!prelude_src) {
-    fprintf(stderr, "Error: Could not read %s\n", prelude_path);
-    return 1;
-  }
-
-  PState ps = {
-    .file = prelude_path,
-    .src  = prelude_src,
-    .pos  = 0,
-    .len  = (u32)strlen(prelude_src),
-    .line = 1,
-    .col  = 1
-  };
-  parse_def(&ps);
-  free(prelude_src);
-
-  // Find and load runtime.hvm4
-  char *runtime_path = omni_find_runtime_file("runtime.hvm4");
-  if (!runtime_path) {
-    fprintf(stderr, "Error: Could not find lib/runtime.hvm4 (required for evaluation)\n");
-    return 1;
-  }
-
-  char *runtime_src = sys_file_read(runtime_path);
-  if (!runtime_src) {
-    fprintf(stderr, "Error: Could not read %s\n", runtime_path);
-    return 1;
+  char *srcs[OMNI_RUNTIME_FILE_COUNT] = {0};
+  char *paths[OMNI_RUNTIME_FILE_COUNT] = {0};
+  int err = 0;
+  char phase[OMNI_PHASE_NAME_MAX];
+  OmniPhaseMark pm;
+
+  omni_phase_begin(&pm);
+  for (u32 i = 0; i < OMNI_RUNTIME_FILE_COUNT && !err; i++) {
+    char *path = omni_find_runtime_file(OMNI_RUNTIME_FILES[i]);
+    if (!path) {
+      fprintf(stderr, "Error: Could not find lib/%s (%s)\n",
+              OMNI_RUNTIME_FILES[i], OMNI_RUNTIME_FILE_ROLES[i]);
+      err = 1;
+      break;
+    }
+    paths[i] = strdup(path);  // omni_find_runtime_file reuses its buffer
+    srcs[i] = sys_file_read(path);
+    if (!srcs[i]) {
+      fprintf(stderr, "Error: Could not read %s\n", path);
+      err = 1;
+    }
   }
-
-  PState rs = {
-    .file = runtime_path,
-    .src  = runtime_src,
-    .pos  = 0,
-    .len  = (u32)strlen(runtime_src),
-    .line = 1,
-    .col  = 1
-  };
-  parse_def(&rs);
-  free(runtime_src);
-
-  // Find and load types.hvm4
-  char *types_path = omni_find_runtime_file("types.hvm4");
-  if (!types_path) {
-    fprintf(stderr, "Error: Could not find lib/types.hvm4 (required for type system)\n");
-    return 1;
+  omni_phase_end(&pm, "load:read");
+
+  u64 src_hash = 0;
+  int from_image = 0;
+  if (!err && g_runtime_image) {
+    src_hash = omni_image_hash_sources(OMNI_RUNTIME_FILES, srcs, OMNI_RUNTIME_FILE_COUNT);
+    if (!g_runtime_image_rebuild) {
+      omni_phase_begin(&pm);
+      from_image = omni_image_load(g_runtime_image, src_hash);
+      omni_phase_end(&pm, "load:image");
+    }
   }
 
-  char *types_src = sys_file_read(types_path);
-  if (!types_src) {
-    fprintf(stderr, "Error: Could not read %s\n", types_path);
-    return 1;
+  // Tree-shaken load (--shake-runtime): index every source, parse only the
+  // evaluator's closure. The index keeps the sources for later on-demand loads.
+  int shaken = 0;
+  if (!err && !from_image && !g_runtime_image && g_runtime_shake) {
+    for (u32 i = 0; i < OMNI_RUNTIME_FILE_COUNT; i++) {
+      omni_phase_begin(&pm);
+      omni_deps_add_file(paths[i], srcs[i]);
+      snprintf(phase, sizeof(phase), "load:index %s", OMNI_RUNTIME_FILES[i]);
+      omni_phase_end(&pm, phase);
+      srcs[i] = NULL;
+    }
+    omni_phase_begin(&pm);
+    omni_deps_build();
+    omni_deps_require_name("omni_eval", 9);
+    omni_deps_require_name("omni_menv_empty", 15);
+    omni_phase_end(&pm, "load:closure");
+    shaken = 1;
   }
 
-  PState ts = {
-    .file = types_path,
-    .src  = types_src,
-    .pos  = 0,
-    .len  = (u32)strlen(types_src),
-    .line = 1,
-    .col  = 1
-  };
-  parse_def(&ts);
-  free(types_src);
-
-  // Find and load kinds.hvm4 (higher-kinded types support)
-  char *kinds_path = omni_find_runtime_file("kinds.hvm4");
-  if (!kinds_path) {
-    fprintf(stderr, "Error: Could not find lib/kinds.hvm4 (required for higher-kinded types)\n");
-    return 1;
+  for (u32 i = 0; i < OMNI_RUNTIME_FILE_COUNT && !err && !from_image && !shaken; i++) {
+    PState ps = {
+      .file = paths[i],
+      .src  = srcs[i],
+      .pos  = 0,
+      .len  = (u32)strlen(srcs[i]),
+      .line = 1,
+      .col  = 1
+    };
+    omni_phase_begin(&pm);
+    parse_def(&ps);
+    snprintf(phase, sizeof(phase), "load:%s", OMNI_RUNTIME_FILES[i]);
+    omni_phase_end(&pm, phase);
   }
 
-  char *kinds_src = sys_file_read(kinds_path);
-  if (!kinds_src) {
-    fprintf(stderr, "Error: Could not read %s\n", kinds_path);
-    return 1;
+  for (u32 i = 0; i < OMNI_RUNTIME_FILE_COUNT; i++) {
+    free(srcs[i]);
+    free(paths[i]);
   }
-
-  PState ks = {
-    .file = kinds_path,
-    .src  = kinds_src,
-    .pos  = 0,
-    .len  = (u32)strlen(kinds_src),
-    .line = 1,
-    .col  = 1
-  };
-  parse_def(&ks);
-  free(kinds_src);
+  if (err) return 1;
 
   // Verify critical functions are loaded
   u32 eval_id = table_find("omni_eval", 9);
@@ -859,25 +907,41 @@ fn int omni_load_runtime(void) {
     return 1;
   }
 
+  // Missing or stale image: rebuild it from what was just parsed
+  if (g_runtime_image && !from_image) {
+    int save_err = omni_image_save(g_runtime_image, src_hash);
+    if (save_err != 0) {
+      fprintf(stderr, "%s: Could not write runtime image %s: %s\n",
+              g_runtime_image_rebuild ? "Error" : "Warning",
+              g_runtime_image, strerror(save_err));
+      if (g_runtime_image_rebuild) return 1;
+    }
+  }
+
   g_runtime_loaded = 1;
   return 0;
 }
 
-fn void omni_runtime_init(void) {
-  // Initialize HVM4 runtime
-  thread_set_count(1);
-  wnf_set_tid(0);
+fn void omni_runtime_init(u32 threads) {
+  // Initialize HVM4 runtime: one heap slice per reducer thread
+  omni_reducer_configure(threads);
 
   // Allocate global memory
+  // HEAP is mapped rather than calloc'd so it is page aligned and a runtime
+  // image can be mapped over its prefix
   BOOK  = calloc(BOOK_CAP, sizeof(u32));
-  HEAP  = calloc(HEAP_CAP, sizeof(Term));
+  HEAP  = mmap(NULL, HEAP_CAP * sizeof(Term), PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
   TABLE = calloc(BOOK_CAP, sizeof(char*));
 
+  if (HEAP == MAP_FAILED) HEAP = NULL;
   if (!BOOK || !HEAP || !TABLE) {
     fprintf(stderr, "Error: Memory allocation failed\n");
     exit(1);
   }
   heap_init_slices();
+  omni_image_mark();
+  omni_reducer_start();
 
   // Initialize OmniLisp names
   omni_names_init();
@@ -885,13 +949,26 @@ fn void omni_runtime_init(void) {
   // Initialize FFI
   omni_ffi_handle_init();
   omni_ffi_register_stdlib();
+  omni_ffi_register_io();
+  omni_ffi_register_buffer();
+  omni_ffi_register_pstring();
+  omni_ffi_register_stream();
+  omni_ffi_register_dt();
+  omni_ffi_register_json();
+  omni_ffi_register_uring();
+  omni_ffi_register_dynlib();
+  omni_ffi_register_internal(OMNI_NAM_PEVL, omni_spark_ffi_eval);
+  omni_ffi_register_internal(OMNI_NAM_SPLN, omni_spark_ffi_length);
 
   // Initialize FFI dispatch hook (must be after names init)
   omni_ffi_hook_init();
 }
 
 fn void omni_runtime_cleanup(void) {
+  omni_reducer_shutdown();
+
   // Cleanup FFI
+  omni_uring_shutdown();
   omni_ffi_pool_shutdown();
   omni_ffi_handle_cleanup();
 }
@@ -904,8 +981,8 @@ fn Term omni_reduce_with_ffi(Term t) {
   // Reduce to weak normal form
   Term result = wnf(t);
 
-  // Check if it's an FFI node (#FFI{name, args} has 2 args = C02)
-  if (term_tag(result) == C02 && term_ext(result) == OMNI_NAM_FFI) {
+  // Check if it's an FFI node (#FFI{name, args}, #FAsy, #FAsB, #FAwt)
+  if (omni_ffi_is_node(result)) {
     // Dispatch FFI call
     result = omni_ffi_dispatch(result);
   }
@@ -913,26 +990,434 @@ fn Term omni_reduce_with_ffi(Term t) {
   return result;
 }
 
+// =============================================================================
+// Normalization
+// =============================================================================
+//
+// Full normalization reduces a term to WNF and then every constructor field
+// below it. Fields are heap slots, so the pending work is just a stack of
+// heap locations: reducing a slot writes its WNF back in place and pushes
+// the slots of its fields. No C recursion, so a million-element list is no
+// deeper than a one-element one.
+//
+// With several reducer threads each keeps its own stack and pops from the
+// top (depth-first, left to right). When the shared pool runs dry, a busy
+// thread donates the bottom half of its stack, the oldest and usually the
+// largest subtrees, for idle threads to pick up. A list walked head first
+// never holds more than a cell or two on the stack, leaving nothing to
+// donate, so with several threads #CON cells go tail first instead: the
+// owner runs down the spine and the heads pile up below it, where donation
+// hands them out. The spine itself is still walked by one thread.
+
+#define OMNI_NORMALIZE_STACK_INIT    1024
+#define OMNI_NORMALIZE_DONATE_EVERY  256   // Slots reduced between donation checks
+#define OMNI_NORMALIZE_DONATE_MIN    16    // Keep small stacks to ourselves
+
+typedef struct {
+  u32 *data;
+  u32  len;
+  u32  cap;
+} OmniSlotStack;
+
+fn void omni_slot_stack_push(OmniSlotStack *s, u32 loc) {
+  if (s->len == s->cap) {
+    s->cap = s->cap ? s->cap * 2 : OMNI_NORMALIZE_STACK_INIT;
+    s->data = (u32*)realloc(s->data, (size_t)s->cap * sizeof(u32));
+  }
+  s->data[s->len++] = loc;
+}
+
+// Shared pool of slots handed between reducer threads
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t  ready;     // Work donated, or everyone finished
+  OmniSlotStack   slots;
+  atomic_uint     hungry;    // Threads waiting for work
+  u32             active;    // Threads holding work
+} OmniNormalizePool;
+
+// Reduce the slot at loc to WNF in place and queue its fields; spine_first
+// queues a #CON cell's tail ahead of its head
+fn void omni_normalize_slot(u32 loc, OmniSlotStack *stack, int spine_first) {
+  Term r = omni_reduce_with_ffi(HEAP[loc]);
+  HEAP[loc] = r;
+
+  u32 tag = term_tag(r);
+  if (tag <= C00 || tag > C16) return;
+
+  u32 val = term_val(r);
+  if (spine_first && tag == C02 && term_ext(r) == NAM_CON) {
+    omni_slot_stack_push(stack, val);
+    omni_slot_stack_push(stack, val + 1);
+    return;
+  }
+
+  // Push in reverse so field 0 is normalized first
+  for (u32 i = tag - C00; i > 0; i--) {
+    omni_slot_stack_push(stack, val + i - 1);
+  }
+}
+
+// Move the bottom half of a thread's stack to the shared pool
+fn void omni_normalize_donate(OmniNormalizePool *pool, OmniSlotStack *stack) {
+  u32 give = stack->len / 2;
+
+  pthread_mutex_lock(&pool->mutex);
+  for (u32 i = 0; i < give; i++) {
+    omni_slot_stack_push(&pool->slots, stack->data[i]);
+  }
+  pthread_cond_broadcast(&pool->ready);
+  pthread_mutex_unlock(&pool->mutex);
+
+  memmove(stack->data, stack->data + give, (size_t)(stack->len - give) * sizeof(u32));
+  stack->len -= give;
+}
+
+fn void omni_normalize_worker(u32 tid, void *ctx) {
+  (void)tid;
+  OmniNormalizePool *pool = (OmniNormalizePool*)ctx;
+  OmniSlotStack stack = {0};
+  int multi = omni_reducer_count() > 1;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    // Take shared work, or wait until some appears or nobody holds any
+    while (pool->slots.len == 0 && pool->active > 0) {
+      atomic_fetch_add(&pool->hungry, 1);
+      pthread_cond_wait(&pool->ready, &pool->mutex);
+      atomic_fetch_sub(&pool->hungry, 1);
+    }
+    if (pool->slots.len == 0) break;
+
+    // Take from the top, keeping the order so field 0 still comes first
+    u32 take = pool->slots.len / omni_reducer_count();
+    if (take == 0) take = 1;
+    pool->slots.len -= take;
+    for (u32 i = 0; i < take; i++) {
+      omni_slot_stack_push(&stack, pool->slots.data[pool->slots.len + i]);
+    }
+    pool->active++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    u32 since_check = 0;
+    while (stack.len > 0) {
+      omni_normalize_slot(stack.data[--stack.len], &stack, multi);
+
+      if (multi && ++since_check >= OMNI_NORMALIZE_DONATE_EVERY) {
+        since_check = 0;
+        if (stack.len >= OMNI_NORMALIZE_DONATE_MIN && atomic_load(&pool->hungry) > 0) {
+          omni_normalize_donate(pool, &stack);
+        }
+      }
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->active--;
+    if (pool->active == 0 && pool->slots.len == 0) {
+      pthread_cond_broadcast(&pool->ready);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  free(stack.data);
+}
+
 // Full normalization with FFI
 fn Term omni_normalize(Term t) {
-  Term wnf_result = omni_reduce_with_ffi(t);
+  Term root = omni_reduce_with_ffi(t);
+  u32 tag = term_tag(root);
+  if (tag <= C00 || tag > C16) return root;
+
+  OmniNormalizePool pool = {0};
+  pthread_mutex_init(&pool.mutex, NULL);
+  pthread_cond_init(&pool.ready, NULL);
+  atomic_init(&pool.hungry, 0);
+  for (u32 i = tag - C00; i > 0; i--) {
+    omni_slot_stack_push(&pool.slots, term_val(root) + i - 1);
+  }
 
-  // Continue normalization if needed
-  u32 tag = term_tag(wnf_result);
+  omni_reducer_parallel(omni_normalize_worker, &pool);
 
-  // Check if it's a constructor (C00-C16)
-  if (tag >= C00 && tag <= C16) {
-    u32 val = term_val(wnf_result);
-    u32 arity = tag - C00;
+  free(pool.slots.data);
+  pthread_cond_destroy(&pool.ready);
+  pthread_mutex_destroy(&pool.mutex);
+  return root;
+}
+
+// Reduce an evaluation for printing. With one reducer thread only the top is
+// reduced and the printer pulls the rest; with several, the whole result is
+// normalized in parallel first and the printer finds it already reduced.
+fn Term omni_eval_for_print(Term t) {
+  if (omni_reducer_count() > 1) return omni_normalize(t);
+  return omni_reduce_with_ffi(t);
+}
+
+// Evaluate a parsed program with the runtime interpreter:
+// @omni_eval(@omni_menv_empty)(ast), reduced for printing
+// Returns 0 if the runtime entry points are missing
+fn int omni_eval_ast(Term ast, Term *out) {
+  u32 eval_id = table_find("omni_eval", 9);
+  u32 menv_id = table_find("omni_menv_empty", 15);
+
+  if (BOOK[eval_id] == 0 || BOOK[menv_id] == 0) {
+    return 0;
+  }
+
+  Term eval_ref = term_new_ref(eval_id);
+  Term menv_ref = term_new_ref(menv_id);
+  Term eval_with_menv = term_new_app(eval_ref, menv_ref);
+  Term eval_expr = term_new_app(eval_with_menv, ast);
+  *out = omni_eval_for_print(eval_expr);
+  return 1;
+}
+
+// =============================================================================
+// Parallel Evaluation
+// =============================================================================
+//
+// omni_normalize only runs once evaluation is over. To give the reducer
+// threads work while the program is still evaluating, the runtime passes
+// them independent subterms through the FFI "PEvl": [n, xs] -> xs, with the
+// first n elements of the list (or of an #Arr's data) reduced to WNF. n is
+// #Cst{k} only when the caller knows the spine has k cells, so walking it
+// cannot run into an infinite or unforced list:
+//   - (map f xs) asks "SpLn" first. An #Arr has its length; a list counts
+//     only if its whole spine is already built in the heap (a quoted list,
+//     or one a previous PEvl walked). Anything else, including an #Iter, a
+//     #Rang or a lazily built list, gets #Noth{} and maps lazily.
+//   - (reduce-tree f init xs) takes the length once and passes it down,
+//     handing each pair of halves over as a PEvl of 2.
+//
+// Each element becomes a spark: a heap slot plus the pending count of the
+// call that queued it. The first call on the main thread opens a parallel
+// section, and the other threads run sparks until that call has all its
+// elements. Calls made inside the section, such as a map inside a mapped
+// function or the halves of a half, queue their sparks in the same pool.
+// A caller reduces its first element itself. While its other sparks are
+// out, it runs whatever sparks are queued, so a thread only sleeps when
+// the pool is empty. The elements are independent thunks, so the thread
+// that reduces one doesn't change the result. It only changes the order of
+// any FFI effects inside them. A spark is reduced in the handle scope its
+// call was made in.
+//
+// With one reducer thread, or under another section (omni_normalize),
+// "SpLn" reports no length and "PEvl" returns xs after reducing only its
+// head, so map stays lazy.
+
+#define OMNI_SPARK_INIT 256
+
+typedef struct {
+  u32          loc;      // Heap slot reduced to WNF in place
+  atomic_uint *pending;  // Sparks of the queuing call not yet reduced
+  u32          scope;    // Handle scope of the queuing thread (handle.c)
+} OmniSpark;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t  ready;  // Sparks queued, a call's last spark reduced, or section over
+  OmniSpark      *data;
+  u32             len;
+  u32             cap;
+  atomic_int      open;   // A spark section is running
+  int             done;   // The section's first call has all its elements
+} OmniSparkPool;
+
+static OmniSparkPool OMNI_SPARKS = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .ready = PTHREAD_COND_INITIALIZER,
+};
+
+// Queue locs[1..n-1] as sparks counted against pending, locs[1] on top
+fn void omni_spark_queue(u32 *locs, u32 n, atomic_uint *pending) {
+  pthread_mutex_lock(&OMNI_SPARKS.mutex);
+  if (OMNI_SPARKS.len + n > OMNI_SPARKS.cap) {
+    u32 cap = OMNI_SPARKS.cap ? OMNI_SPARKS.cap : OMNI_SPARK_INIT;
+    while (cap < OMNI_SPARKS.len + n) cap *= 2;
+    OMNI_SPARKS.data = (OmniSpark*)realloc(OMNI_SPARKS.data, (size_t)cap * sizeof(OmniSpark));
+    OMNI_SPARKS.cap = cap;
+  }
+  u32 scope = omni_ffi_handle_scope_current();
+  for (u32 i = n; i > 1; i--) {
+    OMNI_SPARKS.data[OMNI_SPARKS.len++] = (OmniSpark){locs[i - 1], pending, scope};
+  }
+  pthread_cond_broadcast(&OMNI_SPARKS.ready);
+  pthread_mutex_unlock(&OMNI_SPARKS.mutex);
+}
+
+fn void omni_spark_reduce(OmniSpark sp) {
+  u32 scope = omni_ffi_handle_scope_enter(sp.scope);
+  HEAP[sp.loc] = omni_reduce_with_ffi(HEAP[sp.loc]);
+  omni_ffi_handle_scope_enter(scope);
+  if (atomic_fetch_sub(sp.pending, 1) == 1) {
+    pthread_mutex_lock(&OMNI_SPARKS.mutex);
+    pthread_cond_broadcast(&OMNI_SPARKS.ready);
+    pthread_mutex_unlock(&OMNI_SPARKS.mutex);
+  }
+}
+
+// Run queued sparks until *pending reaches zero, or with pending NULL until
+// the section is done
+fn void omni_spark_help(atomic_uint *pending) {
+  pthread_mutex_lock(&OMNI_SPARKS.mutex);
+  while (pending ? atomic_load(pending) > 0 : !OMNI_SPARKS.done) {
+    if (OMNI_SPARKS.len == 0) {
+      pthread_cond_wait(&OMNI_SPARKS.ready, &OMNI_SPARKS.mutex);
+      continue;
+    }
+    OmniSpark sp = OMNI_SPARKS.data[--OMNI_SPARKS.len];
+    pthread_mutex_unlock(&OMNI_SPARKS.mutex);
+    omni_spark_reduce(sp);
+    pthread_mutex_lock(&OMNI_SPARKS.mutex);
+  }
+  pthread_mutex_unlock(&OMNI_SPARKS.mutex);
+}
+
+// Reduce every slot in locs, all but the first as sparks
+fn void omni_spark_fork(u32 *locs, u32 n) {
+  atomic_uint pending;
+  atomic_init(&pending, n - 1);
+  omni_spark_queue(locs, n, &pending);
+  HEAP[locs[0]] = omni_reduce_with_ffi(HEAP[locs[0]]);
+  omni_spark_help(&pending);
+}
+
+typedef struct {
+  u32 *locs;
+  u32  n;
+} OmniSparkRoot;
+
+fn void omni_spark_worker(u32 tid, void *ctx) {
+  if (tid != 0) {
+    omni_spark_help(NULL);
+    return;
+  }
+  OmniSparkRoot *root = (OmniSparkRoot*)ctx;
+  omni_spark_fork(root->locs, root->n);
+
+  pthread_mutex_lock(&OMNI_SPARKS.mutex);
+  OMNI_SPARKS.done = 1;
+  pthread_cond_broadcast(&OMNI_SPARKS.ready);
+  pthread_mutex_unlock(&OMNI_SPARKS.mutex);
+}
+
+// Whether a PEvl made here would hand out sparks
+fn int omni_spark_can_fork(void) {
+  if (omni_reducer_count() <= 1) return 0;
+  if (atomic_load(&OMNI_SPARKS.open)) return 1;
+  return omni_reducer_tid == 0 && !omni_reducer_busy();
+}
+
+// Length of an #Arr, or of a list whose cells are all built (heap reads
+// only: an unforced tail anywhere means the length is not known)
+fn int omni_spark_known_length(Term xs, u32 *out) {
+  if (term_tag(xs) == C02 && term_ext(xs) == OMNI_NAM_ARR) {
+    Term len = HEAP[term_val(xs)];
+    if (term_tag(len) != NUM) return 0;
+    *out = term_val(len);
+    return 1;
+  }
+  u32 n = 0;
+  Term cell = xs;
+  while (term_tag(cell) == C02 && term_ext(cell) == NAM_CON) {
+    n++;
+    cell = HEAP[term_val(cell) + 1];
+  }
+  if (term_tag(cell) != C00 || term_ext(cell) != NAM_NIL) return 0;
+  *out = n;
+  return 1;
+}
 
-    for (u32 i = 0; i < arity; i++) {
-      Term child = HEAP[val + i];
-      Term normalized = omni_normalize(child);
-      HEAP[val + i] = normalized;
+// FFI "SpLn": [xs] -> [n, xs], n being #Cst{length} if PEvl could spark xs
+// and its length is known without reducing anything, #Noth{} otherwise
+fn Term omni_spark_ffi_length(Term args) {
+  Term xs;
+  if (omni_buf_args(args, &xs, 1) != 1) return args;
+  u32 len;
+  Term n = term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+  if (omni_spark_can_fork() && omni_spark_known_length(xs, &len)) {
+    Term k = term_new_num(len);
+    n = term_new_ctr(OMNI_NAM_CST, 1, &k);
+  }
+  Term tail[2] = {xs, term_new_ctr(NAM_NIL, 0, NULL)};
+  Term pair[2] = {n, term_new_ctr(NAM_CON, 2, tail)};
+  return term_new_ctr(NAM_CON, 2, pair);
+}
+
+// FFI "PEvl": [n, xs] -> xs, the first n elements of xs reduced on the
+// reducer threads; with n not a #Cst, xs as it is
+fn Term omni_spark_ffi_eval(Term args) {
+  Term a[2];
+  if (omni_buf_args(args, a, 2) != 2) return args;
+  Term xs = a[1];
+
+  int top = !atomic_load(&OMNI_SPARKS.open);
+  if (!omni_spark_can_fork()) return xs;
+  if (term_tag(a[0]) != C01 || term_ext(a[0]) != OMNI_NAM_CST) return xs;
+  u32 n = term_val(omni_reduce_with_ffi(HEAP[term_val(a[0])]));
+
+  // Walk n cells of the spine; the elements stay unevaluated
+  Term cell = xs;
+  if (term_tag(xs) == C02 && term_ext(xs) == OMNI_NAM_ARR) {
+    cell = omni_reduce_with_ffi(HEAP[term_val(xs) + 1]);
+    HEAP[term_val(xs) + 1] = cell;
+  }
+  OmniSlotStack locs = {0};
+  while (locs.len < n && term_tag(cell) == C02 && term_ext(cell) == NAM_CON) {
+    u32 val = term_val(cell);
+    omni_slot_stack_push(&locs, val);
+    if (locs.len == n) break;
+    cell = omni_reduce_with_ffi(HEAP[val + 1]);
+    HEAP[val + 1] = cell;
+  }
+
+  if (locs.len > 1 && top) {
+    OmniSparkRoot root = {locs.data, locs.len};
+    OMNI_SPARKS.done = 0;
+    atomic_store(&OMNI_SPARKS.open, 1);
+    omni_reducer_parallel(omni_spark_worker, &root);
+    atomic_store(&OMNI_SPARKS.open, 0);
+  } else if (locs.len > 1) {
+    omni_spark_fork(locs.data, locs.len);
+  }
+
+  free(locs.data);
+  return xs;
+}
+
+// =============================================================================
+// Telemetry Report
+// =============================================================================
+
+#define OMNI_TELEMETRY_TOP 10
+
+// Print the constructor-entry histograms gathered by the dispatch hook
+fn void omni_print_telemetry(void) {
+  static OmniTelemetry sum;
+  OmniTelemetrySlot top[OMNI_TELEMETRY_TOP];
+  u32 n = omni_telemetry_summary(&sum, top, OMNI_TELEMETRY_TOP);
+
+  printf("  Constructor entries: %llu", (unsigned long long)sum.entries);
+  if (OMNI_TELEMETRY_SAMPLE > 1) printf(" (sampled 1 in %d)", OMNI_TELEMETRY_SAMPLE);
+  printf("\n");
+  for (u32 i = 0; i < OMNI_TELEMETRY_TAGS; i++) {
+    if (sum.tags[i] > 0) {
+      printf("    C%02u: %llu\n", i, (unsigned long long)sum.tags[i]);
     }
   }
 
-  return wnf_result;
+  printf("  Top constructors:\n");
+  for (u32 i = 0; i < n; i++) {
+    u32 idx = (top[i].key >> 24) - 1;
+    u32 ext = top[i].key & 0xFFFFFF;
+    char name[16];
+    nick_to_str(ext, name, sizeof(name));
+    printf("    #%-6s C%02u %10u%s\n", name, idx, top[i].count,
+           ext == OMNI_NAM_FFI ? "  (FFI)" : "");
+  }
+  if (sum.dropped > 0) {
+    printf("    (%llu entries in full histogram buckets not itemized)\n",
+           (unsigned long long)sum.dropped);
+  }
 }
 
 // =============================================================================
@@ -991,10 +1476,18 @@ fn int run_compile_only(const char *source, const char *output, int debug) {
 }
 
 fn int run_evaluate(const char *source, int collapse_limit, int stats, int debug, int hvm4_print) {
+  // Load runtime.hvm4 if not already loaded. This happens before parsing so a
+  // runtime image maps onto an untouched heap and user defines are not
+  // overwritten by runtime definitions of the same name.
+  int runtime_err = omni_load_runtime();
+  OmniPhaseMark pm;
+
+  omni_phase_begin(&pm);
   OmniParse parse;
   omni_parse_init(&parse, source);
 
   Term ast = omni_parse(&parse);
+  omni_phase_end(&pm, "parse");
 
   if (parse.error) {
     fprintf(stderr, "Parse error at line %u, col %u: %s\n",
@@ -1002,15 +1495,17 @@ fn int run_evaluate(const char *source, int collapse_limit, int stats, int debug
     return 1;
   }
 
+  // Pull in the runtime definitions this program can reach
+  omni_phase_begin(&pm);
+  omni_deps_require_ast(ast);
+  omni_phase_end(&pm, "load:closure");
+
   if (debug) {
     printf("AST:\n");
     print_ast(ast);
     printf("\nEvaluating...\n\n");
   }
 
-  // Load runtime.hvm4 if not already loaded
-  int runtime_err = omni_load_runtime();
-
   Term result;
 
   if (runtime_err == 0 && g_runtime_loaded) {
@@ -1035,58 +1530,63 @@ fn int run_evaluate(const char *source, int collapse_limit, int stats, int debug
     // @omni_eval(@omni_menv_empty)(ast)
     Term eval_expr = term_new_app(eval_with_menv, ast);
 
-    // Evaluate to strong normal form
-    result = omni_normalize(eval_expr);
+    // Evaluate to WNF
+    omni_phase_begin(&pm);
+    result = omni_reduce_with_ffi(eval_expr);
+    omni_phase_end(&pm, "eval");
+
+    // print_term needs the strong normal form, and several reducers normalize
+    // faster up front; otherwise the printer pulls fields as it goes
+    if (hvm4_print || omni_reducer_count() > 1) {
+      omni_phase_begin(&pm);
+      result = omni_normalize(result);
+      omni_phase_end(&pm, "normalize");
+    }
   } else {
     // Runtime is required - no fallback interpreter
     fprintf(stderr, "Error: runtime.hvm4 failed to load - cannot evaluate\n");
     return 1;
   }
 
-  // Debug: show how many times the FFI hook was called
-  if (omni_ffi_debug) {
-    fprintf(stderr, "[DEBUG] FFI hook called %lu times\n", omni_hook_calls);
-    fprintf(stderr, "[DEBUG] Total constructor enters: %lu\n", omni_ctr_enter_count);
-    // Show tag distribution with ext breakdown
-    fprintf(stderr, "[DEBUG] Constructor tag breakdown:\n");
-    for (int i = 0; i <= 16; i++) {
-      if (omni_tag_counts[i] > 0) {
-        fprintf(stderr, "  C%02d: %lu entries, %u unique exts\n", i, omni_tag_counts[i], omni_unique_ext_per_tag[i]);
-        // Show top exts for this tag
-        for (unsigned int j = 0; j < omni_unique_ext_per_tag[i] && j < 5; j++) {
-          fprintf(stderr, "    ext=%lu (count=%lu)%s\n",
-                  (unsigned long)omni_ext_per_tag[i][j],
-                  (unsigned long)omni_ext_count_per_tag[i][j],
-                  omni_ext_per_tag[i][j] == OMNI_NAM_FFI ? " <-- FFI!" : "");
-        }
-      }
-    }
-    // Also check if FFI ext appears in C02
-    fprintf(stderr, "[DEBUG] Checking for FFI (ext=%u) in C02: ", OMNI_NAM_FFI);
-    int found = 0;
-    for (unsigned int j = 0; j < omni_unique_ext_per_tag[2]; j++) {
-      if (omni_ext_per_tag[2][j] == OMNI_NAM_FFI) {
-        fprintf(stderr, "FOUND! (count=%lu)\n", (unsigned long)omni_ext_count_per_tag[2][j]);
-        found = 1;
-        break;
-      }
-    }
-    if (!found) fprintf(stderr, "NOT FOUND\n");
-  }
-
+  // At -j 1 the result is only in WNF, and the printer reduces the rest as
+  // it goes: that reduction is counted under eval
+  OmniPhaseMark pulled = {0};
+  omni_phase_begin(&pm);
   printf("Result: ");
   if (hvm4_print) {
     // Use HVM4's print_term for coverage testing
     print_term(result);
   } else {
+    g_print_pulled = &pulled;
     omni_print_value(result);
+    g_print_pulled = NULL;
   }
   printf("\n");
+  fflush(stdout);
+  omni_phase_end(&pm, "print");
+  omni_phase_move(&pulled, "print", "eval");
 
   if (stats) {
     printf("\nStatistics:\n");
     printf("  Handles allocated: %u\n", omni_ffi_handle_count());
     printf("  Interactions: %llu\n", (unsigned long long)wnf_itrs_total());
+    if (omni_deps_def_count() > 0) {
+      printf("  Runtime defs loaded: %u/%u\n", omni_deps_loaded_count(), omni_deps_def_count());
+    }
+    omni_stats_print_phases(stdout);
+    if (omni_telemetry_enabled()) {
+      omni_print_telemetry();
+    }
+  }
+
+  if (g_stats_json) {
+    FILE *out = strcmp(g_stats_json, "-") == 0 ? stdout : fopen(g_stats_json, "w");
+    if (!out) {
+      fprintf(stderr, "Error: cannot write %s: %s\n", g_stats_json, strerror(errno));
+      return 1;
+    }
+    omni_stats_write_json(out, wnf_itrs_total(), omni_ffi_handle_count());
+    if (out != stdout) fclose(out);
   }
 
   return 0;
@@ -1098,56 +1598,64 @@ fn int run_evaluate(const char *source, int collapse_limit, int stats, int debug
 
 #define REPL_BUFFER_SIZE 4096
 
-// Evaluate a single expression and write result to output
-// Returns result string (caller must free) or NULL on error
-fn char* eval_to_string(const char *source, int debug) {
+// Heap checkpoint for REPL/server evaluations: taken once the runtime is
+// loaded, advanced past each evaluation's definitions
+static OmniHeapMark g_eval_mark = {0};
+static int g_eval_mark_ready = 0;
+
+// Evaluate a single expression and print the result (or error) to out
+// Allocations stay on the heap; see eval_to_writer
+fn void eval_to_writer_uncommitted(const char *source, int debug, OmniWriter *out) {
   OmniParse parse;
   omni_parse_init(&parse, source);
 
   Term ast = omni_parse(&parse);
 
   if (parse.error) {
-    char *err = (char*)malloc(256);
-    snprintf(err, 256, "Parse error at line %u, col %u: %s",
-             parse.line, parse.col, parse.error);
-    return err;
+    omni_writer_printf(out, "Parse error at line %u, col %u: %s",
+                       parse.line, parse.col, parse.error);
+    return;
   }
 
-  // Load runtime if not loaded
-  omni_load_runtime();
+  omni_deps_require_ast(ast);
 
   Term result;
 
   if (!g_runtime_loaded) {
-    return strdup("Error: runtime.hvm4 failed to load");
+    omni_writer_puts(out, "Error: runtime.hvm4 failed to load");
+    return;
   }
 
   // Use the HVM4 interpreter
-  u32 eval_id = table_find("omni_eval", 9);
-  u32 menv_id = table_find("omni_menv_empty", 15);
-
-  if (BOOK[eval_id] == 0 || BOOK[menv_id] == 0) {
-    return strdup("Error: runtime.hvm4 missing required definitions");
+  if (!omni_eval_ast(ast, &result)) {
+    omni_writer_puts(out, "Error: runtime.hvm4 missing required definitions");
+    return;
   }
 
-  Term eval_ref = term_new_ref(eval_id);
-  Term menv_ref = term_new_ref(menv_id);
-  Term eval_with_menv = term_new_app(eval_ref, menv_ref);
-  Term eval_expr = term_new_app(eval_with_menv, ast);
-  result = omni_normalize(eval_expr);
+  // Stream the result through the user-friendly printer
+  omni_print_value_to(out, result);
+}
 
-  // Convert result to string using user-friendly printer
-  char *buf = (char*)malloc(REPL_BUFFER_SIZE);
-  FILE *memstream = fmemopen(buf, REPL_BUFFER_SIZE - 1, "w");
-  if (!memstream) {
-    free(buf);
-    return strdup("Error: failed to create output stream");
+// Evaluate a single expression and print the result (or error) to out
+// Once the result is printed, everything the evaluation allocated is rolled
+// back except the definitions it made, so a long session does not grow the
+// heap without bound.
+fn void eval_to_writer(const char *source, int debug, OmniWriter *out) {
+  // Load runtime if not loaded (before parsing, see run_evaluate)
+  if (omni_load_runtime() == 0 && !g_eval_mark_ready) {
+    omni_heap_mark(&g_eval_mark);
+    g_eval_mark_ready = 1;
   }
 
-  omni_print_value_to(memstream, result);
-  fclose(memstream);
+  eval_to_writer_uncommitted(source, debug, out);
 
-  return buf;
+  if (g_eval_mark_ready) {
+    u64 used = omni_heap_used_since(&g_eval_mark);
+    if (!omni_heap_commit(&g_eval_mark)) {
+      fprintf(stderr, "Note: a definition holds a term the heap commit cannot move; "
+                      "keeping %llu heap words\n", (unsigned long long)used);
+    }
+  }
 }
 
 fn int run_repl(int debug) {
@@ -1197,12 +1705,13 @@ fn int run_repl(int debug) {
       continue;
     }
 
-    // Evaluate expression
-    char *result = eval_to_string(line, debug);
-    if (result) {
-      printf("%s\n", result);
-      free(result);
-    }
+    // Evaluate expression, streaming the result to the terminal
+    fflush(stdout);
+    OmniWriter out;
+    omni_writer_fd(&out, STDOUT_FILENO);
+    eval_to_writer(line, debug, &out);
+    omni_writer_putc(&out, '\n');
+    omni_writer_close(&out);
   }
 
   return 0;
@@ -1248,17 +1757,12 @@ fn int handle_client(int client_fd, int debug) {
       continue;
     }
 
-    // Evaluate and send result
-    char *result = eval_to_string(buffer, debug);
-    if (result) {
-      send(client_fd, result, strlen(result), 0);
-      free(result);
-    } else {
-      send(client_fd, "Error: evaluation failed", 24, 0);
-    }
-
-    // Send delimiter: null byte + newline
-    send(client_fd, "\0\n", 2, 0);
+    // Evaluate and stream the result, then the delimiter: null byte + newline
+    OmniWriter out;
+    omni_writer_socket(&out, client_fd);
+    eval_to_writer(buffer, debug, &out);
+    omni_writer_put(&out, "\0\n", 2);
+    omni_writer_close(&out);
   }
 
   close(client_fd);
@@ -1349,6 +1853,237 @@ fn int run_server(int port, int debug) {
   return 0;
 }
 
+// =============================================================================
+// Batch Mode - Many Programs Against One Loaded Runtime
+// =============================================================================
+//
+// Manifest: one JSON object per line, {"id": ..., "source": "..."}.
+// id may be a string or a number and is echoed back verbatim.
+//
+// Output: one JSON object per job, in manifest order:
+//   {"id": ..., "value": "...", "itrs": N, "ms": T}
+//   {"id": ..., "error": "..."}
+//
+// The heap is rolled back to the post-runtime mark after every job, so jobs
+// cannot see each other's defines and memory use stays flat.
+
+// Find "key": in a flat JSON object; returns a pointer to its value or NULL
+fn const char* omni_batch_json_find(const char *line, const char *key) {
+  size_t klen = strlen(key);
+  const char *p = line;
+  while ((p = strchr(p, '"')) != NULL) {
+    if (strncmp(p + 1, key, klen) == 0 && p[klen + 1] == '"') {
+      const char *v = p + klen + 2;
+      while (*v == ' ' || *v == '\t') v++;
+      if (*v == ':') {
+        v++;
+        while (*v == ' ' || *v == '\t') v++;
+        return v;
+      }
+    }
+    // Skip this string (key or value) including escapes
+    p++;
+    while (*p && *p != '"') {
+      if (*p == '\\' && p[1]) p++;
+      p++;
+    }
+    if (*p) p++;
+  }
+  return NULL;
+}
+
+// Decode a JSON string starting at its opening quote, with json.c's
+// escape decoder. Returns a malloc'd UTF-8 string, or NULL if v is not a
+// well-formed string.
+fn char* omni_batch_json_string(const char *v) {
+  if (*v != '"') return NULL;
+  v++;
+  const char *end = v + strlen(v);
+  char *out = (char*)malloc((size_t)(end - v) + 1);
+  if (!out) return NULL;
+  size_t n = 0;
+  while (v < end && *v != '"') {
+    char c = *v++;
+    if (c != '\\') { out[n++] = c; continue; }
+    if (v == end) break;
+    c = *v++;
+    switch (c) {
+      case 'n': out[n++] = '\n'; break;
+      case 't': out[n++] = '\t'; break;
+      case 'r': out[n++] = '\r'; break;
+      case 'b': out[n++] = '\b'; break;
+      case 'f': out[n++] = '\f'; break;
+      case 'u': {
+        u32 cp;
+        if (!omni_json_unescape_u(&v, end, &cp)) {
+          free(out);
+          return NULL;
+        }
+        n += omni_json_put_utf8(out + n, cp);
+        break;
+      }
+      default: out[n++] = c; break;  // \" \\ \/
+    }
+  }
+  if (v == end) {
+    free(out);
+    return NULL;  // No closing quote
+  }
+  out[n] = '\0';
+  return out;
+}
+
+// Copy the raw JSON value at v (string or scalar) for echoing back
+fn char* omni_batch_json_raw(const char *v) {
+  const char *e = v;
+  if (*e == '"') {
+    e++;
+    while (*e && *e != '"') {
+      if (*e == '\\' && e[1]) e++;
+      e++;
+    }
+    if (*e) e++;
+  } else {
+    while (*e && *e != ',' && *e != '}' && *e != ' ' && *e != '\n') e++;
+  }
+  return strndup(v, (size_t)(e - v));
+}
+
+fn void omni_batch_write_json_string(FILE *out, const char *s, size_t len) {
+  fputc('"', out);
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\') {
+      fputc('\\', out);
+      fputc(c, out);
+    } else if (c == '\n') {
+      fputs("\\n", out);
+    } else if (c < 0x20) {
+      fprintf(out, "\\u%04x", c);
+    } else {
+      fputc(c, out);
+    }
+  }
+  fputc('"', out);
+}
+
+fn double omni_batch_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+fn int run_batch(const char *manifest, const char *output, int debug) {
+  FILE *in = strcmp(manifest, "-") == 0 ? stdin : fopen(manifest, "r");
+  if (!in) {
+    fprintf(stderr, "Error: Cannot open manifest '%s': %s\n", manifest, strerror(errno));
+    return 1;
+  }
+  FILE *out = stdout;
+  if (output) {
+    out = fopen(output, "w");
+    if (!out) {
+      fprintf(stderr, "Error: Cannot create output file '%s'\n", output);
+      if (in != stdin) fclose(in);
+      return 1;
+    }
+  }
+
+  if (omni_load_runtime() != 0) {
+    fprintf(stderr, "Error: runtime.hvm4 failed to load - cannot evaluate\n");
+    if (in != stdin) fclose(in);
+    if (out != stdout) fclose(out);
+    return 1;
+  }
+
+  // Each job starts from this state: the heap and BOOK are rolled back,
+  // the handles it made are released and the FFI names it declared dropped
+  OmniHeapMark base = {0};
+  omni_heap_mark(&base);
+  u32 ffi_base = omni_ffi_registry_mark();
+
+  char *line = NULL;
+  size_t line_cap = 0;
+  u32 line_no = 0;
+  u32 failed = 0;
+
+  while (g_running && getline(&line, &line_cap, in) > 0) {
+    line_no++;
+    const char *p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '\n' || *p == '\0') continue;
+
+    const char *id_val = omni_batch_json_find(line, "id");
+    const char *src_val = omni_batch_json_find(line, "source");
+    char *id = id_val ? omni_batch_json_raw(id_val) : NULL;
+    char *source = src_val ? omni_batch_json_string(src_val) : NULL;
+
+    fputs("{\"id\":", out);
+    if (id) fputs(id, out); else fprintf(out, "%u", line_no);
+
+    if (!source) {
+      fputs(",\"error\":\"missing \\\"source\\\" string\"}\n", out);
+      failed++;
+      free(id);
+      continue;
+    }
+
+    double t0 = omni_batch_now_ms();
+    u64 itrs0 = wnf_itrs_total();
+    u32 handles = omni_ffi_handle_scope_begin();
+
+    OmniParse parse;
+    omni_parse_init(&parse, source);
+    Term ast = omni_parse(&parse);
+
+    if (parse.error) {
+      char msg[256];
+      int n = snprintf(msg, sizeof(msg), "Parse error at line %u, col %u: %s",
+                       parse.line, parse.col, parse.error);
+      fputs(",\"error\":", out);
+      omni_batch_write_json_string(out, msg, (size_t)n < sizeof(msg) ? (size_t)n : sizeof(msg) - 1);
+      failed++;
+    } else {
+      omni_deps_require_ast(ast);
+      Term result;
+      if (!omni_eval_ast(ast, &result)) {
+        fputs(",\"error\":\"runtime.hvm4 missing required definitions\"", out);
+        failed++;
+      } else {
+        OmniWriter mem;
+        omni_writer_mem(&mem);
+        omni_print_value_to(&mem, result);
+        size_t len = 0;
+        char *buf = omni_writer_take(&mem, &len);
+
+        double ms = omni_batch_now_ms() - t0;
+        fputs(",\"value\":", out);
+        omni_batch_write_json_string(out, buf, len);
+        fprintf(out, ",\"itrs\":%llu,\"ms\":%.3f",
+                (unsigned long long)(wnf_itrs_total() - itrs0), ms);
+        if (debug) {
+          fprintf(out, ",\"heap\":%llu", (unsigned long long)omni_heap_used_since(&base));
+        }
+        free(buf);
+      }
+    }
+    fputs("}\n", out);
+    fflush(out);
+
+    free(id);
+    free(source);
+    omni_ffi_handle_scope_end(handles);
+    omni_ffi_registry_truncate(ffi_base);
+    omni_heap_reset(&base);
+  }
+
+  free(line);
+  omni_heap_mark_free(&base);
+  if (in != stdin) fclose(in);
+  if (out != stdout) fclose(out);
+  return failed > 0 ? 1 : 0;
+}
+
 // =============================================================================
 // Main
 // =============================================================================
@@ -1366,17 +2101,40 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
-  // Initialize runtime
-  omni_runtime_init();
+  // FFI workers start with the first async call
+  omni_ffi_pool_configure(omni_ffi_workers_wanted(opts.ffi_workers));
+
+  // Initialize runtime (the profiler measures a single reducer thread)
+  omni_runtime_init(opts.profile ? 1 : omni_reducer_threads_wanted(opts.threads));
+  if (opts.profile) {
+    omni_profile_start(opts.profile);
+  }
 
   // Enable type checking if requested
   if (opts.type_check) {
     omni_enable_type_check(1);
   }
 
+  g_runtime_image = opts.build_image ? opts.build_image : opts.image;
+  g_runtime_image_rebuild = opts.build_image != NULL;
+  g_runtime_shake = opts.shake_runtime && omni_reducer_count() == 1;
+  if (opts.shake_runtime && !g_runtime_shake) {
+    fprintf(stderr, "Note: --shake-runtime needs -j 1; loading the full runtime\n");
+  }
+  g_stats_json = opts.stats_json;
+
   int result = 0;
 
-  if (opts.server_port > 0) {
+  if (opts.build_image) {
+    // Parse the runtime sources and snapshot them
+    result = omni_load_runtime();
+    if (result == 0) printf("Wrote runtime image: %s\n", opts.build_image);
+  } else if (opts.batch) {
+    // Batch mode: the runtime is loaded once, so load all of it rather than
+    // re-parsing lazily loaded definitions after every heap rollback
+    g_runtime_shake = 0;
+    result = run_batch(opts.batch, opts.output, opts.debug);
+  } else if (opts.server_port > 0) {
     // Socket server mode
     result = run_server(opts.server_port, opts.debug);
   } else if (opts.interactive) {
@@ -1411,6 +2169,10 @@ int main(int argc, char *argv[]) {
     result = run_repl(opts.debug);
   }
 
+  if (opts.profile && omni_profile_finish() != 0 && result == 0) {
+    result = 1;
+  }
+
   // Cleanup
   omni_runtime_cleanup();
 
@@ -0,0 +1,435 @@
+// OmniLisp Reduction Profiler
+// --profile FILE: attribute interactions and wall time, folded-stack output
+//
+// The profiler keeps a stack of the OmniLisp definitions being run. While it
+// records, BkGt (#FRef) hands out each function's AST with its body wrapped
+// in #PBdy{id, body}; the @omni_eval arm for #PBdy pushes a frame for id
+// ("PfIn") before evaluating the body and pops back to it ("PfOu") once the
+// body is in weak normal form. Evaluation is lazy, so work a caller forces
+// later is charged to the caller, as with other lazy cost-centre profilers.
+//
+// Interactions (wnf_itrs_total) are charged exactly, on every constructor
+// entry and frame change, to the context
+//   omnilisp;<def>;<def>;...;#<Ctr>
+// where the defs are the stack from the outermost call and #<Ctr> is the
+// constructor being entered; for AST nodes that is the @omni_eval arm at
+// work. Wall time is sampled: every OMNI_PROFILE_TIME_EVERY events the
+// clock is read once and the time since the last sample goes to the context
+// current at the sample.
+//
+// Stacks are interned as a tree of frames, so a context costs one node and
+// one table entry however deep it is. Frames deeper than
+// OMNI_PROFILE_MAX_DEPTH are counted but not recorded.
+//
+// Output is folded stacks ("frame;frame;frame weight" per line) as read by
+// flamegraph.pl and speedscope:
+//   FILE       weighted by interactions
+//   FILE.time  weighted by wall time in microseconds
+//
+// Profiling runs with a single reducer thread, so the global interaction
+// counter belongs to the thread being measured.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// =============================================================================
+// Profile Tables
+// =============================================================================
+
+#define OMNI_PROFILE_ROOT        0            // Frame of the top level
+#define OMNI_PROFILE_INIT_CAP    1024         // Power of 2
+#define OMNI_PROFILE_MAX_DEPTH   512          // Frames recorded per stack
+#define OMNI_PROFILE_TIME_EVERY  64           // Events between clock reads
+
+// A stack, as its top frame: fn_id called from the stack at parent
+typedef struct {
+  u32 parent;
+  u32 fn_id;           // TABLE id of the OmniLisp function
+} OmniProfileFrame;
+
+typedef struct {
+  u32 frame;           // Stack of the context
+  u32 ctr;             // Constructor nick (ext)
+  u64 itrs;            // Interactions charged to this context
+  u64 ns;              // Wall time charged to this context
+  int used;
+} OmniProfileEntry;
+
+// BkGt results already wrapped, by TABLE id
+typedef struct {
+  u32  fn_id;
+  Term ast;            // BOOK term it was built from
+  Term wrapped;
+  int  used;
+} OmniProfileWrap;
+
+typedef struct {
+  int               active;
+  const char       *path;
+
+  OmniProfileEntry *entries;    // Open-addressed on (frame, ctr)
+  u32               cap;
+  u32               len;
+
+  OmniProfileFrame *frames;     // frames[0] is the root
+  u32               frame_count;
+  u32               frame_cap;
+  u32              *frame_index;  // Open-addressed (parent, fn_id) -> frame + 1
+  u32               frame_index_cap;
+
+  OmniProfileWrap  *wraps;
+  u32               wrap_cap;
+  u32               wrap_len;
+
+  u32               stack[OMNI_PROFILE_MAX_DEPTH];  // Frames, innermost last
+  u32               depth;
+  u32               overflow;   // Frames pushed past OMNI_PROFILE_MAX_DEPTH
+
+  u32               cur_ctr;    // Constructor of the current context
+  u64               last_itrs;  // Interaction counter at the last charge
+  u64               last_ns;    // Clock at the last sample
+  u32               until_sample;
+} OmniProfile;
+
+static OmniProfile OMNI_PROFILE = {0};
+
+fn u64 omni_profile_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+fn u32 omni_profile_hash(u32 a, u32 b) {
+  return ((a * 0x9E3779B1u) ^ (b * 0x85EBCA77u)) * 0xC2B2AE3Du;
+}
+
+fn u32 omni_profile_top(void) {
+  return OMNI_PROFILE.depth ? OMNI_PROFILE.stack[OMNI_PROFILE.depth - 1] : OMNI_PROFILE_ROOT;
+}
+
+// -----------------------------------------------------------------------------
+// Frames
+// -----------------------------------------------------------------------------
+
+fn u32* omni_profile_frame_slot(u32 *index, u32 cap, u32 parent, u32 fn_id) {
+  u32 i = omni_profile_hash(parent, fn_id) & (cap - 1);
+  while (index[i]) {
+    OmniProfileFrame *f = &OMNI_PROFILE.frames[index[i] - 1];
+    if (f->parent == parent && f->fn_id == fn_id) break;
+    i = (i + 1) & (cap - 1);
+  }
+  return &index[i];
+}
+
+fn void omni_profile_frame_grow(void) {
+  u32 cap = OMNI_PROFILE.frame_index_cap * 2;
+  u32 *index = (u32*)calloc(cap, sizeof(u32));
+  for (u32 f = 1; f < OMNI_PROFILE.frame_count; f++) {
+    OmniProfileFrame *fr = &OMNI_PROFILE.frames[f];
+    *omni_profile_frame_slot(index, cap, fr->parent, fr->fn_id) = f + 1;
+  }
+  free(OMNI_PROFILE.frame_index);
+  OMNI_PROFILE.frame_index = index;
+  OMNI_PROFILE.frame_index_cap = cap;
+}
+
+// The frame for fn_id called from parent, interned
+fn u32 omni_profile_frame(u32 parent, u32 fn_id) {
+  if (OMNI_PROFILE.frame_count * 2 >= OMNI_PROFILE.frame_index_cap) omni_profile_frame_grow();
+  u32 *slot = omni_profile_frame_slot(OMNI_PROFILE.frame_index, OMNI_PROFILE.frame_index_cap,
+                                      parent, fn_id);
+  if (*slot) return *slot - 1;
+
+  if (OMNI_PROFILE.frame_count == OMNI_PROFILE.frame_cap) {
+    OMNI_PROFILE.frame_cap *= 2;
+    OMNI_PROFILE.frames = (OmniProfileFrame*)realloc(OMNI_PROFILE.frames,
+                                                     OMNI_PROFILE.frame_cap * sizeof(OmniProfileFrame));
+  }
+  u32 f = OMNI_PROFILE.frame_count++;
+  OMNI_PROFILE.frames[f] = (OmniProfileFrame){parent, fn_id};
+  *slot = f + 1;
+  return f;
+}
+
+// -----------------------------------------------------------------------------
+// Contexts
+// -----------------------------------------------------------------------------
+
+fn OmniProfileEntry* omni_profile_slot(OmniProfileEntry *entries, u32 cap, u32 frame, u32 ctr) {
+  u32 i = omni_profile_hash(frame, ctr) & (cap - 1);
+  while (entries[i].used && (entries[i].frame != frame || entries[i].ctr != ctr)) {
+    i = (i + 1) & (cap - 1);
+  }
+  return &entries[i];
+}
+
+fn void omni_profile_grow(void) {
+  u32 cap = OMNI_PROFILE.cap * 2;
+  OmniProfileEntry *entries = (OmniProfileEntry*)calloc(cap, sizeof(OmniProfileEntry));
+  for (u32 i = 0; i < OMNI_PROFILE.cap; i++) {
+    OmniProfileEntry *e = &OMNI_PROFILE.entries[i];
+    if (e->used) *omni_profile_slot(entries, cap, e->frame, e->ctr) = *e;
+  }
+  free(OMNI_PROFILE.entries);
+  OMNI_PROFILE.entries = entries;
+  OMNI_PROFILE.cap = cap;
+}
+
+fn OmniProfileEntry* omni_profile_current(void) {
+  if (OMNI_PROFILE.len * 2 >= OMNI_PROFILE.cap) omni_profile_grow();
+  u32 frame = omni_profile_top();
+  OmniProfileEntry *e = omni_profile_slot(OMNI_PROFILE.entries, OMNI_PROFILE.cap,
+                                          frame, OMNI_PROFILE.cur_ctr);
+  if (!e->used) {
+    e->used = 1;
+    e->frame = frame;
+    e->ctr = OMNI_PROFILE.cur_ctr;
+    OMNI_PROFILE.len++;
+  }
+  return e;
+}
+
+// Charge the interactions since the last event to the current context, and
+// on every OMNI_PROFILE_TIME_EVERY-th event the time since the last sample
+fn void omni_profile_charge(void) {
+  u64 itrs = wnf_itrs_total();
+  OmniProfileEntry *e = omni_profile_current();
+  e->itrs += itrs - OMNI_PROFILE.last_itrs;
+  OMNI_PROFILE.last_itrs = itrs;
+
+  if (--OMNI_PROFILE.until_sample == 0) {
+    u64 ns = omni_profile_now_ns();
+    e->ns += ns - OMNI_PROFILE.last_ns;
+    OMNI_PROFILE.last_ns = ns;
+    OMNI_PROFILE.until_sample = OMNI_PROFILE_TIME_EVERY;
+  }
+}
+
+// =============================================================================
+// Events
+// =============================================================================
+
+// Constructor entry (called through omni_profile_fn by the dispatch hook)
+fn void omni_profile_enter(unsigned long t) {
+  omni_profile_charge();
+  OMNI_PROFILE.cur_ctr = term_ext((Term)t);
+}
+
+// A call to the function at table_id starts
+fn void omni_profile_push(u32 table_id) {
+  if (!OMNI_PROFILE.active) return;
+  omni_profile_charge();
+  if (OMNI_PROFILE.depth == OMNI_PROFILE_MAX_DEPTH) {
+    OMNI_PROFILE.overflow++;
+    return;
+  }
+  u32 f = omni_profile_frame(omni_profile_top(), table_id);
+  OMNI_PROFILE.stack[OMNI_PROFILE.depth++] = f;
+}
+
+// The call to table_id returned: back to the frame of its caller. Frames
+// above it (calls cut short by an effect or an error) go with it.
+fn void omni_profile_pop(u32 table_id) {
+  if (!OMNI_PROFILE.active) return;
+  omni_profile_charge();
+  if (OMNI_PROFILE.overflow > 0) {
+    OMNI_PROFILE.overflow--;
+    return;
+  }
+  u32 d = OMNI_PROFILE.depth;
+  while (d > 0 && OMNI_PROFILE.frames[OMNI_PROFILE.stack[d - 1]].fn_id != table_id) d--;
+  if (d > 0) OMNI_PROFILE.depth = d - 1;
+}
+
+// -----------------------------------------------------------------------------
+// Wrapped Bodies
+// -----------------------------------------------------------------------------
+
+fn OmniProfileWrap* omni_profile_wrap_slot(OmniProfileWrap *wraps, u32 cap, u32 fn_id) {
+  u32 i = omni_profile_hash(fn_id, 0) & (cap - 1);
+  while (wraps[i].used && wraps[i].fn_id != fn_id) i = (i + 1) & (cap - 1);
+  return &wraps[i];
+}
+
+fn void omni_profile_wrap_grow(void) {
+  u32 cap = OMNI_PROFILE.wrap_cap * 2;
+  OmniProfileWrap *wraps = (OmniProfileWrap*)calloc(cap, sizeof(OmniProfileWrap));
+  for (u32 i = 0; i < OMNI_PROFILE.wrap_cap; i++) {
+    OmniProfileWrap *w = &OMNI_PROFILE.wraps[i];
+    if (w->used) *omni_profile_wrap_slot(wraps, cap, w->fn_id) = *w;
+  }
+  free(OMNI_PROFILE.wraps);
+  OMNI_PROFILE.wraps = wraps;
+  OMNI_PROFILE.wrap_cap = cap;
+}
+
+// Drop every wrapped body: the heap they were built in is being discarded
+// (omni_heap_reset)
+fn void omni_profile_wrap_forget(void) {
+  if (!OMNI_PROFILE.wraps) return;
+  memset(OMNI_PROFILE.wraps, 0, OMNI_PROFILE.wrap_cap * sizeof(OmniProfileWrap));
+  OMNI_PROFILE.wrap_len = 0;
+}
+
+// The AST of the function at table_id with its body, under every parameter,
+// wrapped in #PBdy{id, body}; anything that is not a lambda comes back as is.
+// Built once per definition while recording; a redefinition is wrapped anew.
+fn Term omni_profile_wrap(u32 table_id, Term ast) {
+  if (!OMNI_PROFILE.active) return ast;
+  if (OMNI_PROFILE.wrap_len * 2 >= OMNI_PROFILE.wrap_cap) omni_profile_wrap_grow();
+  OmniProfileWrap *w = omni_profile_wrap_slot(OMNI_PROFILE.wraps, OMNI_PROFILE.wrap_cap, table_id);
+  if (w->used && w->ast == ast) return w->wrapped;
+
+  // Lambdas down to the body, then rebuilt around #PBdy from the inside out
+  Term lams[64];
+  u32 n = 0;
+  Term cur = ast;
+  while (n < 64 && term_tag(cur) == C01
+         && (term_ext(cur) == OMNI_NAM_LAM || term_ext(cur) == OMNI_NAM_LAMR)) {
+    lams[n++] = cur;
+    cur = HEAP[term_val(cur)];
+  }
+
+  Term wrapped = ast;
+  if (n > 0) {
+    Term pbdy_args[2] = {term_new_num(table_id), cur};
+    wrapped = term_new_ctr(OMNI_NAM_PBDY, 2, pbdy_args);
+    while (n > 0) {
+      wrapped = term_new_ctr(term_ext(lams[--n]), 1, &wrapped);
+    }
+  }
+
+  if (!w->used) OMNI_PROFILE.wrap_len++;
+  w->used = 1;
+  w->fn_id = table_id;
+  w->ast = ast;
+  w->wrapped = wrapped;
+  return wrapped;
+}
+
+// Table id of a #PBdy argument: a number or #Cst{n}
+fn u32 omni_profile_id_arg(Term args) {
+  if (term_tag(args) != C02 || term_ext(args) != NAM_CON) return 0;
+  Term id = wnf(HEAP[term_val(args)]);
+  if (term_tag(id) == C01 && term_ext(id) == OMNI_NAM_CST) id = wnf(HEAP[term_val(id)]);
+  return term_val(id);
+}
+
+// FFI "PfIn": [id] -> #Cst{id}, before a #PBdy body is evaluated
+fn Term omni_profile_ffi_enter(Term args) {
+  u32 id = omni_profile_id_arg(args);
+  omni_profile_push(id);
+  Term n = term_new_num(id);
+  return term_new_ctr(OMNI_NAM_CST, 1, &n);
+}
+
+// FFI "PfOu": [#Cst{id}, value] -> value, once the body is in WNF
+fn Term omni_profile_ffi_leave(Term args) {
+  omni_profile_pop(omni_profile_id_arg(args));
+  if (term_tag(args) != C02 || term_ext(args) != NAM_CON) return args;
+  Term rest = wnf(HEAP[term_val(args) + 1]);
+  if (term_tag(rest) != C02 || term_ext(rest) != NAM_CON) {
+    return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+  }
+  return wnf(HEAP[term_val(rest)]);
+}
+
+// =============================================================================
+// Start / Finish
+// =============================================================================
+
+fn void omni_profile_start(const char *path) {
+  OMNI_PROFILE.active          = 1;
+  OMNI_PROFILE.path            = path;
+  OMNI_PROFILE.cap             = OMNI_PROFILE_INIT_CAP;
+  OMNI_PROFILE.entries         = (OmniProfileEntry*)calloc(OMNI_PROFILE.cap, sizeof(OmniProfileEntry));
+  OMNI_PROFILE.len             = 0;
+  OMNI_PROFILE.frame_cap       = OMNI_PROFILE_INIT_CAP;
+  OMNI_PROFILE.frames          = (OmniProfileFrame*)malloc(OMNI_PROFILE.frame_cap * sizeof(OmniProfileFrame));
+  OMNI_PROFILE.frames[0]       = (OmniProfileFrame){OMNI_PROFILE_ROOT, 0};
+  OMNI_PROFILE.frame_count     = 1;
+  OMNI_PROFILE.frame_index_cap = OMNI_PROFILE_INIT_CAP;
+  OMNI_PROFILE.frame_index     = (u32*)calloc(OMNI_PROFILE.frame_index_cap, sizeof(u32));
+  OMNI_PROFILE.wrap_cap        = OMNI_PROFILE_INIT_CAP;
+  OMNI_PROFILE.wraps           = (OmniProfileWrap*)calloc(OMNI_PROFILE.wrap_cap, sizeof(OmniProfileWrap));
+  OMNI_PROFILE.wrap_len        = 0;
+  OMNI_PROFILE.depth           = 0;
+  OMNI_PROFILE.overflow        = 0;
+  OMNI_PROFILE.cur_ctr         = 0;
+  OMNI_PROFILE.last_itrs       = wnf_itrs_total();
+  OMNI_PROFILE.last_ns         = omni_profile_now_ns();
+  OMNI_PROFILE.until_sample    = OMNI_PROFILE_TIME_EVERY;
+  omni_profile_fn = omni_profile_enter;
+}
+
+// Write one folded line per context with a non-zero weight
+fn void omni_profile_write(FILE *f, int by_time) {
+  u32 path[OMNI_PROFILE_MAX_DEPTH];
+  for (u32 i = 0; i < OMNI_PROFILE.cap; i++) {
+    OmniProfileEntry *e = &OMNI_PROFILE.entries[i];
+    if (!e->used) continue;
+    u64 weight = by_time ? e->ns / 1000 : e->itrs;
+    if (weight == 0) continue;
+
+    u32 n = 0;
+    for (u32 fr = e->frame; fr != OMNI_PROFILE_ROOT && n < OMNI_PROFILE_MAX_DEPTH;
+         fr = OMNI_PROFILE.frames[fr].parent) {
+      path[n++] = OMNI_PROFILE.frames[fr].fn_id;
+    }
+
+    fputs("omnilisp", f);
+    if (n == 0) fputs(";<toplevel>", f);
+    while (n > 0) {
+      u32 id = path[--n];
+      fprintf(f, ";%s", id < TABLE_LEN && TABLE[id] ? TABLE[id] : "<anonymous>");
+    }
+    char ctr[16] = "<start>";
+    if (e->ctr != 0) nick_to_str(e->ctr, ctr, sizeof(ctr));
+    fprintf(f, ";#%s %llu\n", ctr, (unsigned long long)weight);
+  }
+}
+
+// Stop recording and write FILE and FILE.time
+// Returns 0 on success, 1 if a file could not be written
+fn int omni_profile_finish(void) {
+  if (!OMNI_PROFILE.active) return 0;
+  OMNI_PROFILE.until_sample = 1;  // Last sample: the time since the one before
+  omni_profile_charge();
+  omni_profile_fn = 0;
+  OMNI_PROFILE.active = 0;
+
+  int err = 0;
+  size_t plen = strlen(OMNI_PROFILE.path);
+  char *time_path = (char*)malloc(plen + 6);
+  memcpy(time_path, OMNI_PROFILE.path, plen);
+  memcpy(time_path + plen, ".time", 6);
+
+  for (int by_time = 0; by_time <= 1; by_time++) {
+    const char *path = by_time ? time_path : OMNI_PROFILE.path;
+    FILE *f = fopen(path, "w");
+    if (!f) {
+      fprintf(stderr, "Error: cannot write profile %s: %s\n", path, strerror(errno));
+      err = 1;
+      continue;
+    }
+    omni_profile_write(f, by_time);
+    fclose(f);
+  }
+
+  free(time_path);
+  free(OMNI_PROFILE.entries);
+  free(OMNI_PROFILE.frames);
+  free(OMNI_PROFILE.frame_index);
+  free(OMNI_PROFILE.wraps);
+  OMNI_PROFILE.entries = NULL;
+  OMNI_PROFILE.frames = NULL;
+  OMNI_PROFILE.frame_index = NULL;
+  OMNI_PROFILE.wraps = NULL;
+  return err;
+}
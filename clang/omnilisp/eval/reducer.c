@@ -0,0 +1,172 @@
+// OmniLisp Reducer Threads
+// N threads reducing one heap (-j N / OMNI_THREADS)
+//
+// HVM4 partitions HEAP into one slice per thread (thread_set_count before
+// heap_init_slices), and each reducing thread identifies itself with
+// wnf_set_tid. Thread 0 is always the main thread; threads 1..N-1 are
+// started here and park until the main thread opens a parallel section.
+//
+// A parallel section runs the same body on every reducer thread and returns
+// when all of them are done. How work is split is up to the body (see
+// omni_normalize and the "PEvl" sparks in main.c).
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// =============================================================================
+// Configuration
+// =============================================================================
+
+#define OMNI_MAX_REDUCERS 64  // HVM4 keeps per-thread heap state for 64
+
+typedef void (*OmniReducerBody)(u32 tid, void *ctx);
+
+typedef struct {
+  pthread_t       threads[OMNI_MAX_REDUCERS];
+  u32             count;       // Reducer threads including the main thread
+  pthread_mutex_t mutex;
+  pthread_cond_t  start;       // Signalled when a section opens
+  pthread_cond_t  done;        // Signalled when the last worker finishes
+  u64             epoch;       // Incremented per section
+  u32             running;     // Workers still inside the section
+  OmniReducerBody body;
+  void           *ctx;
+  int             in_section;  // Main thread is inside omni_reducer_parallel
+  int             shutdown;
+} OmniReducerPool;
+
+static OmniReducerPool OMNI_REDUCERS = {
+  .count = 1,
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .start = PTHREAD_COND_INITIALIZER,
+  .done  = PTHREAD_COND_INITIALIZER,
+};
+
+// =============================================================================
+// Thread Count
+// =============================================================================
+
+// Resolve the reducer count: explicit -j wins, then OMNI_THREADS, then 1
+fn u32 omni_reducer_threads_wanted(int cli_threads) {
+  long n = cli_threads;
+  if (n <= 0) {
+    const char *env = getenv("OMNI_THREADS");
+    n = env ? strtol(env, NULL, 10) : 1;
+  }
+  if (n < 1) n = 1;
+  if (n > OMNI_MAX_REDUCERS) n = OMNI_MAX_REDUCERS;
+  return (u32)n;
+}
+
+fn u32 omni_reducer_count(void) {
+  return OMNI_REDUCERS.count;
+}
+
+// Whether a parallel section is running; only meaningful on the main thread
+fn int omni_reducer_busy(void) {
+  return OMNI_REDUCERS.in_section;
+}
+
+// =============================================================================
+// Worker Loop
+// =============================================================================
+
+fn void* omni_reducer_worker(void *arg) {
+  u32 tid = (u32)(uintptr_t)arg;
+  wnf_set_tid(tid);
+  omni_reducer_tid = tid;
+
+  u64 seen = 0;
+  pthread_mutex_lock(&OMNI_REDUCERS.mutex);
+  while (1) {
+    while (OMNI_REDUCERS.epoch == seen && !OMNI_REDUCERS.shutdown) {
+      pthread_cond_wait(&OMNI_REDUCERS.start, &OMNI_REDUCERS.mutex);
+    }
+    if (OMNI_REDUCERS.shutdown) break;
+    seen = OMNI_REDUCERS.epoch;
+    OmniReducerBody body = OMNI_REDUCERS.body;
+    void *ctx = OMNI_REDUCERS.ctx;
+    pthread_mutex_unlock(&OMNI_REDUCERS.mutex);
+
+    body(tid, ctx);
+
+    pthread_mutex_lock(&OMNI_REDUCERS.mutex);
+    if (--OMNI_REDUCERS.running == 0) {
+      pthread_cond_signal(&OMNI_REDUCERS.done);
+    }
+  }
+  pthread_mutex_unlock(&OMNI_REDUCERS.mutex);
+  return NULL;
+}
+
+// =============================================================================
+// Initialization
+// =============================================================================
+
+// Configure HVM4 for n threads; call before heap_init_slices
+fn void omni_reducer_configure(u32 n) {
+  OMNI_REDUCERS.count = n;
+  thread_set_count(n);
+  wnf_set_tid(0);
+  omni_reducer_tid = 0;
+}
+
+// Start threads 1..n-1; call once the heap is initialized
+fn void omni_reducer_start(void) {
+  for (u32 i = 1; i < OMNI_REDUCERS.count; i++) {
+    if (pthread_create(&OMNI_REDUCERS.threads[i], NULL, omni_reducer_worker,
+                       (void*)(uintptr_t)i) != 0) {
+      // Run with the threads we have; HVM4 slices beyond them stay unused
+      OMNI_REDUCERS.count = i;
+      break;
+    }
+  }
+}
+
+fn void omni_reducer_shutdown(void) {
+  pthread_mutex_lock(&OMNI_REDUCERS.mutex);
+  OMNI_REDUCERS.shutdown = 1;
+  pthread_cond_broadcast(&OMNI_REDUCERS.start);
+  pthread_mutex_unlock(&OMNI_REDUCERS.mutex);
+
+  for (u32 i = 1; i < OMNI_REDUCERS.count; i++) {
+    pthread_join(OMNI_REDUCERS.threads[i], NULL);
+  }
+  OMNI_REDUCERS.count = 1;
+}
+
+// =============================================================================
+// Parallel Sections
+// =============================================================================
+
+// Run body(tid, ctx) on every reducer thread, the caller acting as tid 0
+// Returns after all threads have finished. Sections don't nest: callers
+// check omni_reducer_busy first.
+fn void omni_reducer_parallel(OmniReducerBody body, void *ctx) {
+  if (OMNI_REDUCERS.count <= 1) {
+    body(0, ctx);
+    return;
+  }
+
+  OMNI_REDUCERS.in_section = 1;
+  pthread_mutex_lock(&OMNI_REDUCERS.mutex);
+  OMNI_REDUCERS.body = body;
+  OMNI_REDUCERS.ctx = ctx;
+  OMNI_REDUCERS.running = OMNI_REDUCERS.count - 1;
+  OMNI_REDUCERS.epoch++;
+  pthread_cond_broadcast(&OMNI_REDUCERS.start);
+  pthread_mutex_unlock(&OMNI_REDUCERS.mutex);
+
+  body(0, ctx);
+
+  pthread_mutex_lock(&OMNI_REDUCERS.mutex);
+  while (OMNI_REDUCERS.running > 0) {
+    pthread_cond_wait(&OMNI_REDUCERS.done, &OMNI_REDUCERS.mutex);
+  }
+  pthread_mutex_unlock(&OMNI_REDUCERS.mutex);
+  OMNI_REDUCERS.in_section = 0;
+}
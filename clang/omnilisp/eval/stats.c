@@ -0,0 +1,161 @@
+// OmniLisp Run Statistics
+// Per-phase wall time and heap growth, plus FFI call counts (-s, --stats-json)
+//
+// A phase is measured between omni_phase_begin and omni_phase_end: monotonic
+// nanoseconds and words allocated across all heap slices. Ending a phase
+// with a name that was already recorded adds to it, so a phase can be
+// measured in several pieces. Work of one phase done inside another (the
+// printer forcing the rest of a lazy result) is summed with
+// omni_phase_piece and moved over with omni_phase_move.
+//
+// Every FFI call the program makes is counted, nested ones included; calls
+// the runtime makes for itself (registered internal) are not. Time is taken
+// at the outermost counted call only, since a nested call's time is already
+// inside it.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// =============================================================================
+// Phases
+// =============================================================================
+
+#define OMNI_PHASE_MAX      32
+#define OMNI_PHASE_NAME_MAX 48
+
+typedef struct {
+  char name[OMNI_PHASE_NAME_MAX];
+  u64  ns;             // Wall time
+  u64  heap;           // Heap words allocated
+  u32  count;          // Times the phase ran
+} OmniPhase;
+
+typedef struct {
+  u64 ns;
+  u64 heap;
+} OmniPhaseMark;
+
+static OmniPhase OMNI_PHASES[OMNI_PHASE_MAX];
+static u32 OMNI_PHASE_COUNT = 0;
+
+fn u64 omni_stats_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+// Heap words handed out so far, over every reducer's slice
+fn u64 omni_stats_heap_words(void) {
+  u64 words = 0;
+  for (u32 t = 0; t < omni_reducer_count(); t++) {
+    words += OMNI_HEAP_NEXT(t);
+  }
+  return words;
+}
+
+fn void omni_phase_begin(OmniPhaseMark *m) {
+  m->heap = omni_stats_heap_words();
+  m->ns = omni_stats_now_ns();
+}
+
+// Phase recorded under name, added if new (NULL when the table is full)
+fn OmniPhase* omni_phase_find(const char *name) {
+  for (u32 i = 0; i < OMNI_PHASE_COUNT; i++) {
+    if (strcmp(OMNI_PHASES[i].name, name) == 0) {
+      return &OMNI_PHASES[i];
+    }
+  }
+  if (OMNI_PHASE_COUNT == OMNI_PHASE_MAX) return NULL;
+  OmniPhase *p = &OMNI_PHASES[OMNI_PHASE_COUNT++];
+  snprintf(p->name, sizeof(p->name), "%s", name);
+  return p;
+}
+
+fn void omni_phase_end(OmniPhaseMark *m, const char *name) {
+  u64 ns = omni_stats_now_ns() - m->ns;
+  u64 heap = omni_stats_heap_words() - m->heap;
+
+  OmniPhase *p = omni_phase_find(name);
+  if (!p) return;
+  p->ns += ns;
+  p->heap += heap;
+  p->count++;
+}
+
+// Add what ran since m to sum, for a piece of one phase's work that
+// happens inside another (see omni_phase_move)
+fn void omni_phase_piece(OmniPhaseMark *m, OmniPhaseMark *sum) {
+  sum->ns += omni_stats_now_ns() - m->ns;
+  sum->heap += omni_stats_heap_words() - m->heap;
+}
+
+// Take sum out of phase from, already ended around it, and add it to phase
+// to without counting another run of to
+fn void omni_phase_move(OmniPhaseMark *sum, const char *from, const char *to) {
+  OmniPhase *src = omni_phase_find(from);
+  OmniPhase *dst = omni_phase_find(to);
+  if (!src || !dst) return;
+  u64 ns = sum->ns < src->ns ? sum->ns : src->ns;
+  u64 heap = sum->heap < src->heap ? sum->heap : src->heap;
+  src->ns -= ns;
+  src->heap -= heap;
+  dst->ns += ns;
+  dst->heap += heap;
+}
+
+// =============================================================================
+// FFI Calls
+// =============================================================================
+
+static atomic_ullong OMNI_FFI_CALLS = 0;
+static atomic_ullong OMNI_FFI_NS = 0;
+static __thread u32 omni_ffi_depth = 0;
+
+// Bracket one counted call; returns the start time (0 when nested)
+fn u64 omni_stats_ffi_begin(void) {
+  atomic_fetch_add_explicit(&OMNI_FFI_CALLS, 1, memory_order_relaxed);
+  return omni_ffi_depth++ == 0 ? omni_stats_now_ns() : 0;
+}
+
+fn void omni_stats_ffi_end(u64 start) {
+  if (--omni_ffi_depth != 0) return;
+  atomic_fetch_add_explicit(&OMNI_FFI_NS, omni_stats_now_ns() - start, memory_order_relaxed);
+}
+
+// =============================================================================
+// Reporting
+// =============================================================================
+
+// Human-readable lines for -s
+fn void omni_stats_print_phases(FILE *out) {
+  fprintf(out, "  Phases:\n");
+  for (u32 i = 0; i < OMNI_PHASE_COUNT; i++) {
+    OmniPhase *p = &OMNI_PHASES[i];
+    fprintf(out, "    %-28s %10.3f ms  +%-12llu words", p->name, p->ns / 1e6,
+            (unsigned long long)p->heap);
+    if (p->count > 1) fprintf(out, "  (x%u)", p->count);
+    fprintf(out, "\n");
+  }
+  fprintf(out, "  FFI calls: %llu (%.3f ms)\n",
+          (unsigned long long)atomic_load(&OMNI_FFI_CALLS),
+          atomic_load(&OMNI_FFI_NS) / 1e6);
+}
+
+// One JSON object for --stats-json
+fn void omni_stats_write_json(FILE *out, u64 itrs, u32 handles) {
+  fprintf(out, "{\"phases\":[");
+  for (u32 i = 0; i < OMNI_PHASE_COUNT; i++) {
+    OmniPhase *p = &OMNI_PHASES[i];
+    fprintf(out, "%s{\"name\":\"%s\",\"ms\":%.3f,\"heap_words\":%llu,\"count\":%u}",
+            i ? "," : "", p->name, p->ns / 1e6, (unsigned long long)p->heap, p->count);
+  }
+  fprintf(out, "],\"ffi\":{\"calls\":%llu,\"ms\":%.3f}",
+          (unsigned long long)atomic_load(&OMNI_FFI_CALLS),
+          atomic_load(&OMNI_FFI_NS) / 1e6);
+  fprintf(out, ",\"itrs\":%llu,\"handles\":%u}\n", (unsigned long long)itrs, handles);
+}
@@ -0,0 +1,159 @@
+// OmniLisp Constructor Telemetry
+// Histograms of constructor entries seen by the FFI dispatch hook
+//
+// The hook runs on every constructor entry in wnf, the hottest path of the
+// interpreter, so telemetry is a build option (make TELEMETRY=1, which
+// defines OMNI_TELEMETRY). Without it, omni_telemetry_record compiles to
+// nothing. With it, every reducer thread counts into its own tables:
+// - one counter per tag (C00..C16)
+// - an open-addressed histogram keyed by (tag, 24-bit ext) through a
+//   multiplicative hash; keys that find no free slot are only counted
+//
+// OMNI_TELEMETRY_SAMPLE=N (default 1) records one entry in N per thread.
+// Counts are reported unscaled by -s.
+//
+// Included before hvm4.c (the hook is defined there), so this file only uses
+// plain C types.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef OMNI_TELEMETRY_SAMPLE
+#define OMNI_TELEMETRY_SAMPLE 1
+#endif
+
+#define OMNI_TELEMETRY_THREADS  64     // Matches OMNI_MAX_REDUCERS
+#define OMNI_TELEMETRY_TAGS     17     // C00..C16
+#define OMNI_TELEMETRY_TAG_BASE 24     // Tag number of C00
+#define OMNI_TELEMETRY_SLOTS    1024   // Histogram slots per thread (power of 2)
+#define OMNI_TELEMETRY_PROBES   8      // Linear probes before giving up
+
+// Histogram key: tag index in the top byte, ext below; 0 marks an empty slot
+typedef struct {
+  uint32_t key;
+  uint32_t count;
+} OmniTelemetrySlot;
+
+typedef struct {
+  uint64_t          entries;                       // Recorded entries
+  uint64_t          dropped;                       // Recorded, but no slot
+  uint64_t          tags[OMNI_TELEMETRY_TAGS];
+  uint32_t          countdown;                     // Entries until next sample
+  OmniTelemetrySlot slots[OMNI_TELEMETRY_SLOTS];
+} __attribute__((aligned(64))) OmniTelemetry;
+
+#ifdef OMNI_TELEMETRY
+static OmniTelemetry omni_telemetry[OMNI_TELEMETRY_THREADS];
+#endif
+
+// =============================================================================
+// Recording
+// =============================================================================
+
+static inline uint32_t omni_telemetry_hash(uint32_t key) {
+  return (key * 0x9E3779B1u) >> (32 - 10);  // log2(OMNI_TELEMETRY_SLOTS)
+}
+
+// Record one constructor entry. `term` is the raw 64-bit term: tag at bits
+// 56-62, ext at bits 32-55.
+static inline void omni_telemetry_record(unsigned int tid, unsigned long term) {
+#ifdef OMNI_TELEMETRY
+  OmniTelemetry *t = &omni_telemetry[tid];
+#if OMNI_TELEMETRY_SAMPLE > 1
+  if (t->countdown > 0) {
+    t->countdown--;
+    return;
+  }
+  t->countdown = OMNI_TELEMETRY_SAMPLE - 1;
+#endif
+
+  uint32_t tag = (uint32_t)(term >> 56) & 0x7F;
+  if (tag < OMNI_TELEMETRY_TAG_BASE || tag >= OMNI_TELEMETRY_TAG_BASE + OMNI_TELEMETRY_TAGS) {
+    return;
+  }
+  uint32_t idx = tag - OMNI_TELEMETRY_TAG_BASE;
+  uint32_t key = ((idx + 1) << 24) | ((uint32_t)(term >> 32) & 0xFFFFFF);
+
+  t->entries++;
+  t->tags[idx]++;
+
+  uint32_t h = omni_telemetry_hash(key);
+  for (uint32_t p = 0; p < OMNI_TELEMETRY_PROBES; p++) {
+    OmniTelemetrySlot *s = &t->slots[(h + p) & (OMNI_TELEMETRY_SLOTS - 1)];
+    if (s->key == key) {
+      s->count++;
+      return;
+    }
+    if (s->key == 0) {
+      s->key = key;
+      s->count = 1;
+      return;
+    }
+  }
+  t->dropped++;
+#else
+  (void)tid;
+  (void)term;
+#endif
+}
+
+// =============================================================================
+// Reporting
+// =============================================================================
+
+static inline int omni_telemetry_enabled(void) {
+#ifdef OMNI_TELEMETRY
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+static int omni_telemetry_cmp(const void *a, const void *b) {
+  uint32_t ca = ((const OmniTelemetrySlot*)a)->count;
+  uint32_t cb = ((const OmniTelemetrySlot*)b)->count;
+  return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+// Sum every thread's tables into sum, and fill top[0..max) with its most
+// frequent (tag, ext) keys. Returns the number of keys written to top.
+static uint32_t omni_telemetry_summary(OmniTelemetry *sum, OmniTelemetrySlot *top, uint32_t max) {
+  memset(sum, 0, sizeof(*sum));
+#ifdef OMNI_TELEMETRY
+  for (uint32_t tid = 0; tid < OMNI_TELEMETRY_THREADS; tid++) {
+    OmniTelemetry *t = &omni_telemetry[tid];
+    if (t->entries == 0) continue;
+    sum->entries += t->entries;
+    sum->dropped += t->dropped;
+    for (uint32_t i = 0; i < OMNI_TELEMETRY_TAGS; i++) sum->tags[i] += t->tags[i];
+
+    for (uint32_t i = 0; i < OMNI_TELEMETRY_SLOTS; i++) {
+      OmniTelemetrySlot *src = &t->slots[i];
+      if (src->key == 0) continue;
+      uint32_t h = omni_telemetry_hash(src->key);
+      uint32_t p = 0;
+      for (; p < OMNI_TELEMETRY_PROBES; p++) {
+        OmniTelemetrySlot *dst = &sum->slots[(h + p) & (OMNI_TELEMETRY_SLOTS - 1)];
+        if (dst->key == 0) dst->key = src->key;
+        if (dst->key == src->key) {
+          dst->count += src->count;
+          break;
+        }
+      }
+      if (p == OMNI_TELEMETRY_PROBES) sum->dropped += src->count;
+    }
+  }
+#endif
+
+  OmniTelemetrySlot *all = (OmniTelemetrySlot*)malloc(sizeof(sum->slots));
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < OMNI_TELEMETRY_SLOTS; i++) {
+    if (sum->slots[i].key != 0) all[n++] = sum->slots[i];
+  }
+  qsort(all, n, sizeof(OmniTelemetrySlot), omni_telemetry_cmp);
+  if (n > max) n = max;
+  memcpy(top, all, n * sizeof(OmniTelemetrySlot));
+  free(all);
+  return n;
+}
@@ -0,0 +1,327 @@
+// OmniLisp Byte Buffers
+// Contiguous, reference-counted byte regions passed across the FFI as-is
+//
+//   (string->buf s)          -> #Buf         one UTF-8 copy of the char list
+//   (buf->string b)          -> char list    one copy back
+//   (buf-length b)           -> #Cst{n}
+//   (buf-ref b i)            -> #Cst{byte}
+//   (buf-slice b start end)  -> #Buf         a view, no copy
+//   (read-file-buf path)     -> #Buf         the file's bytes, no char list
+//
+// read-file-stream (io.c) maps the file instead of reading it: the buffer
+// is the mapping, and is unmapped with its last reference.
+//
+// A #Buf{#Hndl} is an owned handle (type OMNI_NAM_BUF) to an OmniBuf. The
+// handle holds one reference; slices and calls in flight hold their own, so
+// freeing the handle (with-handle-scope, exit) never pulls bytes out from
+// under a view or an FFI worker. The region is released with the last
+// reference.
+//
+// Signatures (signature.c) take and return buffers as "buf": a pointer and
+// a length, in two integer registers, the way a C function taking
+// (const void *data, size_t len) or returning struct { void *p; size_t n; }
+// sees them. write-file and append-file write a #Buf without converting it.
+//
+// Char lists are only built or walked by string->buf and buf->string, as
+// UTF-8 the way packed strings are. A buffer may hold NULs or bytes that
+// are not UTF-8; buf->string gives each byte that does not start a
+// complete sequence as a char of its own.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// =============================================================================
+// Buffers
+// =============================================================================
+
+typedef struct OmniBuf OmniBuf;
+struct OmniBuf {
+  atomic_uint refs;
+  u8      *data;
+  size_t   len;
+  OmniBuf *parent;             // Slice: the buffer the bytes belong to
+  void    *owned;              // Adopted region, freed with the buffer
+  size_t   mapped;             // or, if non-zero, its length to munmap
+  u32      chars;              // Packed strings (pstring.c): code points
+  u32      hash;               // and FNV-1a of the bytes
+  u8       bytes[];            // Inline storage, len + 1 (NUL) bytes
+};
+
+// A buffer of len bytes with inline storage, NUL-terminated
+fn OmniBuf* omni_buf_new(size_t len) {
+  OmniBuf *b = (OmniBuf*)malloc(sizeof(OmniBuf) + len + 1);
+  if (!b) return NULL;
+  atomic_init(&b->refs, 1);
+  b->data = b->bytes;
+  b->len = len;
+  b->parent = NULL;
+  b->owned = NULL;
+  b->mapped = 0;
+  b->chars = b->hash = 0;
+  b->bytes[len] = 0;
+  return b;
+}
+
+// A buffer over len bytes at data without copying them; with own, data is
+// malloc'd and freed with the buffer
+fn OmniBuf* omni_buf_adopt(void *data, size_t len, int own) {
+  OmniBuf *b = (OmniBuf*)malloc(sizeof(OmniBuf));
+  if (!b) {
+    if (own) free(data);
+    return NULL;
+  }
+  atomic_init(&b->refs, 1);
+  b->data = (u8*)data;
+  b->len = len;
+  b->parent = NULL;
+  b->owned = own ? data : NULL;
+  b->mapped = 0;
+  b->chars = b->hash = 0;
+  return b;
+}
+
+// A buffer over the first len bytes of fd, mapped read-only; NULL (errno
+// set) if it cannot be mapped. Pages are read as they are touched.
+fn OmniBuf* omni_buf_map(int fd, size_t len) {
+  if (len == 0) return omni_buf_new(0);         // mmap rejects empty maps
+  void *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) return NULL;
+  madvise(data, len, MADV_SEQUENTIAL);
+  OmniBuf *b = omni_buf_adopt(data, len, 0);
+  if (!b) {
+    munmap(data, len);
+    errno = ENOMEM;
+    return NULL;
+  }
+  b->owned = data;
+  b->mapped = len;
+  return b;
+}
+
+fn OmniBuf* omni_buf_retain(OmniBuf *b) {
+  atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+  return b;
+}
+
+// omni_buf_retain for omni_ffi_handle_acquire
+fn void* omni_buf_retain_ptr(void *b) {
+  return omni_buf_retain((OmniBuf*)b);
+}
+
+fn void omni_buf_release(OmniBuf *b) {
+  while (b && atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) == 1) {
+    OmniBuf *parent = b->parent;
+    if (b->mapped) munmap(b->owned, b->mapped);
+    else free(b->owned);
+    free(b);
+    b = parent;
+  }
+}
+
+// Handle table release hook for OMNI_NAM_BUF
+fn void omni_buf_drop(void *ptr) {
+  omni_buf_release((OmniBuf*)ptr);
+}
+
+// len bytes of b from start, sharing its storage
+fn OmniBuf* omni_buf_slice(OmniBuf *b, size_t start, size_t len) {
+  OmniBuf *root = b->parent ? b->parent : b;
+  OmniBuf *s = (OmniBuf*)malloc(sizeof(OmniBuf));
+  if (!s) return NULL;
+  atomic_init(&s->refs, 1);
+  s->data = b->data + start;
+  s->len = len;
+  s->parent = omni_buf_retain(root);
+  s->owned = NULL;
+  s->mapped = 0;
+  s->chars = s->hash = 0;
+  return s;
+}
+
+// =============================================================================
+// Terms
+// =============================================================================
+
+fn Term omni_buf_error(int err) {
+  Term err_args[1] = {term_new_num(err)};
+  return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+}
+
+// #Buf{#Hndl} taking over the caller's reference to b
+fn Term omni_buf_term(OmniBuf *b) {
+  if (!b) return omni_buf_error(ENOMEM);
+  Term h = omni_ffi_handle_alloc(b, OMNI_OWNED, OMNI_NAM_BUF);
+  if (term_ext(h) != OMNI_NAM_HNDL) {
+    omni_buf_release(b);
+    return h;
+  }
+  return term_new_ctr(OMNI_NAM_BUF, 1, &h);
+}
+
+// Forward declarations (pstring.c)
+fn OmniBuf* omni_pstr_acquire(Term t);
+fn u32 omni_pstr_encode(u32 c, u8 *out);
+fn u32 omni_pstr_count(const u8 *data, size_t len);
+fn Term omni_pstr_decode_list(const u8 *data, size_t len, size_t chars);
+
+// Buffer of a reduced #Buf (or a view of a packed string's bytes), with a
+// reference for the caller; NULL if t is not a live buffer
+fn OmniBuf* omni_buf_acquire(Term t) {
+  if (term_tag(t) != C01) return NULL;
+  if (term_ext(t) == OMNI_NAM_PSTR) return omni_pstr_acquire(t);
+  if (term_ext(t) != OMNI_NAM_BUF) return NULL;
+  Term h = wnf(HEAP[term_val(t)]);
+  return (OmniBuf*)omni_ffi_handle_acquire(h, OMNI_NAM_BUF, omni_buf_retain_ptr);
+}
+
+// UTF-8 bytes of a char list (#CHR or numbers), in one pass
+fn OmniBuf* omni_buf_from_list(Term list) {
+  size_t cap = 64, len = 0;
+  OmniBuf *b = omni_buf_new(cap);
+  if (!b) return NULL;
+  Term cur = wnf(list);
+  while (term_tag(cur) == C02 && term_ext(cur) == NAM_CON) {
+    u32 loc = term_val(cur);
+    Term head = wnf(HEAP[loc]);
+    if (term_tag(head) == C01 && term_ext(head) == NAM_CHR) head = wnf(HEAP[term_val(head)]);
+    if (len + 4 > cap) {
+      cap *= 2;
+      OmniBuf *grown = (OmniBuf*)realloc(b, sizeof(OmniBuf) + cap + 1);
+      if (!grown) {
+        free(b);
+        return NULL;
+      }
+      b = grown;
+    }
+    len += omni_pstr_encode(term_val(head), b->bytes + len);
+    cur = wnf(HEAP[loc + 1]);
+  }
+  b->data = b->bytes;
+  b->len = len;
+  b->bytes[len] = 0;
+  return b;
+}
+
+// Char list of len bytes
+fn Term omni_buf_to_list(const u8 *data, size_t len) {
+  Term result = term_new_ctr(NAM_NIL, 0, NULL);
+  for (size_t i = len; i > 0; i--) {
+    Term chr_args[1] = {term_new_num(data[i - 1])};
+    Term con_args[2] = {term_new_ctr(NAM_CHR, 1, chr_args), result};
+    result = term_new_ctr(NAM_CON, 2, con_args);
+  }
+  return result;
+}
+
+// The first n reduced args; returns how many there were
+fn u32 omni_buf_args(Term args, Term *out, u32 n) {
+  u32 got = 0;
+  while (got < n && term_tag(args) == C02 && term_ext(args) == NAM_CON) {
+    u32 loc = term_val(args);
+    out[got++] = wnf(HEAP[loc]);
+    args = wnf(HEAP[loc + 1]);
+  }
+  return got;
+}
+
+// Non-negative integer argument
+fn int omni_buf_index(Term t, size_t *out) {
+  if (term_tag(t) == C01 && (term_ext(t) == OMNI_NAM_CST || term_ext(t) == OMNI_NAM_LIT)) {
+    t = wnf(HEAP[term_val(t)]);
+  }
+  if (term_tag(t) != NUM) return 0;
+  *out = term_val(t);
+  return 1;
+}
+
+// =============================================================================
+// FFI Wrappers
+// =============================================================================
+
+// (string->buf s)
+fn Term omni_ffi_buf_from_string(Term args) {
+  Term s;
+  if (omni_buf_args(args, &s, 1) != 1) return omni_buf_error(EINVAL);
+  if (term_tag(s) == C01 && term_ext(s) == OMNI_NAM_PSTR) {
+    OmniBuf *v = omni_buf_acquire(s);               // Packed: one copy of its bytes
+    OmniBuf *b = v ? omni_buf_new(v->len) : NULL;
+    if (b) memcpy(b->bytes, v->data, v->len);
+    omni_buf_release(v);
+    return b ? omni_buf_term(b) : omni_buf_error(v ? ENOMEM : EINVAL);
+  }
+  return omni_buf_term(omni_buf_from_list(s));
+}
+
+// (buf->string b)
+fn Term omni_ffi_buf_to_string(Term args) {
+  Term t;
+  OmniBuf *b = omni_buf_args(args, &t, 1) == 1 ? omni_buf_acquire(t) : NULL;
+  if (!b) return omni_buf_error(EINVAL);
+  Term result = omni_pstr_decode_list(b->data, b->len, omni_pstr_count(b->data, b->len));
+  omni_buf_release(b);
+  return result;
+}
+
+// (buf-length b)
+fn Term omni_ffi_buf_length(Term args) {
+  Term t;
+  OmniBuf *b = omni_buf_args(args, &t, 1) == 1 ? omni_buf_acquire(t) : NULL;
+  if (!b) return omni_buf_error(EINVAL);
+  Term n = term_new_num((u32)b->len);
+  omni_buf_release(b);
+  return term_new_ctr(OMNI_NAM_CST, 1, &n);
+}
+
+// (buf-ref b i)
+fn Term omni_ffi_buf_ref(Term args) {
+  Term t[2];
+  size_t i;
+  if (omni_buf_args(args, t, 2) != 2 || !omni_buf_index(t[1], &i)) return omni_buf_error(EINVAL);
+  OmniBuf *b = omni_buf_acquire(t[0]);
+  if (!b) return omni_buf_error(EINVAL);
+  int in_range = i < b->len;
+  Term byte = term_new_num(in_range ? b->data[i] : 0);
+  omni_buf_release(b);
+  if (!in_range) return omni_buf_error(ERANGE);
+  return term_new_ctr(OMNI_NAM_CST, 1, &byte);
+}
+
+// (buf-slice b start end): bytes start..end-1
+fn Term omni_ffi_buf_slice(Term args) {
+  Term t[3];
+  size_t start, end;
+  if (omni_buf_args(args, t, 3) != 3 || !omni_buf_index(t[1], &start) ||
+      !omni_buf_index(t[2], &end)) {
+    return omni_buf_error(EINVAL);
+  }
+  OmniBuf *b = omni_buf_acquire(t[0]);
+  if (!b) return omni_buf_error(EINVAL);
+  if (start > end || end > b->len) {
+    omni_buf_release(b);
+    return omni_buf_error(ERANGE);
+  }
+  OmniBuf *s = omni_buf_slice(b, start, end - start);
+  omni_buf_release(b);
+  return omni_buf_term(s);
+}
+
+// =============================================================================
+// FFI Registration
+// =============================================================================
+
+// Names are OMNI_NAM_* nicks, so this runs after omni_names_init
+// (read-file-buf is staged with the other file calls, in io.c)
+fn void omni_ffi_register_buffer(void) {
+  omni_ffi_handle_on_drop(OMNI_NAM_BUF, omni_buf_drop);
+  omni_ffi_register_term(OMNI_NAM_STBF, omni_ffi_buf_from_string);
+  omni_ffi_register_term(OMNI_NAM_BFST, omni_ffi_buf_to_string);
+  omni_ffi_register_term(OMNI_NAM_BFLN, omni_ffi_buf_length);
+  omni_ffi_register_term(OMNI_NAM_BFRF, omni_ffi_buf_ref);
+  omni_ffi_register_term(OMNI_NAM_BFSL, omni_ffi_buf_slice);
+}
@@ -271,7 +271,7 @@ fn Term omni_dt_format(Term dt, Term fmt) {
   strftime(buf, sizeof(buf), fmt_str, &tm);
   free(fmt_str);
 
-  return omni_cstr_to_list(buf);
+  return omni_ffi_string_term(buf, strlen(buf));
 }
 
 // Parse datetime from string
@@ -510,53 +510,22 @@ fn Term omni_ffi_dt_parse(Term args) {
 }
 
 // =============================================================================
-// DateTime Dispatch
+// DateTime Registration
 // =============================================================================
 
-// Dispatch for datetime operations
-fn Term omni_ffi_dt_dispatch(u32 name_nick, Term args) {
-  if (name_nick == OMNI_NAM_DTNW) {
-    return omni_ffi_dt_now(args);
-  }
-  if (name_nick == OMNI_NAM_DTYR) {
-    return omni_ffi_dt_year(args);
-  }
-  if (name_nick == OMNI_NAM_DTMO) {
-    return omni_ffi_dt_month(args);
-  }
-  if (name_nick == OMNI_NAM_DTDY) {
-    return omni_ffi_dt_day(args);
-  }
-  if (name_nick == OMNI_NAM_DTHR) {
-    return omni_ffi_dt_hour(args);
-  }
-  if (name_nick == OMNI_NAM_DTMI) {
-    return omni_ffi_dt_minute(args);
-  }
-  if (name_nick == OMNI_NAM_DTSC) {
-    return omni_ffi_dt_second(args);
-  }
-  if (name_nick == OMNI_NAM_DTTS) {
-    return omni_ffi_dt_to_timestamp(args);
-  }
-  if (name_nick == OMNI_NAM_DTFT) {
-    return omni_ffi_dt_from_timestamp(args);
-  }
-  if (name_nick == OMNI_NAM_DTAD) {
-    return omni_ffi_dt_add(args);
-  }
-  if (name_nick == OMNI_NAM_DTSB) {
-    return omni_ffi_dt_sub(args);
-  }
-  if (name_nick == OMNI_NAM_DTDF) {
-    return omni_ffi_dt_diff(args);
-  }
-  if (name_nick == OMNI_NAM_DTFM) {
-    return omni_ffi_dt_format(args);
-  }
-  if (name_nick == OMNI_NAM_DTPR) {
-    return omni_ffi_dt_parse(args);
-  }
-
-  return 0;  // Not a datetime operation
+fn void omni_ffi_register_dt(void) {
+  omni_ffi_register_term(OMNI_NAM_DTNW, omni_ffi_dt_now);
+  omni_ffi_register_term(OMNI_NAM_DTYR, omni_ffi_dt_year);
+  omni_ffi_register_term(OMNI_NAM_DTMO, omni_ffi_dt_month);
+  omni_ffi_register_term(OMNI_NAM_DTDY, omni_ffi_dt_day);
+  omni_ffi_register_term(OMNI_NAM_DTHR, omni_ffi_dt_hour);
+  omni_ffi_register_term(OMNI_NAM_DTMI, omni_ffi_dt_minute);
+  omni_ffi_register_term(OMNI_NAM_DTSC, omni_ffi_dt_second);
+  omni_ffi_register_term(OMNI_NAM_DTTS, omni_ffi_dt_to_timestamp);
+  omni_ffi_register_term(OMNI_NAM_DTFT, omni_ffi_dt_from_timestamp);
+  omni_ffi_register_term(OMNI_NAM_DTAD, omni_ffi_dt_add);
+  omni_ffi_register_term(OMNI_NAM_DTSB, omni_ffi_dt_sub);
+  omni_ffi_register_term(OMNI_NAM_DTDF, omni_ffi_dt_diff);
+  omni_ffi_register_term(OMNI_NAM_DTFM, omni_ffi_dt_format);
+  omni_ffi_register_term(OMNI_NAM_DTPR, omni_ffi_dt_parse);
 }
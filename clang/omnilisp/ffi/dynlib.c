@@ -0,0 +1,187 @@
+// OmniLisp Native Libraries
+// Load shared objects at runtime and declare their functions by signature
+//
+//   (ffi-load "libfoo.so")                       -> #FFI{DlOp, [path]}
+//   (ffi-declare "name" "symbol" "f64(f64)")     -> #FFI{DlDc, [name sym sig]}
+//   (ffi "libfoo" "name" args...)                 the declared function
+//
+// ffi-load opens a library with dlopen (RTLD_NOW, so missing dependencies
+// fail here rather than on the first call). Libraries stay loaded until
+// exit: declared entries keep pointers into them.
+//
+// ffi-declare resolves the symbol once, searching the loaded libraries from
+// the most recent, then the interpreter itself (libc, libm), and registers it
+// under name like omni_ffi_register_sig (signature.c). The registry then
+// serves every call from its nick-indexed table, so the cost of dlsym is paid
+// at declaration only. A nick keeps only the first four characters of a name,
+// so a name is refused when its nick already belongs to a built-in or to
+// another declared name ("sqrtf" next to the built-in "sqrt"); declaring the
+// same name again replaces it.
+//
+// Both return #True, or #Err{errno}: ENOENT for a library or symbol that is
+// not found, EINVAL for a malformed signature or arguments, EEXIST for a
+// name whose nick is taken, ENOSPC when the library table or the registry is
+// full.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// Library Table
+// =============================================================================
+
+#define OMNI_FFI_MAX_LIBS 64
+
+// Names given to ffi-declare, by nick: the registry keeps only the nick, so
+// this tells a redeclaration from a different name that shares it
+typedef struct {
+  u32 nick;
+  char *name;
+} OmniFFIDecl;
+
+typedef struct {
+  void *handles[OMNI_FFI_MAX_LIBS];
+  u32 count;
+  OmniFFIDecl *decls;
+  u32 decl_count;
+  u32 decl_cap;
+  pthread_mutex_t lock;
+} OmniFFILibs;
+
+static OmniFFILibs OMNI_FFI_LIBS = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// dlopen path and remember it; returns 0 or an errno value
+fn int omni_ffi_lib_open(const char *path) {
+  void *h = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (!h) return ENOENT;
+
+  int err = 0;
+  pthread_mutex_lock(&OMNI_FFI_LIBS.lock);
+  u32 i = 0;
+  while (i < OMNI_FFI_LIBS.count && OMNI_FFI_LIBS.handles[i] != h) i++;
+  if (i < OMNI_FFI_LIBS.count) {
+    dlclose(h);                         // Already loaded: drop the extra reference
+  } else if (OMNI_FFI_LIBS.count == OMNI_FFI_MAX_LIBS) {
+    dlclose(h);
+    err = ENOSPC;
+  } else {
+    OMNI_FFI_LIBS.handles[OMNI_FFI_LIBS.count++] = h;
+  }
+  pthread_mutex_unlock(&OMNI_FFI_LIBS.lock);
+  return err;
+}
+
+// Address of symbol: loaded libraries, newest first, then the interpreter
+fn void* omni_ffi_lib_symbol(const char *symbol) {
+  void *sym = NULL;
+  pthread_mutex_lock(&OMNI_FFI_LIBS.lock);
+  for (u32 i = OMNI_FFI_LIBS.count; i > 0 && !sym; i--) {
+    sym = dlsym(OMNI_FFI_LIBS.handles[i - 1], symbol);
+  }
+  pthread_mutex_unlock(&OMNI_FFI_LIBS.lock);
+  return sym ? sym : dlsym(RTLD_DEFAULT, symbol);
+}
+
+// Register fn_ptr under name by signature, unless its nick is taken by a
+// built-in or a different declared name; returns 0 or an errno value
+fn int omni_ffi_lib_register(const char *name, void *fn_ptr, const char *signature) {
+  u32 nick = omni_nick(name);
+  char *copy = NULL;
+  int err = 0;
+  pthread_mutex_lock(&OMNI_FFI_LIBS.lock);
+  u32 i = 0;
+  while (i < OMNI_FFI_LIBS.decl_count && OMNI_FFI_LIBS.decls[i].nick != nick) i++;
+  if (i < OMNI_FFI_LIBS.decl_count) {
+    if (strcmp(OMNI_FFI_LIBS.decls[i].name, name) != 0) err = EEXIST;
+  } else if (omni_ffi_lookup(nick)) {
+    err = EEXIST;
+  } else {
+    if (OMNI_FFI_LIBS.decl_count == OMNI_FFI_LIBS.decl_cap) {
+      u32 cap = OMNI_FFI_LIBS.decl_cap ? OMNI_FFI_LIBS.decl_cap * 2 : 16;
+      OmniFFIDecl *grown = (OmniFFIDecl*)realloc(OMNI_FFI_LIBS.decls, cap * sizeof(OmniFFIDecl));
+      if (grown) {
+        OMNI_FFI_LIBS.decls = grown;
+        OMNI_FFI_LIBS.decl_cap = cap;
+      }
+    }
+    copy = OMNI_FFI_LIBS.decl_count < OMNI_FFI_LIBS.decl_cap ? strdup(name) : NULL;
+    if (!copy) err = ENOMEM;
+  }
+  if (!err && !omni_ffi_register_sig(name, fn_ptr, signature, OMNI_BORROWED, 0)) err = ENOSPC;
+  if (!err && copy) {
+    OMNI_FFI_LIBS.decls[OMNI_FFI_LIBS.decl_count++] = (OmniFFIDecl){nick, copy};
+  } else {
+    free(copy);
+  }
+  pthread_mutex_unlock(&OMNI_FFI_LIBS.lock);
+  return err;
+}
+
+// =============================================================================
+// FFI Wrappers
+// =============================================================================
+
+fn Term omni_ffi_lib_status(int err) {
+  if (err == 0) return term_new_ctr(OMNI_NAM_TRUE, 0, NULL);
+  Term err_args[1] = {term_new_num(err)};
+  return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+}
+
+// Up to n strings from an args list, malloc'd; returns how many were read
+fn u32 omni_ffi_lib_strings(Term args, char **out, u32 n) {
+  u32 got = 0;
+  while (got < n && term_tag(args) == C02 && term_ext(args) == NAM_CON) {
+    u32 loc = term_val(args);
+    Term v = wnf(HEAP[loc]);
+    if ((term_tag(v) != C02 || term_ext(v) != NAM_CON) && !omni_pstr_is(v)) break;
+    out[got] = omni_list_to_cstr(v);
+    if (!out[got]) break;
+    got++;
+    args = wnf(HEAP[loc + 1]);
+  }
+  return got;
+}
+
+// (ffi-load path)
+fn Term omni_ffi_lib_load(Term args) {
+  char *path;
+  if (omni_ffi_lib_strings(args, &path, 1) != 1) return omni_ffi_lib_status(EINVAL);
+  int err = omni_ffi_lib_open(path);
+  free(path);
+  return omni_ffi_lib_status(err);
+}
+
+// (ffi-declare name symbol signature)
+fn Term omni_ffi_lib_declare(Term args) {
+  char *s[3];
+  u32 n = omni_ffi_lib_strings(args, s, 3);
+  int err = EINVAL;
+  if (n == 3) {
+    void *fn_ptr = omni_ffi_lib_symbol(s[1]);
+    if (!fn_ptr) {
+      err = ENOENT;
+    } else {
+      OmniFFISig sig;
+      if (!omni_ffi_sig_parse(s[2], &sig)) err = EINVAL;
+      else err = omni_ffi_lib_register(s[0], fn_ptr, s[2]);
+    }
+  }
+  for (u32 i = 0; i < n; i++) free(s[i]);
+  return omni_ffi_lib_status(err);
+}
+
+// =============================================================================
+// FFI Registration
+// =============================================================================
+
+// Names are OMNI_NAM_* nicks, so this runs after omni_names_init
+fn void omni_ffi_register_dynlib(void) {
+  omni_ffi_register_term(OMNI_NAM_DLOP, omni_ffi_lib_load);
+  omni_ffi_register_term(OMNI_NAM_DLDC, omni_ffi_lib_declare);
+}
@@ -1,10 +1,30 @@
 // OmniLisp Handle Table
 // Safe handle-based memory management for FFI pointers
 // Uses generation counters for ABA protection
+//
+// Reducer threads (-j N) and FFI workers use the table concurrently. It is
+// made of fixed segments that are never moved, so a slot pointer stays valid
+// for the life of the table. Each slot has one atomic word holding its
+// generation and a live bit: releasing a handle (free, consume, take) is a
+// CAS that bumps the generation, so exactly one caller wins and every copy
+// of the handle goes stale at once. Lookups take no lock; they read the
+// word, the slot, and the word again.
+//
+// Free slots sit on per-thread shards, picked by reducer id, each with its
+// own lock. A thread frees to and allocates from its own shard; an empty
+// shard takes a fresh segment.
+//
+// (with-handle-scope body) releases the handles allocated while body was
+// evaluated, on whichever reducer, together when it finishes, apart from
+// those its value holds: one CAS per handle, one shard lock for the lot.
 
 // hvm4.c is already included by main.c before this file
 // #include "../../../hvm4/clang/hvm4.c"
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
 // =============================================================================
 // Ownership Kinds
 // =============================================================================
@@ -20,85 +40,127 @@ typedef enum {
 // Handle Slot
 // =============================================================================
 
+// tag: generation << 1 | live. The other fields are written by the
+// allocating thread before the tag goes live and cleared by the thread that
+// wins the release; lookups may read them meanwhile, so all accesses after
+// publication are atomic and checked against the tag. A lookup that takes a
+// reference to the pointee pins the slot, and the release waits for the
+// pins before the pointer is dropped.
 typedef struct {
-  u32  generation;     // Generation counter for ABA protection
+  atomic_uint tag;
+  atomic_uint pins;    // omni_ffi_handle_acquire calls reading the pointer
   void *pointer;       // The actual C pointer
   OmniOwnership ownership;
   u32  type_id;        // Type identifier for runtime checks
-  u32  next_free;      // Index of next free slot (when in free list)
+  u32  next_free;      // Index of next free slot (on a shard's free list)
 } OmniHandleSlot;
 
+#define OMNI_HANDLE_GEN_MASK  0xFFFu                  // 12 bits, as packed in #Hndl
+#define OMNI_HANDLE_LIVE(gen) (((gen) << 1) | 1u)
+
 // =============================================================================
 // Handle Table
 // =============================================================================
 
-#define OMNI_HANDLE_INITIAL_CAP 1024
-#define OMNI_HANDLE_MAX_CAP     (1 << 20)  // 1M handles max
+#define OMNI_HANDLE_SEG_BITS    10
+#define OMNI_HANDLE_SEG_SIZE    (1u << OMNI_HANDLE_SEG_BITS)   // Slots per segment
+#define OMNI_HANDLE_MAX_SEGS    (1u << (20 - OMNI_HANDLE_SEG_BITS))  // 1M handles max
+#define OMNI_HANDLE_SHARDS      OMNI_MAX_REDUCERS
 
 typedef struct {
-  OmniHandleSlot *slots;
-  u32  capacity;
+  pthread_mutex_t lock;
   u32  free_head;      // Head of free list (UINT32_MAX = none free)
-  u32  count;          // Number of allocated handles
+} __attribute__((aligned(64))) OmniHandleShard;
+
+typedef struct {
+  OmniHandleSlot *segs[OMNI_HANDLE_MAX_SEGS];  // Published once, never moved
+  atomic_uint segments;                        // Segments in use
+  atomic_uint count;                           // Number of allocated handles
+  OmniHandleShard shards[OMNI_HANDLE_SHARDS];
 } OmniHandleTable;
 
 // Global handle table
-static OmniHandleTable OMNI_HANDLES = {0};
-static int OMNI_HANDLES_READY = 0;
+static OmniHandleTable OMNI_HANDLES;
+static pthread_once_t OMNI_HANDLES_ONCE = PTHREAD_ONCE_INIT;
+static pthread_mutex_t OMNI_HANDLES_LOCK = PTHREAD_MUTEX_INITIALIZER;  // Segment growth
+
+// Open handle scopes, shared by every thread and looked up by id, since a
+// scope may be closed on another reducer than the one that opened it. A
+// handle allocated while scopes are open is recorded in the scope current
+// on its thread, or failing that in the newest root scope (one opened
+// outside any other), which covers reducers that run part of a body
+// without having entered its scope.
+typedef struct {
+  u32  id;             // Never reused, so a stale id finds nothing
+  u32  parent;         // Scope current where this one was opened, 0 for a root
+  u32 *recs;           // Packed handles
+  u32  len, cap;
+} OmniHandleScope;
+
+typedef struct {
+  pthread_mutex_t  lock;
+  OmniHandleScope *open;   // In opening order: a scope comes after its parent
+  u32  len, cap;
+  u32  next_id;
+  atomic_uint count;       // len, read without the lock by allocation
+} OmniHandleScopes;
+
+static OmniHandleScopes OMNI_HANDLE_SCOPES = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static __thread u32 OMNI_HANDLE_SCOPE_CUR;   // Scope of this thread's allocations
 
 // =============================================================================
 // Handle Table Initialization
 // =============================================================================
 
-fn void omni_ffi_handle_init(void) {
-  if (OMNI_HANDLES_READY) return;
+fn void omni_ffi_handle_setup(void) {
+  for (u32 i = 0; i < OMNI_HANDLE_SHARDS; i++) {
+    pthread_mutex_init(&OMNI_HANDLES.shards[i].lock, NULL);
+    OMNI_HANDLES.shards[i].free_head = UINT32_MAX;
+  }
+}
 
-  OMNI_HANDLES.capacity = OMNI_HANDLE_INITIAL_CAP;
-  OMNI_HANDLES.slots = (OmniHandleSlot*)calloc(
-    OMNI_HANDLE_INITIAL_CAP, sizeof(OmniHandleSlot)
-  );
+fn void omni_ffi_handle_init(void) {
+  pthread_once(&OMNI_HANDLES_ONCE, omni_ffi_handle_setup);
+}
 
-  // Build initial free list
-  for (u32 i = 0; i < OMNI_HANDLE_INITIAL_CAP - 1; i++) {
-    OMNI_HANDLES.slots[i].next_free = i + 1;
-    OMNI_HANDLES.slots[i].generation = 0;
-    OMNI_HANDLES.slots[i].pointer = NULL;
-  }
-  OMNI_HANDLES.slots[OMNI_HANDLE_INITIAL_CAP - 1].next_free = UINT32_MAX;
-  OMNI_HANDLES.free_head = 0;
-  OMNI_HANDLES.count = 0;
+// Slot idx, or NULL if its segment does not exist
+fn OmniHandleSlot* omni_ffi_handle_at(u32 idx) {
+  u32 seg = idx >> OMNI_HANDLE_SEG_BITS;
+  if (seg >= OMNI_HANDLE_MAX_SEGS) return NULL;
+  OmniHandleSlot *slots = __atomic_load_n(&OMNI_HANDLES.segs[seg], __ATOMIC_ACQUIRE);
+  return slots ? &slots[idx & (OMNI_HANDLE_SEG_SIZE - 1)] : NULL;
+}
 
-  OMNI_HANDLES_READY = 1;
+fn OmniHandleShard* omni_ffi_handle_shard(void) {
+  return &OMNI_HANDLES.shards[omni_reducer_tid % OMNI_HANDLE_SHARDS];
 }
 
 // =============================================================================
 // Handle Table Growth
 // =============================================================================
 
-fn int omni_ffi_handle_grow(void) {
-  u32 new_cap = OMNI_HANDLES.capacity * 2;
-  if (new_cap > OMNI_HANDLE_MAX_CAP) {
+// Add a segment and chain its slots onto shard (whose lock is held)
+fn int omni_ffi_handle_grow(OmniHandleShard *shard) {
+  pthread_mutex_lock(&OMNI_HANDLES_LOCK);
+  u32 seg = atomic_load_explicit(&OMNI_HANDLES.segments, memory_order_relaxed);
+  OmniHandleSlot *slots = seg < OMNI_HANDLE_MAX_SEGS
+    ? (OmniHandleSlot*)calloc(OMNI_HANDLE_SEG_SIZE, sizeof(OmniHandleSlot))
+    : NULL;
+  if (!slots) {
+    pthread_mutex_unlock(&OMNI_HANDLES_LOCK);
     return 0;  // Cannot grow further
   }
 
-  OmniHandleSlot *new_slots = (OmniHandleSlot*)realloc(
-    OMNI_HANDLES.slots,
-    new_cap * sizeof(OmniHandleSlot)
-  );
-  if (!new_slots) return 0;
-
-  // Initialize new slots and add to free list
-  for (u32 i = OMNI_HANDLES.capacity; i < new_cap - 1; i++) {
-    new_slots[i].next_free = i + 1;
-    new_slots[i].generation = 0;
-    new_slots[i].pointer = NULL;
+  u32 base = seg << OMNI_HANDLE_SEG_BITS;
+  for (u32 i = 0; i < OMNI_HANDLE_SEG_SIZE - 1; i++) {
+    slots[i].next_free = base + i + 1;
   }
-  new_slots[new_cap - 1].next_free = OMNI_HANDLES.free_head;
-  OMNI_HANDLES.free_head = OMNI_HANDLES.capacity;
-
-  OMNI_HANDLES.slots = new_slots;
-  OMNI_HANDLES.capacity = new_cap;
+  slots[OMNI_HANDLE_SEG_SIZE - 1].next_free = shard->free_head;
+  shard->free_head = base;
 
+  __atomic_store_n(&OMNI_HANDLES.segs[seg], slots, __ATOMIC_RELEASE);
+  atomic_store_explicit(&OMNI_HANDLES.segments, seg + 1, memory_order_release);
+  pthread_mutex_unlock(&OMNI_HANDLES_LOCK);
   return 1;
 }
 
@@ -106,35 +168,71 @@ fn int omni_ffi_handle_grow(void) {
 // Handle Allocation
 // =============================================================================
 
+// Index of open scope id, or UINT32_MAX (lock held)
+fn u32 omni_ffi_handle_scope_find(u32 id) {
+  for (u32 i = OMNI_HANDLE_SCOPES.len; id != 0 && i > 0; i--) {
+    if (OMNI_HANDLE_SCOPES.open[i - 1].id == id) return i - 1;
+  }
+  return UINT32_MAX;
+}
+
+fn void omni_ffi_handle_scope_push(OmniHandleScope *sc, u32 packed) {
+  if (sc->len == sc->cap) {
+    u32 cap = sc->cap ? sc->cap * 2 : 64;
+    u32 *recs = (u32*)realloc(sc->recs, cap * sizeof(u32));
+    if (!recs) return;  // Untracked: released one at a time as before
+    sc->recs = recs;
+    sc->cap = cap;
+  }
+  sc->recs[sc->len++] = packed;
+}
+
+// Remember a new handle in the thread's scope, or the newest root scope
+fn void omni_ffi_handle_scope_record(u32 packed) {
+  pthread_mutex_lock(&OMNI_HANDLE_SCOPES.lock);
+  u32 i = omni_ffi_handle_scope_find(OMNI_HANDLE_SCOPE_CUR);
+  for (u32 j = OMNI_HANDLE_SCOPES.len; i == UINT32_MAX && j > 0; j--) {
+    if (OMNI_HANDLE_SCOPES.open[j - 1].parent == 0) i = j - 1;
+  }
+  if (i != UINT32_MAX) omni_ffi_handle_scope_push(&OMNI_HANDLE_SCOPES.open[i], packed);
+  pthread_mutex_unlock(&OMNI_HANDLE_SCOPES.lock);
+}
+
 // Allocate a handle for a pointer
 // Returns handle as Term: #Hndl{idx, gen}
 fn Term omni_ffi_handle_alloc(void *ptr, OmniOwnership ownership, u32 type_id) {
-  if (!OMNI_HANDLES_READY) omni_ffi_handle_init();
-
-  // Grow table if needed
-  if (OMNI_HANDLES.free_head == UINT32_MAX) {
-    if (!omni_ffi_handle_grow()) {
-      // Out of handles - return error
-      Term args[1] = {term_new_num(0)};
-      return term_new_ctr(OMNI_NAM_ERR, 1, args);
-    }
+  omni_ffi_handle_init();
+  OmniHandleShard *shard = omni_ffi_handle_shard();
+
+  pthread_mutex_lock(&shard->lock);
+  if (shard->free_head == UINT32_MAX && !omni_ffi_handle_grow(shard)) {
+    pthread_mutex_unlock(&shard->lock);
+    // Out of handles - return error
+    Term args[1] = {term_new_num(0)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, args);
   }
 
   // Pop from free list
-  u32 idx = OMNI_HANDLES.free_head;
-  OmniHandleSlot *slot = &OMNI_HANDLES.slots[idx];
-  OMNI_HANDLES.free_head = slot->next_free;
-  OMNI_HANDLES.count++;
-
-  // Initialize slot
-  slot->pointer = ptr;
-  slot->ownership = ownership;
-  slot->type_id = type_id;
-  // generation already set (preserved across reuse)
+  u32 idx = shard->free_head;
+  OmniHandleSlot *slot = omni_ffi_handle_at(idx);
+  shard->free_head = slot->next_free;
+  pthread_mutex_unlock(&shard->lock);
+
+  // Initialize slot, then publish it; generation was bumped on release
+  __atomic_store_n(&slot->pointer, ptr, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->ownership, ownership, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->type_id, type_id, __ATOMIC_RELAXED);
+  u32 gen = atomic_load_explicit(&slot->tag, memory_order_relaxed) >> 1;
+  atomic_store_explicit(&slot->tag, OMNI_HANDLE_LIVE(gen), memory_order_release);
+  atomic_fetch_add_explicit(&OMNI_HANDLES.count, 1, memory_order_relaxed);
 
   // Return #Hndl{packed} as a CTR node
   // Pack idx (20 bits) and gen (12 bits) into val
-  u32 packed = (idx & 0xFFFFF) | ((slot->generation & 0xFFF) << 20);
+  u32 packed = (idx & 0xFFFFF) | ((gen & OMNI_HANDLE_GEN_MASK) << 20);
+  if (atomic_load_explicit(&OMNI_HANDLE_SCOPES.count, memory_order_relaxed) > 0) {
+    omni_ffi_handle_scope_record(packed);
+  }
+
   Term args[1] = {term_new_num(packed)};
   return term_new_ctr(OMNI_NAM_HNDL, 1, args);
 }
@@ -143,43 +241,105 @@ fn Term omni_ffi_handle_alloc(void *ptr, OmniOwnership ownership, u32 type_id) {
 // Handle Deallocation
 // =============================================================================
 
-// Free a handle and optionally the underlying pointer
-fn int omni_ffi_handle_free(Term handle) {
-  // Check if it's a constructor with 1 arg (C01)
-  if (term_tag(handle) != C01) return 0;
-  if (term_ext(handle) != OMNI_NAM_HNDL) return 0;
+// Slot and generation of a #Hndl; NULL if t is not one
+fn OmniHandleSlot* omni_ffi_handle_decode(Term handle, u32 *gen) {
+  if (term_tag(handle) != C01) return NULL;
+  if (term_ext(handle) != OMNI_NAM_HNDL) return NULL;
 
-  // Get packed value from the constructor's argument
   Term arg = HEAP[term_val(handle)];
   u32 packed = term_val(arg);
-  u32 idx = packed & 0xFFFFF;
-  u32 gen = (packed >> 20) & 0xFFF;
+  *gen = (packed >> 20) & OMNI_HANDLE_GEN_MASK;
+  return omni_ffi_handle_at(packed & 0xFFFFF);
+}
 
-  if (idx >= OMNI_HANDLES.capacity) return 0;
+// End generation gen of slot: only one caller gets 1, and afterwards owns
+// the slot's contents until it is pushed back on a free list
+fn int omni_ffi_handle_retire(OmniHandleSlot *slot, u32 gen) {
+  u32 live = OMNI_HANDLE_LIVE(gen);
+  u32 dead = ((gen + 1) & OMNI_HANDLE_GEN_MASK) << 1;
+  return atomic_compare_exchange_strong_explicit(
+    &slot->tag, &live, dead, memory_order_seq_cst, memory_order_relaxed
+  );
+}
 
-  OmniHandleSlot *slot = &OMNI_HANDLES.slots[idx];
+// Clear a retired slot; returns the pointer it held. Waits out the
+// acquires that saw the slot live (omni_ffi_handle_acquire).
+fn void* omni_ffi_handle_clear(OmniHandleSlot *slot) {
+  while (atomic_load_explicit(&slot->pins, memory_order_seq_cst) != 0) sched_yield();
+  void *ptr = __atomic_load_n(&slot->pointer, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->pointer, NULL, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->ownership, OMNI_BORROWED, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->type_id, 0, __ATOMIC_RELAXED);
+  return ptr;
+}
 
-  // Validate generation
-  if (slot->generation != gen) {
-    return 0;  // Stale handle
+// Owned pointers are released with free() unless their type registered a
+// release function (buffer.c: reference-counted byte regions)
+typedef void (*OmniHandleDrop)(void *ptr);
+
+#define OMNI_HANDLE_MAX_DROPS 8
+
+typedef struct {
+  u32 type_id;
+  OmniHandleDrop drop;
+} OmniHandleDropEntry;
+
+static OmniHandleDropEntry OMNI_HANDLE_DROPS[OMNI_HANDLE_MAX_DROPS];
+static u32 OMNI_HANDLE_DROP_COUNT = 0;
+
+// Set at registration, before any handle of type_id exists
+fn void omni_ffi_handle_on_drop(u32 type_id, OmniHandleDrop drop) {
+  if (OMNI_HANDLE_DROP_COUNT < OMNI_HANDLE_MAX_DROPS) {
+    OMNI_HANDLE_DROPS[OMNI_HANDLE_DROP_COUNT++] = (OmniHandleDropEntry){type_id, drop};
   }
+}
 
-  // Free the underlying pointer if owned
-  if (slot->ownership == OMNI_OWNED && slot->pointer) {
-    free(slot->pointer);
+// Release an owned pointer of type_id
+fn void omni_ffi_handle_drop(void *ptr, u32 type_id) {
+  if (!ptr) return;
+  for (u32 i = 0; i < OMNI_HANDLE_DROP_COUNT; i++) {
+    if (OMNI_HANDLE_DROPS[i].type_id == type_id) {
+      OMNI_HANDLE_DROPS[i].drop(ptr);
+      return;
+    }
   }
+  free(ptr);
+}
 
-  // Increment generation to invalidate any remaining references
-  slot->generation = (slot->generation + 1) & 0xFFF;
-  slot->pointer = NULL;
-  slot->ownership = OMNI_BORROWED;
-  slot->type_id = 0;
+// Clear a retired slot, releasing its pointer if the handle owned it
+fn void omni_ffi_handle_dispose(OmniHandleSlot *slot) {
+  OmniOwnership ownership = __atomic_load_n(&slot->ownership, __ATOMIC_RELAXED);
+  u32 type_id = __atomic_load_n(&slot->type_id, __ATOMIC_RELAXED);
+  void *ptr = omni_ffi_handle_clear(slot);
+  if (ownership == OMNI_OWNED) omni_ffi_handle_drop(ptr, type_id);
+}
 
-  // Push to free list
-  slot->next_free = OMNI_HANDLES.free_head;
-  OMNI_HANDLES.free_head = idx;
-  OMNI_HANDLES.count--;
+// Push the chain first..last of n retired slots on the thread's shard
+fn void omni_ffi_handle_release(u32 first, OmniHandleSlot *last, u32 n) {
+  OmniHandleShard *shard = omni_ffi_handle_shard();
+  pthread_mutex_lock(&shard->lock);
+  last->next_free = shard->free_head;
+  shard->free_head = first;
+  pthread_mutex_unlock(&shard->lock);
+  atomic_fetch_sub_explicit(&OMNI_HANDLES.count, n, memory_order_relaxed);
+}
 
+fn u32 omni_ffi_handle_index(Term handle) {
+  return term_val(HEAP[term_val(handle)]) & 0xFFFFF;
+}
+
+// Free a handle and optionally the underlying pointer
+fn int omni_ffi_handle_free(Term handle) {
+  u32 gen;
+  OmniHandleSlot *slot = omni_ffi_handle_decode(handle, &gen);
+  if (!slot || !omni_ffi_handle_retire(slot, gen)) {
+    return 0;  // Stale handle
+  }
+
+  // Free the underlying pointer if owned
+  omni_ffi_handle_dispose(slot);
+
+  omni_ffi_handle_release(omni_ffi_handle_index(handle), slot, 1);
   return 1;
 }
 
@@ -187,47 +347,52 @@ fn int omni_ffi_handle_free(Term handle) {
 // Handle Dereferencing
 // =============================================================================
 
-// Get the pointer from a handle (with validation)
-fn void* omni_ffi_handle_deref(Term handle) {
-  if (term_tag(handle) != C01) return NULL;
-  if (term_ext(handle) != OMNI_NAM_HNDL) return NULL;
-
-  Term arg = HEAP[term_val(handle)];
-  u32 packed = term_val(arg);
-  u32 idx = packed & 0xFFFFF;
-  u32 gen = (packed >> 20) & 0xFFF;
-
-  if (idx >= OMNI_HANDLES.capacity) return NULL;
-
-  OmniHandleSlot *slot = &OMNI_HANDLES.slots[idx];
-
-  // Validate generation
-  if (slot->generation != gen) {
+// Slot of a live handle (for ownership checking); the pointer stays valid
+// for the life of the table, its contents only while the handle is live
+fn OmniHandleSlot* omni_ffi_handle_slot(Term handle) {
+  u32 gen;
+  OmniHandleSlot *slot = omni_ffi_handle_decode(handle, &gen);
+  if (!slot) return NULL;
+  if (atomic_load_explicit(&slot->tag, memory_order_acquire) != OMNI_HANDLE_LIVE(gen)) {
     return NULL;  // Stale handle
   }
-
-  return slot->pointer;
+  return slot;
 }
 
-// Get handle slot info (for ownership checking)
-fn OmniHandleSlot* omni_ffi_handle_slot(Term handle) {
-  if (term_tag(handle) != C01) return NULL;
-  if (term_ext(handle) != OMNI_NAM_HNDL) return NULL;
-
-  Term arg = HEAP[term_val(handle)];
-  u32 packed = term_val(arg);
-  u32 idx = packed & 0xFFFFF;
-  u32 gen = (packed >> 20) & 0xFFF;
+// Get the pointer from a handle (with validation)
+fn void* omni_ffi_handle_deref(Term handle) {
+  u32 gen;
+  OmniHandleSlot *slot = omni_ffi_handle_decode(handle, &gen);
+  if (!slot) return NULL;
 
-  if (idx >= OMNI_HANDLES.capacity) return NULL;
+  // Read between two checks of the tag, so a pointer of a later generation
+  // is never returned for this one
+  u32 live = OMNI_HANDLE_LIVE(gen);
+  if (atomic_load_explicit(&slot->tag, memory_order_acquire) != live) return NULL;
+  void *ptr = __atomic_load_n(&slot->pointer, __ATOMIC_RELAXED);
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&slot->tag, memory_order_relaxed) != live) return NULL;
+  return ptr;
+}
 
-  OmniHandleSlot *slot = &OMNI_HANDLES.slots[idx];
+// Pointer of a live handle of type_id with retain applied to it, or NULL.
+// The slot is pinned from before the tag is checked until retain returns,
+// and a release waits for the pin, so the pointee cannot be dropped in
+// between: the caller's reference is taken on a live object.
+fn void* omni_ffi_handle_acquire(Term handle, u32 type_id, void *(*retain)(void*)) {
+  u32 gen;
+  OmniHandleSlot *slot = omni_ffi_handle_decode(handle, &gen);
+  if (!slot) return NULL;
 
-  if (slot->generation != gen) {
-    return NULL;
+  atomic_fetch_add_explicit(&slot->pins, 1, memory_order_seq_cst);
+  void *ptr = NULL;
+  if (atomic_load_explicit(&slot->tag, memory_order_seq_cst) == OMNI_HANDLE_LIVE(gen) &&
+      __atomic_load_n(&slot->type_id, __ATOMIC_RELAXED) == type_id) {
+    ptr = __atomic_load_n(&slot->pointer, __ATOMIC_RELAXED);
+    if (ptr) ptr = retain(ptr);
   }
-
-  return slot;
+  atomic_fetch_sub_explicit(&slot->pins, 1, memory_order_release);
+  return ptr;
 }
 
 // =============================================================================
@@ -241,8 +406,7 @@ fn int omni_ffi_handle_valid(Term handle) {
 // Check if handle has expected type
 fn int omni_ffi_handle_type_check(Term handle, u32 expected_type) {
   OmniHandleSlot *slot = omni_ffi_handle_slot(handle);
-  if (!slot) return 0;
-  return slot->type_id == expected_type;
+  return slot && __atomic_load_n(&slot->type_id, __ATOMIC_RELAXED) == expected_type;
 }
 
 // =============================================================================
@@ -251,34 +415,249 @@ fn int omni_ffi_handle_type_check(Term handle, u32 expected_type) {
 
 // Mark handle as consumed (ownership transferred to C)
 fn int omni_ffi_handle_consume(Term handle) {
+  u32 gen;
   OmniHandleSlot *slot = omni_ffi_handle_slot(handle);
-  if (!slot) return 0;
-
-  if (slot->ownership != OMNI_OWNED) {
+  if (!slot || __atomic_load_n(&slot->ownership, __ATOMIC_RELAXED) != OMNI_OWNED) {
     return 0;  // Can only consume owned handles
   }
+  omni_ffi_handle_decode(handle, &gen);
+  if (!omni_ffi_handle_retire(slot, gen)) return 0;
 
-  slot->ownership = OMNI_CONSUMED;
-
-  // Invalidate handle
-  slot->generation = (slot->generation + 1) & 0xFFF;
-  slot->pointer = NULL;  // C now owns this
+  // Invalidate handle; C now owns the pointer
+  omni_ffi_handle_clear(slot);
+  omni_ffi_handle_release(omni_ffi_handle_index(handle), slot, 1);
+  return 1;
+}
 
-  // Return to free list
-  slot->next_free = OMNI_HANDLES.free_head;
-  OMNI_HANDLES.free_head = (u32)(slot - OMNI_HANDLES.slots);
-  OMNI_HANDLES.count--;
+// Take the pointer out of an owned handle of the given type, invalidating
+// the handle in the same step. Returns NULL if the handle is stale, of
+// another type or already taken, so only one caller ever gets the pointer.
+fn void* omni_ffi_handle_take(Term handle, u32 expected_type) {
+  u32 gen;
+  OmniHandleSlot *slot = omni_ffi_handle_slot(handle);
+  if (!slot || __atomic_load_n(&slot->ownership, __ATOMIC_RELAXED) != OMNI_OWNED ||
+      __atomic_load_n(&slot->type_id, __ATOMIC_RELAXED) != expected_type) {
+    return NULL;
+  }
+  omni_ffi_handle_decode(handle, &gen);
+  if (!omni_ffi_handle_retire(slot, gen)) return NULL;
 
-  return 1;
+  void *ptr = omni_ffi_handle_clear(slot);
+  omni_ffi_handle_release(omni_ffi_handle_index(handle), slot, 1);
+  return ptr;
 }
 
 // Borrow a handle (for FFI call that doesn't take ownership)
 fn void* omni_ffi_handle_borrow(Term handle) {
-  OmniHandleSlot *slot = omni_ffi_handle_slot(handle);
-  if (!slot) return NULL;
-
   // Borrowed access is always allowed
-  return slot->pointer;
+  return omni_ffi_handle_deref(handle);
+}
+
+// =============================================================================
+// Handle Scopes
+// =============================================================================
+
+// Open a scope and make it current on this thread; returns its id, 0 if
+// it could not be opened
+fn u32 omni_ffi_handle_scope_begin(void) {
+  omni_ffi_handle_init();
+  OmniHandleScopes *all = &OMNI_HANDLE_SCOPES;
+  pthread_mutex_lock(&all->lock);
+  if (all->len == all->cap) {
+    u32 cap = all->cap ? all->cap * 2 : 16;
+    OmniHandleScope *open = (OmniHandleScope*)realloc(all->open, cap * sizeof(OmniHandleScope));
+    if (!open) {
+      pthread_mutex_unlock(&all->lock);
+      return 0;
+    }
+    all->open = open;
+    all->cap = cap;
+  }
+  if (++all->next_id == 0) all->next_id = 1;
+  u32 id = all->next_id;
+  u32 cur = omni_ffi_handle_scope_find(OMNI_HANDLE_SCOPE_CUR);
+  all->open[all->len++] = (OmniHandleScope){
+    .id = id,
+    .parent = cur == UINT32_MAX ? 0 : OMNI_HANDLE_SCOPE_CUR,
+  };
+  atomic_store_explicit(&all->count, all->len, memory_order_relaxed);
+  pthread_mutex_unlock(&all->lock);
+
+  OMNI_HANDLE_SCOPE_CUR = id;
+  return id;
+}
+
+fn int omni_ffi_handle_packed_cmp(const void *a, const void *b) {
+  u32 x = *(const u32*)a, y = *(const u32*)b;
+  return x < y ? -1 : x > y;
+}
+
+// Close scope id and any still open inside it, and release every handle
+// they recorded that is still live, except the keep[0..nkeep) (sorted),
+// which pass to the enclosing scope if it is open. Freed slots are chained
+// and returned to the shard in one step. Returns the number released.
+fn u32 omni_ffi_handle_scope_end_keeping(u32 id, const u32 *keep, u32 nkeep) {
+  OmniHandleScopes *all = &OMNI_HANDLE_SCOPES;
+  pthread_mutex_lock(&all->lock);
+  u32 at = omni_ffi_handle_scope_find(id);
+  if (at == UINT32_MAX) {
+    pthread_mutex_unlock(&all->lock);
+    return 0;
+  }
+
+  // Take the scope out, folding in the scopes opened inside it
+  OmniHandleScope sc = all->open[at];
+  u32 *closed = (u32*)malloc((all->len - at) * sizeof(u32));
+  u32 nclosed = 0, out = at;
+  if (closed) closed[nclosed++] = id;
+  for (u32 j = at + 1; j < all->len; j++) {
+    OmniHandleScope *in = &all->open[j];
+    int inside = 0;
+    for (u32 k = 0; k < nclosed && !inside; k++) inside = in->parent == closed[k];
+    if (!inside) {
+      all->open[out++] = *in;
+      continue;
+    }
+    closed[nclosed++] = in->id;
+    for (u32 r = 0; r < in->len; r++) omni_ffi_handle_scope_push(&sc, in->recs[r]);
+    free(in->recs);
+  }
+  all->len = out;
+
+  // Kept handles are the enclosing scope's business now
+  u32 up = omni_ffi_handle_scope_find(sc.parent);
+  for (u32 r = 0; r < sc.len; r++) {
+    if (nkeep && bsearch(&sc.recs[r], keep, nkeep, sizeof(u32), omni_ffi_handle_packed_cmp)) {
+      if (up != UINT32_MAX) omni_ffi_handle_scope_push(&all->open[up], sc.recs[r]);
+      sc.recs[r] = UINT32_MAX;
+    }
+  }
+  atomic_store_explicit(&all->count, all->len, memory_order_relaxed);
+  pthread_mutex_unlock(&all->lock);
+
+  for (u32 k = 0; k < nclosed; k++) {
+    if (OMNI_HANDLE_SCOPE_CUR == closed[k]) OMNI_HANDLE_SCOPE_CUR = sc.parent;
+  }
+  if (!closed) OMNI_HANDLE_SCOPE_CUR = sc.parent;
+  free(closed);
+
+  // Release outside the lock: a drop function may allocate handles
+  u32 first = UINT32_MAX, n = 0;
+  OmniHandleSlot *last = NULL;
+  for (u32 i = 0; i < sc.len; i++) {
+    if (sc.recs[i] == UINT32_MAX) continue;
+    u32 idx = sc.recs[i] & 0xFFFFF;
+    u32 gen = (sc.recs[i] >> 20) & OMNI_HANDLE_GEN_MASK;
+    OmniHandleSlot *slot = omni_ffi_handle_at(idx);
+    if (!slot || !omni_ffi_handle_retire(slot, gen)) continue;  // Freed or taken already
+
+    omni_ffi_handle_dispose(slot);
+
+    slot->next_free = first;
+    first = idx;
+    if (!last) last = slot;
+    n++;
+  }
+  if (n > 0) omni_ffi_handle_release(first, last, n);
+
+  free(sc.recs);
+  return n;
+}
+
+// Close scope id and release everything it recorded
+fn u32 omni_ffi_handle_scope_end(u32 id) {
+  return omni_ffi_handle_scope_end_keeping(id, NULL, 0);
+}
+
+// Scope this thread's allocations are recorded in, 0 if none
+fn u32 omni_ffi_handle_scope_current(void) {
+  return OMNI_HANDLE_SCOPE_CUR;
+}
+
+// Record this thread's allocations in scope id from now on (work handed
+// over from another thread); returns the scope it replaces
+fn u32 omni_ffi_handle_scope_enter(u32 id) {
+  u32 prev = OMNI_HANDLE_SCOPE_CUR;
+  OMNI_HANDLE_SCOPE_CUR = id;
+  return prev;
+}
+
+// Reduce v to normal form on this thread, in place, and collect the
+// packed value of every #Hndl in it into *keep (malloc'd, sorted)
+fn Term omni_ffi_handle_scope_result(Term v, u32 **keep, u32 *nkeep) {
+  u32 *stack = NULL, len = 0, cap = 0;
+  u32 kcap = 0;
+  *keep = NULL;
+  *nkeep = 0;
+
+  v = wnf(v);
+  Term t = v;
+  while (1) {
+    u32 tag = term_tag(t);
+    if (tag > C00 && tag <= C16) {
+      u32 val = term_val(t);
+      if (tag == C01 && term_ext(t) == OMNI_NAM_HNDL) {
+        if (*nkeep == kcap) {
+          kcap = kcap ? kcap * 2 : 16;
+          u32 *k = (u32*)realloc(*keep, kcap * sizeof(u32));
+          if (k) *keep = k;
+        }
+        if (*nkeep < kcap) (*keep)[(*nkeep)++] = term_val(HEAP[val]);
+      } else {
+        for (u32 i = tag - C00; i > 0; i--) {
+          if (len == cap) {
+            cap = cap ? cap * 2 : 256;
+            u32 *st = (u32*)realloc(stack, cap * sizeof(u32));
+            if (!st) break;  // Out of memory: the rest stays unreduced
+            stack = st;
+          }
+          stack[len++] = val + i - 1;
+        }
+      }
+    }
+    if (len == 0) break;
+    u32 loc = stack[--len];
+    t = wnf(HEAP[loc]);
+    HEAP[loc] = t;
+  }
+
+  free(stack);
+  if (*nkeep > 1) qsort(*keep, *nkeep, sizeof(u32), omni_ffi_handle_packed_cmp);
+  return v;
+}
+
+// FFI "HScB": [] -> #Cst{id}, run before the body of with-handle-scope
+fn Term omni_ffi_handle_scope_open(Term args) {
+  (void)args;
+  Term id = term_new_num(omni_ffi_handle_scope_begin());
+  return term_new_ctr(OMNI_NAM_CST, 1, &id);
+}
+
+// FFI "HScE": [#Cst{id}, value] -> value, run after it. The value is
+// reduced to normal form first, still in the scope, so the body is done
+// allocating when the scope closes; a handle the value holds is kept (a
+// closure's captures are not looked into). The body must therefore have a
+// finite value.
+fn Term omni_ffi_handle_scope_close(Term args) {
+  if (term_tag(args) != C02 || term_ext(args) != NAM_CON) return args;
+  u32 loc = term_val(args);
+  Term id = wnf(HEAP[loc]);
+  Term rest = wnf(HEAP[loc + 1]);
+  if (term_tag(rest) != C02 || term_ext(rest) != NAM_CON) {
+    return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+  }
+  if (term_tag(id) != C01 || term_ext(id) != OMNI_NAM_CST) {
+    return wnf(HEAP[term_val(rest)]);
+  }
+
+  u32 scope = term_val(wnf(HEAP[term_val(id)]));
+  u32 prev = omni_ffi_handle_scope_enter(scope);
+  u32 *keep, nkeep;
+  Term val = omni_ffi_handle_scope_result(HEAP[term_val(rest)], &keep, &nkeep);
+  omni_ffi_handle_scope_enter(prev);
+  omni_ffi_handle_scope_end_keeping(scope, keep, nkeep);
+  free(keep);
+  return val;
 }
 
 // =============================================================================
@@ -286,23 +665,35 @@ fn void* omni_ffi_handle_borrow(Term handle) {
 // =============================================================================
 
 fn void omni_ffi_handle_cleanup(void) {
-  if (!OMNI_HANDLES_READY) return;
+  pthread_mutex_lock(&OMNI_HANDLES_LOCK);
+  u32 segs = atomic_load_explicit(&OMNI_HANDLES.segments, memory_order_acquire);
 
   // Free all owned pointers
-  for (u32 i = 0; i < OMNI_HANDLES.capacity; i++) {
-    OmniHandleSlot *slot = &OMNI_HANDLES.slots[i];
-    if (slot->pointer && slot->ownership == OMNI_OWNED) {
-      free(slot->pointer);
-      slot->pointer = NULL;
+  for (u32 s = 0; s < segs; s++) {
+    OmniHandleSlot *slots = OMNI_HANDLES.segs[s];
+    for (u32 i = 0; i < OMNI_HANDLE_SEG_SIZE; i++) {
+      OmniHandleSlot *slot = &slots[i];
+      if ((atomic_load(&slot->tag) & 1u) && slot->pointer && slot->ownership == OMNI_OWNED) {
+        omni_ffi_handle_drop(slot->pointer, slot->type_id);
+        slot->pointer = NULL;
+      }
     }
+    free(slots);
+    OMNI_HANDLES.segs[s] = NULL;
   }
 
-  free(OMNI_HANDLES.slots);
-  OMNI_HANDLES.slots = NULL;
-  OMNI_HANDLES.capacity = 0;
-  OMNI_HANDLES.free_head = UINT32_MAX;
-  OMNI_HANDLES.count = 0;
-  OMNI_HANDLES_READY = 0;
+  for (u32 i = 0; i < OMNI_HANDLE_SHARDS; i++) {
+    OMNI_HANDLES.shards[i].free_head = UINT32_MAX;
+  }
+  atomic_store(&OMNI_HANDLES.segments, 0);
+  atomic_store(&OMNI_HANDLES.count, 0);
+  pthread_mutex_unlock(&OMNI_HANDLES_LOCK);
+
+  pthread_mutex_lock(&OMNI_HANDLE_SCOPES.lock);
+  for (u32 i = 0; i < OMNI_HANDLE_SCOPES.len; i++) free(OMNI_HANDLE_SCOPES.open[i].recs);
+  OMNI_HANDLE_SCOPES.len = 0;
+  atomic_store(&OMNI_HANDLE_SCOPES.count, 0);
+  pthread_mutex_unlock(&OMNI_HANDLE_SCOPES.lock);
 }
 
 // =============================================================================
@@ -338,10 +729,10 @@ fn void* omni_ffi_ptr_unwrap(Term ptr_term) {
 // =============================================================================
 
 fn u32 omni_ffi_handle_count(void) {
-  return OMNI_HANDLES.count;
+  return atomic_load_explicit(&OMNI_HANDLES.count, memory_order_relaxed);
 }
 
 fn u32 omni_ffi_handle_capacity(void) {
-  return OMNI_HANDLES.capacity;
+  return atomic_load_explicit(&OMNI_HANDLES.segments, memory_order_acquire) * OMNI_HANDLE_SEG_SIZE;
 }
 
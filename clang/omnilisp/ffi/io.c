@@ -14,7 +14,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 
@@ -40,13 +42,25 @@ fn u32 omni_list_length(Term list) {
   return len;
 }
 
-// Convert HVM4 char list to C string
+// Convert HVM4 char list (or packed string) to C string
 // Returns malloc'd string (caller must free)
 // Returns NULL on error
 fn char* omni_list_to_cstr(Term list) {
   // Evaluate the list first
   list = wnf(list);
 
+  // Packed string: copy its UTF-8 bytes
+  if (omni_pstr_is(list)) {
+    OmniBuf *b = omni_pstr_acquire(list);
+    char *s = b ? (char*)malloc(b->len + 1) : NULL;
+    if (s) {
+      memcpy(s, b->data, b->len);
+      s[b->len] = '\0';
+    }
+    omni_buf_release(b);
+    return s;
+  }
+
   // First pass: count length
   u32 len = omni_list_length(list);
 
@@ -114,26 +128,25 @@ fn Term omni_cstr_to_list(const char *str) {
   return result;
 }
 
+// String result of an FFI call: packed with OMNI_PACKED_STRINGS=1
+// (pstring.c), a char list otherwise
+fn Term omni_ffi_string_term(const char *str, size_t len) {
+  if (OMNI_PSTR_ENABLED) return omni_pstr_string(str ? str : "", len);
+  return omni_cstr_to_list(str);
+}
+
 // =============================================================================
 // File Operations
 // =============================================================================
 
-// Read entire file contents as char list
-// Returns char list on success, #Err{errno} on failure
-fn Term omni_io_read_file(Term path_list) {
-  char *path = omni_list_to_cstr(path_list);
-  if (!path) {
-    Term args[1] = {term_new_num(ENOMEM)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
-  }
-
+// Read the whole file at path into a NUL-terminated malloc'd buffer, and
+// its length into *len unless len is NULL
+// Returns 0 on success, an errno value on failure. Does not touch the heap,
+// so it can run on an FFI worker.
+fn int omni_io_read_path(const char *path, char **out, size_t *len) {
+  *out = NULL;
   FILE *f = fopen(path, "rb");
-  if (!f) {
-    int err = errno;
-    free(path);
-    Term args[1] = {term_new_num(err)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
-  }
+  if (!f) return errno;
 
   // Get file size
   fseek(f, 0, SEEK_END);
@@ -142,110 +155,132 @@ fn Term omni_io_read_file(Term path_list) {
 
   if (size < 0 || size > 100000000) {  // 100MB limit
     fclose(f);
-    free(path);
-    Term args[1] = {term_new_num(EFBIG)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
+    return EFBIG;
   }
 
   // Read content
   char *content = (char*)malloc(size + 1);
   if (!content) {
     fclose(f);
-    free(path);
-    Term args[1] = {term_new_num(ENOMEM)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
+    return ENOMEM;
   }
 
   size_t read_size = fread(content, 1, size, f);
   content[read_size] = '\0';
   fclose(f);
-  free(path);
 
-  // Convert to char list
-  Term result = omni_cstr_to_list(content);
-  free(content);
+  *out = content;
+  if (len) *len = read_size;
+  return 0;
+}
 
-  return result;
+// Map the file at path read-only into *out (buffer.c) instead of reading it
+// Returns 0 on success, an errno value on failure. Stream offsets are #Cst
+// numbers, so files of 4GB or more are refused with EFBIG.
+fn int omni_io_map_path(const char *path, OmniBuf **out) {
+  *out = NULL;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return errno;
+
+  struct stat st;
+  int err = 0;
+  if (fstat(fd, &st) != 0) {
+    err = errno;
+  } else if (!S_ISREG(st.st_mode)) {
+    err = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+  } else if ((u64)st.st_size > 0xFFFFFFFFull) {
+    err = EFBIG;
+  } else if (!(*out = omni_buf_map(fd, (size_t)st.st_size))) {
+    err = errno ? errno : ENOMEM;
+  }
+  close(fd);
+  return err;
 }
 
-// Write string content to file
-// Returns #True on success, #Err{errno} on failure
-fn Term omni_io_write_file(Term path_list, Term content_list) {
+// Read entire file contents as char list
+// Returns char list on success, #Err{errno} on failure
+fn Term omni_io_read_file(Term path_list) {
   char *path = omni_list_to_cstr(path_list);
   if (!path) {
     Term args[1] = {term_new_num(ENOMEM)};
     return term_new_ctr(OMNI_NAM_ERR, 1, args);
   }
 
-  char *content = omni_list_to_cstr(content_list);
-  if (!content) {
-    free(path);
-    Term args[1] = {term_new_num(ENOMEM)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
-  }
-
-  FILE *f = fopen(path, "wb");
-  if (!f) {
-    int err = errno;
-    free(path);
-    free(content);
+  char *content;
+  size_t len;
+  int err = omni_io_read_path(path, &content, &len);
+  free(path);
+  if (err) {
     Term args[1] = {term_new_num(err)};
     return term_new_ctr(OMNI_NAM_ERR, 1, args);
   }
 
-  size_t len = strlen(content);
-  size_t written = fwrite(content, 1, len, f);
-  fclose(f);
-  free(path);
+  // Convert to char list
+  Term result = omni_ffi_string_term(content, len);
   free(content);
 
-  if (written != len) {
-    Term args[1] = {term_new_num(EIO)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
-  }
+  return result;
+}
 
-  return term_new_ctr(OMNI_NAM_TRUE, 0, NULL);
+// Write len bytes of data to path, truncating it or appending to it
+// Returns 0 on success, an errno value on failure (heap-free, like
+// omni_io_read_path)
+fn int omni_io_write_path(const char *path, const char *data, size_t len, int append) {
+  FILE *f = fopen(path, append ? "ab" : "wb");
+  if (!f) return errno;
+
+  size_t written = fwrite(data, 1, len, f);
+  int err = written != len ? EIO : 0;
+  if (fclose(f) != 0 && !err) err = errno;
+  return err;
 }
 
-// Append string content to file
-// Returns #True on success, #Err{errno} on failure
-fn Term omni_io_append_file(Term path_list, Term content_list) {
+// write-file / append-file on char lists or a #Buf
+fn Term omni_io_put_file(Term path_list, Term content_list, int append) {
   char *path = omni_list_to_cstr(path_list);
   if (!path) {
     Term args[1] = {term_new_num(ENOMEM)};
     return term_new_ctr(OMNI_NAM_ERR, 1, args);
   }
 
-  char *content = omni_list_to_cstr(content_list);
-  if (!content) {
+  int err;
+  if (term_tag(content_list) == C01 && term_ext(content_list) == OMNI_NAM_BUF) {
+    OmniBuf *b = omni_buf_acquire(content_list);
+    err = b ? omni_io_write_path(path, (const char*)b->data, b->len, append) : EINVAL;
+    omni_buf_release(b);
     free(path);
-    Term args[1] = {term_new_num(ENOMEM)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
-  }
-
-  FILE *f = fopen(path, "ab");
-  if (!f) {
-    int err = errno;
+  } else {
+    char *content = omni_list_to_cstr(content_list);
+    if (!content) {
+      free(path);
+      Term args[1] = {term_new_num(ENOMEM)};
+      return term_new_ctr(OMNI_NAM_ERR, 1, args);
+    }
+    err = omni_io_write_path(path, content, strlen(content), append);
     free(path);
     free(content);
-    Term args[1] = {term_new_num(err)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
   }
 
-  size_t len = strlen(content);
-  size_t written = fwrite(content, 1, len, f);
-  fclose(f);
-  free(path);
-  free(content);
-
-  if (written != len) {
-    Term args[1] = {term_new_num(EIO)};
+  if (err) {
+    Term args[1] = {term_new_num(err)};
     return term_new_ctr(OMNI_NAM_ERR, 1, args);
   }
 
   return term_new_ctr(OMNI_NAM_TRUE, 0, NULL);
 }
 
+// Write string content to file
+// Returns #True on success, #Err{errno} on failure
+fn Term omni_io_write_file(Term path_list, Term content_list) {
+  return omni_io_put_file(path_list, content_list, 0);
+}
+
+// Append string content to file
+// Returns #True on success, #Err{errno} on failure
+fn Term omni_io_append_file(Term path_list, Term content_list) {
+  return omni_io_put_file(path_list, content_list, 1);
+}
+
 // Check if file exists
 // Returns #True or #Fals
 fn Term omni_io_file_exists(Term path_list) {
@@ -334,7 +369,7 @@ fn Term omni_io_list_dir(Term path_list) {
 
   // Build list from end to beginning (for proper order)
   for (int i = count - 1; i >= 0; i--) {
-    Term name = omni_cstr_to_list(entries[i]);
+    Term name = omni_ffi_string_term(entries[i], strlen(entries[i]));
     free(entries[i]);
     Term con_args[2] = {name, result};
     result = term_new_ctr(NAM_CON, 2, con_args);
@@ -393,6 +428,65 @@ fn Term omni_io_rename_file(Term from_list, Term to_list) {
   return term_new_ctr(OMNI_NAM_TRUE, 0, NULL);
 }
 
+// Copy from to to. The kernel copies the data (copy_file_range) when both
+// files allow it; otherwise it goes through a buffer.
+// Returns 0 on success, an errno value on failure
+fn int omni_io_copy_path(const char *from, const char *to) {
+  int src = open(from, O_RDONLY | O_CLOEXEC);
+  if (src < 0) return errno;
+  int dst = open(to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (dst < 0) {
+    int err = errno;
+    close(src);
+    return err;
+  }
+
+  int err = 0;
+  int kernel = 1;
+#ifdef SYS_copy_file_range
+  for (;;) {
+    long n = syscall(SYS_copy_file_range, src, NULL, dst, NULL, (size_t)1 << 30, 0);
+    if (n == 0) break;
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      // Unsupported for this pair of files: copy through a buffer, from
+      // wherever the kernel stopped
+      if (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP) {
+        kernel = 0;
+      } else {
+        err = errno;
+      }
+      break;
+    }
+  }
+#else
+  kernel = 0;
+#endif
+
+  if (!kernel && !err) {
+    char buf[65536];
+    for (;;) {
+      ssize_t n = read(src, buf, sizeof(buf));
+      if (n == 0) break;
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        err = errno;
+        break;
+      }
+      for (ssize_t off = 0; off < n && !err; ) {
+        ssize_t w = write(dst, buf + off, n - off);
+        if (w < 0 && errno != EINTR) err = errno;
+        if (w > 0) off += w;
+      }
+      if (err) break;
+    }
+  }
+
+  close(src);
+  if (close(dst) != 0 && !err) err = errno;
+  return err;
+}
+
 // Copy file
 // Returns #True on success, #Err{errno} on failure
 fn Term omni_io_copy_file(Term from_list, Term to_list) {
@@ -409,44 +503,12 @@ fn Term omni_io_copy_file(Term from_list, Term to_list) {
     return term_new_ctr(OMNI_NAM_ERR, 1, args);
   }
 
-  FILE *src = fopen(from, "rb");
-  if (!src) {
-    int err = errno;
-    free(from);
-    free(to);
-    Term args[1] = {term_new_num(err)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
-  }
-
-  FILE *dst = fopen(to, "wb");
-  if (!dst) {
-    int err = errno;
-    fclose(src);
-    free(from);
-    free(to);
-    Term args[1] = {term_new_num(err)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, args);
-  }
-
-  // Copy in chunks
-  char buf[8192];
-  size_t n;
-  int success = 1;
-
-  while ((n = fread(buf, 1, sizeof(buf), src)) > 0) {
-    if (fwrite(buf, 1, n, dst) != n) {
-      success = 0;
-      break;
-    }
-  }
-
-  fclose(src);
-  fclose(dst);
+  int err = omni_io_copy_path(from, to);
   free(from);
   free(to);
 
-  if (!success) {
-    Term args[1] = {term_new_num(EIO)};
+  if (err) {
+    Term args[1] = {term_new_num(err)};
     return term_new_ctr(OMNI_NAM_ERR, 1, args);
   }
 
@@ -472,7 +534,7 @@ fn Term omni_io_getenv(Term name_list) {
     return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
   }
 
-  return omni_cstr_to_list(value);
+  return omni_ffi_string_term(value, strlen(value));
 }
 
 // Set environment variable
@@ -517,6 +579,205 @@ fn Term omni_ffi_io_read_file(Term args) {
   return omni_io_read_file(path);
 }
 
+// Async file calls: the arguments are copied out on submission, the file
+// is read or written on an FFI worker (or by io_uring, see uring.c) and the
+// result built by whoever awaits it
+typedef struct {
+  char  *path;
+  char  *path2;                // copy-file destination
+  char  *data;                 // Content read, or content to write
+  size_t len;                  // Bytes in data
+  OmniBuf *buf;                // #Buf content: data points into it
+  int    err;
+} OmniIOJob;
+
+// A job with the first n (1 or 2) args copied into path and path2
+fn OmniIOJob* omni_io_job_new(Term args, u32 n) {
+  OmniIOJob *job = (OmniIOJob*)calloc(1, sizeof(OmniIOJob));
+  if (!job) return NULL;
+  char **dst[2] = {&job->path, &job->path2};
+  Term cur = args;
+  for (u32 i = 0; i < n; i++) {
+    if (term_tag(cur) != C02 || term_ext(cur) != NAM_CON) {
+      job->err = EINVAL;
+      return job;
+    }
+    *dst[i] = omni_list_to_cstr(wnf(HEAP[term_val(cur)]));
+    if (!*dst[i]) {
+      job->err = ENOMEM;
+      return job;
+    }
+    cur = wnf(HEAP[term_val(cur) + 1]);
+  }
+  return job;
+}
+
+fn void omni_io_job_free(OmniIOJob *job) {
+  if (!job) return;
+  free(job->path);
+  free(job->path2);
+  if (job->buf) omni_buf_release(job->buf);
+  else free(job->data);
+  free(job);
+}
+
+// #True, or #Err{errno} for a failed or missing job; frees the job
+fn Term omni_io_job_status(OmniIOJob *job) {
+  int err = job ? job->err : ENOMEM;
+  omni_io_job_free(job);
+  if (err) {
+    Term err_args[1] = {term_new_num(err)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  }
+  return term_new_ctr(OMNI_NAM_TRUE, 0, NULL);
+}
+
+fn void* omni_ffi_io_read_file_prepare(Term args) {
+  return omni_io_job_new(args, 1);
+}
+
+fn void omni_ffi_io_read_file_run(void *payload) {
+  OmniIOJob *job = (OmniIOJob*)payload;
+  if (!job || job->err) return;
+  job->err = omni_io_read_path(job->path, &job->data, &job->len);
+}
+
+fn Term omni_ffi_io_read_file_finish(void *payload) {
+  OmniIOJob *job = (OmniIOJob*)payload;
+  if (!job || job->err) return omni_io_job_status(job);
+  Term result = omni_ffi_string_term(job->data, job->len);
+  omni_io_job_free(job);
+  return result;
+}
+
+// read-file-buf: the bytes read become the buffer's storage
+fn Term omni_ffi_io_read_file_buf_finish(void *payload) {
+  OmniIOJob *job = (OmniIOJob*)payload;
+  if (!job || job->err) return omni_io_job_status(job);
+  OmniBuf *b = omni_buf_adopt(job->data, job->len, 1);
+  job->data = NULL;
+  omni_io_job_free(job);
+  return omni_buf_term(b);
+}
+
+fn Term omni_ffi_io_read_file_buf(Term args) {
+  OmniIOJob *job = (OmniIOJob*)omni_ffi_io_read_file_prepare(args);
+  omni_ffi_io_read_file_run(job);
+  return omni_ffi_io_read_file_buf_finish(job);
+}
+
+// read-file-stream: the file mapped as a #Buf, which runtime.hvm4 wraps in
+// an #Iter stepping with omni_ffi_io_stream_next
+fn Term omni_ffi_io_read_file_stream(Term args) {
+  OmniIOJob *job = omni_io_job_new(args, 1);
+  if (!job || job->err) return omni_io_job_status(job);
+  OmniBuf *b;
+  job->err = omni_io_map_path(job->path, &b);
+  if (job->err) return omni_io_job_status(job);
+  omni_io_job_free(job);
+  return omni_buf_term(b);
+}
+
+// n bytes of a file stream from off: a packed string with
+// OMNI_PACKED_STRINGS=1, a char list (one char per byte, as read-file) otherwise
+fn Term omni_io_stream_piece(OmniBuf *b, size_t off, size_t n) {
+  if (OMNI_PSTR_ENABLED) return omni_pstr_string((const char*)b->data + off, n);
+  return omni_buf_to_list(b->data + off, n);
+}
+
+// buf, chunk, offset -> #Some{piece, #Cst{next offset}}, or #None at the
+// end. With chunk 0 the piece is the next line without its "\n" or
+// "\r\n"; otherwise it is up to chunk bytes, cut back to the start of a
+// UTF-8 sequence when the chunk would split one. Only the pages under the
+// piece are touched.
+fn Term omni_ffi_io_stream_next(Term args) {
+  Term t[3];
+  size_t chunk, off;
+  if (omni_buf_args(args, t, 3) != 3 || !omni_buf_index(t[1], &chunk) ||
+      !omni_buf_index(t[2], &off)) {
+    return omni_buf_error(EINVAL);
+  }
+  OmniBuf *b = omni_buf_acquire(t[0]);
+  if (!b) return omni_buf_error(EINVAL);
+  if (off >= b->len) {
+    omni_buf_release(b);
+    return term_new_ctr(OMNI_NAM_NONE, 0, NULL);
+  }
+
+  const u8 *p = b->data + off;
+  size_t rest = b->len - off, n, next;
+  if (chunk == 0) {
+    const u8 *nl = (const u8*)memchr(p, '\n', rest);
+    n = nl ? (size_t)(nl - p) : rest;
+    next = off + n + (nl ? 1 : 0);
+    if (nl && n > 0 && p[n - 1] == '\r') n--;
+  } else {
+    n = chunk < rest ? chunk : rest;
+    size_t cut = n;
+    while (cut < rest && cut > 0 && n - cut < 3 && (p[cut] & 0xC0) == 0x80) cut--;
+    if (cut > 0) n = cut;
+    next = off + n;
+  }
+
+  Term piece = omni_io_stream_piece(b, off, n);
+  omni_buf_release(b);
+  Term pos = term_new_num((u32)next);
+  Term some_args[2] = {piece, term_new_ctr(OMNI_NAM_CST, 1, &pos)};
+  return term_new_ctr(OMNI_NAM_SOME, 2, some_args);
+}
+
+// path, content -> path in job->path, content in job->data; a #Buf is
+// written from its own storage
+fn void* omni_ffi_io_write_file_prepare(Term args) {
+  OmniIOJob *job = omni_io_job_new(args, 1);
+  if (!job || job->err) return job;
+  Term tail = wnf(HEAP[term_val(args) + 1]);
+  if (term_tag(tail) != C02 || term_ext(tail) != NAM_CON) {
+    job->err = EINVAL;
+    return job;
+  }
+  Term content = wnf(HEAP[term_val(tail)]);
+  if (term_tag(content) == C01 && term_ext(content) == OMNI_NAM_BUF) {
+    job->buf = omni_buf_acquire(content);
+    if (!job->buf) job->err = EINVAL;
+    else {
+      job->data = (char*)job->buf->data;
+      job->len = job->buf->len;
+    }
+    return job;
+  }
+  job->data = omni_list_to_cstr(content);
+  if (!job->data) job->err = ENOMEM;
+  else job->len = strlen(job->data);
+  return job;
+}
+
+fn void omni_ffi_io_write_file_run(void *payload) {
+  OmniIOJob *job = (OmniIOJob*)payload;
+  if (!job || job->err) return;
+  job->err = omni_io_write_path(job->path, job->data, job->len, 0);
+}
+
+fn void omni_ffi_io_append_file_run(void *payload) {
+  OmniIOJob *job = (OmniIOJob*)payload;
+  if (!job || job->err) return;
+  job->err = omni_io_write_path(job->path, job->data, job->len, 1);
+}
+
+fn void* omni_ffi_io_copy_file_prepare(Term args) {
+  return omni_io_job_new(args, 2);
+}
+
+fn void omni_ffi_io_copy_file_run(void *payload) {
+  OmniIOJob *job = (OmniIOJob*)payload;
+  if (!job || job->err) return;
+  job->err = omni_io_copy_path(job->path, job->path2);
+}
+
+fn Term omni_ffi_io_status_finish(void *payload) {
+  return omni_io_job_status((OmniIOJob*)payload);
+}
+
 // Wrapper for write-file: takes path and content arguments
 fn Term omni_ffi_io_write_file(Term args) {
   // Args is a cons list with two elements: path, content
@@ -732,95 +993,72 @@ fn Term omni_ffi_io_book_get(Term args) {
     return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
   }
 
-  // Look up BOOK entry
+  // Look up BOOK entry, loading a not-yet-parsed runtime definition
   u32 heap_loc = BOOK[table_id];
+  if (heap_loc == 0 && omni_deps_require_id(table_id)) {
+    heap_loc = BOOK[table_id];
+  }
   if (heap_loc == 0) {
     return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
   }
 
   // Return the term stored at BOOK[table_id]
-  // This is the function's AST (typically a #Lam or #LamR)
+  // This is the function's AST (typically a #Lam or #LamR); under --profile
+  // its body comes wrapped to push a frame for the call
   Term result = HEAP[heap_loc];
-  return result;
+  return omni_profile_wrap(table_id, result);
 }
 
 // =============================================================================
-// FFI IO Registration
+// Debug
 // =============================================================================
 
-// Nick codes for IO operations (computed at runtime in omni_names_init)
-// These should match the values in nick/omnilisp.c
-
-fn void omni_ffi_register_io(void) {
-  // Register IO functions with their nick-encoded names
-  // These use OMNI_FFI_VARIADIC since they need special argument handling
-  // The dispatch happens via direct function table lookup
-
-  // We'll register these as special handlers in the FFI dispatch
-  // See omni_ffi_io_dispatch below
+// DbgT: return the first argument reduced, for inspecting terms from OmniLisp
+fn Term omni_ffi_io_debug_term(Term args) {
+  if (term_tag(args) == C02 && term_ext(args) == NAM_CON) {
+    return wnf(HEAP[term_val(args)]);
+  }
+  return term_new_num(0);
 }
 
 // =============================================================================
-// IO Dispatch
+// FFI IO Registration
 // =============================================================================
 
-// Special dispatch for IO operations
-// Called from omni_ffi_dispatch when encountering IO-related FFI names
-fn Term omni_ffi_io_dispatch(u32 name_nick, Term args) {
-  // Check which IO operation this is
-  if (name_nick == OMNI_NAM_RDFL) {
-    return omni_ffi_io_read_file(args);
-  }
-  if (name_nick == OMNI_NAM_WRFL) {
-    return omni_ffi_io_write_file(args);
-  }
-  if (name_nick == OMNI_NAM_APFL) {
-    return omni_ffi_io_append_file(args);
-  }
-  if (name_nick == OMNI_NAM_EXST) {
-    return omni_ffi_io_file_exists(args);
-  }
-  if (name_nick == OMNI_NAM_ISDR) {
-    return omni_ffi_io_is_dir(args);
-  }
-  if (name_nick == OMNI_NAM_MKDR) {
-    return omni_ffi_io_mkdir(args);
-  }
-  if (name_nick == OMNI_NAM_LSDR) {
-    return omni_ffi_io_list_dir(args);
-  }
-  if (name_nick == OMNI_NAM_DLFL) {
-    return omni_ffi_io_delete_file(args);
-  }
-  if (name_nick == OMNI_NAM_RNFL) {
-    return omni_ffi_io_rename_file(args);
-  }
-  if (name_nick == OMNI_NAM_CPFL) {
-    return omni_ffi_io_copy_file(args);
-  }
-  if (name_nick == OMNI_NAM_GTEV) {
-    return omni_ffi_io_getenv(args);
-  }
-  if (name_nick == OMNI_NAM_STEV) {
-    return omni_ffi_io_setenv(args);
-  }
-  if (name_nick == OMNI_NAM_BKGT) {
-    return omni_ffi_io_book_get(args);
-  }
-
-  // Debug FFI: DbgT (debug term) - inspect first arg (silent unless omni_ffi_debug)
-  // nick("DbgT") = 1165396 (computed)
-  if (name_nick == 1165396) {  // DbgT
-    // Get first arg
-    if (term_tag(args) == C02 && term_ext(args) == NAM_CON) {
-      u32 aloc = term_val(args);
-      Term t = wnf(HEAP[aloc]);
-      // Return the term unchanged
-      return t;
-    }
-    return term_new_num(0);
-  }
-
-  // Not an IO operation
-  return 0;  // Return 0 to indicate not handled
+// Names are OMNI_NAM_* nicks, so this runs after omni_names_init
+fn void omni_ffi_register_io(void) {
+  omni_ffi_register_staged(OMNI_NAM_RDFL, omni_ffi_io_read_file,
+                           omni_ffi_io_read_file_prepare,
+                           omni_ffi_io_read_file_run,
+                           omni_ffi_io_read_file_finish);
+  omni_ffi_register_staged(OMNI_NAM_RDFB, omni_ffi_io_read_file_buf,
+                           omni_ffi_io_read_file_prepare,
+                           omni_ffi_io_read_file_run,
+                           omni_ffi_io_read_file_buf_finish);
+  omni_ffi_register_term(OMNI_NAM_RDFS, omni_ffi_io_read_file_stream);
+  omni_ffi_register_term(OMNI_NAM_FSNX, omni_ffi_io_stream_next);
+  omni_ffi_register_staged(OMNI_NAM_WRFL, omni_ffi_io_write_file,
+                           omni_ffi_io_write_file_prepare,
+                           omni_ffi_io_write_file_run,
+                           omni_ffi_io_status_finish);
+  omni_ffi_register_staged(OMNI_NAM_APFL, omni_ffi_io_append_file,
+                           omni_ffi_io_write_file_prepare,
+                           omni_ffi_io_append_file_run,
+                           omni_ffi_io_status_finish);
+  omni_ffi_register_term(OMNI_NAM_EXST, omni_ffi_io_file_exists);
+  omni_ffi_register_term(OMNI_NAM_ISDR, omni_ffi_io_is_dir);
+  omni_ffi_register_term(OMNI_NAM_MKDR, omni_ffi_io_mkdir);
+  omni_ffi_register_term(OMNI_NAM_LSDR, omni_ffi_io_list_dir);
+  omni_ffi_register_term(OMNI_NAM_DLFL, omni_ffi_io_delete_file);
+  omni_ffi_register_term(OMNI_NAM_RNFL, omni_ffi_io_rename_file);
+  omni_ffi_register_staged(OMNI_NAM_CPFL, omni_ffi_io_copy_file,
+                           omni_ffi_io_copy_file_prepare,
+                           omni_ffi_io_copy_file_run,
+                           omni_ffi_io_status_finish);
+  omni_ffi_register_term(OMNI_NAM_GTEV, omni_ffi_io_getenv);
+  omni_ffi_register_term(OMNI_NAM_STEV, omni_ffi_io_setenv);
+  omni_ffi_register_internal(OMNI_NAM_BKGT, omni_ffi_io_book_get);
+  omni_ffi_register_internal(OMNI_NAM_PFIN, omni_profile_ffi_enter);
+  omni_ffi_register_internal(OMNI_NAM_PFOU, omni_profile_ffi_leave);
+  omni_ffi_register_term(omni_nick("DbgT"), omni_ffi_io_debug_term);
 }
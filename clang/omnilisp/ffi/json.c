@@ -4,8 +4,8 @@
 // JSON values are represented as:
 // - JSON object -> #Dct{...} (dict)
 // - JSON array  -> #CON list
-// - JSON string -> #CON char list (wrapped in #Str if needed)
-// - JSON number -> #Cst{n}
+// - JSON string -> packed string with OMNI_PACKED_STRINGS=1, char list otherwise
+// - JSON number -> #Cst{n} for integers 0..2^32-1, #Fix{hi, lo, scale} otherwise
 // - JSON true   -> #True
 // - JSON false  -> #Fals
 // - JSON null   -> #Noth
@@ -13,21 +13,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdint.h>
 
 // Forward declarations
-fn Term omni_json_parse_value(const char **p);
 fn void omni_json_stringify_value(Term val, char **buf, size_t *len, size_t *cap);
 
-// =============================================================================
-// JSON Parsing Helpers
-// =============================================================================
-
-// Skip whitespace
-fn void omni_json_skip_ws(const char **p) {
-  while (**p && isspace((unsigned char)**p)) (*p)++;
-}
-
 // JSON parse error codes
 #define OMNI_JSON_ERR_STRING   1
 #define OMNI_JSON_ERR_NUMBER   2
@@ -37,293 +27,680 @@ fn void omni_json_skip_ws(const char **p) {
 #define OMNI_JSON_ERR_EOF      6
 #define OMNI_JSON_ERR_SYNTAX   7
 #define OMNI_JSON_ERR_MEMORY   8
+#define OMNI_JSON_ERR_RANGE    9
 
-// Parse a JSON string, returning OmniLisp string (char list)
-fn Term omni_json_parse_string(const char **p) {
-  if (**p != '"') {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_STRING)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
-  }
-  (*p)++;  // Skip opening quote
+// =============================================================================
+// Structural Index (stage one)
+// =============================================================================
+//
+// For large inputs the parser runs in two stages, after simdjson. Stage one
+// classifies 64 bytes at a time into bitmasks (backslashes, quotes,
+// operators, whitespace) and, with carry and prefix-XOR tricks on those
+// masks, finds which quotes are escaped and which bytes are inside strings.
+// It records the offset of every token outside strings: the operators
+// {}[]:, and the first byte of each string and scalar. Stage two is the
+// parser below, stepping from token to token through the index instead of
+// skipping whitespace byte by byte.
+//
+// Classification is the only part that depends on the CPU: AVX2 or SSE2 on
+// x86-64, picked with cpuid when JSON is registered, and a table lookup
+// elsewhere. OMNI_JSON_SIMD=0 forces the table.
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Inputs at least this large are indexed. Below it the extra pass and the
+// index (up to the size of the input) do not pay for themselves.
+static size_t OMNI_JSON_INDEX_MIN = (size_t)1 << 20;
+
+typedef struct {
+  u64    prev_odd;        // 1 if the last block ended in an odd run of backslashes
+  u64    prev_in_string;  // all ones if the last block ended inside a string
+  u64    prev_scalar;     // 1 if the last byte of the last block was a scalar byte
+  u32   *idx;
+  size_t n;
+  size_t cap;
+} OmniJsonIndexer;
+
+// Index data[0..len); 0 if the index could not grow
+typedef int (*OmniJsonStage1)(OmniJsonIndexer *ix, const u8 *data, size_t len);
+
+// Byte classes for the table kernel
+#define OMNI_JSON_C_OP     1
+#define OMNI_JSON_C_WS     2
+#define OMNI_JSON_C_QUOTE  4
+#define OMNI_JSON_C_BS     8
+
+static const u8 OMNI_JSON_CLASS[256] = {
+  [','] = OMNI_JSON_C_OP, [':'] = OMNI_JSON_C_OP,
+  ['['] = OMNI_JSON_C_OP, [']'] = OMNI_JSON_C_OP,
+  ['{'] = OMNI_JSON_C_OP, ['}'] = OMNI_JSON_C_OP,
+  [' '] = OMNI_JSON_C_WS, ['\t'] = OMNI_JSON_C_WS,
+  ['\n'] = OMNI_JSON_C_WS, ['\r'] = OMNI_JSON_C_WS,
+  ['"'] = OMNI_JSON_C_QUOTE, ['\\'] = OMNI_JSON_C_BS,
+};
+
+fn u64 omni_json_prefix_xor(u64 x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
 
-  // Find end of string (handling escapes)
-  const char *start = *p;
-  size_t len = 0;
-  while (**p && **p != '"') {
-    if (**p == '\\' && (*p)[1]) {
-      (*p) += 2;  // Skip escape sequence
-      len++;
-    } else {
-      (*p)++;
-      len++;
-    }
+// Index one classified block of 64 bytes starting at offset base
+fn void omni_json_index_block(OmniJsonIndexer *ix, u64 bs, u64 quote, u64 op, u64 ws, u32 base) {
+  // Bytes escaped by an odd run of backslashes: add each run's start to the
+  // run and see where the carry lands, separately for runs starting on even
+  // and odd positions
+  const u64 even = 0x5555555555555555ULL;
+  u64 starts = bs & ~(bs << 1);
+  u64 even_start_mask = even ^ ix->prev_odd;
+  u64 even_starts = starts & even_start_mask;
+  u64 odd_starts = starts & ~even_start_mask;
+  u64 even_carries = bs + even_starts;
+  u64 odd_carries;
+  u64 ends_odd = __builtin_add_overflow(bs, odd_starts, &odd_carries);
+  odd_carries |= ix->prev_odd;
+  ix->prev_odd = ends_odd;
+  u64 escaped = (even_carries & ~bs & ~even) | (odd_carries & ~bs & even);
+
+  // Inside strings: from each opening quote up to (not including) its
+  // closing one
+  quote &= ~escaped;
+  u64 in_string = omni_json_prefix_xor(quote) ^ ix->prev_in_string;
+  ix->prev_in_string = (u64)((int64_t)in_string >> 63);
+
+  // A scalar (or string) starts at a non-operator, non-whitespace byte that
+  // does not continue another scalar
+  u64 scalar = ~(op | ws);
+  u64 nonquote = scalar & ~quote;
+  u64 follows = (nonquote << 1) | ix->prev_scalar;
+  ix->prev_scalar = nonquote >> 63;
+  u64 tokens = (op | (scalar & ~follows)) & ~(in_string ^ quote);
+
+  // Four offsets per step, unconditionally: stores past the last token land
+  // in the slack omni_json_index_reserve keeps
+  u32 *out = ix->idx + ix->n;
+  ix->n += (size_t)__builtin_popcountll(tokens);
+  while (tokens) {
+    out[0] = base + (u32)__builtin_ctzll(tokens);
+    tokens &= tokens - 1;
+    out[1] = base + (u32)__builtin_ctzll(tokens | (1ULL << 63));
+    tokens &= tokens - 1;
+    out[2] = base + (u32)__builtin_ctzll(tokens | (1ULL << 63));
+    tokens &= tokens - 1;
+    out[3] = base + (u32)__builtin_ctzll(tokens | (1ULL << 63));
+    tokens &= tokens - 1;
+    out += 4;
   }
+}
 
-  if (**p != '"') {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_STRING)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
-  }
+// Room for one more block of tokens, plus slack for the unrolled stores
+fn int omni_json_index_reserve(OmniJsonIndexer *ix) {
+  if (ix->cap - ix->n >= 68) return 1;
+  size_t cap = ix->cap * 2 + 64;
+  u32 *grown = (u32*)realloc(ix->idx, cap * sizeof(u32));
+  if (!grown) return 0;
+  ix->idx = grown;
+  ix->cap = cap;
+  return 1;
+}
 
-  // Build char list from string content
-  char *buf = (char*)malloc(len + 1);
-  if (!buf) {
-    Term err_args[1] = {term_new_num(ENOMEM)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
-  }
+// The last partial block, padded with whitespace
+fn const u8* omni_json_tail_block(u8 *block, const u8 *p, size_t n) {
+  memset(block, ' ', 64);
+  memcpy(block, p, n);
+  return block;
+}
 
-  const char *q = start;
-  size_t i = 0;
-  while (q < *p) {
-    if (*q == '\\' && q[1]) {
-      q++;
-      switch (*q) {
-        case 'n': buf[i++] = '\n'; break;
-        case 't': buf[i++] = '\t'; break;
-        case 'r': buf[i++] = '\r'; break;
-        case '\\': buf[i++] = '\\'; break;
-        case '"': buf[i++] = '"'; break;
-        case '/': buf[i++] = '/'; break;
-        default: buf[i++] = *q; break;
-      }
-      q++;
-    } else {
-      buf[i++] = *q++;
+fn int omni_json_stage1_table(OmniJsonIndexer *ix, const u8 *data, size_t len) {
+  u8 block[64];
+  for (size_t i = 0; i < len; i += 64) {
+    const u8 *p = len - i >= 64 ? data + i : omni_json_tail_block(block, data + i, len - i);
+    u64 bs = 0, quote = 0, op = 0, ws = 0;
+    for (u32 j = 0; j < 64; j++) {
+      u64 c = OMNI_JSON_CLASS[p[j]];
+      op    |= (c & 1) << j;
+      ws    |= ((c >> 1) & 1) << j;
+      quote |= ((c >> 2) & 1) << j;
+      bs    |= ((c >> 3) & 1) << j;
     }
+    if (!omni_json_index_reserve(ix)) return 0;
+    omni_json_index_block(ix, bs, quote, op, ws, (u32)i);
   }
-  buf[i] = '\0';
-
-  (*p)++;  // Skip closing quote
-
-  Term result = omni_cstr_to_list(buf);
-  free(buf);
-  return result;
+  return 1;
 }
 
-// Parse a JSON number
-fn Term omni_json_parse_number(const char **p) {
-  char *end;
-  double d = strtod(*p, &end);
-  if (end == *p) {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_NUMBER)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+#if defined(__x86_64__)
+
+fn int omni_json_stage1_sse2(OmniJsonIndexer *ix, const u8 *data, size_t len) {
+  u8 block[64];
+  for (size_t i = 0; i < len; i += 64) {
+    const u8 *p = len - i >= 64 ? data + i : omni_json_tail_block(block, data + i, len - i);
+    u64 bs = 0, quote = 0, op = 0, ws = 0;
+    for (u32 j = 0; j < 64; j += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(p + j));
+      // '[' and ']' are '{' and '}' without bit 0x20
+      __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+      __m128i o = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(',')), _mm_cmpeq_epi8(v, _mm_set1_epi8(':'))),
+        _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))));
+      __m128i w = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+      op    |= (u64)(u32)_mm_movemask_epi8(o) << j;
+      ws    |= (u64)(u32)_mm_movemask_epi8(w) << j;
+      quote |= (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << j;
+      bs    |= (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << j;
+    }
+    if (!omni_json_index_reserve(ix)) return 0;
+    omni_json_index_block(ix, bs, quote, op, ws, (u32)i);
   }
-  *p = end;
-
-  // Convert to integer if it's a whole number, otherwise use as-is
-  // HVM4 only supports integers, so truncate
-  int n = (int)d;
-  Term num_arg[1] = {term_new_num((u32)n)};
-  return term_new_ctr(OMNI_NAM_CST, 1, num_arg);
+  return 1;
 }
 
-// Parse a JSON array - builds list in reverse then reverses
-fn Term omni_json_parse_array(const char **p) {
-  if (**p != '[') {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_ARRAY)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+__attribute__((target("avx2")))
+fn int omni_json_stage1_avx2(OmniJsonIndexer *ix, const u8 *data, size_t len) {
+  u8 block[64];
+  for (size_t i = 0; i < len; i += 64) {
+    const u8 *p = len - i >= 64 ? data + i : omni_json_tail_block(block, data + i, len - i);
+    u64 bs = 0, quote = 0, op = 0, ws = 0;
+    for (u32 j = 0; j < 64; j += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(p + j));
+      __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+      __m256i o = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))));
+      __m256i w = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+      op    |= (u64)(u32)_mm256_movemask_epi8(o) << j;
+      ws    |= (u64)(u32)_mm256_movemask_epi8(w) << j;
+      quote |= (u64)(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << j;
+      bs    |= (u64)(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << j;
+    }
+    if (!omni_json_index_reserve(ix)) return 0;
+    omni_json_index_block(ix, bs, quote, op, ws, (u32)i);
   }
-  (*p)++;  // Skip [
+  return 1;
+}
 
-  omni_json_skip_ws(p);
+#endif
 
-  if (**p == ']') {
-    (*p)++;
-    return term_new_ctr(NAM_NIL, 0, NULL);  // Empty list
-  }
+static OmniJsonStage1 OMNI_JSON_STAGE1 = omni_json_stage1_table;
 
-  // Collect all elements into a temporary array (max 1024 elements)
-  Term elements[1024];
-  int count = 0;
+fn void omni_json_stage1_select(void) {
+#if defined(__x86_64__)
+  const char *env = getenv("OMNI_JSON_SIMD");
+  if (env && env[0] == '0') return;
+  __builtin_cpu_init();
+  OMNI_JSON_STAGE1 = __builtin_cpu_supports("avx2") ? omni_json_stage1_avx2 : omni_json_stage1_sse2;
+#endif
+}
 
-  // Parse first element
-  elements[count] = omni_json_parse_value(p);
-  if (term_tag(elements[count]) >= C00 && term_ext(elements[count]) == OMNI_NAM_ERR) {
-    return elements[count];  // Propagate error
+// Token offsets of data[0..len) (malloc'd), or NULL when out of memory
+fn u32* omni_json_index(const char *data, size_t len, size_t *n) {
+  OmniJsonIndexer ix = {0};
+  ix.cap = len / 4 + 68;
+  ix.idx = (u32*)malloc(ix.cap * sizeof(u32));
+  if (!ix.idx) return NULL;
+  if (!OMNI_JSON_STAGE1(&ix, (const u8*)data, len)) {
+    free(ix.idx);
+    return NULL;
   }
-  count++;
+  *n = ix.n;
+  return ix.idx;
+}
 
-  omni_json_skip_ws(p);
+// =============================================================================
+// JSON Parser
+// =============================================================================
+//
+// The parser is iterative. Each open array or object is a frame on a
+// growable stack, and its finished elements wait on a value stack until the
+// closing bracket turns them into a list or dict, so neither nesting depth
+// nor container size is capped. Input is a byte range: a mapped file, a
+// buffer or a packed string is parsed in place. Given a structural index,
+// the parser moves between tokens through it.
+
+typedef struct {
+  char   kind;    // '[' or '{'
+  size_t base;    // first element of this container on the value stack
+} OmniJsonFrame;
+
+typedef struct {
+  const char    *p;
+  const char    *end;
+  Term          *vals;      // elements of open containers (key, value for objects)
+  size_t         nvals;
+  size_t         vcap;
+  OmniJsonFrame *frames;
+  size_t         depth;
+  size_t         fcap;
+  char          *scratch;   // unescaped bytes of the current string
+  size_t         scap;
+  const char    *base;      // start of the input, for index offsets
+  u32           *index;     // token offsets from stage one, or NULL
+  size_t         nindex;
+  size_t         at;        // first index entry not yet passed
+} OmniJsonParser;
+
+fn void omni_json_parser_init(OmniJsonParser *ps, const char *data, size_t len) {
+  memset(ps, 0, sizeof(*ps));
+  ps->p = data;
+  ps->end = data + len;
+  ps->base = data;
+}
 
-  // Parse remaining elements
-  while (**p == ',' && count < 1024) {
-    (*p)++;  // Skip comma
-    omni_json_skip_ws(p);
+fn void omni_json_parser_free(OmniJsonParser *ps) {
+  free(ps->vals);
+  free(ps->frames);
+  free(ps->scratch);
+  free(ps->index);
+}
 
-    elements[count] = omni_json_parse_value(p);
-    if (term_tag(elements[count]) >= C00 && term_ext(elements[count]) == OMNI_NAM_ERR) {
-      return elements[count];  // Propagate error
-    }
-    count++;
+fn Term omni_json_error(int code) {
+  Term err_args[1] = {term_new_num(code)};
+  return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+}
 
-    omni_json_skip_ws(p);
-  }
+fn int omni_json_is_error(Term t) {
+  return term_tag(t) == C01 && term_ext(t) == OMNI_NAM_ERR;
+}
 
-  // Close array
-  if (**p != ']') {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_ARRAY)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+// Skip JSON whitespace. With an index this is a jump to the next token: a
+// gap between tokens holds only whitespace, because any other byte after
+// whitespace, an operator or a string is itself a token, and a scalar must
+// be followed by whitespace or an operator.
+fn void omni_json_skip_ws(OmniJsonParser *ps) {
+  if (ps->index) {
+    while (ps->at < ps->nindex && ps->base + ps->index[ps->at] < ps->p) ps->at++;
+    ps->p = ps->at < ps->nindex ? ps->base + ps->index[ps->at] : ps->end;
+    return;
+  }
+  while (ps->p < ps->end &&
+         (*ps->p == ' ' || *ps->p == '\n' || *ps->p == '\r' || *ps->p == '\t')) {
+    ps->p++;
   }
-  (*p)++;
+}
 
-  // Build list from back to front (so it ends up in correct order)
-  Term result = term_new_ctr(NAM_NIL, 0, NULL);
-  for (int i = count - 1; i >= 0; i--) {
-    Term cons_args[2] = {elements[i], result};
-    result = term_new_ctr(NAM_CON, 2, cons_args);
+fn int omni_json_push(OmniJsonParser *ps, Term v) {
+  if (ps->nvals == ps->vcap) {
+    size_t cap = ps->vcap ? ps->vcap * 2 : 64;
+    Term *grown = (Term*)realloc(ps->vals, cap * sizeof(Term));
+    if (!grown) return OMNI_JSON_ERR_MEMORY;
+    ps->vals = grown;
+    ps->vcap = cap;
   }
+  ps->vals[ps->nvals++] = v;
+  return 0;
+}
 
-  return result;
+fn int omni_json_open(OmniJsonParser *ps, char kind) {
+  if (ps->depth == ps->fcap) {
+    size_t cap = ps->fcap ? ps->fcap * 2 : 16;
+    OmniJsonFrame *grown = (OmniJsonFrame*)realloc(ps->frames, cap * sizeof(OmniJsonFrame));
+    if (!grown) return OMNI_JSON_ERR_MEMORY;
+    ps->frames = grown;
+    ps->fcap = cap;
+  }
+  ps->frames[ps->depth].kind = kind;
+  ps->frames[ps->depth].base = ps->nvals;
+  ps->depth++;
+  return 0;
 }
 
-// Parse a JSON object - collects all key-value pairs
-fn Term omni_json_parse_object(const char **p) {
-  if (**p != '{') {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_OBJECT)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+// Pop the innermost container: its elements become a list, or for an object
+// a #Dict{entries} of #CON{key, #CON{val, #NIL}} pairs
+fn Term omni_json_close(OmniJsonParser *ps) {
+  OmniJsonFrame f = ps->frames[--ps->depth];
+  Term nil = term_new_ctr(NAM_NIL, 0, NULL);
+  Term result = nil;
+
+  if (f.kind == '[') {
+    for (size_t i = ps->nvals; i > f.base; i--) {
+      Term cons_args[2] = {ps->vals[i - 1], result};
+      result = term_new_ctr(NAM_CON, 2, cons_args);
+    }
+  } else {
+    for (size_t i = ps->nvals; i > f.base; i -= 2) {
+      Term val_cons_args[2] = {ps->vals[i - 1], nil};
+      Term val_cons = term_new_ctr(NAM_CON, 2, val_cons_args);
+      Term pair_args[2] = {ps->vals[i - 2], val_cons};
+      Term pair = term_new_ctr(NAM_CON, 2, pair_args);
+      Term entry_args[2] = {pair, result};
+      result = term_new_ctr(NAM_CON, 2, entry_args);
+    }
+    result = term_new_ctr(OMNI_NAM_DICT, 1, &result);
   }
-  (*p)++;  // Skip {
 
-  omni_json_skip_ws(p);
+  ps->nvals = f.base;
+  return result;
+}
 
-  if (**p == '}') {
-    (*p)++;
-    // Return empty dict: #Dict{#NIL}
-    Term nil = term_new_ctr(OMNI_NAM_NIL, 0, NULL);
-    Term dict_args[1] = {nil};
-    return term_new_ctr(OMNI_NAM_DICT, 1, dict_args);
+// len bytes of UTF-8 as a string term; unlike omni_ffi_string_term this
+// keeps NUL bytes. Char lists hold code points, as reader literals do. A
+// large document can hold more strings than there are handles, so once none
+// are left for packing the rest become char lists.
+fn Term omni_json_string_term(const char *s, size_t len) {
+  if (OMNI_PSTR_ENABLED) {
+    Term t = omni_pstr_string(s, len);
+    if (!omni_json_is_error(t)) return t;
   }
+  return omni_pstr_decode_list((const u8*)s, len, len);
+}
 
-  // Collect key-value pairs (max 256 pairs)
-  Term keys[256];
-  Term vals[256];
-  int count = 0;
-
-  // Parse first key-value pair
-  keys[count] = omni_json_parse_string(p);
-  if (term_tag(keys[count]) >= C00 && term_ext(keys[count]) == OMNI_NAM_ERR) {
-    return keys[count];
+fn int omni_json_hex4(const char *p, const char *end, u32 *out) {
+  if (end - p < 4) return 0;
+  u32 v = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = p[i];
+    v <<= 4;
+    if (c >= '0' && c <= '9') v |= (u32)(c - '0');
+    else if (c >= 'a' && c <= 'f') v |= (u32)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F') v |= (u32)(c - 'A' + 10);
+    else return 0;
   }
+  *out = v;
+  return 1;
+}
 
-  omni_json_skip_ws(p);
-  if (**p != ':') {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_COLON)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+fn size_t omni_json_put_utf8(char *out, u32 cp) {
+  if (cp < 0x80) {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = (char)(0xC0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    out[0] = (char)(0xE0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (cp & 0x3F));
+    return 3;
   }
-  (*p)++;
+  out[0] = (char)(0xF0 | (cp >> 18));
+  out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (cp & 0x3F));
+  return 4;
+}
 
-  omni_json_skip_ws(p);
-  vals[count] = omni_json_parse_value(p);
-  if (term_tag(vals[count]) >= C00 && term_ext(vals[count]) == OMNI_NAM_ERR) {
-    return vals[count];
+// Decode the XXXX of a \uXXXX escape at *p (just past the u) into *cp,
+// joining a following \uXXXX low surrogate into one code point. Advances
+// *p past what it used; returns 0 if the four hex digits are not there.
+fn int omni_json_unescape_u(const char **p, const char *end, u32 *cp) {
+  u32 lo;
+  if (!omni_json_hex4(*p, end, cp)) return 0;
+  *p += 4;
+  if (*cp >= 0xD800 && *cp <= 0xDBFF && end - *p >= 6 && (*p)[0] == '\\' && (*p)[1] == 'u' &&
+      omni_json_hex4(*p + 2, end, &lo) && lo >= 0xDC00 && lo <= 0xDFFF) {
+    *cp = 0x10000 + ((*cp - 0xD800) << 10) + (lo - 0xDC00);
+    *p += 6;
   }
-  count++;
+  return 1;
+}
 
-  omni_json_skip_ws(p);
+// Parse a JSON string at its opening quote. A string without escapes is
+// taken straight from the input; otherwise it is decoded into the scratch
+// buffer, \uXXXX (and surrogate pairs) as UTF-8. Decoding never grows the
+// text, so the scratch needs no more than the raw length.
+fn Term omni_json_parse_string(OmniJsonParser *ps) {
+  if (ps->p == ps->end || *ps->p != '"') return omni_json_error(OMNI_JSON_ERR_STRING);
+  const char *start = ps->p + 1;
+  const char *end = ps->end;
+
+  const char *q = (const char*)memchr(start, '"', (size_t)(end - start));
+  if (!q) return omni_json_error(OMNI_JSON_ERR_STRING);
+  if (!memchr(start, '\\', (size_t)(q - start))) {
+    ps->p = q + 1;
+    return omni_json_string_term(start, (size_t)(q - start));
+  }
 
-  // Parse remaining key-value pairs
-  while (**p == ',' && count < 256) {
-    (*p)++;  // Skip comma
-    omni_json_skip_ws(p);
+  // Escapes: find the real closing quote first
+  q = start;
+  while (q < end && *q != '"') q += (*q == '\\' && q + 1 < end) ? 2 : 1;
+  if (q >= end) return omni_json_error(OMNI_JSON_ERR_STRING);
+
+  size_t raw = (size_t)(q - start);
+  if (raw > ps->scap) {
+    char *grown = (char*)realloc(ps->scratch, raw);
+    if (!grown) return omni_json_error(OMNI_JSON_ERR_MEMORY);
+    ps->scratch = grown;
+    ps->scap = raw;
+  }
 
-    keys[count] = omni_json_parse_string(p);
-    if (term_tag(keys[count]) >= C00 && term_ext(keys[count]) == OMNI_NAM_ERR) {
-      return keys[count];
+  char *out = ps->scratch;
+  size_t n = 0;
+  const char *p = start;
+  while (p < q) {
+    if (*p != '\\') {
+      out[n++] = *p++;
+      continue;
     }
-
-    omni_json_skip_ws(p);
-    if (**p != ':') {
-      Term err_args[1] = {term_new_num(OMNI_JSON_ERR_COLON)};
-      return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+    p++;
+    char c = *p++;
+    switch (c) {
+      case 'n': out[n++] = '\n'; break;
+      case 't': out[n++] = '\t'; break;
+      case 'r': out[n++] = '\r'; break;
+      case 'b': out[n++] = '\b'; break;
+      case 'f': out[n++] = '\f'; break;
+      case 'u': {
+        u32 cp;
+        if (!omni_json_unescape_u(&p, q, &cp)) return omni_json_error(OMNI_JSON_ERR_STRING);
+        n += omni_json_put_utf8(out + n, cp);
+        break;
+      }
+      default: out[n++] = c; break;  // \" \\ \/ and anything else as itself
     }
-    (*p)++;
+  }
 
-    omni_json_skip_ws(p);
-    vals[count] = omni_json_parse_value(p);
-    if (term_tag(vals[count]) >= C00 && term_ext(vals[count]) == OMNI_NAM_ERR) {
-      return vals[count];
-    }
-    count++;
+  ps->p = q + 1;
+  return omni_json_string_term(out, n);
+}
 
-    omni_json_skip_ws(p);
+// Parse a JSON number exactly: the digits become a 64-bit mantissa and the
+// fraction and exponent a decimal scale. Integers in 0..2^32-1 are #Cst,
+// everything else #Fix{hi, lo, scale}. Fraction digits past 18 decimals or
+// past 64 bits are dropped; an integer part that does not fit is an error.
+fn Term omni_json_parse_number(OmniJsonParser *ps) {
+  const char *p = ps->p;
+  const char *end = ps->end;
+  const u64 max = (u64)INT64_MAX;
+  int neg = 0;
+  u64 m = 0;
+  int64_t scale = 0;
+
+  if (p < end && *p == '-') {
+    neg = 1;
+    p++;
   }
-
-  // Close object
-  if (**p != '}') {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_OBJECT)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  if (p == end || *p < '0' || *p > '9') return omni_json_error(OMNI_JSON_ERR_NUMBER);
+  while (p < end && *p >= '0' && *p <= '9') {
+    u64 d = (u64)(*p++ - '0');
+    if (m > (max - d) / 10) return omni_json_error(OMNI_JSON_ERR_RANGE);
+    m = m * 10 + d;
   }
-  (*p)++;
 
-  // Build entries list from back to front
-  // Each entry is a pair: #CON{key, #CON{val, #NIL}}
-  Term nil = term_new_ctr(OMNI_NAM_NIL, 0, NULL);
-  Term entries = nil;
+  if (p < end && *p == '.') {
+    p++;
+    if (p == end || *p < '0' || *p > '9') return omni_json_error(OMNI_JSON_ERR_NUMBER);
+    while (p < end && *p >= '0' && *p <= '9') {
+      u64 d = (u64)(*p++ - '0');
+      if (scale < 18 && m <= (max - d) / 10) {
+        m = m * 10 + d;
+        scale++;
+      }
+    }
+  }
 
-  for (int i = count - 1; i >= 0; i--) {
-    // Build pair: (key val)
-    Term val_cons_args[2] = {vals[i], nil};
-    Term val_cons = term_new_ctr(OMNI_NAM_CON, 2, val_cons_args);
-    Term pair_args[2] = {keys[i], val_cons};
-    Term pair = term_new_ctr(OMNI_NAM_CON, 2, pair_args);
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    int eneg = 0;
+    if (p < end && (*p == '+' || *p == '-')) eneg = *p++ == '-';
+    if (p == end || *p < '0' || *p > '9') return omni_json_error(OMNI_JSON_ERR_NUMBER);
+    int64_t e = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      if (e < 100000) e = e * 10 + (*p - '0');
+      p++;
+    }
+    scale += eneg ? e : -e;
+  }
 
-    // Prepend to entries
-    Term entry_args[2] = {pair, entries};
-    entries = term_new_ctr(OMNI_NAM_CON, 2, entry_args);
+  while (scale < 0) {
+    if (m > max / 10) return omni_json_error(OMNI_JSON_ERR_RANGE);
+    m *= 10;
+    scale++;
   }
+  while (scale > 18) {
+    m /= 10;
+    scale--;
+  }
+  ps->p = p;
 
-  // Build the dict: #Dict{entries}
-  Term dict_args[1] = {entries};
-  return term_new_ctr(OMNI_NAM_DICT, 1, dict_args);
+  int64_t v = neg ? -(int64_t)m : (int64_t)m;
+  if (scale == 0 && v >= 0 && v <= 0xFFFFFFFFLL) {
+    Term num_arg[1] = {term_new_num((u32)v)};
+    return term_new_ctr(OMNI_NAM_CST, 1, num_arg);
+  }
+  Term fix_args[3] = {
+    term_new_num((u32)((u64)v >> 32)),
+    term_new_num((u32)((u64)v & 0xFFFFFFFF)),
+    term_new_num((u32)scale),
+  };
+  return term_new_ctr(OMNI_NAM_FIX, 3, fix_args);
 }
 
-// Parse any JSON value
-fn Term omni_json_parse_value(const char **p) {
-  omni_json_skip_ws(p);
+// Parse a string, number, true, false or null. Anything but whitespace or
+// an operator right after a number or literal is an error.
+fn Term omni_json_parse_scalar(OmniJsonParser *ps) {
+  size_t left = (size_t)(ps->end - ps->p);
+  Term v;
 
-  if (!**p) {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_EOF)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
-  }
-
-  switch (**p) {
+  switch (*ps->p) {
     case '"':
-      return omni_json_parse_string(p);
-
-    case '{':
-      return omni_json_parse_object(p);
-
-    case '[':
-      return omni_json_parse_array(p);
+      return omni_json_parse_string(ps);
 
     case 't':  // true
-      if (strncmp(*p, "true", 4) == 0) {
-        *p += 4;
-        return term_new_ctr(OMNI_NAM_TRUE, 0, NULL);
-      }
+      if (left < 4 || memcmp(ps->p, "true", 4) != 0) return omni_json_error(OMNI_JSON_ERR_SYNTAX);
+      ps->p += 4;
+      v = term_new_ctr(OMNI_NAM_TRUE, 0, NULL);
       break;
 
     case 'f':  // false
-      if (strncmp(*p, "false", 5) == 0) {
-        *p += 5;
-        return term_new_ctr(OMNI_NAM_FALS, 0, NULL);
-      }
+      if (left < 5 || memcmp(ps->p, "false", 5) != 0) return omni_json_error(OMNI_JSON_ERR_SYNTAX);
+      ps->p += 5;
+      v = term_new_ctr(OMNI_NAM_FALS, 0, NULL);
       break;
 
     case 'n':  // null
-      if (strncmp(*p, "null", 4) == 0) {
-        *p += 4;
-        return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
-      }
+      if (left < 4 || memcmp(ps->p, "null", 4) != 0) return omni_json_error(OMNI_JSON_ERR_SYNTAX);
+      ps->p += 4;
+      v = term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
       break;
 
     case '-':
     case '0': case '1': case '2': case '3': case '4':
     case '5': case '6': case '7': case '8': case '9':
-      return omni_json_parse_number(p);
+      v = omni_json_parse_number(ps);
+      if (omni_json_is_error(v)) return v;
+      break;
+
+    default:
+      return omni_json_error(OMNI_JSON_ERR_SYNTAX);
   }
 
-  Term err_args[1] = {term_new_num(OMNI_JSON_ERR_SYNTAX)};
-  return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  if (ps->p < ps->end && !(OMNI_JSON_CLASS[(u8)*ps->p] & (OMNI_JSON_C_OP | OMNI_JSON_C_WS))) {
+    return omni_json_error(OMNI_JSON_ERR_SYNTAX);
+  }
+  return v;
+}
+
+// Parse `"key" :` of an object member onto the value stack; its value follows
+fn int omni_json_parse_key(OmniJsonParser *ps) {
+  omni_json_skip_ws(ps);
+  if (ps->p == ps->end || *ps->p != '"') return OMNI_JSON_ERR_OBJECT;
+  Term key = omni_json_parse_string(ps);
+  if (omni_json_is_error(key)) return OMNI_JSON_ERR_STRING;
+  omni_json_skip_ws(ps);
+  if (ps->p == ps->end || *ps->p != ':') return OMNI_JSON_ERR_COLON;
+  ps->p++;
+  return omni_json_push(ps, key);
+}
+
+// Parse one JSON document, leaving ps->p just past it
+fn Term omni_json_parse_value(OmniJsonParser *ps) {
+  int err;
+
+  for (;;) {
+    omni_json_skip_ws(ps);
+    if (ps->p == ps->end) return omni_json_error(OMNI_JSON_ERR_EOF);
+
+    Term v;
+    char c = *ps->p;
+    if (c == '[' || c == '{') {
+      ps->p++;
+      if ((err = omni_json_open(ps, c))) return omni_json_error(err);
+      omni_json_skip_ws(ps);
+      if (ps->p < ps->end && *ps->p == (c == '[' ? ']' : '}')) {
+        ps->p++;
+        v = omni_json_close(ps);
+      } else {
+        if (c == '{' && (err = omni_json_parse_key(ps))) return omni_json_error(err);
+        continue;  // first element
+      }
+    } else {
+      v = omni_json_parse_scalar(ps);
+      if (omni_json_is_error(v)) return v;
+    }
+
+    // v is complete: add it to the innermost container, closing every
+    // container that ends right after it
+    for (;;) {
+      if (ps->depth == 0) return v;
+      if ((err = omni_json_push(ps, v))) return omni_json_error(err);
+      omni_json_skip_ws(ps);
+      char kind = ps->frames[ps->depth - 1].kind;
+      if (ps->p < ps->end && *ps->p == ',') {
+        ps->p++;
+        if (kind == '{' && (err = omni_json_parse_key(ps))) return omni_json_error(err);
+        break;  // next element
+      }
+      if (ps->p < ps->end && *ps->p == (kind == '[' ? ']' : '}')) {
+        ps->p++;
+        v = omni_json_close(ps);
+        continue;
+      }
+      return omni_json_error(kind == '[' ? OMNI_JSON_ERR_ARRAY : OMNI_JSON_ERR_OBJECT);
+    }
+  }
+}
+
+// Parse the document at the start of len bytes; *used gets the bytes consumed.
+// Without used the document must be all there is: anything but whitespace
+// after it is #Err{EINVAL}.
+fn Term omni_json_parse_bytes(const char *data, size_t len, size_t *used) {
+  OmniJsonParser ps;
+  omni_json_parser_init(&ps, data, len);
+  if (len >= OMNI_JSON_INDEX_MIN && len <= UINT32_MAX) {
+    ps.index = omni_json_index(data, len, &ps.nindex);  // NULL: parse bytewise
+  }
+  Term result = omni_json_parse_value(&ps);
+  if (used) {
+    *used = (size_t)(ps.p - data);
+  } else if (!omni_json_is_error(result)) {
+    omni_json_skip_ws(&ps);
+    if (ps.p != ps.end) result = omni_json_error(EINVAL);
+  }
+  omni_json_parser_free(&ps);
+  return result;
 }
 
 // =============================================================================
@@ -356,10 +733,10 @@ fn void omni_json_append_char(char **buf, size_t *len, size_t *cap, char c) {
 
 // Stringify a char list as JSON string
 fn void omni_json_stringify_string(Term list, char **buf, size_t *len, size_t *cap) {
-  char *s = omni_list_to_cstr(list);
+  OmniBuf *b = omni_pstr_arg(list);  // code points back to UTF-8
   omni_json_append_char(buf, len, cap, '"');
-  if (s) {
-    for (const char *p = s; *p; p++) {
+  if (b) {
+    for (const char *p = (const char*)b->data, *end = p + b->len; p < end && *p; p++) {
       switch (*p) {
         case '"': omni_json_append(buf, len, cap, "\\\""); break;
         case '\\': omni_json_append(buf, len, cap, "\\\\"); break;
@@ -369,7 +746,7 @@ fn void omni_json_stringify_string(Term list, char **buf, size_t *len, size_t *c
         default: omni_json_append_char(buf, len, cap, *p); break;
       }
     }
-    free(s);
+    omni_buf_release(b);
   }
   omni_json_append_char(buf, len, cap, '"');
 }
@@ -406,7 +783,28 @@ fn void omni_json_stringify_value(Term val, char **buf, size_t *len, size_t *cap
   if (term_tag(val) == C01 && term_ext(val) == OMNI_NAM_CST) {
     Term inner = wnf(HEAP[term_val(val)]);
     char num_buf[32];
-    snprintf(num_buf, sizeof(num_buf), "%d", (int)term_val(inner));
+    snprintf(num_buf, sizeof(num_buf), "%u", term_val(inner));
+    omni_json_append(buf, len, cap, num_buf);
+    return;
+  }
+
+  // Check for #Fix{hi, lo, scale} (64-bit or decimal number)
+  if (term_tag(val) == C03 && term_ext(val) == OMNI_NAM_FIX) {
+    u32 loc = term_val(val);
+    u64 hi = term_val(wnf(HEAP[loc]));
+    u64 lo = term_val(wnf(HEAP[loc + 1]));
+    u32 scale = term_val(wnf(HEAP[loc + 2]));
+    int64_t m = (int64_t)((hi << 32) | lo);
+    u64 mag = m < 0 ? (u64)0 - (u64)m : (u64)m;
+    char num_buf[48];
+    if (scale == 0 || scale > 19) {
+      snprintf(num_buf, sizeof(num_buf), "%s%llu", m < 0 ? "-" : "", (unsigned long long)mag);
+    } else {
+      u64 div = 1;
+      for (u32 i = 0; i < scale; i++) div *= 10;
+      snprintf(num_buf, sizeof(num_buf), "%s%llu.%0*llu", m < 0 ? "-" : "",
+               (unsigned long long)(mag / div), (int)scale, (unsigned long long)(mag % div));
+    }
     omni_json_append(buf, len, cap, num_buf);
     return;
   }
@@ -419,6 +817,12 @@ fn void omni_json_stringify_value(Term val, char **buf, size_t *len, size_t *cap
     return;
   }
 
+  // Packed string
+  if (omni_pstr_is(val)) {
+    omni_json_stringify_string(val, buf, len, cap);
+    return;
+  }
+
   // Check for CON (list/array)
   if (term_tag(val) == C02 && term_ext(val) == NAM_CON) {
     // Check if it's a char list (string)
@@ -508,21 +912,50 @@ fn void omni_json_stringify_value(Term val, char **buf, size_t *len, size_t *cap
 // Main JSON Functions
 // =============================================================================
 
-// Parse JSON string to OmniLisp value
+// Parse JSON text to OmniLisp value. A #Buf or packed string is parsed
+// in place; a char list is flattened first.
 fn Term omni_json_parse(Term str) {
-  char *cstr = omni_list_to_cstr(str);
-  if (!cstr) {
-    Term err_args[1] = {term_new_num(OMNI_JSON_ERR_MEMORY)};
-    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  OmniBuf *b = omni_buf_acquire(str);
+  if (b) {
+    Term result = omni_json_parse_bytes((const char*)b->data, b->len, NULL);
+    omni_buf_release(b);
+    return result;
   }
 
-  const char *p = cstr;
-  Term result = omni_json_parse_value(&p);
+  char *cstr = omni_list_to_cstr(str);
+  if (!cstr) return omni_json_error(OMNI_JSON_ERR_MEMORY);
+
+  Term result = omni_json_parse_bytes(cstr, strlen(cstr), NULL);
   free(cstr);
 
   return result;
 }
 
+// JSON Lines: the document on the line at off. Blank lines are skipped, and
+// a line holding anything but one document is OMNI_JSON_ERR_SYNTAX.
+// *next gets the offset after the line; returns 0 at the end of the input.
+fn int omni_json_lines_step(const char *data, size_t len, size_t off, Term *doc, size_t *next) {
+  while (off < len && (data[off] == ' ' || data[off] == '\n' ||
+                       data[off] == '\r' || data[off] == '\t')) {
+    off++;
+  }
+  if (off >= len) return 0;
+
+  const char *line = data + off;
+  const char *nl = (const char*)memchr(line, '\n', len - off);
+  size_t n = nl ? (size_t)(nl - line) : len - off;
+
+  OmniJsonParser ps;
+  omni_json_parser_init(&ps, line, n);
+  *doc = omni_json_parse_value(&ps);
+  omni_json_skip_ws(&ps);
+  if (!omni_json_is_error(*doc) && ps.p != ps.end) *doc = omni_json_error(OMNI_JSON_ERR_SYNTAX);
+  omni_json_parser_free(&ps);
+
+  *next = off + n + (nl ? 1 : 0);
+  return 1;
+}
+
 // Stringify OmniLisp value to JSON string
 fn Term omni_json_stringify(Term val) {
   size_t cap = 256;
@@ -536,7 +969,7 @@ fn Term omni_json_stringify(Term val) {
 
   omni_json_stringify_value(val, &buf, &len, &cap);
 
-  Term result = omni_cstr_to_list(buf);
+  Term result = omni_json_string_term(buf, len);
   free(buf);
 
   return result;
@@ -566,17 +999,35 @@ fn Term omni_ffi_json_stringify(Term args) {
   return omni_json_stringify(val);
 }
 
+// buf, offset -> #Some{document, #Cst{next offset}}, or #None at the end.
+// runtime.hvm4 steps a json-lines #Iter with this; a bad line yields its
+// #Err and the stream carries on with the next one.
+fn Term omni_ffi_json_lines_next(Term args) {
+  Term t[2];
+  size_t off, next;
+  if (omni_buf_args(args, t, 2) != 2 || !omni_buf_index(t[1], &off)) {
+    return omni_json_error(EINVAL);
+  }
+  OmniBuf *b = omni_buf_acquire(t[0]);
+  if (!b) return omni_json_error(EINVAL);
+
+  Term doc;
+  int more = omni_json_lines_step((const char*)b->data, b->len, off, &doc, &next);
+  omni_buf_release(b);
+  if (!more) return term_new_ctr(OMNI_NAM_NONE, 0, NULL);
+
+  Term pos = term_new_num((u32)next);
+  Term some_args[2] = {doc, term_new_ctr(OMNI_NAM_CST, 1, &pos)};
+  return term_new_ctr(OMNI_NAM_SOME, 2, some_args);
+}
+
 // =============================================================================
-// JSON Dispatch
+// JSON Registration
 // =============================================================================
 
-fn Term omni_ffi_json_dispatch(u32 name_nick, Term args) {
-  if (name_nick == OMNI_NAM_JPRS) {
-    return omni_ffi_json_parse(args);
-  }
-  if (name_nick == OMNI_NAM_JSTR) {
-    return omni_ffi_json_stringify(args);
-  }
-
-  return 0;  // Not a JSON operation
+fn void omni_ffi_register_json(void) {
+  omni_json_stage1_select();
+  omni_ffi_register_term(OMNI_NAM_JPRS, omni_ffi_json_parse);
+  omni_ffi_register_term(OMNI_NAM_JSTR, omni_ffi_json_stringify);
+  omni_ffi_register_term(OMNI_NAM_JLNX, omni_ffi_json_lines_next);
 }
@@ -0,0 +1,443 @@
+// OmniLisp Packed Strings
+// UTF-8 bytes in one buffer instead of a #CON chain of #CHR
+//
+// A char list costs two constructors and a number per character, and every
+// string helper in runtime.hvm4 walks it. A packed string #PStr{n} keeps
+// the UTF-8 encoding in the heap itself: n is the heap index of a header
+// with the number of code points and an FNV-1a hash computed when it is
+// made, and a fresh string's bytes follow the header. Nothing outside the
+// heap refers to it, so it needs no handle and goes away with the heap
+// cells around it (a --batch job, a REPL rollback), like a char list would.
+//
+//   str-length      cached count
+//   str-char-at     O(1) for ASCII, one scan otherwise
+//   str-slice       a new header over the same bytes
+//   str-index-of    memchr and memcmp
+//   equality        length and hash first, then memcmp
+//
+// Every other string function takes a char list; runtime.hvm4 converts a
+// packed string with @omni_str_list (FFI "PsLs") where one is needed, and
+// FFI arguments accept either (omni_list_to_cstr copies the bytes).
+//
+// (pack-string s) and (unpack-string s) convert explicitly. With
+// OMNI_PACKED_STRINGS=1, string literals in expressions and the strings
+// returned by read-file, getenv, list-dir, json-stringify and
+// datetime-format are packed as well. It is off by default: programs that
+// take strings apart as lists (first, rest, match) need unpack-string.
+//
+// Char lists hold code points: the parser decodes UTF-8. Packing encodes
+// each one back, and unpacking decodes, so a literal round-trips exactly.
+// A byte that is not valid UTF-8 unpacks as a char of that value, as in a
+// list read from a file.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int OMNI_PSTR_ENABLED = 0;   // OMNI_PACKED_STRINGS=1
+
+// =============================================================================
+// UTF-8
+// =============================================================================
+
+// Encode code point c at out (4 bytes of room); returns the byte count
+fn u32 omni_pstr_encode(u32 c, u8 *out) {
+  if (c < 0x80) {
+    out[0] = (u8)c;
+    return 1;
+  }
+  if (c < 0x800) {
+    out[0] = (u8)(0xC0 | (c >> 6));
+    out[1] = (u8)(0x80 | (c & 0x3F));
+    return 2;
+  }
+  if (c < 0x10000) {
+    out[0] = (u8)(0xE0 | (c >> 12));
+    out[1] = (u8)(0x80 | ((c >> 6) & 0x3F));
+    out[2] = (u8)(0x80 | (c & 0x3F));
+    return 3;
+  }
+  out[0] = (u8)(0xF0 | ((c >> 18) & 0x07));
+  out[1] = (u8)(0x80 | ((c >> 12) & 0x3F));
+  out[2] = (u8)(0x80 | ((c >> 6) & 0x3F));
+  out[3] = (u8)(0x80 | (c & 0x3F));
+  return 4;
+}
+
+// Decode the code point at data[*i], advancing *i past it; a byte that does
+// not start a complete sequence decodes as itself
+fn u32 omni_pstr_decode(const u8 *data, size_t len, size_t *i) {
+  u8 b = data[*i];
+  u32 n = b >= 0xF0 && b < 0xF8 ? 3 : b >= 0xE0 && b < 0xF0 ? 2 : b >= 0xC0 && b < 0xE0 ? 1 : 0;
+  if (n == 0 || *i + n >= len) {
+    (*i)++;
+    return b;
+  }
+  u32 c = b & (0x3F >> n);
+  for (u32 k = 1; k <= n; k++) {
+    u8 cont = data[*i + k];
+    if ((cont & 0xC0) != 0x80) {
+      (*i)++;
+      return b;
+    }
+    c = (c << 6) | (cont & 0x3F);
+  }
+  *i += n + 1;
+  return c;
+}
+
+// Code points in len bytes
+fn u32 omni_pstr_count(const u8 *data, size_t len) {
+  u32 chars = 0;
+  size_t i = 0;
+  while (i < len) {
+    if (data[i] < 0x80) {
+      i++;
+    } else {
+      omni_pstr_decode(data, len, &i);
+    }
+    chars++;
+  }
+  return chars;
+}
+
+// Byte offset of code point idx in len bytes holding chars code points
+// (len if past the end)
+fn size_t omni_pstr_offset(const u8 *data, size_t len, size_t chars, size_t idx) {
+  if (chars == len) return idx < len ? idx : len;   // ASCII
+  size_t i = 0;
+  while (idx > 0 && i < len) {
+    omni_pstr_decode(data, len, &i);
+    idx--;
+  }
+  return i;
+}
+
+fn u32 omni_pstr_hash(const u8 *data, size_t len) {
+  u32 h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ data[i]) * 16777619u;
+  }
+  return h;
+}
+
+// Fill in the cached length and hash
+fn OmniBuf* omni_pstr_measure(OmniBuf *b) {
+  if (!b) return NULL;
+  b->hash = omni_pstr_hash(b->data, b->len);
+  b->chars = omni_pstr_count(b->data, b->len);
+  return b;
+}
+
+// =============================================================================
+// Packed Strings
+// =============================================================================
+
+// Header of a packed string, in the heap cells #PStr{n} points at
+typedef struct {
+  u32 bytes;    // Heap index of the cell its bytes start in
+  u32 off;      // Offset of the string in them
+  u32 len;      // Bytes
+  u32 chars;    // Code points
+  u32 hash;     // FNV-1a of the bytes
+  u32 unused;
+} OmniPStr;
+
+#define OMNI_PSTR_CELLS ((sizeof(OmniPStr) + sizeof(Term) - 1) / sizeof(Term))
+
+fn int omni_pstr_is(Term t) {
+  return term_tag(t) == C01 && term_ext(t) == OMNI_NAM_PSTR;
+}
+
+// Header of a reduced #PStr, or NULL
+fn OmniPStr* omni_pstr_at(Term t) {
+  if (!omni_pstr_is(t)) return NULL;
+  Term n = wnf(HEAP[term_val(t)]);
+  return term_tag(n) == NUM ? (OmniPStr*)&HEAP[term_val(n)] : NULL;
+}
+
+fn const u8* omni_pstr_data(const OmniPStr *p) {
+  return (const u8*)&HEAP[p->bytes] + p->off;
+}
+
+// #PStr{n} over a header filled in by the caller
+fn Term omni_pstr_node(u64 loc) {
+  Term n = term_new_num((u32)loc);
+  return term_new_ctr(OMNI_NAM_PSTR, 1, &n);
+}
+
+// A packed copy of len bytes
+fn Term omni_pstr_string(const char *data, size_t len) {
+  if (len >= UINT32_MAX) return omni_buf_error(ENOMEM);
+  u64 loc = heap_alloc(OMNI_PSTR_CELLS + (len + sizeof(Term)) / sizeof(Term));
+  OmniPStr *p = (OmniPStr*)&HEAP[loc];
+  u8 *bytes = (u8*)&HEAP[loc + OMNI_PSTR_CELLS];
+  memcpy(bytes, data, len);
+  bytes[len] = 0;
+  p->bytes = (u32)(loc + OMNI_PSTR_CELLS);
+  p->off = 0;
+  p->len = (u32)len;
+  p->chars = omni_pstr_count(bytes, len);
+  p->hash = omni_pstr_hash(bytes, len);
+  p->unused = 0;
+  return omni_pstr_node(loc);
+}
+
+// Cells a copy of the string whose header is at loc takes: a header and
+// its own bytes, whether or not the original shares them with a slice
+fn u64 omni_pstr_copy_cells(u64 loc) {
+  const OmniPStr *p = (const OmniPStr*)&HEAP[loc];
+  return OMNI_PSTR_CELLS + ((u64)p->len + sizeof(Term)) / sizeof(Term);
+}
+
+// Write that copy to out, for it to live at heap index at (omni_heap_commit)
+fn void omni_pstr_copy_to(u64 loc, Term *out, u64 at) {
+  const OmniPStr *p = (const OmniPStr*)&HEAP[loc];
+  OmniPStr *q = (OmniPStr*)out;
+  u8 *bytes = (u8*)(out + OMNI_PSTR_CELLS);
+  memcpy(bytes, omni_pstr_data(p), p->len);
+  bytes[p->len] = 0;
+  q->bytes = (u32)(at + OMNI_PSTR_CELLS);
+  q->off = 0;
+  q->len = p->len;
+  q->chars = p->chars;
+  q->hash = p->hash;
+  q->unused = 0;
+}
+
+// A packed copy of b's bytes; releases the caller's reference to b
+fn Term omni_pstr_term(OmniBuf *b) {
+  if (!b) return omni_buf_error(ENOMEM);
+  Term t = omni_pstr_string((const char*)b->data, b->len);
+  omni_buf_release(b);
+  return t;
+}
+
+// A buffer of len bytes copied from data, measured
+fn OmniBuf* omni_pstr_new(const char *data, size_t len) {
+  OmniBuf *b = omni_buf_new(len);
+  if (!b) return NULL;
+  memcpy(b->bytes, data, len);
+  return omni_pstr_measure(b);
+}
+
+// The bytes of a reduced #PStr as a buffer, for the caller to release. It
+// views the heap without copying, so it must not be kept past the
+// evaluation that made the string.
+fn OmniBuf* omni_pstr_acquire(Term t) {
+  OmniPStr *p = omni_pstr_at(t);
+  if (!p) return NULL;
+  OmniBuf *b = omni_buf_adopt((void*)omni_pstr_data(p), p->len, 0);
+  if (!b) return NULL;
+  b->chars = p->chars;
+  b->hash = p->hash;
+  return b;
+}
+
+// UTF-8 encoding of a char list of code points, in one pass
+fn OmniBuf* omni_pstr_from_list(Term list) {
+  size_t cap = 64, len = 0;
+  OmniBuf *b = omni_buf_new(cap);
+  if (!b) return NULL;
+  Term cur = wnf(list);
+  while (term_tag(cur) == C02 && term_ext(cur) == NAM_CON) {
+    u32 loc = term_val(cur);
+    Term head = wnf(HEAP[loc]);
+    if (term_tag(head) == C01 && term_ext(head) == NAM_CHR) head = wnf(HEAP[term_val(head)]);
+    if (len + 4 > cap) {
+      cap *= 2;
+      OmniBuf *grown = (OmniBuf*)realloc(b, sizeof(OmniBuf) + cap + 1);
+      if (!grown) {
+        free(b);
+        return NULL;
+      }
+      b = grown;
+    }
+    len += omni_pstr_encode(term_val(head), b->bytes + len);
+    cur = wnf(HEAP[loc + 1]);
+  }
+  b->data = b->bytes;
+  b->len = len;
+  b->bytes[len] = 0;
+  return omni_pstr_measure(b);
+}
+
+// Char list of the first chars code points in len bytes of UTF-8
+fn Term omni_pstr_decode_list(const u8 *data, size_t len, size_t chars) {
+  // Decoded front to back, linked back to front
+  u32 *codes = (u32*)malloc((chars + 1) * sizeof(u32));
+  if (!codes) return omni_buf_error(ENOMEM);
+  size_t i = 0;
+  u32 n = 0;
+  while (i < len && n < chars) codes[n++] = omni_pstr_decode(data, len, &i);
+
+  Term result = term_new_ctr(NAM_NIL, 0, NULL);
+  while (n > 0) {
+    Term chr_args[1] = {term_new_num(codes[--n])};
+    Term con_args[2] = {term_new_ctr(NAM_CHR, 1, chr_args), result};
+    result = term_new_ctr(NAM_CON, 2, con_args);
+  }
+  free(codes);
+  return result;
+}
+
+// Char list of the code points in b
+fn Term omni_pstr_to_list(const OmniBuf *b) {
+  return omni_pstr_decode_list(b->data, b->len, b->chars);
+}
+
+// Bytes of a packed string or char list argument, with a reference
+fn OmniBuf* omni_pstr_arg(Term t) {
+  if (omni_pstr_is(t)) return omni_pstr_acquire(t);
+  if (term_tag(t) == C00 && term_ext(t) == NAM_NIL) return omni_pstr_new("", 0);
+  if (term_tag(t) == C02 && term_ext(t) == NAM_CON) return omni_pstr_from_list(t);
+  return NULL;
+}
+
+// =============================================================================
+// FFI Wrappers
+// =============================================================================
+
+// (pack-string s): packed strings pass through
+fn Term omni_ffi_pstr_pack(Term args) {
+  Term s;
+  if (omni_buf_args(args, &s, 1) != 1) return omni_buf_error(EINVAL);
+  if (omni_pstr_is(s)) return s;
+  OmniBuf *b = omni_pstr_arg(s);
+  return b ? omni_pstr_term(b) : omni_buf_error(EINVAL);
+}
+
+// (unpack-string s): char lists pass through
+fn Term omni_ffi_pstr_unpack(Term args) {
+  Term s;
+  if (omni_buf_args(args, &s, 1) != 1) return omni_buf_error(EINVAL);
+  OmniBuf *b = omni_pstr_acquire(s);
+  if (!b) return s;
+  Term result = omni_pstr_to_list(b);
+  omni_buf_release(b);
+  return result;
+}
+
+// str-length
+fn Term omni_ffi_pstr_length(Term args) {
+  Term s;
+  OmniPStr *p = omni_buf_args(args, &s, 1) == 1 ? omni_pstr_at(s) : NULL;
+  if (!p) return omni_buf_error(EINVAL);
+  Term n = term_new_num(p->chars);
+  return term_new_ctr(OMNI_NAM_CST, 1, &n);
+}
+
+// str-char-at: #CHR{code}, or #Noth past the end
+fn Term omni_ffi_pstr_char_at(Term args) {
+  Term t[2];
+  size_t idx;
+  if (omni_buf_args(args, t, 2) != 2) return omni_buf_error(EINVAL);
+  OmniPStr *p = omni_pstr_at(t[0]);
+  if (!p) return omni_buf_error(EINVAL);
+  if (!omni_buf_index(t[1], &idx) || idx >= p->chars) {
+    return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+  }
+  const u8 *data = omni_pstr_data(p);
+  size_t i = omni_pstr_offset(data, p->len, p->chars, idx);
+  Term code = term_new_num(omni_pstr_decode(data, p->len, &i));
+  return term_new_ctr(NAM_CHR, 1, &code);
+}
+
+// str-slice: len chars from start, both clamped to the string; a header
+// over the same bytes
+fn Term omni_ffi_pstr_slice(Term args) {
+  Term t[3];
+  size_t start, count;
+  if (omni_buf_args(args, t, 3) != 3) return omni_buf_error(EINVAL);
+  OmniPStr *p = omni_pstr_at(t[0]);
+  if (!p) return omni_buf_error(EINVAL);
+  if (!omni_buf_index(t[1], &start)) start = 0;
+  if (!omni_buf_index(t[2], &count)) count = 0;
+  if (start > p->chars) start = p->chars;
+  if (count > p->chars - start) count = p->chars - start;
+
+  const u8 *data = omni_pstr_data(p);
+  size_t from = omni_pstr_offset(data, p->len, p->chars, start);
+  size_t to = p->chars == p->len ? from + count : from;
+  for (size_t k = 0; k < count && p->chars != p->len; k++) {
+    omni_pstr_decode(data, p->len, &to);
+  }
+
+  u64 loc = heap_alloc(OMNI_PSTR_CELLS);
+  OmniPStr *s = (OmniPStr*)&HEAP[loc];
+  s->bytes = p->bytes;
+  s->off = p->off + (u32)from;
+  s->len = (u32)(to - from);
+  s->chars = (u32)count;
+  s->hash = omni_pstr_hash(data + from, to - from);
+  s->unused = 0;
+  return omni_pstr_node(loc);
+}
+
+// First occurrence of needle (nlen > 0) in hay, or NULL; memchr finds the
+// candidates (memmem is a GNU extension)
+fn const u8* omni_pstr_find(const u8 *hay, size_t len, const u8 *needle, size_t nlen) {
+  const u8 *p = hay, *end = hay + len;
+  while (nlen <= (size_t)(end - p)) {
+    p = (const u8*)memchr(p, needle[0], (size_t)(end - p) - nlen + 1);
+    if (!p) return NULL;
+    if (memcmp(p, needle, nlen) == 0) return p;
+    p++;
+  }
+  return NULL;
+}
+
+// str-index-of: #Cst{char index} of the first needle, or #Noth
+fn Term omni_ffi_pstr_index_of(Term args) {
+  Term t[2];
+  if (omni_buf_args(args, t, 2) != 2) return omni_buf_error(EINVAL);
+  OmniBuf *b = omni_pstr_acquire(t[0]);
+  OmniBuf *needle = omni_pstr_arg(t[1]);
+  Term result = term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+  if (b && needle && b->len > 0) {
+    const u8 *hit = needle->len == 0 ? b->data
+                  : omni_pstr_find(b->data, b->len, needle->data, needle->len);
+    if (hit) {
+      Term n = term_new_num(omni_pstr_count(b->data, (size_t)(hit - b->data)));
+      result = term_new_ctr(OMNI_NAM_CST, 1, &n);
+    }
+  }
+  if (!b || !needle) result = omni_buf_error(EINVAL);
+  omni_buf_release(b);
+  omni_buf_release(needle);
+  return result;
+}
+
+// Equality with a packed string or char list: raw 1 or 0, as
+// @omni_values_equal returns
+fn Term omni_ffi_pstr_equal(Term args) {
+  Term t[2];
+  if (omni_buf_args(args, t, 2) != 2) return term_new_num(0);
+  OmniBuf *a = omni_pstr_arg(t[0]);
+  OmniBuf *b = omni_pstr_arg(t[1]);
+  int eq = a && b && a->len == b->len && a->hash == b->hash &&
+           memcmp(a->data, b->data, a->len) == 0;
+  omni_buf_release(a);
+  omni_buf_release(b);
+  return term_new_num(eq);
+}
+
+// =============================================================================
+// FFI Registration
+// =============================================================================
+
+// Names are OMNI_NAM_* nicks, so this runs after omni_names_init
+fn void omni_ffi_register_pstring(void) {
+  const char *env = getenv("OMNI_PACKED_STRINGS");
+  OMNI_PSTR_ENABLED = env && env[0] == '1';
+  omni_ffi_register_term(OMNI_NAM_PSPK, omni_ffi_pstr_pack);
+  omni_ffi_register_term(OMNI_NAM_PSLS, omni_ffi_pstr_unpack);
+  omni_ffi_register_term(OMNI_NAM_PSLN, omni_ffi_pstr_length);
+  omni_ffi_register_term(OMNI_NAM_PSAT, omni_ffi_pstr_char_at);
+  omni_ffi_register_term(OMNI_NAM_PSSL, omni_ffi_pstr_slice);
+  omni_ffi_register_term(OMNI_NAM_PSIX, omni_ffi_pstr_index_of);
+  omni_ffi_register_term(OMNI_NAM_PSEQ, omni_ffi_pstr_equal);
+}
@@ -0,0 +1,275 @@
+// OmniLisp FFI Registry
+// One table for every FFI function, indexed directly by nick
+//
+// An #FFI{name, args} node carries the function name as a 24-bit nick. The
+// registry splits it in two halves: the high 12 bits select a page in a
+// fixed directory, the low 12 bits a slot in that page. A slot holds the
+// index (+1) of the entry in a dense array, so a lookup is two loads and
+// never compares names, however many modules register functions.
+//
+// Pages are allocated the first time a name lands in them. Nicks encode
+// characters from the left, so names sharing their first two characters
+// share a page (DtNw, DtYr, ...).
+//
+// Entries are not modified once published. Registering a name again adds
+// a new entry and repoints the slot, so lookups on reducer threads run
+// without the lock while registration can still happen at runtime. The one
+// exception is a declared signature (omni_ffi_register_sig) registered
+// again under its own name: it is rewritten in place so that redeclaring
+// in a loop doesn't fill the table. No call to that name may be in flight
+// when this happens.
+//
+// Two kinds of entry:
+// - native:  a C function, called with arguments unpacked from the args
+//            list; either one of the fixed call types (omni_ffi_register)
+//            or a declared C signature (omni_ffi_register_sig, signature.c)
+// - term:    a handler that receives the reduced args list and builds the
+//            result Term itself (omni_ffi_register_term; io.c, datetime.c,
+//            json.c)
+//
+// A term entry touches the heap, so it cannot run on an FFI worker. To run
+// asynchronously it is split in three stages (omni_ffi_register_staged):
+// prepare copies the arguments out of the heap on the submitting thread,
+// run does the blocking part on a worker, finish builds the result on the
+// thread that awaits it. Native entries always run on a worker.
+//
+// A staged entry may also have a start stage (omni_ffi_register_start):
+// it begins the call without occupying a worker, e.g. by queuing it on
+// io_uring (uring.c), and completes the future itself. When it declines,
+// the call goes to a worker as usual.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// FFI Call Types
+// =============================================================================
+
+typedef enum {
+  OMNI_FFI_VOID_VOID = 0,      // void fn(void)
+  OMNI_FFI_INT_VOID,           // int fn(void)
+  OMNI_FFI_PTR_VOID,           // void* fn(void)
+  OMNI_FFI_VOID_INT,           // void fn(int)
+  OMNI_FFI_INT_INT,            // int fn(int)
+  OMNI_FFI_PTR_INT,            // void* fn(int)
+  OMNI_FFI_VOID_PTR,           // void fn(void*)
+  OMNI_FFI_INT_PTR,            // int fn(void*)
+  OMNI_FFI_PTR_PTR,            // void* fn(void*)
+  OMNI_FFI_INT_PTR_INT,        // int fn(void*, int)
+  OMNI_FFI_PTR_PTR_INT,        // void* fn(void*, int)
+  OMNI_FFI_INT_PTR_PTR,        // int fn(void*, void*)
+  OMNI_FFI_PTR_PTR_PTR,        // void* fn(void*, void*)
+  OMNI_FFI_VARIADIC,           // General case (slow path)
+  OMNI_FFI_SIGNATURE,          // Declared signature, entry->sig
+} OmniFFICallType;
+
+// Parsed C signature (signature.c)
+struct OmniFFISig;
+
+// =============================================================================
+// Entries
+// =============================================================================
+
+// Handler for a term entry: gets the reduced args list, returns the result
+typedef Term (*OmniFFITermFn)(Term args);
+
+// Stages of an asynchronous term entry
+typedef void* (*OmniFFIPrepareFn)(Term args);   // Submitter: args -> payload
+typedef void  (*OmniFFIRunFn)(void *payload);   // Worker: no heap access
+typedef Term  (*OmniFFIFinishFn)(void *payload); // Awaiter: result, frees payload
+
+// Start a staged call on a completion engine; future is its OmniFFIFuture.
+// more = further starts follow right away, so submission may be deferred
+// until a call with more = 0. Returns 0, with nothing left pending, to
+// hand the call to a worker instead.
+typedef int   (*OmniFFIStartFn)(void *payload, void *future, int more);
+
+typedef struct {
+  u32 name_nick;               // Nick-encoded function name
+  OmniFFITermFn term_fn;       // Term handler, or NULL for a native entry
+  OmniFFIPrepareFn prepare;    // Async stages of a term entry (all or none)
+  OmniFFIRunFn run;
+  OmniFFIFinishFn finish;
+  OmniFFIStartFn start;        // Optional: run without a worker
+  void *fn_ptr;                // Native function pointer
+  OmniFFICallType call_type;   // Native signature
+  struct OmniFFISig *sig;      // With OMNI_FFI_SIGNATURE
+  OmniOwnership result_ownership;
+  u32 result_type_id;
+  int internal;                // Runtime plumbing, left out of -s call counts
+} OmniFFIEntry;
+
+#define OMNI_FFI_TABLE_SIZE  4096                              // Entries, < 65536
+#define OMNI_FFI_PAGE_BITS   12
+#define OMNI_FFI_PAGE_SIZE   (1u << OMNI_FFI_PAGE_BITS)
+#define OMNI_FFI_DIR_SIZE    (1u << (24 - OMNI_FFI_PAGE_BITS))
+
+static OmniFFIEntry OMNI_FFI_TABLE[OMNI_FFI_TABLE_SIZE];
+static u32 OMNI_FFI_TABLE_COUNT = 0;
+static u16 *OMNI_FFI_DIR[OMNI_FFI_DIR_SIZE];                   // Pages of entry index + 1
+static pthread_mutex_t OMNI_FFI_TABLE_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+// =============================================================================
+// Registration
+// =============================================================================
+
+// Publish a copy of e under e->name_nick; returns 0 if the table is full
+fn int omni_ffi_registry_add(const OmniFFIEntry *e) {
+  u32 nick = e->name_nick & 0xFFFFFF;
+  int ok = 0;
+
+  pthread_mutex_lock(&OMNI_FFI_TABLE_LOCK);
+  u16 *page = OMNI_FFI_DIR[nick >> OMNI_FFI_PAGE_BITS];
+  if (!page) {
+    page = (u16*)calloc(OMNI_FFI_PAGE_SIZE, sizeof(u16));
+    if (page) __atomic_store_n(&OMNI_FFI_DIR[nick >> OMNI_FFI_PAGE_BITS], page, __ATOMIC_RELEASE);
+  }
+  if (page && OMNI_FFI_TABLE_COUNT < OMNI_FFI_TABLE_SIZE) {
+    u32 idx = OMNI_FFI_TABLE_COUNT++;
+    OMNI_FFI_TABLE[idx] = *e;
+    OMNI_FFI_TABLE[idx].name_nick = nick;
+    __atomic_store_n(&page[nick & (OMNI_FFI_PAGE_SIZE - 1)], (u16)(idx + 1), __ATOMIC_RELEASE);
+    ok = 1;
+  }
+  pthread_mutex_unlock(&OMNI_FFI_TABLE_LOCK);
+  return ok;
+}
+
+// Overwrite the entry published under e->name_nick, keeping its slot; *old
+// gets what it held. Returns 0, changing nothing, if the nick has no entry.
+fn int omni_ffi_registry_replace(const OmniFFIEntry *e, OmniFFIEntry *old) {
+  u32 nick = e->name_nick & 0xFFFFFF;
+  int ok = 0;
+
+  pthread_mutex_lock(&OMNI_FFI_TABLE_LOCK);
+  u16 *page = OMNI_FFI_DIR[nick >> OMNI_FFI_PAGE_BITS];
+  u16 slot = page ? page[nick & (OMNI_FFI_PAGE_SIZE - 1)] : 0;
+  if (slot) {
+    *old = OMNI_FFI_TABLE[slot - 1];
+    OMNI_FFI_TABLE[slot - 1] = *e;
+    OMNI_FFI_TABLE[slot - 1].name_nick = nick;
+    ok = 1;
+  }
+  pthread_mutex_unlock(&OMNI_FFI_TABLE_LOCK);
+  return ok;
+}
+
+// Number of entries so far, to undo later registrations with
+// omni_ffi_registry_truncate
+fn u32 omni_ffi_registry_mark(void) {
+  pthread_mutex_lock(&OMNI_FFI_TABLE_LOCK);
+  u32 mark = OMNI_FFI_TABLE_COUNT;
+  pthread_mutex_unlock(&OMNI_FFI_TABLE_LOCK);
+  return mark;
+}
+
+// Drop the entries added since mark: a name they took over points back to
+// the entry it had before, a new name is gone. Entries rewritten in place
+// keep their new contents. Nothing may be reducing when this runs.
+fn void omni_ffi_registry_truncate(u32 mark) {
+  pthread_mutex_lock(&OMNI_FFI_TABLE_LOCK);
+  while (OMNI_FFI_TABLE_COUNT > mark) {
+    u32 idx = --OMNI_FFI_TABLE_COUNT;
+    OmniFFIEntry *e = &OMNI_FFI_TABLE[idx];
+    u16 *page = OMNI_FFI_DIR[e->name_nick >> OMNI_FFI_PAGE_BITS];
+    u16 *slot = &page[e->name_nick & (OMNI_FFI_PAGE_SIZE - 1)];
+    if (*slot == idx + 1) {
+      u16 prev = 0;
+      for (u32 i = idx; i-- > 0;) {
+        if (OMNI_FFI_TABLE[i].name_nick == e->name_nick) {
+          prev = (u16)(i + 1);
+          break;
+        }
+      }
+      __atomic_store_n(slot, prev, __ATOMIC_RELEASE);
+    }
+    if (e->call_type == OMNI_FFI_SIGNATURE) free(e->sig);
+    memset(e, 0, sizeof(*e));
+  }
+  pthread_mutex_unlock(&OMNI_FFI_TABLE_LOCK);
+}
+
+// Register a native C function
+fn void omni_ffi_register(
+  const char *name,
+  void *fn_ptr,
+  OmniFFICallType call_type,
+  OmniOwnership result_ownership,
+  u32 result_type_id
+) {
+  OmniFFIEntry e = {
+    .name_nick        = omni_nick(name),
+    .fn_ptr           = fn_ptr,
+    .call_type        = call_type,
+    .result_ownership = result_ownership,
+    .result_type_id   = result_type_id,
+  };
+  omni_ffi_registry_add(&e);
+}
+
+// Register a term handler under an already computed nick (OMNI_NAM_*)
+fn void omni_ffi_register_term(u32 name_nick, OmniFFITermFn term_fn) {
+  OmniFFIEntry e = {
+    .name_nick = name_nick,
+    .term_fn   = term_fn,
+  };
+  omni_ffi_registry_add(&e);
+}
+
+// Register a term handler the runtime itself calls (book lookup, profiler
+// and spark hooks, scope brackets); -s does not count or time it
+fn void omni_ffi_register_internal(u32 name_nick, OmniFFITermFn term_fn) {
+  OmniFFIEntry e = {
+    .name_nick = name_nick,
+    .term_fn   = term_fn,
+    .internal  = 1,
+  };
+  omni_ffi_registry_add(&e);
+}
+
+// Register a term handler that can also run on an FFI worker
+fn void omni_ffi_register_staged(
+  u32 name_nick,
+  OmniFFITermFn term_fn,
+  OmniFFIPrepareFn prepare,
+  OmniFFIRunFn run,
+  OmniFFIFinishFn finish
+) {
+  OmniFFIEntry e = {
+    .name_nick = name_nick,
+    .term_fn   = term_fn,
+    .prepare   = prepare,
+    .run       = run,
+    .finish    = finish,
+  };
+  omni_ffi_registry_add(&e);
+}
+
+// Forward declaration (defined below)
+fn OmniFFIEntry* omni_ffi_lookup(u32 name_nick);
+
+// Add a start stage to the staged entry under name_nick (publishes a copy)
+fn void omni_ffi_register_start(u32 name_nick, OmniFFIStartFn start) {
+  OmniFFIEntry *old = omni_ffi_lookup(name_nick);
+  if (!old || !old->prepare) return;
+  OmniFFIEntry e = *old;
+  e.start = start;
+  omni_ffi_registry_add(&e);
+}
+
+// =============================================================================
+// Lookup
+// =============================================================================
+
+// Entry registered under name_nick, or NULL
+fn OmniFFIEntry* omni_ffi_lookup(u32 name_nick) {
+  if (name_nick > 0xFFFFFF) return NULL;
+  u16 *page = __atomic_load_n(&OMNI_FFI_DIR[name_nick >> OMNI_FFI_PAGE_BITS], __ATOMIC_ACQUIRE);
+  if (!page) return NULL;
+  u16 slot = __atomic_load_n(&page[name_nick & (OMNI_FFI_PAGE_SIZE - 1)], __ATOMIC_ACQUIRE);
+  return slot ? &OMNI_FFI_TABLE[slot - 1] : NULL;
+}
@@ -0,0 +1,697 @@
+// OmniLisp FFI Signatures
+// Native calls declared with a C signature: "f64(f64, f64)", "ptr(cstr, cstr)"
+//
+// omni_ffi_register_sig takes a C function and its signature as text:
+//   ret(arg, arg, ...)
+// with types
+//   void                  return only
+//   i8 i16 i32 i64        signed integers
+//   u8 u16 u32 u64        unsigned integers
+//   f32 f64               floating point
+//   ptr                   #Hndl, #Ptr, or nothing/0 for NULL
+//   cstr                  a string (copied for the call) or a pointer
+//   {t, t, ...}           struct of scalar fields, by value, up to 16 bytes
+//   buf                   a #Buf (buffer.c) as pointer and length, in two
+//                         integer registers; returned as {ptr, u64}
+//
+// The signature is parsed once, at registration. Each argument is assigned
+// to integer or floating-point registers the way the SysV x86-64 ABI does
+// (structs by eightbyte), and the call goes through one of a few
+// pre-generated thunks, chosen by the class of the return value. A thunk
+// calls the function as if it took all six integer and eight vector
+// argument registers: the integer and vector registers are allocated
+// independently, so the prototype only has to agree on each register, and
+// a callee ignores the ones it does not use. An f32 travels in the low half
+// of a double register.
+//
+// Arguments are converted from Terms by declared type (#Cst, #Fix, strings,
+// handles, lists for structs); one that does not fit makes the call return
+// #Err{EINVAL} instead of being dropped. Results come back as #Cst (or #Fix
+// when they do not fit in 32 bits), #Fix for floats, handles for pointers,
+// lists for structs. #Fix holds a signed 64-bit mantissa, so a u64 at or
+// above 2^63 comes back as #Err{ERANGE} rather than as a negative number.
+//
+// Scalar signatures need x86-64 or AArch64, whose calling conventions both
+// work this way; structs by value need x86-64. More register arguments
+// than the ABI has (a stack argument) fail registration.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// Types
+// =============================================================================
+
+#define OMNI_FFI_SIG_MAX_ARGS   14   // 6 integer + 8 vector registers
+#define OMNI_FFI_SIG_INT_REGS   6
+#define OMNI_FFI_SIG_SSE_REGS   8
+#define OMNI_FFI_STRUCT_FIELDS  16
+
+typedef enum {
+  OMNI_FFI_T_VOID = 0,
+  OMNI_FFI_T_I8,
+  OMNI_FFI_T_I16,
+  OMNI_FFI_T_I32,
+  OMNI_FFI_T_I64,
+  OMNI_FFI_T_U8,
+  OMNI_FFI_T_U16,
+  OMNI_FFI_T_U32,
+  OMNI_FFI_T_U64,
+  OMNI_FFI_T_F32,
+  OMNI_FFI_T_F64,
+  OMNI_FFI_T_PTR,
+  OMNI_FFI_T_CSTR,
+  OMNI_FFI_T_STRUCT,
+  OMNI_FFI_T_BUF,
+} OmniFFIType;
+
+// Register class of an eightbyte
+#define OMNI_FFI_CLASS_INT 0
+#define OMNI_FFI_CLASS_SSE 1
+
+typedef struct {
+  u8 type;                              // OmniFFIType
+  u8 size;                              // Bytes
+  u8 nfields;                           // Struct fields
+  u8 words;                             // Eightbytes (1 or 2)
+  u8 classes[2];                        // OMNI_FFI_CLASS_* per eightbyte
+  u8 fields[OMNI_FFI_STRUCT_FIELDS];    // Scalar field types
+  u8 offsets[OMNI_FFI_STRUCT_FIELDS];
+} OmniFFITypeDesc;
+
+// Return classes, one thunk each
+typedef enum {
+  OMNI_FFI_RET_VOID = 0,
+  OMNI_FFI_RET_I,                       // rax
+  OMNI_FFI_RET_D,                       // xmm0
+  OMNI_FFI_RET_II,                      // rax, rdx
+  OMNI_FFI_RET_DD,                      // xmm0, xmm1
+  OMNI_FFI_RET_ID,                      // rax, xmm0
+  OMNI_FFI_RET_DI,                      // xmm0, rax
+} OmniFFIRetClass;
+
+struct OmniFFISig {
+  OmniFFITypeDesc ret;
+  OmniFFITypeDesc args[OMNI_FFI_SIG_MAX_ARGS];
+  u8 nargs;
+  u8 ret_class;                         // OmniFFIRetClass
+};
+typedef struct OmniFFISig OmniFFISig;
+
+// Argument registers and result of one call; strings copied for the call
+// are freed with the frame, buffers passed to it released
+typedef struct {
+  u64      iv[OMNI_FFI_SIG_INT_REGS];
+  double   dv[OMNI_FFI_SIG_SSE_REGS];
+  u64      ret[2];
+  char    *temps[OMNI_FFI_SIG_MAX_ARGS];
+  u32      ntemps;
+  OmniBuf *bufs[OMNI_FFI_SIG_INT_REGS / 2];
+  u32      nbufs;
+} OmniFFIFrame;
+
+fn u8 omni_ffi_type_size(u8 t) {
+  switch (t) {
+    case OMNI_FFI_T_I8:  case OMNI_FFI_T_U8:  return 1;
+    case OMNI_FFI_T_I16: case OMNI_FFI_T_U16: return 2;
+    case OMNI_FFI_T_I32: case OMNI_FFI_T_U32: case OMNI_FFI_T_F32: return 4;
+    case OMNI_FFI_T_VOID: return 0;
+    default: return 8;
+  }
+}
+
+fn int omni_ffi_type_is_float(u8 t) {
+  return t == OMNI_FFI_T_F32 || t == OMNI_FFI_T_F64;
+}
+
+// =============================================================================
+// Signature Parsing
+// =============================================================================
+
+fn void omni_ffi_sig_skip(const char **p) {
+  while (isspace((unsigned char)**p)) (*p)++;
+}
+
+// Scalar type name at *p; returns 0 and leaves *p if there is none
+fn int omni_ffi_sig_scalar(const char **p, u8 *out) {
+  static const struct { const char *name; u8 type; } names[] = {
+    {"void", OMNI_FFI_T_VOID}, {"i8", OMNI_FFI_T_I8}, {"i16", OMNI_FFI_T_I16},
+    {"i32", OMNI_FFI_T_I32}, {"i64", OMNI_FFI_T_I64}, {"u8", OMNI_FFI_T_U8},
+    {"u16", OMNI_FFI_T_U16}, {"u32", OMNI_FFI_T_U32}, {"u64", OMNI_FFI_T_U64},
+    {"f32", OMNI_FFI_T_F32}, {"f64", OMNI_FFI_T_F64}, {"ptr", OMNI_FFI_T_PTR},
+    {"cstr", OMNI_FFI_T_CSTR}, {"buf", OMNI_FFI_T_BUF},
+  };
+  omni_ffi_sig_skip(p);
+  size_t len = 0;
+  while (isalnum((unsigned char)(*p)[len])) len++;
+  for (u32 i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strlen(names[i].name) == len && strncmp(*p, names[i].name, len) == 0) {
+      *p += len;
+      *out = names[i].type;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Lay out a struct's fields and classify its eightbytes
+fn int omni_ffi_sig_layout(OmniFFITypeDesc *d) {
+  u32 off = 0, align = 1;
+  for (u32 i = 0; i < d->nfields; i++) {
+    u8 t = d->fields[i];
+    u32 sz = omni_ffi_type_size(t);
+    if (t == OMNI_FFI_T_VOID) return 0;
+    off = (off + sz - 1) & ~(sz - 1);
+    d->offsets[i] = (u8)off;
+    off += sz;
+    if (sz > align) align = sz;
+    if (off > 16) return 0;                     // Passed in memory: unsupported
+  }
+  d->size = (u8)((off + align - 1) & ~(align - 1));
+  d->words = d->size > 8 ? 2 : 1;
+  // An eightbyte is SSE only if every field in it is floating point
+  d->classes[0] = d->classes[1] = OMNI_FFI_CLASS_SSE;
+  for (u32 i = 0; i < d->nfields; i++) {
+    if (!omni_ffi_type_is_float(d->fields[i])) d->classes[d->offsets[i] / 8] = OMNI_FFI_CLASS_INT;
+  }
+  return d->size > 0;
+}
+
+// One type (scalar or struct) at *p
+fn int omni_ffi_sig_type(const char **p, OmniFFITypeDesc *d) {
+  memset(d, 0, sizeof(*d));
+  omni_ffi_sig_skip(p);
+  if (**p != '{') {
+    if (!omni_ffi_sig_scalar(p, &d->type)) return 0;
+    if (d->type == OMNI_FFI_T_BUF) {
+      d->size = 16;                             // Same registers as {ptr, u64}
+      d->words = 2;
+      d->classes[0] = d->classes[1] = OMNI_FFI_CLASS_INT;
+      return 1;
+    }
+    d->size = omni_ffi_type_size(d->type);
+    d->words = 1;
+    d->classes[0] = omni_ffi_type_is_float(d->type) ? OMNI_FFI_CLASS_SSE : OMNI_FFI_CLASS_INT;
+    return 1;
+  }
+
+#if !defined(__x86_64__)
+  return 0;                                     // Struct classification is SysV x86-64
+#endif
+  (*p)++;
+  d->type = OMNI_FFI_T_STRUCT;
+  for (;;) {
+    u8 t;
+    if (d->nfields == OMNI_FFI_STRUCT_FIELDS || !omni_ffi_sig_scalar(p, &t)) return 0;
+    if (t == OMNI_FFI_T_BUF) return 0;
+    if (t == OMNI_FFI_T_CSTR) t = OMNI_FFI_T_PTR;
+    d->fields[d->nfields++] = t;
+    omni_ffi_sig_skip(p);
+    if (**p == '}') break;
+    if (**p != ',') return 0;
+    (*p)++;
+  }
+  (*p)++;
+  return omni_ffi_sig_layout(d);
+}
+
+fn int omni_ffi_sig_ret_class(const OmniFFITypeDesc *d) {
+  if (d->type == OMNI_FFI_T_VOID) return OMNI_FFI_RET_VOID;
+  int c0 = d->classes[0] == OMNI_FFI_CLASS_SSE;
+  if (d->words == 1) return c0 ? OMNI_FFI_RET_D : OMNI_FFI_RET_I;
+  int c1 = d->classes[1] == OMNI_FFI_CLASS_SSE;
+  if (c0) return c1 ? OMNI_FFI_RET_DD : OMNI_FFI_RET_DI;
+  return c1 ? OMNI_FFI_RET_ID : OMNI_FFI_RET_II;
+}
+
+// Parse "ret(arg, ...)"; returns 0 for a malformed or unsupported signature
+fn int omni_ffi_sig_parse(const char *text, OmniFFISig *sig) {
+#if !defined(__x86_64__) && !defined(__aarch64__)
+  (void)text;
+  (void)sig;
+  return 0;
+#else
+  memset(sig, 0, sizeof(*sig));
+  const char *p = text;
+  if (!omni_ffi_sig_type(&p, &sig->ret)) return 0;
+  omni_ffi_sig_skip(&p);
+  if (*p++ != '(') return 0;
+
+  u32 ints = 0, sses = 0;
+  omni_ffi_sig_skip(&p);
+  if (*p == ')') {
+    p++;
+  } else {
+    for (;;) {
+      if (sig->nargs == OMNI_FFI_SIG_MAX_ARGS) return 0;
+      OmniFFITypeDesc *a = &sig->args[sig->nargs++];
+      if (!omni_ffi_sig_type(&p, a) || a->type == OMNI_FFI_T_VOID) {
+        // "void" alone is an empty list
+        if (sig->nargs == 1 && a->type == OMNI_FFI_T_VOID) {
+          sig->nargs = 0;
+          omni_ffi_sig_skip(&p);
+          if (*p++ != ')') return 0;
+          break;
+        }
+        return 0;
+      }
+      for (u32 w = 0; w < a->words; w++) {
+        if (a->classes[w] == OMNI_FFI_CLASS_SSE) sses++;
+        else ints++;
+      }
+      omni_ffi_sig_skip(&p);
+      if (*p == ')') {
+        p++;
+        break;
+      }
+      if (*p++ != ',') return 0;
+    }
+  }
+  omni_ffi_sig_skip(&p);
+  if (*p != '\0') return 0;
+  if (ints > OMNI_FFI_SIG_INT_REGS || sses > OMNI_FFI_SIG_SSE_REGS) return 0;
+
+  sig->ret_class = (u8)omni_ffi_sig_ret_class(&sig->ret);
+  return 1;
+#endif
+}
+
+// =============================================================================
+// Thunks
+// =============================================================================
+
+#define OMNI_FFI_REGS \
+  u64, u64, u64, u64, u64, u64, \
+  double, double, double, double, double, double, double, double
+#define OMNI_FFI_PASS(f) \
+  (f)->iv[0], (f)->iv[1], (f)->iv[2], (f)->iv[3], (f)->iv[4], (f)->iv[5], \
+  (f)->dv[0], (f)->dv[1], (f)->dv[2], (f)->dv[3], \
+  (f)->dv[4], (f)->dv[5], (f)->dv[6], (f)->dv[7]
+
+typedef struct { u64 a; u64 b; } OmniFFIRetII;
+typedef struct { double a; double b; } OmniFFIRetDD;
+typedef struct { u64 a; double b; } OmniFFIRetID;
+typedef struct { double a; u64 b; } OmniFFIRetDI;
+
+typedef void (*OmniFFIThunk)(void *fn_ptr, OmniFFIFrame *f);
+
+fn void omni_ffi_thunk_void(void *fp, OmniFFIFrame *f) {
+  ((void (*)(OMNI_FFI_REGS))fp)(OMNI_FFI_PASS(f));
+}
+
+fn void omni_ffi_thunk_i(void *fp, OmniFFIFrame *f) {
+  f->ret[0] = ((u64 (*)(OMNI_FFI_REGS))fp)(OMNI_FFI_PASS(f));
+}
+
+fn void omni_ffi_thunk_d(void *fp, OmniFFIFrame *f) {
+  double r = ((double (*)(OMNI_FFI_REGS))fp)(OMNI_FFI_PASS(f));
+  memcpy(&f->ret[0], &r, 8);
+}
+
+fn void omni_ffi_thunk_ii(void *fp, OmniFFIFrame *f) {
+  OmniFFIRetII r = ((OmniFFIRetII (*)(OMNI_FFI_REGS))fp)(OMNI_FFI_PASS(f));
+  f->ret[0] = r.a;
+  f->ret[1] = r.b;
+}
+
+fn void omni_ffi_thunk_dd(void *fp, OmniFFIFrame *f) {
+  OmniFFIRetDD r = ((OmniFFIRetDD (*)(OMNI_FFI_REGS))fp)(OMNI_FFI_PASS(f));
+  memcpy(&f->ret[0], &r.a, 8);
+  memcpy(&f->ret[1], &r.b, 8);
+}
+
+fn void omni_ffi_thunk_id(void *fp, OmniFFIFrame *f) {
+  OmniFFIRetID r = ((OmniFFIRetID (*)(OMNI_FFI_REGS))fp)(OMNI_FFI_PASS(f));
+  f->ret[0] = r.a;
+  memcpy(&f->ret[1], &r.b, 8);
+}
+
+fn void omni_ffi_thunk_di(void *fp, OmniFFIFrame *f) {
+  OmniFFIRetDI r = ((OmniFFIRetDI (*)(OMNI_FFI_REGS))fp)(OMNI_FFI_PASS(f));
+  memcpy(&f->ret[0], &r.a, 8);
+  f->ret[1] = r.b;
+}
+
+// Indexed by OmniFFIRetClass
+static const OmniFFIThunk OMNI_FFI_THUNKS[] = {
+  omni_ffi_thunk_void,
+  omni_ffi_thunk_i,
+  omni_ffi_thunk_d,
+  omni_ffi_thunk_ii,
+  omni_ffi_thunk_dd,
+  omni_ffi_thunk_id,
+  omni_ffi_thunk_di,
+};
+
+// Call fn_ptr with a marshalled frame; f->ret holds the result registers.
+// Touches no heap, so it runs on FFI workers.
+fn void omni_ffi_sig_invoke(const OmniFFISig *sig, void *fn_ptr, OmniFFIFrame *f) {
+  OMNI_FFI_THUNKS[sig->ret_class](fn_ptr, f);
+}
+
+// =============================================================================
+// Arguments
+// =============================================================================
+
+// Numeric value of a reduced term: NUM, #Cst/#Lit, #Fix, #True/#Fals
+fn int omni_ffi_term_number(Term t, int64_t *iv, double *dv) {
+  u8 tag = term_tag(t);
+  if (tag == NUM) {
+    *iv = term_val(t);
+    *dv = (double)*iv;
+    return 1;
+  }
+  u32 ext = term_ext(t);
+  if (tag == C01 && (ext == OMNI_NAM_CST || ext == OMNI_NAM_LIT)) {
+    return omni_ffi_term_number(wnf(HEAP[term_val(t)]), iv, dv);
+  }
+  if (tag == C03 && ext == OMNI_NAM_FIX) {
+    u32 loc = term_val(t);
+    u64 hi = term_val(wnf(HEAP[loc]));
+    u64 lo = term_val(wnf(HEAP[loc + 1]));
+    u32 scale = term_val(wnf(HEAP[loc + 2]));
+    int64_t m = (int64_t)((hi << 32) | lo);
+    int64_t div = 1;
+    for (u32 i = 0; i < scale && i < 18; i++) div *= 10;
+    *iv = m / div;
+    *dv = (double)m / (double)div;
+    return 1;
+  }
+  if (tag == C00 && (ext == OMNI_NAM_TRUE || ext == OMNI_NAM_FALS)) {
+    *iv = ext == OMNI_NAM_TRUE;
+    *dv = (double)*iv;
+    return 1;
+  }
+  return 0;
+}
+
+// Pointer value of a reduced term: #Hndl, #Ptr, nothing, 0
+fn int omni_ffi_term_pointer(Term t, void **out) {
+  u8 tag = term_tag(t);
+  u32 ext = term_ext(t);
+  if (tag == C01 && ext == OMNI_NAM_HNDL) {
+    *out = omni_ffi_handle_borrow(t);
+    return *out != NULL;
+  }
+  if (tag == C02 && ext == OMNI_NAM_PTR) {
+    *out = omni_ffi_ptr_unwrap(t);
+    return 1;
+  }
+  if (tag == C00 && ext == OMNI_NAM_NOTH) {
+    *out = NULL;
+    return 1;
+  }
+  int64_t iv;
+  double dv;
+  if (omni_ffi_term_number(t, &iv, &dv) && iv == 0) {
+    *out = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+// Scalar of type t, as raw bits (integers extended to 64, f32 in the low half)
+fn int omni_ffi_marshal_scalar(u8 t, Term v, OmniFFIFrame *f, u64 *bits) {
+  int64_t iv;
+  double dv;
+  void *p;
+
+  switch (t) {
+    case OMNI_FFI_T_F32: {
+      if (!omni_ffi_term_number(v, &iv, &dv)) return 0;
+      float x = (float)dv;
+      u32 b;
+      memcpy(&b, &x, 4);
+      *bits = b;
+      return 1;
+    }
+    case OMNI_FFI_T_F64:
+      if (!omni_ffi_term_number(v, &iv, &dv)) return 0;
+      memcpy(bits, &dv, 8);
+      return 1;
+    case OMNI_FFI_T_CSTR:
+      if ((term_tag(v) == C02 && term_ext(v) == NAM_CON) || omni_pstr_is(v)) {
+        char *s = omni_list_to_cstr(v);
+        if (!s) return 0;
+        f->temps[f->ntemps++] = s;
+        *bits = (u64)(uintptr_t)s;
+        return 1;
+      }
+      if (term_tag(v) == C00 && term_ext(v) == NAM_NIL) {
+        char *s = (char*)calloc(1, 1);
+        if (!s) return 0;
+        f->temps[f->ntemps++] = s;
+        *bits = (u64)(uintptr_t)s;
+        return 1;
+      }
+      // Fall through: a pointer to a C string
+    case OMNI_FFI_T_PTR:
+      if (!omni_ffi_term_pointer(v, &p)) return 0;
+      *bits = (u64)(uintptr_t)p;
+      return 1;
+    default:
+      if (!omni_ffi_term_number(v, &iv, &dv)) return 0;
+      switch (t) {
+        case OMNI_FFI_T_I8:  *bits = (u64)(int64_t)(int8_t)iv;  break;
+        case OMNI_FFI_T_I16: *bits = (u64)(int64_t)(int16_t)iv; break;
+        case OMNI_FFI_T_I32: *bits = (u64)(int64_t)(int32_t)iv; break;
+        case OMNI_FFI_T_U8:  *bits = (u8)iv;  break;
+        case OMNI_FFI_T_U16: *bits = (u16)iv; break;
+        case OMNI_FFI_T_U32: *bits = (u32)iv; break;
+        default:             *bits = (u64)iv; break;
+      }
+      return 1;
+  }
+}
+
+fn void omni_ffi_frame_free(OmniFFIFrame *f) {
+  for (u32 i = 0; i < f->ntemps; i++) free(f->temps[i]);
+  for (u32 i = 0; i < f->nbufs; i++) omni_buf_release(f->bufs[i]);
+  f->ntemps = 0;
+  f->nbufs = 0;
+}
+
+// Fill f from a reduced args list; returns 0 or an errno value
+fn int omni_ffi_sig_marshal(const OmniFFISig *sig, Term args_list, OmniFFIFrame *f) {
+  memset(f, 0, sizeof(*f));
+  u32 ni = 0, nd = 0;
+  Term cur = args_list;
+
+  for (u32 i = 0; i < sig->nargs; i++) {
+    if (term_tag(cur) != C02 || term_ext(cur) != NAM_CON) return EINVAL;
+    u32 loc = term_val(cur);
+    Term v = wnf(HEAP[loc]);
+    cur = wnf(HEAP[loc + 1]);
+    const OmniFFITypeDesc *a = &sig->args[i];
+
+    u64 words[2] = {0, 0};
+    if (a->type == OMNI_FFI_T_BUF) {
+      // Held until the frame is freed, so the call sees live bytes
+      OmniBuf *b = omni_buf_acquire(v);
+      if (!b) return EINVAL;
+      f->bufs[f->nbufs++] = b;
+      words[0] = (u64)(uintptr_t)b->data;
+      words[1] = (u64)b->len;
+    } else if (a->type != OMNI_FFI_T_STRUCT) {
+      if (!omni_ffi_marshal_scalar(a->type, v, f, &words[0])) return EINVAL;
+    } else {
+      // Fields from a list, packed at their offsets
+      u8 bytes[16] = {0};
+      for (u32 k = 0; k < a->nfields; k++) {
+        if (term_tag(v) != C02 || term_ext(v) != NAM_CON) return EINVAL;
+        u64 b;
+        if (!omni_ffi_marshal_scalar(a->fields[k], wnf(HEAP[term_val(v)]), f, &b)) return EINVAL;
+        memcpy(bytes + a->offsets[k], &b, omni_ffi_type_size(a->fields[k]));
+        v = wnf(HEAP[term_val(v) + 1]);
+      }
+      memcpy(words, bytes, 16);
+    }
+
+    for (u32 w = 0; w < a->words; w++) {
+      if (a->classes[w] == OMNI_FFI_CLASS_SSE) memcpy(&f->dv[nd++], &words[w], 8);
+      else f->iv[ni++] = words[w];
+    }
+  }
+  return 0;
+}
+
+// =============================================================================
+// Results
+// =============================================================================
+
+// Integer as #Cst{n}, or #Fix{hi, lo, 0} outside 0..2^32-1
+fn Term omni_ffi_int_term(int64_t v) {
+  if (v >= 0 && v <= 0xFFFFFFFFLL) {
+    Term n = term_new_num((u32)v);
+    return term_new_ctr(OMNI_NAM_CST, 1, &n);
+  }
+  Term args[3] = {
+    term_new_num((u32)((u64)v >> 32)),
+    term_new_num((u32)((u64)v & 0xFFFFFFFF)),
+    term_new_num(0),
+  };
+  return term_new_ctr(OMNI_NAM_FIX, 3, args);
+}
+
+// Unsigned integer as omni_ffi_int_term does; #Err{ERANGE} from 2^63 up,
+// where the #Fix mantissa would read it as negative
+fn Term omni_ffi_uint_term(u64 v) {
+  if (v > (u64)INT64_MAX) {
+    Term err_args[1] = {term_new_num(ERANGE)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  }
+  return omni_ffi_int_term((int64_t)v);
+}
+
+// Double as #Fix with up to 9 decimals, trailing zeros dropped
+fn Term omni_ffi_float_term(double d) {
+  if (isnan(d) || isinf(d)) {
+    Term err_args[1] = {term_new_num(EDOM)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  }
+  u32 scale = 9;
+  double m = d * 1e9;
+  while (scale > 0 && fabs(m) >= 9.2e18) {
+    m /= 10;
+    scale--;
+  }
+  if (fabs(m) >= 9.2e18) {
+    Term err_args[1] = {term_new_num(ERANGE)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  }
+  int64_t mant = llround(m);
+  while (scale > 0 && mant % 10 == 0) {
+    mant /= 10;
+    scale--;
+  }
+  Term args[3] = {
+    term_new_num((u32)((u64)mant >> 32)),
+    term_new_num((u32)((u64)mant & 0xFFFFFFFF)),
+    term_new_num(scale),
+  };
+  return term_new_ctr(OMNI_NAM_FIX, 3, args);
+}
+
+// Scalar of type t from raw bits
+fn Term omni_ffi_scalar_term(u8 t, u64 bits, OmniOwnership ownership, u32 type_id) {
+  switch (t) {
+    case OMNI_FFI_T_I8:  return omni_ffi_int_term((int8_t)bits);
+    case OMNI_FFI_T_I16: return omni_ffi_int_term((int16_t)bits);
+    case OMNI_FFI_T_I32: return omni_ffi_int_term((int32_t)bits);
+    case OMNI_FFI_T_I64: return omni_ffi_int_term((int64_t)bits);
+    case OMNI_FFI_T_U8:  return omni_ffi_int_term((u8)bits);
+    case OMNI_FFI_T_U16: return omni_ffi_int_term((u16)bits);
+    case OMNI_FFI_T_U32: return omni_ffi_int_term((u32)bits);
+    case OMNI_FFI_T_U64: return omni_ffi_uint_term(bits);
+    case OMNI_FFI_T_F32: {
+      float x;
+      u32 b = (u32)bits;
+      memcpy(&x, &b, 4);
+      return omni_ffi_float_term(x);
+    }
+    case OMNI_FFI_T_F64: {
+      double x;
+      memcpy(&x, &bits, 8);
+      return omni_ffi_float_term(x);
+    }
+    case OMNI_FFI_T_CSTR:
+      if (bits == 0) return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+      return omni_cstr_to_list((const char*)(uintptr_t)bits);
+    case OMNI_FFI_T_PTR:
+      if (bits == 0) return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+      return omni_ffi_handle_alloc((void*)(uintptr_t)bits, ownership, type_id);
+    default:
+      return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+  }
+}
+
+// Result Term of a finished call; frees the frame's copies
+fn Term omni_ffi_sig_result(const OmniFFISig *sig, OmniFFIFrame *f,
+                            OmniOwnership ownership, u32 type_id) {
+  omni_ffi_frame_free(f);
+  const OmniFFITypeDesc *r = &sig->ret;
+  if (r->type == OMNI_FFI_T_BUF) {
+    // Wrapped where it lies; an owned result is the callee's malloc'd region
+    if (f->ret[0] == 0) return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+    void *data = (void*)(uintptr_t)f->ret[0];
+    return omni_buf_term(omni_buf_adopt(data, (size_t)f->ret[1], ownership == OMNI_OWNED));
+  }
+  if (r->type != OMNI_FFI_T_STRUCT) {
+    return omni_ffi_scalar_term(r->type, f->ret[0], ownership, type_id);
+  }
+
+  u8 bytes[16];
+  memcpy(bytes, f->ret, 16);
+  Term result = term_new_ctr(NAM_NIL, 0, NULL);
+  for (u32 k = r->nfields; k > 0; k--) {
+    u64 b = 0;
+    memcpy(&b, bytes + r->offsets[k - 1], omni_ffi_type_size(r->fields[k - 1]));
+    Term con_args[2] = {omni_ffi_scalar_term(r->fields[k - 1], b, OMNI_BORROWED, 0), result};
+    result = term_new_ctr(NAM_CON, 2, con_args);
+  }
+  return result;
+}
+
+// Marshal, call and convert on the calling thread
+fn Term omni_ffi_sig_call(const OmniFFIEntry *e, Term args_list) {
+  OmniFFIFrame f;
+  int err = omni_ffi_sig_marshal(e->sig, args_list, &f);
+  if (err) {
+    omni_ffi_frame_free(&f);
+    Term err_args[1] = {term_new_num(err)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  }
+  omni_ffi_sig_invoke(e->sig, e->fn_ptr, &f);
+  return omni_ffi_sig_result(e->sig, &f, e->result_ownership, e->result_type_id);
+}
+
+// =============================================================================
+// Registration
+// =============================================================================
+
+// Register a C function by signature; returns 0 if the signature is
+// malformed or not callable on this platform. A name already registered by
+// signature has its entry replaced in place.
+fn int omni_ffi_register_sig(
+  const char *name,
+  void *fn_ptr,
+  const char *signature,
+  OmniOwnership result_ownership,
+  u32 result_type_id
+) {
+  OmniFFISig *sig = (OmniFFISig*)malloc(sizeof(OmniFFISig));
+  if (!sig) return 0;
+  if (!omni_ffi_sig_parse(signature, sig)) {
+    free(sig);
+    return 0;
+  }
+  OmniFFIEntry e = {
+    .name_nick        = omni_nick(name),
+    .fn_ptr           = fn_ptr,
+    .call_type        = OMNI_FFI_SIGNATURE,
+    .sig              = sig,
+    .result_ownership = result_ownership,
+    .result_type_id   = result_type_id,
+  };
+
+  // A signature registered again takes over its entry and frees the old sig
+  OmniFFIEntry *cur = omni_ffi_lookup(e.name_nick);
+  OmniFFIEntry old;
+  if (cur && cur->call_type == OMNI_FFI_SIGNATURE && !cur->term_fn &&
+      omni_ffi_registry_replace(&e, &old)) {
+    free(old.sig);
+    return 1;
+  }
+  if (!omni_ffi_registry_add(&e)) {
+    free(sig);
+    return 0;
+  }
+  return 1;
+}
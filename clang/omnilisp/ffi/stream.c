@@ -0,0 +1,392 @@
+// OmniLisp File Streams
+// Buffered reader and writer handles over one open file descriptor
+//
+//   (open-writer path)        -> #Wrtr       truncate, or create
+//   (open-writer path "a")    -> #Wrtr       append
+//   (write! w x)              -> #True       x: string, packed string or #Buf
+//   (flush w)                 -> #True       write out what is buffered
+//   (open-reader path)        -> #Rdr
+//   (read-line r)             -> packed string without its "\n", #Noth at end
+//   (read-chunk r n)          -> #Buf of up to n bytes, #Noth at end
+//   (close s)                 -> #True       flush (writer) and close
+//
+// write-file and append-file open, write and close the file on every call.
+// A writer keeps the descriptor open and collects writes in a 64KB buffer,
+// so a loop writing a record per iteration makes one write(2) per buffer,
+// not three syscalls per record. Writes larger than the buffer go straight
+// to the file.
+//
+// A reader refills one 64KB buffer with read(2) and cuts lines and chunks
+// out of it. A line is copied once, into a packed string (pstring.c); a
+// chunk into a buffer (buffer.c). No char list is built: unpack-string
+// gives one when a line must be matched as a list.
+//
+// Streams are owned handles: close, with-handle-scope and exit flush and
+// close them. Each stream has a lock, so reducer threads may share one.
+// Errors come back as #Err{errno}. A buffered write! succeeds before its
+// bytes reach the file; a failure to write them is returned by the write!,
+// flush or close that writes the buffer out.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OMNI_STREAM_BUF_SIZE 65536
+
+// =============================================================================
+// Streams
+// =============================================================================
+
+typedef struct {
+  atomic_uint refs;
+  pthread_mutex_t lock;
+  int    fd;
+  int    eof;                  // Reader: read(2) returned 0
+  u8    *buf;
+  size_t cap;
+  size_t len;                  // Bytes in buf
+  size_t pos;                  // Reader: bytes of buf already returned
+} OmniStream;
+
+fn OmniStream* omni_stream_new(int fd) {
+  OmniStream *st = (OmniStream*)calloc(1, sizeof(OmniStream));
+  if (!st) return NULL;
+  st->buf = (u8*)malloc(OMNI_STREAM_BUF_SIZE);
+  if (!st->buf) {
+    free(st);
+    return NULL;
+  }
+  atomic_init(&st->refs, 1);
+  pthread_mutex_init(&st->lock, NULL);
+  st->fd = fd;
+  st->cap = OMNI_STREAM_BUF_SIZE;
+  return st;
+}
+
+// Write all len bytes at data; returns 0 or an errno value
+fn int omni_stream_write_fd(int fd, const u8 *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return errno;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+// Write out a writer's buffer (lock held); returns 0 or an errno value.
+// The buffer is emptied either way, so one failure is reported once.
+fn int omni_stream_flush_locked(OmniStream *st) {
+  int err = st->len > 0 ? omni_stream_write_fd(st->fd, st->buf, st->len) : 0;
+  st->len = 0;
+  return err;
+}
+
+// Flush (for writers) and close the descriptor; returns 0 or an errno value
+fn int omni_stream_close(OmniStream *st, int writing) {
+  pthread_mutex_lock(&st->lock);
+  int err = writing ? omni_stream_flush_locked(st) : 0;
+  if (st->fd >= 0 && close(st->fd) != 0 && !err) err = errno;
+  st->fd = -1;
+  pthread_mutex_unlock(&st->lock);
+  return err;
+}
+
+fn OmniStream* omni_stream_retain(OmniStream *st) {
+  atomic_fetch_add_explicit(&st->refs, 1, memory_order_relaxed);
+  return st;
+}
+
+// omni_stream_retain for omni_ffi_handle_acquire
+fn void* omni_stream_retain_ptr(void *st) {
+  return omni_stream_retain((OmniStream*)st);
+}
+
+fn void omni_stream_release(OmniStream *st) {
+  if (st && atomic_fetch_sub_explicit(&st->refs, 1, memory_order_acq_rel) == 1) {
+    pthread_mutex_destroy(&st->lock);
+    free(st->buf);
+    free(st);
+  }
+}
+
+// Handle table release hooks: a stream dropped without close is closed here
+fn void omni_stream_drop_writer(void *ptr) {
+  omni_stream_close((OmniStream*)ptr, 1);
+  omni_stream_release((OmniStream*)ptr);
+}
+
+fn void omni_stream_drop_reader(void *ptr) {
+  omni_stream_close((OmniStream*)ptr, 0);
+  omni_stream_release((OmniStream*)ptr);
+}
+
+// Refill a reader's buffer (lock held), keeping the unread bytes; grows it
+// when they already fill it. Returns 0 or an errno value.
+fn int omni_stream_fill_locked(OmniStream *st) {
+  if (st->pos > 0) {
+    memmove(st->buf, st->buf + st->pos, st->len - st->pos);
+    st->len -= st->pos;
+    st->pos = 0;
+  }
+  if (st->len == st->cap) {
+    u8 *grown = (u8*)realloc(st->buf, st->cap * 2);
+    if (!grown) return ENOMEM;
+    st->buf = grown;
+    st->cap *= 2;
+  }
+  for (;;) {
+    ssize_t n = read(st->fd, st->buf + st->len, st->cap - st->len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return errno;
+    if (n == 0) st->eof = 1;
+    st->len += (size_t)n;
+    return 0;
+  }
+}
+
+// =============================================================================
+// Terms
+// =============================================================================
+
+fn Term omni_stream_error(int err) {
+  Term err_args[1] = {term_new_num(err)};
+  return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+}
+
+fn Term omni_stream_status(int err) {
+  return err ? omni_stream_error(err) : term_new_ctr(OMNI_NAM_TRUE, 0, NULL);
+}
+
+// #Wrtr{#Hndl} or #Rdr{#Hndl} taking over the caller's reference to st
+fn Term omni_stream_term(OmniStream *st, u32 type) {
+  Term h = omni_ffi_handle_alloc(st, OMNI_OWNED, type);
+  if (term_ext(h) != OMNI_NAM_HNDL) {
+    omni_stream_close(st, 0);
+    omni_stream_release(st);
+    return h;
+  }
+  return term_new_ctr(type, 1, &h);
+}
+
+// Stream of a reduced #Wrtr or #Rdr (type), with a reference for the
+// caller; NULL if t is not a live stream of that type
+fn OmniStream* omni_stream_acquire(Term t, u32 type) {
+  if (term_tag(t) != C01 || term_ext(t) != type) return NULL;
+  Term h = wnf(HEAP[term_val(t)]);
+  return (OmniStream*)omni_ffi_handle_acquire(h, type, omni_stream_retain_ptr);
+}
+
+// Open path with flags into a new stream term of type
+fn Term omni_stream_open(Term path_term, int flags, u32 type) {
+  char *path = omni_list_to_cstr(path_term);
+  if (!path) return omni_stream_error(ENOMEM);
+  int fd = open(path, flags | O_CLOEXEC, 0644);
+  int err = fd < 0 ? errno : 0;
+  free(path);
+  if (err) return omni_stream_error(err);
+  OmniStream *st = omni_stream_new(fd);
+  if (!st) {
+    close(fd);
+    return omni_stream_error(ENOMEM);
+  }
+  return omni_stream_term(st, type);
+}
+
+// =============================================================================
+// FFI Wrappers
+// =============================================================================
+
+// (open-writer path [mode]): mode "a" appends
+fn Term omni_ffi_stream_open_writer(Term args) {
+  Term t[2];
+  u32 n = omni_buf_args(args, t, 2);
+  if (n < 1) return omni_stream_error(EINVAL);
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  if (n == 2) {
+    char *mode = omni_list_to_cstr(t[1]);
+    if (mode && mode[0] == 'a') flags = O_WRONLY | O_CREAT | O_APPEND;
+    free(mode);
+  }
+  return omni_stream_open(t[0], flags, OMNI_NAM_WRTR);
+}
+
+// (open-reader path)
+fn Term omni_ffi_stream_open_reader(Term args) {
+  Term path;
+  if (omni_buf_args(args, &path, 1) != 1) return omni_stream_error(EINVAL);
+  return omni_stream_open(path, O_RDONLY, OMNI_NAM_RDR);
+}
+
+// (write! w x): buffered; the bytes of a packed string or #Buf are copied
+// from their storage, a char list is encoded as UTF-8
+fn Term omni_ffi_stream_write(Term args) {
+  Term t[2];
+  if (omni_buf_args(args, t, 2) != 2) return omni_stream_error(EINVAL);
+  OmniStream *st = omni_stream_acquire(t[0], OMNI_NAM_WRTR);
+  if (!st) return omni_stream_error(EBADF);
+
+  OmniBuf *b = omni_buf_acquire(t[1]);
+  if (!b) {
+    Term x = t[1];
+    int is_list = (term_tag(x) == C02 && term_ext(x) == NAM_CON) ||
+                  (term_tag(x) == C00 && term_ext(x) == NAM_NIL);
+    b = is_list ? omni_buf_from_list(x) : NULL;
+  }
+  if (!b) {
+    omni_stream_release(st);
+    return omni_stream_error(EINVAL);
+  }
+
+  pthread_mutex_lock(&st->lock);
+  int err = st->fd < 0 ? EBADF : 0;
+  if (!err && st->len + b->len > st->cap) err = omni_stream_flush_locked(st);
+  if (!err && b->len >= st->cap) {
+    err = omni_stream_write_fd(st->fd, b->data, b->len);   // Too big to buffer
+  } else if (!err) {
+    memcpy(st->buf + st->len, b->data, b->len);
+    st->len += b->len;
+  }
+  pthread_mutex_unlock(&st->lock);
+
+  omni_buf_release(b);
+  omni_stream_release(st);
+  return omni_stream_status(err);
+}
+
+// (flush w)
+fn Term omni_ffi_stream_flush(Term args) {
+  Term t;
+  OmniStream *st = omni_buf_args(args, &t, 1) == 1 ? omni_stream_acquire(t, OMNI_NAM_WRTR) : NULL;
+  if (!st) return omni_stream_error(EBADF);
+  pthread_mutex_lock(&st->lock);
+  int err = st->fd < 0 ? EBADF : omni_stream_flush_locked(st);
+  pthread_mutex_unlock(&st->lock);
+  omni_stream_release(st);
+  return omni_stream_status(err);
+}
+
+// (close s): the handle is taken first, so a second close gets EBADF
+fn Term omni_ffi_stream_close(Term args) {
+  Term t;
+  if (omni_buf_args(args, &t, 1) != 1 || term_tag(t) != C01) return omni_stream_error(EBADF);
+  u32 type = term_ext(t);
+  if (type != OMNI_NAM_WRTR && type != OMNI_NAM_RDR) return omni_stream_error(EBADF);
+  OmniStream *st = (OmniStream*)omni_ffi_handle_take(wnf(HEAP[term_val(t)]), type);
+  if (!st) return omni_stream_error(EBADF);
+  int err = omni_stream_close(st, type == OMNI_NAM_WRTR);
+  omni_stream_release(st);
+  return omni_stream_status(err);
+}
+
+// (read-line r): the next line without "\n" or "\r\n"; a last line
+// without a newline is returned as is
+fn Term omni_ffi_stream_read_line(Term args) {
+  Term t;
+  OmniStream *st = omni_buf_args(args, &t, 1) == 1 ? omni_stream_acquire(t, OMNI_NAM_RDR) : NULL;
+  if (!st) return omni_stream_error(EBADF);
+
+  pthread_mutex_lock(&st->lock);
+  int err = st->fd < 0 ? EBADF : 0;
+  size_t scanned = 0;
+  u8 *nl = NULL;
+  while (!err) {
+    nl = (u8*)memchr(st->buf + st->pos + scanned, '\n', st->len - st->pos - scanned);
+    if (nl || st->eof) break;
+    scanned = st->len - st->pos;
+    err = omni_stream_fill_locked(st);
+  }
+
+  Term result;
+  if (err) {
+    result = omni_stream_error(err);
+  } else if (!nl && st->pos == st->len) {
+    result = term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+  } else {
+    const u8 *line = st->buf + st->pos;
+    size_t n = nl ? (size_t)(nl - line) : st->len - st->pos;
+    st->pos += n + (nl ? 1 : 0);
+    if (nl && n > 0 && line[n - 1] == '\r') n--;
+    result = omni_pstr_string((const char*)line, n);
+  }
+  pthread_mutex_unlock(&st->lock);
+  omni_stream_release(st);
+  return result;
+}
+
+// (read-chunk r n): up to n bytes, fewer only at the end of the file
+fn Term omni_ffi_stream_read_chunk(Term args) {
+  Term t[2];
+  size_t want;
+  if (omni_buf_args(args, t, 2) != 2 || !omni_buf_index(t[1], &want) || want == 0) {
+    return omni_stream_error(EINVAL);
+  }
+  OmniStream *st = omni_stream_acquire(t[0], OMNI_NAM_RDR);
+  if (!st) return omni_stream_error(EBADF);
+
+  OmniBuf *b = omni_buf_new(want);
+  pthread_mutex_lock(&st->lock);
+  int err = !b ? ENOMEM : st->fd < 0 ? EBADF : 0;
+  size_t got = 0;
+  while (!err && got < want) {
+    if (st->pos == st->len) {
+      if (st->eof) break;
+      if (want - got >= st->cap) {
+        ssize_t n = read(st->fd, b->bytes + got, want - got);   // Large: skip the copy
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) err = errno;
+        else if (n == 0) st->eof = 1;
+        else got += (size_t)n;
+        continue;
+      }
+      err = omni_stream_fill_locked(st);
+      continue;
+    }
+    size_t n = st->len - st->pos;
+    if (n > want - got) n = want - got;
+    memcpy(b->bytes + got, st->buf + st->pos, n);
+    st->pos += n;
+    got += n;
+  }
+  pthread_mutex_unlock(&st->lock);
+  omni_stream_release(st);
+
+  if (err) {
+    omni_buf_release(b);
+    return omni_stream_error(err);
+  }
+  if (got == 0) {
+    omni_buf_release(b);
+    return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+  }
+  b->len = got;
+  b->bytes[got] = 0;
+  return omni_buf_term(b);
+}
+
+// =============================================================================
+// FFI Registration
+// =============================================================================
+
+// Names are OMNI_NAM_* nicks, so this runs after omni_names_init
+fn void omni_ffi_register_stream(void) {
+  omni_ffi_handle_on_drop(OMNI_NAM_WRTR, omni_stream_drop_writer);
+  omni_ffi_handle_on_drop(OMNI_NAM_RDR, omni_stream_drop_reader);
+  omni_ffi_register_term(OMNI_NAM_OPWR, omni_ffi_stream_open_writer);
+  omni_ffi_register_term(OMNI_NAM_OPRD, omni_ffi_stream_open_reader);
+  omni_ffi_register_term(OMNI_NAM_STWR, omni_ffi_stream_write);
+  omni_ffi_register_term(OMNI_NAM_STFL, omni_ffi_stream_flush);
+  omni_ffi_register_term(OMNI_NAM_STCL, omni_ffi_stream_close);
+  omni_ffi_register_term(OMNI_NAM_STRL, omni_ffi_stream_read_line);
+  omni_ffi_register_term(OMNI_NAM_STRC, omni_ffi_stream_read_chunk);
+}
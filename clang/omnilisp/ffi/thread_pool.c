@@ -1,148 +1,272 @@
 // OmniLisp FFI Thread Pool
 // Worker threads for async FFI execution
 // Based on Purple's threading design
-
+//
+// Submissions go through lock-free bounded MPMC rings (Vyukov's design: one
+// sequence number per cell, producers and consumers each claim a position
+// with a CAS). Single calls go to a global ring; a batch is spread over the
+// workers' local rings. A worker drains its own ring, then the global one,
+// then steals from the other workers' rings. With nothing to do it parks on
+// a futex word that producers bump only when someone is parked, so a busy
+// pool submits without a system call. When the rings are full the caller
+// runs the call itself.
+//
+// The worker count is --ffi-workers N, else $OMNI_FFI_WORKERS, else one per
+// online core.
+//
+// Workers only run the C call and store its raw return value. Turning that
+// into a Term allocates on the heap, which must happen on a reducer thread
+// (it owns a heap slice), so it is done by whoever awaits the future.
+//
+// OmniLisp reaches the pool through three forms:
+//   (async (ffi "lib" "fn" args...))   -> #FAsy{name, args}, one future
+//   (ffi ^:async "lib" "fn" args...)   -> same
+//   (async-batch (ffi ...) ...)        -> #FAsB{reqs}, a list of futures,
+//                                         spread over the workers at once
+//   (await f)                          -> #FAwt{f}, the result
+//   (await-all fs)                     -> #FAwA{fs}, every result in order
+//   (await-any fs)                     -> #FAwN{fs}, (index result remaining)
+// A future is #Pend{#Hndl{...}}: the handle table owns the OmniFFIFuture, so
+// a future that is copied and awaited twice is caught by the generation
+// check instead of touching freed memory. A future released unawaited (by
+// a handle scope, or at exit) is waited for before it is freed.
+//
+// Awaiting does not poll. After a short spin the awaiter writes its reducer
+// id into the state word of every future it waits for and sleeps on its own
+// futex word (one per reducer thread, never freed). The worker that finishes
+// a future swaps the state to done and, if an id was there, bumps and wakes
+// that word. One word serves any number of futures, which is what
+// await-any and await-all block on.
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 // =============================================================================
 // Configuration
 // =============================================================================
 
-#define OMNI_FFI_NUM_WORKERS  4
-#define OMNI_FFI_QUEUE_SIZE   256
-
-// =============================================================================
-// FFI Call Types
-// =============================================================================
-
-typedef enum {
-  OMNI_FFI_VOID_VOID = 0,      // void fn(void)
-  OMNI_FFI_INT_VOID,           // int fn(void)
-  OMNI_FFI_PTR_VOID,           // void* fn(void)
-  OMNI_FFI_VOID_INT,           // void fn(int)
-  OMNI_FFI_INT_INT,            // int fn(int)
-  OMNI_FFI_PTR_INT,            // void* fn(int)
-  OMNI_FFI_VOID_PTR,           // void fn(void*)
-  OMNI_FFI_INT_PTR,            // int fn(void*)
-  OMNI_FFI_PTR_PTR,            // void* fn(void*)
-  OMNI_FFI_INT_PTR_INT,        // int fn(void*, int)
-  OMNI_FFI_PTR_PTR_INT,        // void* fn(void*, int)
-  OMNI_FFI_INT_PTR_PTR,        // int fn(void*, void*)
-  OMNI_FFI_PTR_PTR_PTR,        // void* fn(void*, void*)
-  OMNI_FFI_VARIADIC,           // General case (slow path)
-} OmniFFICallType;
+#define OMNI_FFI_MAX_WORKERS  64
+#define OMNI_FFI_QUEUE_SIZE   1024   // Global ring slots (power of 2)
+#define OMNI_FFI_LOCAL_SIZE   256    // Per-worker ring slots (power of 2)
+#define OMNI_FFI_AWAIT_SPIN   128    // State checks before an awaiter sleeps
 
 // =============================================================================
 // FFI Future (Result Container)
 // =============================================================================
 
+// Future states; OMNI_FFI_WAITER + tid means pending, awaited by reducer tid
+#define OMNI_FFI_PENDING  0u
+#define OMNI_FFI_READY    1u
+#define OMNI_FFI_WAITER   2u
+
 typedef struct {
-  atomic_int ready;            // 0 = pending, 1 = done
-  Term result;                 // Result value
+  atomic_uint ready;           // OMNI_FFI_PENDING, OMNI_FFI_READY or a waiter
+  intptr_t raw;                // Raw C return value, set by the worker
   void *fn_ptr;                // Function pointer
   OmniFFICallType call_type;   // Call signature
   intptr_t args[8];            // Up to 8 arguments
   u32 arg_count;               // Number of arguments
   u32 result_ownership;        // Ownership of result handle
   u32 result_type_id;          // Type ID for result handle
+  OmniFFIEntry *entry;         // Staged term entry (registry.c), or NULL
+  void *payload;               // State of a staged call
+  Term done;                   // Result produced at submission, or 0
+  OmniFFISig *sig;             // With OMNI_FFI_SIGNATURE (signature.c)
+  OmniFFIFrame frame;          // Its marshalled registers and result
 } OmniFFIFuture;
 
 // =============================================================================
-// Task Queue
+// Task Ring (bounded lock-free MPMC)
 // =============================================================================
 
 typedef struct {
-  OmniFFIFuture *tasks[OMNI_FFI_QUEUE_SIZE];
-  u32 head;
-  u32 tail;
-  u32 count;
-  pthread_mutex_t mutex;
-  pthread_cond_t not_empty;
-  pthread_cond_t not_full;
-  int shutdown;
-} OmniFFIQueue;
-
-// =============================================================================
-// Thread Pool
-// =============================================================================
+  atomic_size_t seq;           // Position this cell is ready for
+  OmniFFIFuture *task;
+} OmniFFICell;
 
 typedef struct {
-  pthread_t workers[OMNI_FFI_NUM_WORKERS];
-  OmniFFIQueue queue;
-  int started;
-} OmniFFIPool;
+  _Alignas(64) atomic_size_t head;   // Next position to pop
+  _Alignas(64) atomic_size_t tail;   // Next position to push
+  _Alignas(64) OmniFFICell *cells;
+  size_t mask;
+} OmniFFIRing;
+
+fn int omni_ffi_ring_init(OmniFFIRing *r, size_t cap) {
+  r->cells = (OmniFFICell*)malloc(cap * sizeof(OmniFFICell));
+  if (!r->cells) return 0;
+  for (size_t i = 0; i < cap; i++) {
+    atomic_init(&r->cells[i].seq, i);
+    r->cells[i].task = NULL;
+  }
+  r->mask = cap - 1;
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  return 1;
+}
 
-// Global pool
-static OmniFFIPool OMNI_FFI_POOL = {0};
-static int OMNI_FFI_POOL_READY = 0;
+fn void omni_ffi_ring_free(OmniFFIRing *r) {
+  free(r->cells);
+  r->cells = NULL;
+}
+
+// Returns 0 if the ring is full
+fn int omni_ffi_ring_push(OmniFFIRing *r, OmniFFIFuture *task) {
+  OmniFFICell *c;
+  size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  while (1) {
+    c = &r->cells[pos & r->mask];
+    size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+    intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+    if (dif == 0) {
+      if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return 0;
+    } else {
+      pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    }
+  }
+  c->task = task;
+  atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+  return 1;
+}
+
+// Returns NULL if the ring is empty
+fn OmniFFIFuture* omni_ffi_ring_pop(OmniFFIRing *r) {
+  OmniFFICell *c;
+  size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+  while (1) {
+    c = &r->cells[pos & r->mask];
+    size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+    intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (dif == 0) {
+      if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return NULL;
+    } else {
+      pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    }
+  }
+  OmniFFIFuture *task = c->task;
+  atomic_store_explicit(&c->seq, pos + r->mask + 1, memory_order_release);
+  return task;
+}
 
 // =============================================================================
-// Queue Operations
+// Futex
 // =============================================================================
 
-fn void omni_ffi_queue_init(OmniFFIQueue *q) {
-  q->head = 0;
-  q->tail = 0;
-  q->count = 0;
-  q->shutdown = 0;
-  pthread_mutex_init(&q->mutex, NULL);
-  pthread_cond_init(&q->not_empty, NULL);
-  pthread_cond_init(&q->not_full, NULL);
+// Sleep while *addr == val (returns early on a wake or a signal)
+fn void omni_futex_wait(atomic_uint *addr, u32 val) {
+  syscall(SYS_futex, (u32*)addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
 }
 
-fn void omni_ffi_queue_destroy(OmniFFIQueue *q) {
-  pthread_mutex_destroy(&q->mutex);
-  pthread_cond_destroy(&q->not_empty);
-  pthread_cond_destroy(&q->not_full);
+fn void omni_futex_wake(atomic_uint *addr, u32 n) {
+  syscall(SYS_futex, (u32*)addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
 }
 
-fn int omni_ffi_queue_push(OmniFFIQueue *q, OmniFFIFuture *task) {
-  pthread_mutex_lock(&q->mutex);
-
-  while (q->count >= OMNI_FFI_QUEUE_SIZE && !q->shutdown) {
-    pthread_cond_wait(&q->not_full, &q->mutex);
-  }
+// =============================================================================
+// Completion
+// =============================================================================
 
-  if (q->shutdown) {
-    pthread_mutex_unlock(&q->mutex);
-    return 0;
-  }
+// Awaiters sleep on the word of their reducer thread
+typedef struct {
+  atomic_uint word;
+} __attribute__((aligned(64))) OmniFFIWake;
 
-  q->tasks[q->tail] = task;
-  q->tail = (q->tail + 1) % OMNI_FFI_QUEUE_SIZE;
-  q->count++;
+static OmniFFIWake OMNI_FFI_WAKE[OMNI_MAX_REDUCERS];
 
-  pthread_cond_signal(&q->not_empty);
-  pthread_mutex_unlock(&q->mutex);
-  return 1;
+fn int omni_ffi_future_ready(OmniFFIFuture *f) {
+  return atomic_load_explicit(&f->ready, memory_order_acquire) == OMNI_FFI_READY;
 }
 
-fn OmniFFIFuture* omni_ffi_queue_pop(OmniFFIQueue *q) {
-  pthread_mutex_lock(&q->mutex);
-
-  while (q->count == 0 && !q->shutdown) {
-    pthread_cond_wait(&q->not_empty, &q->mutex);
+// Mark f done and wake its awaiter, if one is registered. The awaiter may
+// free f as soon as the state changes, so f is not touched afterwards.
+fn void omni_ffi_future_complete(OmniFFIFuture *f) {
+  u32 old = atomic_exchange_explicit(&f->ready, OMNI_FFI_READY, memory_order_acq_rel);
+  if (old >= OMNI_FFI_WAITER) {
+    atomic_uint *w = &OMNI_FFI_WAKE[old - OMNI_FFI_WAITER].word;
+    atomic_fetch_add_explicit(w, 1, memory_order_release);
+    omni_futex_wake(w, INT_MAX);
   }
+}
 
-  if (q->shutdown && q->count == 0) {
-    pthread_mutex_unlock(&q->mutex);
-    return NULL;
+// Block until every future in fs is ready (all) or at least one is (any);
+// NULL entries are skipped. Returns the index of a ready future for any, n
+// for all.
+fn u32 omni_ffi_wait(OmniFFIFuture **fs, u32 n, int all) {
+  u32 tid = omni_reducer_tid;
+  u32 mark = OMNI_FFI_WAITER + tid;
+  atomic_uint *w = &OMNI_FFI_WAKE[tid].word;
+
+  for (u32 round = 0; ; round++) {
+    u32 seen = atomic_load_explicit(w, memory_order_acquire);
+    int sleep = round >= OMNI_FFI_AWAIT_SPIN;
+    u32 left = 0;
+
+    for (u32 i = 0; i < n; i++) {
+      if (!fs[i]) continue;
+      u32 state = atomic_load_explicit(&fs[i]->ready, memory_order_acquire);
+      // Register before sleeping; a failed CAS means the state just changed
+      while (sleep && state != OMNI_FFI_READY && state != mark &&
+             !atomic_compare_exchange_weak_explicit(&fs[i]->ready, &state, mark,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire)) {
+      }
+      if (state == OMNI_FFI_READY) {
+        if (!all) return i;
+      } else {
+        left++;
+      }
+    }
+    if (left == 0) return n;
+    if (sleep) omni_futex_wait(w, seen);
   }
+}
 
-  OmniFFIFuture *task = q->tasks[q->head];
-  q->head = (q->head + 1) % OMNI_FFI_QUEUE_SIZE;
-  q->count--;
+// =============================================================================
+// Thread Pool
+// =============================================================================
 
-  pthread_cond_signal(&q->not_full);
-  pthread_mutex_unlock(&q->mutex);
-  return task;
-}
+typedef struct {
+  OmniFFIRing local;           // Batch submissions; other workers steal from it
+  pthread_t   thread;
+} __attribute__((aligned(64))) OmniFFIWorker;
+
+typedef struct {
+  OmniFFIRing    global;       // Single submissions
+  OmniFFIWorker *workers;
+  u32            count;        // Workers (and local rings)
+  u32            started;      // Worker threads running, a prefix of workers
+  u32            wanted;       // Workers to start (omni_ffi_pool_configure)
+  atomic_uint    next;         // Round-robin cursor for batches
+  atomic_uint    wake;         // Futex word, bumped to wake parked workers
+  atomic_uint    sleepers;     // Workers parked or about to park
+  atomic_int     shutdown;     // Set once; submissions then run inline
+} OmniFFIPool;
+
+// Global pool
+static OmniFFIPool OMNI_FFI_POOL = {0};
+static int OMNI_FFI_POOL_READY = 0;
+static int OMNI_FFI_POOL_EXITING = 0;  // Set by shutdown; see omni_ffi_future_drop
+static pthread_once_t OMNI_FFI_POOL_ONCE = PTHREAD_ONCE_INIT;
 
 // =============================================================================
 // FFI Call Execution
 // =============================================================================
 
+// Run the call; safe on any thread
 fn void omni_ffi_execute_call(OmniFFIFuture *f) {
   intptr_t result = 0;
 
@@ -217,14 +341,42 @@ fn void omni_ffi_execute_call(OmniFFIFuture *f) {
       // For now, just handle common cases
       break;
     }
+    case OMNI_FFI_SIGNATURE: {
+      omni_ffi_sig_invoke(f->sig, f->fn_ptr, &f->frame);
+      break;
+    }
+  }
+
+  f->raw = result;
+  omni_ffi_future_complete(f);
+}
+
+// Run a queued task: the native call, or the worker stage of a staged entry
+fn void omni_ffi_run_task(OmniFFIFuture *f) {
+  if (f->entry) {
+    f->entry->run(f->payload);
+    omni_ffi_future_complete(f);
+    return;
+  }
+  omni_ffi_execute_call(f);
+}
+
+// Convert a finished call's raw result to a Term on the calling reducer thread
+fn Term omni_ffi_call_result(OmniFFIFuture *f) {
+  if (f->done) return f->done;
+  if (f->entry) return f->entry->finish(f->payload);
+  if (f->sig) {
+    return omni_ffi_sig_result(f->sig, &f->frame,
+                               (OmniOwnership)f->result_ownership, f->result_type_id);
   }
 
-  // Store result
+  intptr_t result = f->raw;
+
   if (f->call_type == OMNI_FFI_VOID_VOID ||
       f->call_type == OMNI_FFI_VOID_INT ||
       f->call_type == OMNI_FFI_VOID_PTR) {
     // Void return - use Nothing
-    f->result = term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
+    return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
   } else if (f->call_type == OMNI_FFI_PTR_VOID ||
              f->call_type == OMNI_FFI_PTR_INT ||
              f->call_type == OMNI_FFI_PTR_PTR ||
@@ -232,35 +384,63 @@ fn void omni_ffi_execute_call(OmniFFIFuture *f) {
              f->call_type == OMNI_FFI_PTR_PTR_PTR) {
     // Pointer return - wrap in handle
     if (result == 0) {
-      f->result = term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
-    } else {
-      f->result = omni_ffi_handle_alloc(
-        (void*)result,
-        (OmniOwnership)f->result_ownership,
-        f->result_type_id
-      );
+      return term_new_ctr(OMNI_NAM_NOTH, 0, NULL);
     }
-  } else {
-    // Integer return - wrap as Cst (NUM)
-    f->result = term_new_num((u32)result);
+    return omni_ffi_handle_alloc(
+      (void*)result,
+      (OmniOwnership)f->result_ownership,
+      f->result_type_id
+    );
   }
-
-  // Mark as ready (release fence)
-  atomic_store_explicit(&f->ready, 1, memory_order_release);
+  // Integer return - wrap as Cst (NUM)
+  return term_new_num((u32)result);
 }
 
 // =============================================================================
 // Worker Thread
 // =============================================================================
 
+// Own ring first, then the global ring, then steal from the others
+fn OmniFFIFuture* omni_ffi_pool_take(u32 self) {
+  OmniFFIFuture *task = omni_ffi_ring_pop(&OMNI_FFI_POOL.workers[self].local);
+  if (task) return task;
+  task = omni_ffi_ring_pop(&OMNI_FFI_POOL.global);
+  if (task) return task;
+  for (u32 i = 1; i < OMNI_FFI_POOL.count; i++) {
+    task = omni_ffi_ring_pop(&OMNI_FFI_POOL.workers[(self + i) % OMNI_FFI_POOL.count].local);
+    if (task) return task;
+  }
+  return NULL;
+}
+
 fn void* omni_ffi_worker(void *arg) {
-  (void)arg;
+  u32 self = (u32)(uintptr_t)arg;
 
   while (1) {
-    OmniFFIFuture *task = omni_ffi_queue_pop(&OMNI_FFI_POOL.queue);
-    if (!task) break;  // Shutdown
+    OmniFFIFuture *task = omni_ffi_pool_take(self);
+    if (task) {
+      omni_ffi_run_task(task);
+      continue;
+    }
 
-    omni_ffi_execute_call(task);
+    // Announce the park, then look once more: a producer that pushed before
+    // seeing sleepers > 0 is caught by the second look, one that pushed after
+    // bumps wake and makes the futex wait return at once
+    u32 seen = atomic_load_explicit(&OMNI_FFI_POOL.wake, memory_order_acquire);
+    atomic_fetch_add_explicit(&OMNI_FFI_POOL.sleepers, 1, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_seq_cst);
+    task = omni_ffi_pool_take(self);
+    if (task) {
+      atomic_fetch_sub_explicit(&OMNI_FFI_POOL.sleepers, 1, memory_order_relaxed);
+      omni_ffi_run_task(task);
+      continue;
+    }
+    if (atomic_load_explicit(&OMNI_FFI_POOL.shutdown, memory_order_acquire)) {
+      atomic_fetch_sub_explicit(&OMNI_FFI_POOL.sleepers, 1, memory_order_relaxed);
+      break;  // Shutdown, and every ring is drained
+    }
+    omni_futex_wait(&OMNI_FFI_POOL.wake, seen);
+    atomic_fetch_sub_explicit(&OMNI_FFI_POOL.sleepers, 1, memory_order_relaxed);
   }
 
   return NULL;
@@ -270,17 +450,98 @@ fn void* omni_ffi_worker(void *arg) {
 // Pool Initialization
 // =============================================================================
 
+// Resolve the worker count: explicit --ffi-workers wins, then
+// OMNI_FFI_WORKERS, then the number of online cores
+fn u32 omni_ffi_workers_wanted(int cli_workers) {
+  long n = cli_workers;
+  if (n <= 0) {
+    const char *env = getenv("OMNI_FFI_WORKERS");
+    n = env ? strtol(env, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (n < 1) n = 1;
+  if (n > OMNI_FFI_MAX_WORKERS) n = OMNI_FFI_MAX_WORKERS;
+  return (u32)n;
+}
+
+// Set the worker count; takes effect when the pool starts (first async call)
+fn void omni_ffi_pool_configure(u32 n) {
+  OMNI_FFI_POOL.wanted = n;
+}
+
+fn void omni_ffi_pool_start(void) {
+  u32 n = OMNI_FFI_POOL.wanted ? OMNI_FFI_POOL.wanted : omni_ffi_workers_wanted(0);
+  OMNI_FFI_POOL.workers = (OmniFFIWorker*)aligned_alloc(64, n * sizeof(OmniFFIWorker));
+  if (!OMNI_FFI_POOL.workers || !omni_ffi_ring_init(&OMNI_FFI_POOL.global, OMNI_FFI_QUEUE_SIZE)) {
+    atomic_store(&OMNI_FFI_POOL.shutdown, 1);  // No pool: every call runs inline
+    return;
+  }
+
+  for (u32 i = 0; i < n; i++) {
+    if (!omni_ffi_ring_init(&OMNI_FFI_POOL.workers[i].local, OMNI_FFI_LOCAL_SIZE)) break;
+    OMNI_FFI_POOL.count = i + 1;
+  }
+  // count is fixed before any worker runs. Rings of workers that fail to
+  // start are still drained by the others through stealing.
+  for (u32 i = 0; i < OMNI_FFI_POOL.count; i++) {
+    if (pthread_create(&OMNI_FFI_POOL.workers[i].thread, NULL, omni_ffi_worker,
+                       (void*)(uintptr_t)i) != 0) {
+      break;
+    }
+    OMNI_FFI_POOL.started = i + 1;
+  }
+  if (OMNI_FFI_POOL.started == 0) {
+    atomic_store(&OMNI_FFI_POOL.shutdown, 1);
+  }
+
+  __atomic_store_n(&OMNI_FFI_POOL_READY, 1, __ATOMIC_RELEASE);
+}
+
+// Start the workers once, whichever reducer thread gets here first
 fn void omni_ffi_pool_init(void) {
-  if (OMNI_FFI_POOL_READY) return;
+  pthread_once(&OMNI_FFI_POOL_ONCE, omni_ffi_pool_start);
+}
+
+// =============================================================================
+// Submission
+// =============================================================================
+
+// Wake up to n parked workers after pushing work
+fn void omni_ffi_pool_notify(u32 n) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&OMNI_FFI_POOL.sleepers, memory_order_relaxed) == 0) return;
+  atomic_fetch_add_explicit(&OMNI_FFI_POOL.wake, 1, memory_order_release);
+  omni_futex_wake(&OMNI_FFI_POOL.wake, n);
+}
 
-  omni_ffi_queue_init(&OMNI_FFI_POOL.queue);
+// Queue one task; it runs on the caller if the pool is down or full
+fn void omni_ffi_submit(OmniFFIFuture *f) {
+  omni_ffi_pool_init();
+  if (atomic_load_explicit(&OMNI_FFI_POOL.shutdown, memory_order_acquire) ||
+      !omni_ffi_ring_push(&OMNI_FFI_POOL.global, f)) {
+    omni_ffi_run_task(f);
+    return;
+  }
+  omni_ffi_pool_notify(1);
+}
 
-  for (int i = 0; i < OMNI_FFI_NUM_WORKERS; i++) {
-    pthread_create(&OMNI_FFI_POOL.workers[i], NULL, omni_ffi_worker, NULL);
+// Queue n tasks round-robin over the workers' local rings
+fn void omni_ffi_submit_batch(OmniFFIFuture **tasks, u32 n) {
+  omni_ffi_pool_init();
+  if (atomic_load_explicit(&OMNI_FFI_POOL.shutdown, memory_order_acquire)) {
+    for (u32 i = 0; i < n; i++) omni_ffi_run_task(tasks[i]);
+    return;
   }
 
-  OMNI_FFI_POOL.started = 1;
-  OMNI_FFI_POOL_READY = 1;
+  u32 count = OMNI_FFI_POOL.count;
+  u32 start = atomic_fetch_add_explicit(&OMNI_FFI_POOL.next, n, memory_order_relaxed);
+  for (u32 i = 0; i < n; i++) {
+    OmniFFIWorker *w = &OMNI_FFI_POOL.workers[(start + i) % count];
+    if (!omni_ffi_ring_push(&w->local, tasks[i]) &&
+        !omni_ffi_ring_push(&OMNI_FFI_POOL.global, tasks[i])) {
+      omni_ffi_run_task(tasks[i]);
+    }
+  }
+  omni_ffi_pool_notify(n < count ? n : count);
 }
 
 // =============================================================================
@@ -288,20 +549,25 @@ fn void omni_ffi_pool_init(void) {
 // =============================================================================
 
 fn void omni_ffi_pool_shutdown(void) {
+  OMNI_FFI_POOL_EXITING = 1;
   if (!OMNI_FFI_POOL_READY) return;
 
-  // Signal shutdown
-  pthread_mutex_lock(&OMNI_FFI_POOL.queue.mutex);
-  OMNI_FFI_POOL.queue.shutdown = 1;
-  pthread_cond_broadcast(&OMNI_FFI_POOL.queue.not_empty);
-  pthread_mutex_unlock(&OMNI_FFI_POOL.queue.mutex);
+  // Workers finish what is queued, then exit
+  atomic_store_explicit(&OMNI_FFI_POOL.shutdown, 1, memory_order_release);
+  atomic_fetch_add_explicit(&OMNI_FFI_POOL.wake, 1, memory_order_release);
+  omni_futex_wake(&OMNI_FFI_POOL.wake, OMNI_FFI_MAX_WORKERS);
 
-  // Wait for workers
-  for (int i = 0; i < OMNI_FFI_NUM_WORKERS; i++) {
-    pthread_join(OMNI_FFI_POOL.workers[i], NULL);
+  for (u32 i = 0; i < OMNI_FFI_POOL.started; i++) {
+    pthread_join(OMNI_FFI_POOL.workers[i].thread, NULL);
   }
-
-  omni_ffi_queue_destroy(&OMNI_FFI_POOL.queue);
+  for (u32 i = 0; i < OMNI_FFI_POOL.count; i++) {
+    omni_ffi_ring_free(&OMNI_FFI_POOL.workers[i].local);
+  }
+  omni_ffi_ring_free(&OMNI_FFI_POOL.global);
+  free(OMNI_FFI_POOL.workers);
+  OMNI_FFI_POOL.workers = NULL;
+  OMNI_FFI_POOL.count = 0;
+  OMNI_FFI_POOL.started = 0;
   OMNI_FFI_POOL_READY = 0;
 }
 
@@ -309,6 +575,22 @@ fn void omni_ffi_pool_shutdown(void) {
 // Async FFI Dispatch
 // =============================================================================
 
+// Hand a future to the handle table and return #Pend{#Hndl{...}}; call
+// before the future is queued. Without a free handle the call is finished
+// here and its result returned in place of the future.
+fn Term omni_ffi_future_term(OmniFFIFuture *f) {
+  Term h = omni_ffi_handle_alloc((void*)f, OMNI_OWNED, OMNI_NAM_PEND);
+  if (term_ext(h) == OMNI_NAM_HNDL) {
+    return term_new_ctr(OMNI_NAM_PEND, 1, &h);
+  }
+  if (!omni_ffi_future_ready(f)) {
+    omni_ffi_run_task(f);
+  }
+  Term result = omni_ffi_call_result(f);
+  free(f);
+  return result;
+}
+
 // Submit an FFI call and return a pending future
 fn Term omni_ffi_call_async(
   void *fn_ptr,
@@ -318,8 +600,6 @@ fn Term omni_ffi_call_async(
   OmniOwnership result_ownership,
   u32 result_type_id
 ) {
-  if (!OMNI_FFI_POOL_READY) omni_ffi_pool_init();
-
   OmniFFIFuture *f = (OmniFFIFuture*)calloc(1, sizeof(OmniFFIFuture));
   f->fn_ptr = fn_ptr;
   f->call_type = call_type;
@@ -329,13 +609,13 @@ fn Term omni_ffi_call_async(
   }
   f->result_ownership = result_ownership;
   f->result_type_id = result_type_id;
-  atomic_store(&f->ready, 0);
-
-  // Submit to queue
-  omni_ffi_queue_push(&OMNI_FFI_POOL.queue, f);
+  atomic_store(&f->ready, OMNI_FFI_PENDING);
 
-  // Return #Pend{future_ptr}
-  return omni_ffi_ptr_wrap((void*)f);
+  Term pending = omni_ffi_future_term(f);
+  if (term_ext(pending) == OMNI_NAM_PEND) {
+    omni_ffi_submit(f);
+  }
+  return pending;
 }
 
 // =============================================================================
@@ -361,93 +641,169 @@ fn Term omni_ffi_call_sync(
   f.result_type_id = result_type_id;
 
   omni_ffi_execute_call(&f);
-  return f.result;
+  return omni_ffi_call_result(&f);
 }
 
 // =============================================================================
 // Await Future
 // =============================================================================
 
-fn Term omni_ffi_await(Term pending) {
-  // #Ptr{hi, lo} is C02 (2 args)
-  if (term_tag(pending) != C02) return pending;
-  if (term_ext(pending) != OMNI_NAM_PEND &&
-      term_ext(pending) != OMNI_NAM_PTR) return pending;
-
-  OmniFFIFuture *f = (OmniFFIFuture*)omni_ffi_ptr_unwrap(pending);
-  if (!f) return term_new_ctr(OMNI_NAM_ERR, 0, NULL);
-
-  // Spin wait with backoff
-  u32 spins = 0;
-  while (!atomic_load_explicit(&f->ready, memory_order_acquire)) {
-    if (spins < 1000) {
-      spins++;
-      // Busy spin
-    } else if (spins < 10000) {
-      spins++;
-      sched_yield();
-    } else {
-      // Sleep a bit
-      struct timespec ts = {0, 100000};  // 100us
-      nanosleep(&ts, NULL);
-    }
-  }
-
-  Term result = f->result;
+// Wait for f, build its result and free it
+fn Term omni_ffi_await_future(OmniFFIFuture *f) {
+  omni_ffi_wait(&f, 1, 1);
+  Term result = omni_ffi_call_result(f);
   free(f);
   return result;
 }
 
-// =============================================================================
-// FFI Function Table
-// =============================================================================
+// Release a future whose handle goes away unawaited (scope end, cleanup).
+// A worker or the reaper may still be writing to it, so wait for it first.
+// The result is then built and thrown away, which frees a staged call's
+// payload; at exit, when the handle table is being torn down, nothing is
+// built and the payload goes with the process.
+fn void omni_ffi_future_drop(void *ptr) {
+  OmniFFIFuture *f = (OmniFFIFuture*)ptr;
+  omni_ffi_wait(&f, 1, 1);
+  if (!OMNI_FFI_POOL_EXITING) (void)omni_ffi_call_result(f);
+  free(f);
+}
 
-#define OMNI_FFI_TABLE_SIZE 256
+// Await #Pend{#Hndl{...}}; any other value is already a result
+// A future can be awaited once; later awaits of a copy give #Err{EALREADY}
+fn Term omni_ffi_await(Term pending) {
+  if (term_tag(pending) != C01 || term_ext(pending) != OMNI_NAM_PEND) {
+    return pending;
+  }
 
-typedef struct {
-  u32 name_nick;               // Nick-encoded function name
-  void *fn_ptr;                // Function pointer
-  OmniFFICallType call_type;   // Signature type
-  OmniOwnership result_ownership;
-  u32 result_type_id;
-} OmniFFIEntry;
+  Term h = wnf(HEAP[term_val(pending)]);
+  OmniFFIFuture *f = (OmniFFIFuture*)omni_ffi_handle_take(h, OMNI_NAM_PEND);
+  if (!f) {
+    Term err_args[1] = {term_new_num(EALREADY)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  }
+  return omni_ffi_await_future(f);
+}
 
-static OmniFFIEntry OMNI_FFI_TABLE[OMNI_FFI_TABLE_SIZE];
-static u32 OMNI_FFI_TABLE_COUNT = 0;
+// Elements of a list of futures, taken from the handle table. A slot whose
+// future is NULL already holds its result in vals (a plain value, or
+// #Err{EALREADY} for a future awaited before). Returns the count; *fs and
+// *vals are malloc'd.
+fn u32 omni_ffi_take_list(Term list, OmniFFIFuture ***fs, Term **vals) {
+  u32 cap = 16, len = 0;
+  *fs = (OmniFFIFuture**)malloc(cap * sizeof(OmniFFIFuture*));
+  *vals = (Term*)malloc(cap * sizeof(Term));
+
+  Term cur = wnf(list);
+  while (*fs && *vals && term_tag(cur) == C02 && term_ext(cur) == NAM_CON) {
+    u32 loc = term_val(cur);
+    Term v = wnf(HEAP[loc]);
+    cur = wnf(HEAP[loc + 1]);
+
+    if (len == cap) {
+      cap *= 2;
+      OmniFFIFuture **f2 = (OmniFFIFuture**)realloc(*fs, cap * sizeof(OmniFFIFuture*));
+      if (f2) *fs = f2;
+      Term *v2 = (Term*)realloc(*vals, cap * sizeof(Term));
+      if (v2) *vals = v2;
+      if (!f2 || !v2) break;
+    }
 
-// Register an FFI function
-fn void omni_ffi_register(
-  const char *name,
-  void *fn_ptr,
-  OmniFFICallType call_type,
-  OmniOwnership result_ownership,
-  u32 result_type_id
-) {
-  if (OMNI_FFI_TABLE_COUNT >= OMNI_FFI_TABLE_SIZE) return;
+    (*fs)[len] = NULL;
+    (*vals)[len] = v;
+    if (term_tag(v) == C01 && term_ext(v) == OMNI_NAM_PEND) {
+      Term h = wnf(HEAP[term_val(v)]);
+      (*fs)[len] = (OmniFFIFuture*)omni_ffi_handle_take(h, OMNI_NAM_PEND);
+      if (!(*fs)[len]) {
+        Term err_args[1] = {term_new_num(EALREADY)};
+        (*vals)[len] = term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+      }
+    }
+    len++;
+  }
+  return len;
+}
 
-  OmniFFIEntry *e = &OMNI_FFI_TABLE[OMNI_FFI_TABLE_COUNT++];
-  e->name_nick = omni_nick(name);
-  e->fn_ptr = fn_ptr;
-  e->call_type = call_type;
-  e->result_ownership = result_ownership;
-  e->result_type_id = result_type_id;
+fn Term omni_ffi_list_from(Term *items, u32 n) {
+  Term result = term_new_ctr(NAM_NIL, 0, NULL);
+  for (u32 i = n; i > 0; i--) {
+    Term con_args[2] = {items[i - 1], result};
+    result = term_new_ctr(NAM_CON, 2, con_args);
+  }
+  return result;
 }
 
-// Lookup FFI function by nick
-fn OmniFFIEntry* omni_ffi_lookup(u32 name_nick) {
-  for (u32 i = 0; i < OMNI_FFI_TABLE_COUNT; i++) {
-    if (OMNI_FFI_TABLE[i].name_nick == name_nick) {
-      return &OMNI_FFI_TABLE[i];
+// Await every element of a list; the results, in order
+fn Term omni_ffi_await_all(Term list) {
+  OmniFFIFuture **fs;
+  Term *vals;
+  u32 n = omni_ffi_take_list(list, &fs, &vals);
+
+  omni_ffi_wait(fs, n, 1);
+  for (u32 i = 0; i < n; i++) {
+    if (!fs[i]) continue;
+    vals[i] = omni_ffi_call_result(fs[i]);
+    free(fs[i]);
+  }
+
+  Term result = omni_ffi_list_from(vals, n);
+  free(fs);
+  free(vals);
+  return result;
+}
+
+// Await the first element of a list to finish: (index result remaining).
+// The futures in remaining are fresh handles for the ones still running;
+// the handles in the original list are used up.
+fn Term omni_ffi_await_any(Term list) {
+  OmniFFIFuture **fs;
+  Term *vals;
+  u32 n = omni_ffi_take_list(list, &fs, &vals);
+  if (n == 0) {
+    free(fs);
+    free(vals);
+    Term err_args[1] = {term_new_num(EINVAL)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  }
+
+  // A plain value (or a used-up future) wins without waiting
+  u32 won = n;
+  for (u32 i = 0; i < n && won == n; i++) {
+    if (!fs[i]) won = i;
+  }
+  if (won == n) won = omni_ffi_wait(fs, n, 0);
+  if (fs[won]) {
+    vals[won] = omni_ffi_call_result(fs[won]);
+    free(fs[won]);
+  }
+
+  Term *rest = (Term*)malloc(n * sizeof(Term));
+  u32 r = 0;
+  for (u32 i = 0; i < n; i++) {
+    if (i == won) continue;
+    if (!fs[i]) {
+      if (rest) rest[r++] = vals[i];
+      continue;
     }
+    Term h = omni_ffi_handle_alloc((void*)fs[i], OMNI_OWNED, OMNI_NAM_PEND);
+    Term v = term_ext(h) == OMNI_NAM_HNDL ? term_new_ctr(OMNI_NAM_PEND, 1, &h)
+                                          : omni_ffi_await_future(fs[i]);
+    if (rest) rest[r++] = v;
   }
-  return NULL;
+
+  Term triple[3] = {term_new_num(won), vals[won], omni_ffi_list_from(rest, r)};
+  Term result = omni_ffi_list_from(triple, 3);
+  free(rest);
+  free(fs);
+  free(vals);
+  return result;
 }
 
 // =============================================================================
 // FFI Dispatch (called during reduction)
 // =============================================================================
 
-// Forward declaration for recursive dispatch
+// Forward declarations for recursive dispatch
+fn int omni_ffi_is_node(Term t);
 fn Term omni_ffi_dispatch(Term ffi_node);
 
 // Reduce a term, dispatching any FFI terms recursively
@@ -455,54 +811,14 @@ fn Term omni_ffi_dispatch(Term ffi_node);
 fn Term omni_ffi_reduce(Term t) {
   t = wnf(t);
   // If this is an FFI term, dispatch it
-  if (term_tag(t) == C02 && term_ext(t) == OMNI_NAM_FFI) {
+  if (omni_ffi_is_node(t)) {
     return omni_ffi_dispatch(t);
   }
   return t;
 }
 
-// Dispatch #FFI{name, args} node
-fn Term omni_ffi_dispatch(Term ffi_node) {
-  // #FFI{name, args} is C02 (2 args)
-  if (term_tag(ffi_node) != C02) return ffi_node;
-  if (term_ext(ffi_node) != OMNI_NAM_FFI) return ffi_node;
-
-  u32 loc = term_val(ffi_node);
-
-  // CRITICAL: Reduce the name term to resolve ALO markers to actual values
-  Term name_term = wnf(HEAP[loc]);
-
-  // The name should be a NUM with the nick
-  u32 name_nick = term_val(name_term);
-
-  // Reduce args list too
-  Term args_list = wnf(HEAP[loc + 1]);
-
-  // Try IO dispatch first (omni_ffi_io_dispatch is defined in io.c)
-  Term io_result = omni_ffi_io_dispatch(name_nick, args_list);
-  if (io_result != 0) {
-    return io_result;
-  }
-
-  // Try DateTime dispatch (omni_ffi_dt_dispatch is defined in datetime.c)
-  Term dt_result = omni_ffi_dt_dispatch(name_nick, args_list);
-  if (dt_result != 0) {
-    return dt_result;
-  }
-
-  // Try JSON dispatch (omni_ffi_json_dispatch is defined in json.c)
-  Term json_result = omni_ffi_json_dispatch(name_nick, args_list);
-  if (json_result != 0) {
-    return json_result;
-  }
-
-  OmniFFIEntry *entry = omni_ffi_lookup(name_nick);
-  if (!entry) {
-    return term_new_ctr(OMNI_NAM_ERR, 0, NULL);
-  }
-
-  // Extract arguments from cons list
-  intptr_t args[8] = {0};
+// Unpack a reduced args list into C arguments (at most 8); returns the count
+fn u32 omni_ffi_unpack_args(Term args_list, intptr_t args[8]) {
   u32 arg_count = 0;
   Term cur = args_list;
 
@@ -535,7 +851,38 @@ fn Term omni_ffi_dispatch(Term ffi_node) {
     }
   }
 
-  // Execute synchronously (async could be selected based on metadata)
+  return arg_count;
+}
+
+// Nick of an FFI function name: a number (raw, #Cst or #Lit) or a string
+fn u32 omni_ffi_name_nick(Term name) {
+  name = wnf(name);
+  if (term_tag(name) == C01 &&
+      (term_ext(name) == OMNI_NAM_CST || term_ext(name) == OMNI_NAM_LIT)) {
+    return term_val(wnf(HEAP[term_val(name)]));
+  }
+  if ((term_tag(name) == C02 && term_ext(name) == NAM_CON) || omni_pstr_is(name)) {
+    char *str = omni_list_to_cstr(name);
+    u32 nick = str ? omni_nick(str) : 0;
+    free(str);
+    return nick;
+  }
+  return term_val(name);
+}
+
+// Run entry on an already reduced args list
+fn Term omni_ffi_call_entry(OmniFFIEntry *entry, Term args_list) {
+  if (entry->term_fn) {
+    return entry->term_fn(args_list);
+  }
+  if (entry->sig) {
+    return omni_ffi_sig_call(entry, args_list);
+  }
+
+  intptr_t args[8] = {0};
+  u32 arg_count = omni_ffi_unpack_args(args_list, args);
+
+  // Execute synchronously; (async ...) goes through omni_ffi_dispatch_async
   return omni_ffi_call_sync(
     entry->fn_ptr,
     entry->call_type,
@@ -546,26 +893,286 @@ fn Term omni_ffi_dispatch(Term ffi_node) {
   );
 }
 
+// Dispatch #FFI{name, args} node
+fn Term omni_ffi_dispatch_call(Term ffi_node) {
+  // #FFI{name, args} is C02 (2 args)
+  if (term_tag(ffi_node) != C02) return ffi_node;
+  if (term_ext(ffi_node) != OMNI_NAM_FFI) return ffi_node;
+
+  u32 loc = term_val(ffi_node);
+
+  // CRITICAL: Reduce the name term to resolve ALO markers to actual values
+  u32 name_nick = omni_ffi_name_nick(HEAP[loc]);
+
+  // Reduce args list too
+  Term args_list = wnf(HEAP[loc + 1]);
+
+  // Every module registers in one table (registry.c): a single lookup
+  OmniFFIEntry *entry = omni_ffi_lookup(name_nick);
+  if (!entry) {
+    return term_new_ctr(OMNI_NAM_ERR, 0, NULL);
+  }
+  if (entry->internal) {
+    return entry->term_fn(args_list);
+  }
+
+  // Only the call itself is timed for -s, not the reduction of its args
+  u64 start = omni_stats_ffi_begin();
+  Term result = omni_ffi_call_entry(entry, args_list);
+  omni_stats_ffi_end(start);
+  return result;
+}
+
+// =============================================================================
+// Async Forms (async, ^:async, async-batch, await)
+// =============================================================================
+
+// Future for one call of name_nick. Native calls and staged entries are
+// left for a worker (the caller queues them); plain term entries and
+// unknown names complete here, so the future comes back already ready.
+fn OmniFFIFuture* omni_ffi_future_new(u32 name_nick, Term args_list) {
+  OmniFFIFuture *f = (OmniFFIFuture*)calloc(1, sizeof(OmniFFIFuture));
+  if (!f) return NULL;
+
+  OmniFFIEntry *entry = omni_ffi_lookup(name_nick);
+  if (!entry) {
+    f->done = term_new_ctr(OMNI_NAM_ERR, 0, NULL);
+  } else if (entry->term_fn && entry->prepare) {
+    f->entry = entry;
+    f->payload = entry->prepare(args_list);
+    return f;
+  } else if (entry->term_fn) {
+    f->done = entry->term_fn(args_list);
+  } else if (entry->sig) {
+    int err = omni_ffi_sig_marshal(entry->sig, args_list, &f->frame);
+    if (!err) {
+      f->fn_ptr = entry->fn_ptr;
+      f->call_type = OMNI_FFI_SIGNATURE;
+      f->sig = entry->sig;
+      f->result_ownership = entry->result_ownership;
+      f->result_type_id = entry->result_type_id;
+      return f;
+    }
+    omni_ffi_frame_free(&f->frame);
+    Term err_args[1] = {term_new_num(err)};
+    f->done = term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  } else {
+    f->fn_ptr = entry->fn_ptr;
+    f->call_type = entry->call_type;
+    f->arg_count = omni_ffi_unpack_args(args_list, f->args);
+    f->result_ownership = entry->result_ownership;
+    f->result_type_id = entry->result_type_id;
+    return f;
+  }
+
+  atomic_store_explicit(&f->ready, OMNI_FFI_READY, memory_order_release);
+  return f;
+}
+
+// Read the name and reduced args of #FAsy{name, args} or #FReq{name, args}
+fn u32 omni_ffi_request_args(Term req, Term *args_list) {
+  u32 loc = term_val(req);
+  u32 name_nick = omni_ffi_name_nick(HEAP[loc]);
+  *args_list = wnf(HEAP[loc + 1]);
+  return name_nick;
+}
+
+// Hand a new future to its entry's completion engine (the start stage,
+// registry.c); returns 0 if it has to go to a worker instead
+fn int omni_ffi_start(OmniFFIFuture *f, int more) {
+  return f->entry && f->entry->start && f->entry->start(f->payload, f, more);
+}
+
+// #FAsy{name, args} -> #Pend{...}
+fn Term omni_ffi_dispatch_async(Term node) {
+  Term args_list;
+  u32 name_nick = omni_ffi_request_args(node, &args_list);
+
+  OmniFFIFuture *f = omni_ffi_future_new(name_nick, args_list);
+  if (!f) {
+    Term err_args[1] = {term_new_num(ENOMEM)};
+    return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+  }
+
+  int queue = !omni_ffi_future_ready(f);
+  Term pending = omni_ffi_future_term(f);
+  if (queue && term_ext(pending) == OMNI_NAM_PEND && !omni_ffi_start(f, 0)) {
+    omni_ffi_submit(f);
+  }
+  return pending;
+}
+
+// #FAsB{[#FReq{name, args} ...]} -> [#Pend{...} ...]
+// All arguments are read first, then every call is queued in one go
+fn Term omni_ffi_dispatch_batch(Term node) {
+  u32 cap = 16, len = 0, queued = 0;
+  Term *pending = (Term*)malloc(cap * sizeof(Term));
+  OmniFFIFuture **tasks = (OmniFFIFuture**)malloc(cap * sizeof(OmniFFIFuture*));
+
+  Term cur = wnf(HEAP[term_val(node)]);
+  while (pending && tasks && term_tag(cur) == C02 && term_ext(cur) == NAM_CON) {
+    u32 loc = term_val(cur);
+    Term req = wnf(HEAP[loc]);
+    cur = wnf(HEAP[loc + 1]);
+
+    if (len == cap) {
+      cap *= 2;
+      Term *p = (Term*)realloc(pending, cap * sizeof(Term));
+      if (p) pending = p;
+      OmniFFIFuture **t = (OmniFFIFuture**)realloc(tasks, cap * sizeof(OmniFFIFuture*));
+      if (t) tasks = t;
+      if (!p || !t) break;
+    }
+
+    Term args_list;
+    u32 name_nick = omni_ffi_request_args(req, &args_list);
+    OmniFFIFuture *f = omni_ffi_future_new(name_nick, args_list);
+    if (!f) {
+      Term err_args[1] = {term_new_num(ENOMEM)};
+      pending[len++] = term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+      continue;
+    }
+    int queue = !omni_ffi_future_ready(f);
+    pending[len] = omni_ffi_future_term(f);
+    if (queue && term_ext(pending[len]) == OMNI_NAM_PEND) {
+      tasks[queued++] = f;
+    }
+    len++;
+  }
+
+  // Calls with a start stage are submitted to their engine together; the
+  // rest, and any the engine declines, go to the workers
+  u32 startable = 0, pooled = 0;
+  for (u32 i = 0; i < queued; i++) {
+    if (tasks[i]->entry && tasks[i]->entry->start) startable++;
+  }
+  for (u32 i = 0; i < queued; i++) {
+    if (tasks[i]->entry && tasks[i]->entry->start) {
+      startable--;
+      if (omni_ffi_start(tasks[i], startable > 0)) continue;
+    }
+    tasks[pooled++] = tasks[i];
+  }
+  if (pooled > 0) {
+    omni_ffi_submit_batch(tasks, pooled);
+  }
+
+  Term result = term_new_ctr(NAM_NIL, 0, NULL);
+  for (u32 i = len; i > 0; i--) {
+    Term con_args[2] = {pending[i - 1], result};
+    result = term_new_ctr(NAM_CON, 2, con_args);
+  }
+  free(pending);
+  free(tasks);
+  return result;
+}
+
+// #FAwt{future} -> result
+fn Term omni_ffi_dispatch_await(Term node) {
+  return omni_ffi_await(wnf(HEAP[term_val(node)]));
+}
+
+// #FAwA{futures} -> results
+fn Term omni_ffi_dispatch_await_all(Term node) {
+  return omni_ffi_await_all(HEAP[term_val(node)]);
+}
+
+// #FAwN{futures} -> (index result remaining)
+fn Term omni_ffi_dispatch_await_any(Term node) {
+  return omni_ffi_await_any(HEAP[term_val(node)]);
+}
+
+// =============================================================================
+// Entry Point
+// =============================================================================
+
+// Nodes handled by omni_ffi_dispatch
+// ffi-map / ffi-reduce (vectorized.c)
+fn Term omni_ffi_dispatch_map(Term node);
+fn Term omni_ffi_dispatch_reduce(Term node);
+
+fn int omni_ffi_is_node(Term t) {
+  u8 tag = term_tag(t);
+  u32 ext = term_ext(t);
+  if (tag == C02) {
+    return ext == OMNI_NAM_FFI || ext == OMNI_NAM_FASY ||
+           ext == OMNI_NAM_FMAP || ext == OMNI_NAM_FRED;
+  }
+  if (tag == C01) {
+    return ext == OMNI_NAM_FASB || ext == OMNI_NAM_FAWT ||
+           ext == OMNI_NAM_FAWA || ext == OMNI_NAM_FAWN;
+  }
+  return 0;
+}
+
+// Dispatch an FFI node, with call count and time recorded for -s (a plain
+// #FFI call records its own, once it knows the entry is not internal)
+fn Term omni_ffi_dispatch(Term ffi_node) {
+  if (term_tag(ffi_node) == C02 && term_ext(ffi_node) == OMNI_NAM_FFI) {
+    return omni_ffi_dispatch_call(ffi_node);
+  }
+  u64 start = omni_stats_ffi_begin();
+  Term result = ffi_node;
+  if (term_tag(ffi_node) == C02 && term_ext(ffi_node) == OMNI_NAM_FASY) {
+    result = omni_ffi_dispatch_async(ffi_node);
+  } else if (term_tag(ffi_node) == C02 && term_ext(ffi_node) == OMNI_NAM_FMAP) {
+    result = omni_ffi_dispatch_map(ffi_node);
+  } else if (term_tag(ffi_node) == C02 && term_ext(ffi_node) == OMNI_NAM_FRED) {
+    result = omni_ffi_dispatch_reduce(ffi_node);
+  } else if (term_tag(ffi_node) == C01 && term_ext(ffi_node) == OMNI_NAM_FASB) {
+    result = omni_ffi_dispatch_batch(ffi_node);
+  } else if (term_tag(ffi_node) == C01 && term_ext(ffi_node) == OMNI_NAM_FAWT) {
+    result = omni_ffi_dispatch_await(ffi_node);
+  } else if (term_tag(ffi_node) == C01 && term_ext(ffi_node) == OMNI_NAM_FAWA) {
+    result = omni_ffi_dispatch_await_all(ffi_node);
+  } else if (term_tag(ffi_node) == C01 && term_ext(ffi_node) == OMNI_NAM_FAWN) {
+    result = omni_ffi_dispatch_await_any(ffi_node);
+  }
+  omni_stats_ffi_end(start);
+  return result;
+}
+
 // =============================================================================
 // Standard Library FFI Registration
 // =============================================================================
 
 fn void omni_ffi_register_stdlib(void) {
   // Memory
-  omni_ffi_register("mloc", (void*)malloc, OMNI_FFI_PTR_INT, OMNI_OWNED, 0);
-  omni_ffi_register("free", (void*)free, OMNI_FFI_VOID_PTR, OMNI_BORROWED, 0);
-  omni_ffi_register("rloc", (void*)realloc, OMNI_FFI_PTR_PTR_INT, OMNI_OWNED, 0);
-  omni_ffi_register("cloc", (void*)calloc, OMNI_FFI_VARIADIC, OMNI_OWNED, 0);
+  omni_ffi_register_sig("mloc", (void*)malloc, "ptr(u64)", OMNI_OWNED, 0);
+  omni_ffi_register_sig("free", (void*)free, "void(ptr)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("rloc", (void*)realloc, "ptr(ptr, u64)", OMNI_OWNED, 0);
+  omni_ffi_register_sig("cloc", (void*)calloc, "ptr(u64, u64)", OMNI_OWNED, 0);
 
   // I/O
-  omni_ffi_register("puts", (void*)puts, OMNI_FFI_INT_PTR, OMNI_BORROWED, 0);
-  omni_ffi_register("putc", (void*)putchar, OMNI_FFI_INT_INT, OMNI_BORROWED, 0);
-  omni_ffi_register("getc", (void*)getchar, OMNI_FFI_INT_VOID, OMNI_BORROWED, 0);
+  omni_ffi_register_sig("puts", (void*)puts, "i32(cstr)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("putc", (void*)putchar, "i32(i32)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("getc", (void*)getchar, "i32()", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("writ", (void*)write, "i64(i32, buf)", OMNI_BORROWED, 0);
 
   // File I/O
-  omni_ffi_register("fopn", (void*)fopen, OMNI_FFI_PTR_PTR_PTR, OMNI_OWNED, 0);
-  omni_ffi_register("fcls", (void*)fclose, OMNI_FFI_INT_PTR, OMNI_BORROWED, 0);
-  omni_ffi_register("frd", (void*)fread, OMNI_FFI_VARIADIC, OMNI_BORROWED, 0);
-  omni_ffi_register("fwrt", (void*)fwrite, OMNI_FFI_VARIADIC, OMNI_BORROWED, 0);
+  omni_ffi_register_sig("fopn", (void*)fopen, "ptr(cstr, cstr)", OMNI_OWNED, 0);
+  omni_ffi_register_sig("fcls", (void*)fclose, "i32(ptr)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("frd", (void*)fread, "u64(ptr, u64, u64, ptr)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("fwrt", (void*)fwrite, "u64(ptr, u64, u64, ptr)", OMNI_BORROWED, 0);
+
+  // Futures dropped unawaited
+  omni_ffi_handle_on_drop(OMNI_NAM_PEND, omni_ffi_future_drop);
+
+  // Handle scopes (with-handle-scope)
+  omni_ffi_register_internal(OMNI_NAM_HSCB, omni_ffi_handle_scope_open);
+  omni_ffi_register_internal(OMNI_NAM_HSCE, omni_ffi_handle_scope_close);
+
+  // Math (libm)
+  omni_ffi_register_sig("sqrt", (void*)sqrt, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("cbrt", (void*)cbrt, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("pow", (void*)pow, "f64(f64, f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("exp", (void*)exp, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("log", (void*)log, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("sin", (void*)sin, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("cos", (void*)cos, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("tan", (void*)tan, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("atan", (void*)atan, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("fabs", (void*)fabs, "f64(f64)", OMNI_BORROWED, 0);
+  omni_ffi_register_sig("hypot", (void*)hypot, "f64(f64, f64)", OMNI_BORROWED, 0);
 }
 
@@ -0,0 +1,577 @@
+// OmniLisp io_uring File Engine
+// Async read-file, write-file, append-file and copy-file without a worker
+//
+// An async file call (async, async-batch; see thread_pool.c) normally does
+// its blocking part on an FFI worker. Here it becomes a chain of kernel
+// requests instead: open, read or write until done, close. The submitting
+// thread queues the first request; a batch queues all of them and enters
+// the kernel once. A completion thread reaps results, queues each call's
+// next request and completes the future once the file is closed, so no
+// thread sits blocked on a file while the kernel works.
+//
+// The ring is set up by the first async file call. If io_uring is missing
+// (old kernel, seccomp, an opcode the kernel lacks) or OMNI_IO_URING=0, the
+// start stage declines and the calls go to the workers as before. It also
+// declines while OMNI_URING_MAX_OPS calls are in flight: every call has at
+// most one request outstanding, so the queues can never overflow. Should the
+// reaper's io_uring_enter fail, the calls in flight complete with its errno
+// and later ones go to the workers.
+//
+// The kernel is reached through raw syscalls, without liburing.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// =============================================================================
+// Configuration
+// =============================================================================
+
+#define OMNI_URING_ENTRIES   256                    // Submission queue size
+#define OMNI_URING_MAX_OPS   OMNI_URING_ENTRIES     // Calls in flight
+#define OMNI_URING_CHUNK     (256 * 1024)           // copy-file buffer
+#define OMNI_URING_MAX_IO    (1u << 30)             // Bytes per read/write request
+#define OMNI_URING_STOP      0                      // user_data of the shutdown NOP
+
+// =============================================================================
+// Ring
+// =============================================================================
+
+typedef struct {
+  int    fd;
+  int    ready;                // Set up and reaping
+  // Submission queue (shared with the kernel)
+  u32   *sq_head;
+  u32   *sq_tail;
+  u32   *sq_mask;
+  u32   *sq_entries;
+  u32   *sq_array;
+  struct io_uring_sqe *sqes;
+  u32    to_submit;            // Queued since the last io_uring_enter
+  // Completion queue (shared with the kernel)
+  u32   *cq_head;
+  u32   *cq_tail;
+  u32   *cq_mask;
+  struct io_uring_cqe *cqes;
+  // Mappings
+  void  *sq_map;
+  void  *cq_map;
+  size_t sq_map_size;
+  size_t cq_map_size;
+  size_t sqes_size;
+  pthread_mutex_t lock;        // Submission queue, shared by all submitters
+  pthread_t reaper;
+  atomic_uint inflight;
+  struct OmniUringOp *ops;     // Calls in flight, under lock
+} OmniUring;
+
+static OmniUring OMNI_URING = {.fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER};
+static pthread_once_t OMNI_URING_ONCE = PTHREAD_ONCE_INIT;
+
+// =============================================================================
+// File Calls
+// =============================================================================
+
+typedef enum {
+  OMNI_URING_READ,
+  OMNI_URING_WRITE,
+  OMNI_URING_APPEND,
+  OMNI_URING_COPY,
+} OmniUringKind;
+
+typedef enum {
+  OMNI_URING_OPEN,             // Source (or the only file)
+  OMNI_URING_OPEN_DST,         // copy-file destination
+  OMNI_URING_RD,
+  OMNI_URING_WR,
+  OMNI_URING_CLOSE,
+  OMNI_URING_CLOSE_DST,
+} OmniUringStep;
+
+typedef struct OmniUringOp {
+  struct OmniUringOp *prev;    // Calls in flight (OMNI_URING.ops)
+  struct OmniUringOp *next;
+  OmniIOJob *job;              // io.c; result or err goes here
+  void      *future;           // OmniFFIFuture to complete
+  u8         kind;
+  u8         step;             // Request in flight
+  int        fd;               // -1 when not open
+  int        dst;
+  char      *buf;              // read-file: job->data; copy-file: chunk
+  size_t     size;             // read-file: file size; copy-file: bytes in chunk
+  size_t     off;              // File offset of the next read or write
+  size_t     done;             // copy-file: bytes of the chunk written
+} OmniUringOp;
+
+// =============================================================================
+// Submission
+// =============================================================================
+
+// Enter the kernel with everything queued (lock held)
+fn void omni_uring_flush_locked(void) {
+  while (OMNI_URING.to_submit > 0) {
+    long n = syscall(__NR_io_uring_enter, OMNI_URING.fd, OMNI_URING.to_submit, 0, 0, NULL, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    OMNI_URING.to_submit -= (u32)n;
+  }
+}
+
+// Next free submission entry, cleared (lock held)
+fn struct io_uring_sqe* omni_uring_sqe_locked(void) {
+  u32 tail = *OMNI_URING.sq_tail;
+  if (tail - __atomic_load_n(OMNI_URING.sq_head, __ATOMIC_ACQUIRE) == *OMNI_URING.sq_entries) {
+    omni_uring_flush_locked();
+    if (tail - __atomic_load_n(OMNI_URING.sq_head, __ATOMIC_ACQUIRE) == *OMNI_URING.sq_entries) {
+      return NULL;
+    }
+  }
+  u32 idx = tail & *OMNI_URING.sq_mask;
+  struct io_uring_sqe *sqe = &OMNI_URING.sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  OMNI_URING.sq_array[idx] = idx;
+  return sqe;
+}
+
+fn void omni_uring_publish_locked(void) {
+  __atomic_store_n(OMNI_URING.sq_tail, *OMNI_URING.sq_tail + 1, __ATOMIC_RELEASE);
+  OMNI_URING.to_submit++;
+}
+
+// Queue the request for op->step (lock held); returns 0 if the queue is full
+fn int omni_uring_queue_locked(OmniUringOp *op) {
+  struct io_uring_sqe *sqe = omni_uring_sqe_locked();
+  if (!sqe) return 0;
+  OmniIOJob *job = op->job;
+  sqe->user_data = (u64)(uintptr_t)op;
+
+  switch (op->step) {
+    case OMNI_URING_OPEN: {
+      int flags = O_RDONLY;
+      if (op->kind == OMNI_URING_WRITE)  flags = O_WRONLY | O_CREAT | O_TRUNC;
+      if (op->kind == OMNI_URING_APPEND) flags = O_WRONLY | O_CREAT | O_APPEND;
+      sqe->opcode = IORING_OP_OPENAT;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = (u64)(uintptr_t)job->path;
+      sqe->len = 0666;
+      sqe->open_flags = flags | O_CLOEXEC;
+      break;
+    }
+    case OMNI_URING_OPEN_DST:
+      sqe->opcode = IORING_OP_OPENAT;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = (u64)(uintptr_t)job->path2;
+      sqe->len = 0666;
+      sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+      break;
+    case OMNI_URING_RD: {
+      int copy = op->kind == OMNI_URING_COPY;
+      size_t want = copy ? OMNI_URING_CHUNK : op->size - op->off;
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = op->fd;
+      sqe->addr = (u64)(uintptr_t)(copy ? op->buf : op->buf + op->off);
+      sqe->len = want < OMNI_URING_MAX_IO ? (u32)want : OMNI_URING_MAX_IO;
+      sqe->off = op->off;
+      break;
+    }
+    case OMNI_URING_WR: {
+      int copy = op->kind == OMNI_URING_COPY;
+      size_t want = copy ? op->size - op->done : job->len - op->off;
+      sqe->opcode = IORING_OP_WRITE;
+      sqe->fd = copy ? op->dst : op->fd;
+      sqe->addr = (u64)(uintptr_t)(copy ? op->buf + op->done : job->data + op->off);
+      sqe->len = want < OMNI_URING_MAX_IO ? (u32)want : OMNI_URING_MAX_IO;
+      // copy-file has already advanced off past the chunk; O_APPEND ignores it
+      sqe->off = copy ? op->off - op->size + op->done : op->off;
+      break;
+    }
+    case OMNI_URING_CLOSE:
+      sqe->opcode = IORING_OP_CLOSE;
+      sqe->fd = op->fd;
+      break;
+    case OMNI_URING_CLOSE_DST:
+      sqe->opcode = IORING_OP_CLOSE;
+      sqe->fd = op->dst;
+      break;
+  }
+  omni_uring_publish_locked();
+  return 1;
+}
+
+// =============================================================================
+// Completion
+// =============================================================================
+
+// Complete op's future and free it (lock held)
+fn void omni_uring_finish(OmniUringOp *op) {
+  OmniIOJob *job = op->job;
+  if (op->prev) op->prev->next = op->next;
+  else OMNI_URING.ops = op->next;
+  if (op->next) op->next->prev = op->prev;
+
+  if (op->kind == OMNI_URING_READ) {
+    job->data = op->buf;
+    job->len = op->off;
+    if (job->data) job->data[job->len] = '\0';
+  } else if (op->kind == OMNI_URING_COPY) {
+    free(op->buf);
+  }
+  void *future = op->future;
+  free(op);
+  atomic_fetch_sub_explicit(&OMNI_URING.inflight, 1, memory_order_relaxed);
+  omni_ffi_future_complete((OmniFFIFuture*)future);
+}
+
+// Close whatever is still open, then finish
+fn int omni_uring_closing(OmniUringOp *op) {
+  if (op->fd >= 0)  return OMNI_URING_CLOSE;
+  if (op->dst >= 0) return OMNI_URING_CLOSE_DST;
+  return -1;
+}
+
+// Advance op after its request completed with res (lock held)
+fn void omni_uring_step_locked(OmniUringOp *op, int res) {
+  OmniIOJob *job = op->job;
+  int retry = res == -EINTR || res == -EAGAIN;
+  int next = -1;
+
+  switch (op->step) {
+    case OMNI_URING_OPEN:
+      if (res < 0) {
+        job->err = -res;
+        break;
+      }
+      op->fd = res;
+      if (op->kind == OMNI_URING_READ) {
+        struct stat st;
+        if (fstat(op->fd, &st) != 0) {
+          job->err = errno;
+        } else if (st.st_size > 100000000) {  // 100MB limit, as omni_io_read_path
+          job->err = EFBIG;
+        } else if (!(op->buf = (char*)malloc((size_t)st.st_size + 1))) {
+          job->err = ENOMEM;
+        } else {
+          op->size = (size_t)st.st_size;
+          next = op->size > 0 ? OMNI_URING_RD : OMNI_URING_CLOSE;
+        }
+      } else if (op->kind == OMNI_URING_COPY) {
+        next = OMNI_URING_OPEN_DST;
+      } else {
+        next = job->len > 0 ? OMNI_URING_WR : OMNI_URING_CLOSE;
+      }
+      break;
+
+    case OMNI_URING_OPEN_DST:
+      if (res < 0) {
+        job->err = -res;
+      } else if (!(op->buf = (char*)malloc(OMNI_URING_CHUNK))) {
+        op->dst = res;
+        job->err = ENOMEM;
+      } else {
+        op->dst = res;
+        next = OMNI_URING_RD;
+      }
+      break;
+
+    case OMNI_URING_RD:
+      if (retry) {
+        next = OMNI_URING_RD;
+      } else if (res < 0) {
+        job->err = -res;
+      } else if (op->kind == OMNI_URING_COPY) {
+        op->off += (size_t)res;
+        op->size = (size_t)res;
+        op->done = 0;
+        next = res > 0 ? OMNI_URING_WR : OMNI_URING_CLOSE;
+      } else {
+        op->off += (size_t)res;
+        // A file that shrank since fstat ends at the short read
+        next = res > 0 && op->off < op->size ? OMNI_URING_RD : OMNI_URING_CLOSE;
+      }
+      break;
+
+    case OMNI_URING_WR:
+      if (retry) {
+        next = OMNI_URING_WR;
+      } else if (res <= 0) {
+        job->err = res < 0 ? -res : EIO;
+      } else if (op->kind == OMNI_URING_COPY) {
+        op->done += (size_t)res;
+        next = op->done < op->size ? OMNI_URING_WR : OMNI_URING_RD;
+      } else {
+        op->off += (size_t)res;
+        next = op->off < job->len ? OMNI_URING_WR : OMNI_URING_CLOSE;
+      }
+      break;
+
+    case OMNI_URING_CLOSE:
+    case OMNI_URING_CLOSE_DST:
+      if (op->step == OMNI_URING_CLOSE) op->fd = -1;
+      else op->dst = -1;
+      if (res < 0 && !job->err) job->err = -res;
+      break;
+  }
+
+  if (next < 0) next = omni_uring_closing(op);
+  if (next < 0) {
+    omni_uring_finish(op);
+    return;
+  }
+  op->step = (u8)next;
+  if (!omni_uring_queue_locked(op)) {
+    // Cannot happen while each call holds at most one entry
+    if (!job->err) job->err = EAGAIN;
+    if (op->fd >= 0) close(op->fd);
+    if (op->dst >= 0) close(op->dst);
+    omni_uring_finish(op);
+  }
+}
+
+// The ring is unusable: complete every call in flight with err (lock held).
+// Their requests may still be with the kernel, so buffers it could write to
+// are left allocated rather than freed under it.
+fn void omni_uring_fail_locked(int err) {
+  while (OMNI_URING.ops) {
+    OmniUringOp *op = OMNI_URING.ops;
+    if (!op->job->err) op->job->err = err;
+    if (op->fd >= 0) close(op->fd);
+    if (op->dst >= 0) close(op->dst);
+    op->fd = op->dst = -1;
+    op->buf = NULL;
+    op->off = 0;
+    omni_uring_finish(op);
+  }
+}
+
+fn void* omni_uring_reaper(void *arg) {
+  (void)arg;
+  int stopping = 0;
+  for (;;) {
+    long n = syscall(__NR_io_uring_enter, OMNI_URING.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (n < 0 && errno != EINTR) {
+      int err = errno;
+      pthread_mutex_lock(&OMNI_URING.lock);
+      omni_uring_fail_locked(err);
+      // Unless shutdown is already waiting to join, nobody will
+      if (OMNI_URING.ready) pthread_detach(pthread_self());
+      OMNI_URING.ready = 0;
+      pthread_mutex_unlock(&OMNI_URING.lock);
+      return NULL;
+    }
+
+    pthread_mutex_lock(&OMNI_URING.lock);
+    u32 head = *OMNI_URING.cq_head;
+    u32 tail = __atomic_load_n(OMNI_URING.cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      struct io_uring_cqe *cqe = &OMNI_URING.cqes[head & *OMNI_URING.cq_mask];
+      if (cqe->user_data == OMNI_URING_STOP) {
+        stopping = 1;
+      } else {
+        omni_uring_step_locked((OmniUringOp*)(uintptr_t)cqe->user_data, cqe->res);
+      }
+    }
+    __atomic_store_n(OMNI_URING.cq_head, head, __ATOMIC_RELEASE);
+    omni_uring_flush_locked();
+    pthread_mutex_unlock(&OMNI_URING.lock);
+
+    // Calls still in flight at shutdown are seen through
+    if (stopping && atomic_load(&OMNI_URING.inflight) == 0) return NULL;
+  }
+}
+
+// =============================================================================
+// Setup / Shutdown
+// =============================================================================
+
+// Every opcode the engine issues is supported
+fn int omni_uring_probe(int fd) {
+  size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe *probe = (struct io_uring_probe*)calloc(1, len);
+  if (!probe) return 0;
+  int ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+  const u8 need[] = {IORING_OP_NOP, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE};
+  for (u32 i = 0; ok && i < sizeof(need); i++) {
+    ok = need[i] <= probe->last_op && (probe->ops[need[i]].flags & IO_URING_OP_SUPPORTED);
+  }
+  free(probe);
+  return ok;
+}
+
+fn void omni_uring_unmap(void) {
+  if (OMNI_URING.sqes) munmap(OMNI_URING.sqes, OMNI_URING.sqes_size);
+  if (OMNI_URING.cq_map && OMNI_URING.cq_map != OMNI_URING.sq_map) {
+    munmap(OMNI_URING.cq_map, OMNI_URING.cq_map_size);
+  }
+  if (OMNI_URING.sq_map) munmap(OMNI_URING.sq_map, OMNI_URING.sq_map_size);
+  if (OMNI_URING.fd >= 0) close(OMNI_URING.fd);
+  OMNI_URING.sqes = NULL;
+  OMNI_URING.cq_map = OMNI_URING.sq_map = NULL;
+  OMNI_URING.fd = -1;
+}
+
+fn void* omni_uring_map(size_t size, u64 offset) {
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 OMNI_URING.fd, (off_t)offset);
+  return p == MAP_FAILED ? NULL : p;
+}
+
+fn void omni_uring_setup(void) {
+  const char *env = getenv("OMNI_IO_URING");
+  if (env && strcmp(env, "0") == 0) return;
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  OMNI_URING.fd = (int)syscall(__NR_io_uring_setup, OMNI_URING_ENTRIES, &p);
+  if (OMNI_URING.fd < 0) {
+    OMNI_URING.fd = -1;
+    return;
+  }
+  if (!(p.features & IORING_FEAT_NODROP) || !omni_uring_probe(OMNI_URING.fd)) {
+    omni_uring_unmap();
+    return;
+  }
+
+  OMNI_URING.sq_map_size = p.sq_off.array + p.sq_entries * sizeof(u32);
+  OMNI_URING.cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single && OMNI_URING.cq_map_size > OMNI_URING.sq_map_size) {
+    OMNI_URING.sq_map_size = OMNI_URING.cq_map_size;
+  }
+  OMNI_URING.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  OMNI_URING.sq_map = omni_uring_map(OMNI_URING.sq_map_size, IORING_OFF_SQ_RING);
+  OMNI_URING.cq_map = single ? OMNI_URING.sq_map
+                             : omni_uring_map(OMNI_URING.cq_map_size, IORING_OFF_CQ_RING);
+  OMNI_URING.sqes = (struct io_uring_sqe*)omni_uring_map(OMNI_URING.sqes_size, IORING_OFF_SQES);
+  if (!OMNI_URING.sq_map || !OMNI_URING.cq_map || !OMNI_URING.sqes) {
+    omni_uring_unmap();
+    return;
+  }
+
+  char *sq = (char*)OMNI_URING.sq_map;
+  OMNI_URING.sq_head    = (u32*)(sq + p.sq_off.head);
+  OMNI_URING.sq_tail    = (u32*)(sq + p.sq_off.tail);
+  OMNI_URING.sq_mask    = (u32*)(sq + p.sq_off.ring_mask);
+  OMNI_URING.sq_entries = (u32*)(sq + p.sq_off.ring_entries);
+  OMNI_URING.sq_array   = (u32*)(sq + p.sq_off.array);
+
+  char *cq = (char*)OMNI_URING.cq_map;
+  OMNI_URING.cq_head = (u32*)(cq + p.cq_off.head);
+  OMNI_URING.cq_tail = (u32*)(cq + p.cq_off.tail);
+  OMNI_URING.cq_mask = (u32*)(cq + p.cq_off.ring_mask);
+  OMNI_URING.cqes    = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+  if (pthread_create(&OMNI_URING.reaper, NULL, omni_uring_reaper, NULL) != 0) {
+    omni_uring_unmap();
+    return;
+  }
+  OMNI_URING.ready = 1;
+}
+
+// Let the calls in flight finish, then stop the reaper and release the ring
+fn void omni_uring_shutdown(void) {
+  pthread_mutex_lock(&OMNI_URING.lock);
+  if (!OMNI_URING.ready) {
+    pthread_mutex_unlock(&OMNI_URING.lock);
+    return;
+  }
+  OMNI_URING.ready = 0;
+  struct io_uring_sqe *sqe = omni_uring_sqe_locked();
+  if (sqe) {
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = OMNI_URING_STOP;
+    omni_uring_publish_locked();
+  }
+  omni_uring_flush_locked();
+  pthread_mutex_unlock(&OMNI_URING.lock);
+
+  if (!sqe) return;  // No room to signal the reaper; leave the ring to exit
+  pthread_join(OMNI_URING.reaper, NULL);
+  omni_uring_unmap();
+}
+
+// =============================================================================
+// Start Stages
+// =============================================================================
+
+// Queue the first request of a file call; see OmniFFIStartFn (registry.c)
+fn int omni_uring_start(OmniIOJob *job, void *future, int more, OmniUringKind kind) {
+  pthread_once(&OMNI_URING_ONCE, omni_uring_setup);
+  if (!OMNI_URING.ready) return 0;
+
+  // Calls that failed in prepare go to a worker, which just reports err
+  OmniUringOp *op = NULL;
+  if (job && !job->err) {
+    if (atomic_fetch_add_explicit(&OMNI_URING.inflight, 1, memory_order_relaxed) < OMNI_URING_MAX_OPS) {
+      op = (OmniUringOp*)calloc(1, sizeof(OmniUringOp));
+    }
+    if (!op) atomic_fetch_sub_explicit(&OMNI_URING.inflight, 1, memory_order_relaxed);
+  }
+
+  pthread_mutex_lock(&OMNI_URING.lock);
+  int ok = 0;
+  if (op && OMNI_URING.ready) {  // The reaper may have failed since
+    op->job = job;
+    op->future = future;
+    op->kind = (u8)kind;
+    op->step = OMNI_URING_OPEN;
+    op->fd = op->dst = -1;
+    ok = omni_uring_queue_locked(op);
+    if (ok) {
+      op->next = OMNI_URING.ops;
+      if (op->next) op->next->prev = op;
+      OMNI_URING.ops = op;
+    }
+  }
+  // A declined call leaves nothing pending, even in the middle of a batch
+  if (!more || !ok) omni_uring_flush_locked();
+  pthread_mutex_unlock(&OMNI_URING.lock);
+
+  if (op && !ok) {
+    free(op);
+    atomic_fetch_sub_explicit(&OMNI_URING.inflight, 1, memory_order_relaxed);
+  }
+  return ok;
+}
+
+fn int omni_uring_start_read(void *payload, void *future, int more) {
+  return omni_uring_start((OmniIOJob*)payload, future, more, OMNI_URING_READ);
+}
+
+fn int omni_uring_start_write(void *payload, void *future, int more) {
+  return omni_uring_start((OmniIOJob*)payload, future, more, OMNI_URING_WRITE);
+}
+
+fn int omni_uring_start_append(void *payload, void *future, int more) {
+  return omni_uring_start((OmniIOJob*)payload, future, more, OMNI_URING_APPEND);
+}
+
+fn int omni_uring_start_copy(void *payload, void *future, int more) {
+  return omni_uring_start((OmniIOJob*)payload, future, more, OMNI_URING_COPY);
+}
+
+// =============================================================================
+// Registration
+// =============================================================================
+
+// After omni_ffi_register_io: the staged file entries get a start stage
+fn void omni_ffi_register_uring(void) {
+  omni_ffi_register_start(OMNI_NAM_RDFL, omni_uring_start_read);
+  omni_ffi_register_start(OMNI_NAM_RDFB, omni_uring_start_read);
+  omni_ffi_register_start(OMNI_NAM_WRFL, omni_uring_start_write);
+  omni_ffi_register_start(OMNI_NAM_APFL, omni_uring_start_append);
+  omni_ffi_register_start(OMNI_NAM_CPFL, omni_uring_start_copy);
+}
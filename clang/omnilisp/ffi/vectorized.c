@@ -0,0 +1,303 @@
+// OmniLisp Vectorized FFI Calls
+// One crossing for a whole collection: (ffi-map ...) and (ffi-reduce ...)
+//
+//   (ffi-map "lib" "fn" coll args...)          -> #FMap{name, [coll args...]}
+//   (ffi-reduce "lib" "fn" init coll args...)  -> #FRed{name, [init coll args...]}
+//
+// fn must be registered with a signature (signature.c). ffi-map calls it once
+// per element of coll (a list or an array) as fn(x, args...) and returns the
+// results as an array; ffi-reduce folds acc = fn(acc, x, args...) from init
+// and returns acc. Arguments and elements are scalars (numbers, floats,
+// pointers).
+//
+// Elements are marshalled once into a flat buffer of raw register values.
+// The C loop then calls the thunk with one frame, rewriting only the
+// element's register, and stores raw results in a second buffer; Terms are
+// built once more at the end. Nothing between the two touches the heap, so
+// a large ffi-map is cut into chunks and spread over the FFI workers, with
+// the calling thread doing one chunk itself. The function must then be
+// thread-safe, which every libm function is. ffi-reduce runs in order on the
+// calling thread.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// Configuration
+// =============================================================================
+
+#define OMNI_FFI_MAP_CHUNK   8192    // Elements per worker chunk; smaller maps run inline
+
+// =============================================================================
+// Kernel
+// =============================================================================
+
+// One run of fn over in[0..n); the frame holds the fixed arguments
+typedef struct {
+  const OmniFFISig *sig;
+  void *fn_ptr;
+  OmniFFIFrame frame;
+  u64 *reg;                    // The element's register in frame
+  const u64 *in;
+  u64 *out;
+  size_t n;
+} OmniFFIKernel;
+
+// Register of scalar argument i: the ABI hands them out in order, integer
+// and vector registers counted apart
+fn u64* omni_ffi_sig_slot(const OmniFFISig *sig, OmniFFIFrame *f, u32 i) {
+  u32 ni = 0, nd = 0;
+  for (u32 k = 0; k < i; k++) {
+    if (sig->args[k].classes[0] == OMNI_FFI_CLASS_SSE) nd++;
+    else ni++;
+  }
+  if (sig->args[i].classes[0] == OMNI_FFI_CLASS_SSE) return (u64*)&f->dv[nd];
+  return &f->iv[ni];
+}
+
+// Raw return bits as the argument bits of the same type: a callee leaves
+// the upper half of rax undefined for narrow integers
+fn u64 omni_ffi_sig_extend(u8 t, u64 bits) {
+  switch (t) {
+    case OMNI_FFI_T_I8:  return (u64)(int64_t)(int8_t)bits;
+    case OMNI_FFI_T_I16: return (u64)(int64_t)(int16_t)bits;
+    case OMNI_FFI_T_I32: return (u64)(int64_t)(int32_t)bits;
+    case OMNI_FFI_T_U8:  return (u8)bits;
+    case OMNI_FFI_T_U16: return (u16)bits;
+    case OMNI_FFI_T_U32: case OMNI_FFI_T_F32: return (u32)bits;
+    default:             return bits;
+  }
+}
+
+// Worker stage of a chunk (OmniFFIRunFn)
+fn void omni_ffi_kernel_run(void *payload) {
+  OmniFFIKernel *k = (OmniFFIKernel*)payload;
+  OmniFFIThunk thunk = OMNI_FFI_THUNKS[k->sig->ret_class];
+  for (size_t i = 0; i < k->n; i++) {
+    *k->reg = k->in[i];
+    thunk(k->fn_ptr, &k->frame);
+    k->out[i] = k->frame.ret[0];
+  }
+}
+
+// Runs chunks queued on the pool; never looked up by name
+static OmniFFIEntry OMNI_FFI_KERNEL_ENTRY = {
+  .run = omni_ffi_kernel_run,
+};
+
+// Run k, split over the FFI workers when it is large enough
+fn void omni_ffi_kernel_exec(OmniFFIKernel *k) {
+  size_t chunks = k->n / OMNI_FFI_MAP_CHUNK;
+  if (chunks < 2) {
+    omni_ffi_kernel_run(k);
+    return;
+  }
+  omni_ffi_pool_init();
+  if (chunks > OMNI_FFI_POOL.started + 1) chunks = OMNI_FFI_POOL.started + 1;
+  if (chunks > OMNI_FFI_MAX_WORKERS) chunks = OMNI_FFI_MAX_WORKERS;
+
+  OmniFFIKernel parts[OMNI_FFI_MAX_WORKERS];
+  OmniFFIFuture futures[OMNI_FFI_MAX_WORKERS];
+  OmniFFIFuture *tasks[OMNI_FFI_MAX_WORKERS];
+  size_t per = (k->n + chunks - 1) / chunks;
+  size_t reg = (size_t)(k->reg - (u64*)&k->frame);
+
+  // Chunk 0 stays here, the rest go to the workers
+  for (size_t c = 0; c < chunks; c++) {
+    OmniFFIKernel *p = &parts[c];
+    *p = *k;
+    p->reg = (u64*)&p->frame + reg;
+    p->in = k->in + c * per;
+    p->out = k->out + c * per;
+    p->n = c + 1 < chunks ? per : k->n - c * per;
+    memset(&futures[c], 0, sizeof(OmniFFIFuture));
+    futures[c].entry = &OMNI_FFI_KERNEL_ENTRY;
+    futures[c].payload = p;
+    tasks[c] = &futures[c];
+  }
+  omni_ffi_submit_batch(tasks + 1, (u32)(chunks - 1));
+  omni_ffi_kernel_run(&parts[0]);
+  omni_ffi_wait(tasks + 1, (u32)(chunks - 1), 1);
+}
+
+// =============================================================================
+// Collections
+// =============================================================================
+
+// Elements of a reduced list or #Arr{len, data}, marshalled as type t into
+// a malloc'd buffer; returns 0 and the errno value in *err on failure
+fn u64* omni_ffi_collect(Term coll, u8 t, size_t *n, int *err) {
+  if (term_tag(coll) == C02 && term_ext(coll) == OMNI_NAM_ARR) {
+    coll = wnf(HEAP[term_val(coll) + 1]);
+  }
+  size_t cap = 64;
+  u64 *buf = (u64*)malloc(cap * sizeof(u64));
+  *n = 0;
+  *err = ENOMEM;
+  if (!buf) return NULL;
+
+  OmniFFIFrame scratch;
+  scratch.ntemps = 0;
+  while (term_tag(coll) == C02 && term_ext(coll) == NAM_CON) {
+    u32 loc = term_val(coll);
+    if (*n == cap) {
+      u64 *b = (u64*)realloc(buf, cap * 2 * sizeof(u64));
+      if (!b) {
+        free(buf);
+        return NULL;
+      }
+      buf = b;
+      cap *= 2;
+    }
+    if (!omni_ffi_marshal_scalar(t, wnf(HEAP[loc]), &scratch, &buf[*n])) {
+      free(buf);
+      *err = EINVAL;
+      return NULL;
+    }
+    (*n)++;
+    coll = wnf(HEAP[loc + 1]);
+  }
+  if (term_tag(coll) != C00 || term_ext(coll) != NAM_NIL) {
+    free(buf);
+    *err = EINVAL;
+    return NULL;
+  }
+  *err = 0;
+  return buf;
+}
+
+// =============================================================================
+// Dispatch
+// =============================================================================
+
+fn Term omni_ffi_errno_term(int err) {
+  Term err_args[1] = {term_new_num(err)};
+  return term_new_ctr(OMNI_NAM_ERR, 1, err_args);
+}
+
+// Signature entry for a map or fold over argument pos of name_nick, with the
+// fixed arguments marshalled into k->frame. args is [first rest...]; the
+// collection element sits at pos and is filled in per call.
+fn int omni_ffi_kernel_new(OmniFFIKernel *k, OmniFFIEntry *e, Term args, u32 pos) {
+  memset(k, 0, sizeof(*k));
+  const OmniFFISig *sig = e->sig;
+  if (sig->nargs <= pos) return EINVAL;
+  for (u32 i = 0; i < sig->nargs; i++) {
+    u8 t = sig->args[i].type;
+    if (t == OMNI_FFI_T_STRUCT || t == OMNI_FFI_T_BUF || (i <= pos && t == OMNI_FFI_T_CSTR)) {
+      return EINVAL;
+    }
+  }
+  u8 r = sig->ret.type;
+  if (r == OMNI_FFI_T_STRUCT || r == OMNI_FFI_T_BUF || r == OMNI_FFI_T_CSTR) return EINVAL;
+
+  int err = omni_ffi_sig_marshal(sig, args, &k->frame);
+  if (err) {
+    omni_ffi_frame_free(&k->frame);
+    return err;
+  }
+  k->sig = sig;
+  k->fn_ptr = e->fn_ptr;
+  k->reg = omni_ffi_sig_slot(sig, &k->frame, pos);
+  return 0;
+}
+
+// Read #FMap / #FRed: entry of the name and the args list with the
+// collection (at index pos) replaced by a placeholder 0
+fn OmniFFIEntry* omni_ffi_kernel_args(Term node, u32 pos, Term *coll, Term *args) {
+  u32 name_nick = omni_ffi_request_args(node, args);
+  OmniFFIEntry *e = omni_ffi_lookup(name_nick);
+
+  // Copy the list up to the collection, so the original is left untouched
+  Term items[OMNI_FFI_SIG_MAX_ARGS + 1];
+  u32 n = 0;
+  Term cur = *args;
+  while (term_tag(cur) == C02 && term_ext(cur) == NAM_CON && n <= OMNI_FFI_SIG_MAX_ARGS) {
+    items[n++] = HEAP[term_val(cur)];
+    cur = wnf(HEAP[term_val(cur) + 1]);
+  }
+  if (n <= pos) return NULL;
+  *coll = wnf(items[pos]);
+  items[pos] = term_new_num(0);
+
+  Term list = term_new_ctr(NAM_NIL, 0, NULL);
+  for (u32 i = n; i > 0; i--) {
+    Term con_args[2] = {items[i - 1], list};
+    list = term_new_ctr(NAM_CON, 2, con_args);
+  }
+  *args = list;
+  return e;
+}
+
+// #FMap{name, [coll args...]} -> #Arr{n, results}
+fn Term omni_ffi_dispatch_map(Term node) {
+  Term coll, args;
+  OmniFFIEntry *e = omni_ffi_kernel_args(node, 0, &coll, &args);
+  if (!e) return term_new_ctr(OMNI_NAM_ERR, 0, NULL);
+  if (!e->sig) return omni_ffi_errno_term(EINVAL);
+
+  OmniFFIKernel k;
+  int err = omni_ffi_kernel_new(&k, e, args, 0);
+  if (err) return omni_ffi_errno_term(err);
+
+  size_t n;
+  u64 *in = omni_ffi_collect(coll, e->sig->args[0].type, &n, &err);
+  u64 *out = in ? (u64*)malloc((n ? n : 1) * sizeof(u64)) : NULL;
+  if (!out) {
+    free(in);
+    omni_ffi_frame_free(&k.frame);
+    return omni_ffi_errno_term(err ? err : ENOMEM);
+  }
+  k.in = in;
+  k.out = out;
+  k.n = n;
+  omni_ffi_kernel_exec(&k);
+  omni_ffi_frame_free(&k.frame);
+
+  u8 r = e->sig->ret.type;
+  Term list = term_new_ctr(NAM_NIL, 0, NULL);
+  for (size_t i = n; i > 0; i--) {
+    Term v = omni_ffi_scalar_term(r, out[i - 1], e->result_ownership, e->result_type_id);
+    Term con_args[2] = {v, list};
+    list = term_new_ctr(NAM_CON, 2, con_args);
+  }
+  free(in);
+  free(out);
+  Term arr_args[2] = {term_new_num((u32)n), list};  // raw length, as runtime arrays keep it
+  return term_new_ctr(OMNI_NAM_ARR, 2, arr_args);
+}
+
+// #FRed{name, [init coll args...]} -> fn(...fn(fn(init, x0), x1)..., xn-1)
+fn Term omni_ffi_dispatch_reduce(Term node) {
+  Term coll, args;
+  OmniFFIEntry *e = omni_ffi_kernel_args(node, 1, &coll, &args);
+  if (!e) return term_new_ctr(OMNI_NAM_ERR, 0, NULL);
+  if (!e->sig) return omni_ffi_errno_term(EINVAL);
+  const OmniFFISig *sig = e->sig;
+  if (sig->ret.type != sig->args[0].type) return omni_ffi_errno_term(EINVAL);
+
+  OmniFFIKernel k;
+  int err = omni_ffi_kernel_new(&k, e, args, 1);
+  if (err) return omni_ffi_errno_term(err);
+  u64 *acc = omni_ffi_sig_slot(sig, &k.frame, 0);
+
+  size_t n;
+  u64 *in = omni_ffi_collect(coll, sig->args[1].type, &n, &err);
+  if (!in) {
+    omni_ffi_frame_free(&k.frame);
+    return omni_ffi_errno_term(err);
+  }
+  OmniFFIThunk thunk = OMNI_FFI_THUNKS[sig->ret_class];
+  for (size_t i = 0; i < n; i++) {
+    *k.reg = in[i];
+    thunk(k.fn_ptr, &k.frame);
+    *acc = omni_ffi_sig_extend(sig->ret.type, k.frame.ret[0]);
+  }
+  free(in);
+  omni_ffi_frame_free(&k.frame);
+  return omni_ffi_scalar_term(sig->ret.type, *acc, e->result_ownership, e->result_type_id);
+}
@@ -0,0 +1,382 @@
+// OmniLisp Heap Checkpoints
+// Roll the global HEAP back to an earlier allocation point
+//
+// HVM4 allocates with a bump pointer (HEAP_NEXT) and never frees. Once the
+// result of an evaluation has been consumed, everything allocated for it is
+// garbage, so long-lived drivers (batch, REPL, server) take a mark after the
+// runtime is loaded and reset to it after each evaluation.
+//
+// A reset also undoes what the evaluation did to the book: BOOK entries
+// added or overwritten since the mark point into the discarded heap.
+//
+// With several reducer threads (eval/reducer.c) every thread bumps its own
+// heap slice, so a mark records the top of each slice.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// =============================================================================
+// Checkpoint
+// =============================================================================
+
+#define OMNI_HEAP_NEXT(t) HEAP_NEXT[(t) * 32]
+#define OMNI_HEAP_END(t)  HEAP_END[(t) * 32]
+
+typedef struct {
+  u64  heap_next[OMNI_MAX_REDUCERS];  // Top of each slice at the mark
+  u32  table_len;      // TABLE_LEN at the mark
+  u32 *book;           // Copy of BOOK[0..table_len)
+  u32  deps_loaded;    // Tree-shaken runtime state (load/deps.c)
+  u32  deps_live;
+} OmniHeapMark;
+
+// Record the current heap top and book
+fn void omni_heap_mark(OmniHeapMark *m) {
+  for (u32 t = 0; t < omni_reducer_count(); t++) {
+    m->heap_next[t] = OMNI_HEAP_NEXT(t);
+  }
+  m->table_len   = TABLE_LEN;
+  m->book        = (u32*)realloc(m->book, ((size_t)TABLE_LEN + 1) * sizeof(u32));
+  memcpy(m->book, BOOK, (size_t)TABLE_LEN * sizeof(u32));
+  m->deps_loaded = omni_deps_loaded_count();
+  m->deps_live   = omni_deps_live_count();
+}
+
+fn void omni_heap_mark_free(OmniHeapMark *m) {
+  free(m->book);
+  m->book = NULL;
+}
+
+// Zero HEAP[from..to). Whole pages are handed back to the kernel, which also
+// keeps the resident size of a long-running process flat.
+fn void omni_heap_clear(u64 from, u64 to) {
+  if (to <= from) return;
+  char *lo = (char*)&HEAP[from];
+  char *hi = (char*)&HEAP[to];
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  char *plo = (char*)(((uintptr_t)lo + page - 1) & ~(page - 1));
+  char *phi = (char*)((uintptr_t)hi & ~(page - 1));
+
+  if (phi > plo && madvise(plo, (size_t)(phi - plo), MADV_DONTNEED) == 0) {
+    memset(lo, 0, (size_t)(plo - lo));
+    memset(phi, 0, (size_t)(hi - phi));
+  } else {
+    memset(lo, 0, (size_t)(hi - lo));
+  }
+}
+
+// Discard everything allocated since the mark
+// TABLE names added since then are kept (their ids stay valid), but their
+// BOOK entries are cleared.
+fn void omni_heap_reset(OmniHeapMark *m) {
+  for (u32 id = m->table_len; id < TABLE_LEN; id++) {
+    BOOK[id] = 0;
+  }
+  memcpy(BOOK, m->book, (size_t)m->table_len * sizeof(u32));
+  omni_deps_rollback(m->deps_loaded, m->deps_live);
+  omni_profile_wrap_forget();
+
+  for (u32 t = 0; t < omni_reducer_count(); t++) {
+    omni_heap_clear(m->heap_next[t], OMNI_HEAP_NEXT(t));
+    OMNI_HEAP_NEXT(t) = m->heap_next[t];
+  }
+}
+
+// Words allocated since the mark, over all slices
+fn u64 omni_heap_used_since(OmniHeapMark *m) {
+  u64 used = 0;
+  for (u32 t = 0; t < omni_reducer_count(); t++) {
+    used += OMNI_HEAP_NEXT(t) - m->heap_next[t];
+  }
+  return used;
+}
+
+// Whether loc was allocated after the mark, in any slice
+fn int omni_heap_is_transient(OmniHeapMark *m, u64 loc) {
+  for (u32 t = 0; t < omni_reducer_count(); t++) {
+    if (loc >= m->heap_next[t] && loc < OMNI_HEAP_END(t)) return 1;
+  }
+  return 0;
+}
+
+// =============================================================================
+// Transmigration
+// =============================================================================
+//
+// Definitions made during an evaluation must survive the rollback. Before
+// resetting, everything BOOK reaches in the transient region is copied out,
+// and after the reset the copy is written back at the (new) heap top,
+// becoming part of the retained area.
+//
+// The copy follows constructors from every BOOK entry. A forwarding map from
+// old to new location keeps a node that several definitions (or one, twice)
+// refer to a single node. Retained constructors are walked as well: a write
+// in place (a generic function gaining a method, a list walked by the
+// printer or by PEvl) can leave one pointing into the transient region, and
+// such cells are patched after the reset. Numbers, REFs and nullary
+// constructors are immediate, and a packed string gets a header and bytes
+// of its own.
+//
+// Retained lambdas and other HVM4 terms belong to runtime definitions and
+// are not walked. A transient one (a lazily parsed runtime definition, an
+// unevaluated thunk) has a layout the copy does not know, so the commit
+// refuses: nothing is discarded, and the caller reports the heap it keeps.
+
+typedef struct {
+  Term *data;
+  u64   len;
+  u64   cap;
+} OmniTermBuf;
+
+fn u64 omni_term_buf_reserve(OmniTermBuf *b, u64 n) {
+  if (b->len + n > b->cap) {
+    b->cap = (b->len + n) * 2;
+    b->data = (Term*)realloc(b->data, b->cap * sizeof(Term));
+  }
+  u64 off = b->len;
+  b->len += n;
+  return off;
+}
+
+// Replace the location field of a heap-pointing term
+fn Term omni_term_with_loc(Term t, u64 loc) {
+  return (t & 0xFFFFFFFF00000000ULL) | (u32)loc;
+}
+
+#define OMNI_HEAP_FWD_KEPT UINT64_MAX   // Retained node, already walked
+
+// Forwarding map: old location -> offset of its copy in the buffer
+typedef struct {
+  u64 *keys;        // loc + 1; 0 is empty
+  u64 *vals;
+  u64  cap;         // Power of 2
+  u64  len;
+} OmniHeapFwd;
+
+fn u64 omni_heap_fwd_find(OmniHeapFwd *f, u64 loc) {
+  u64 mask = f->cap - 1;
+  u64 i = ((loc * 0x9E3779B97F4A7C15ULL) >> 24) & mask;
+  while (f->keys[i] != 0 && f->keys[i] != loc + 1) i = (i + 1) & mask;
+  return i;
+}
+
+fn int omni_heap_fwd_get(OmniHeapFwd *f, u64 loc, u64 *val) {
+  if (f->cap == 0) return 0;
+  u64 i = omni_heap_fwd_find(f, loc);
+  if (f->keys[i] == 0) return 0;
+  *val = f->vals[i];
+  return 1;
+}
+
+fn void omni_heap_fwd_put(OmniHeapFwd *f, u64 loc, u64 val) {
+  if ((f->len + 1) * 2 > f->cap) {
+    OmniHeapFwd g = {0};
+    g.cap = f->cap ? f->cap * 2 : 1024;
+    g.keys = (u64*)calloc(g.cap, sizeof(u64));
+    g.vals = (u64*)malloc(g.cap * sizeof(u64));
+    for (u64 i = 0; i < f->cap; i++) {
+      if (f->keys[i] == 0) continue;
+      u64 j = omni_heap_fwd_find(&g, f->keys[i] - 1);
+      g.keys[j] = f->keys[i];
+      g.vals[j] = f->vals[i];
+    }
+    g.len = f->len;
+    free(f->keys);
+    free(f->vals);
+    *f = g;
+  }
+  u64 i = omni_heap_fwd_find(f, loc);
+  if (f->keys[i] == 0) f->len++;
+  f->keys[i] = loc + 1;
+  f->vals[i] = val;
+}
+
+// A node whose fields are still to be walked: arity cells at src, copied to
+// dst in the buffer, or retained (dst OMNI_HEAP_FWD_KEPT) and patched in place
+typedef struct {
+  u64 src;
+  u64 dst;
+  u32 arity;
+} OmniHeapPending;
+
+typedef struct {
+  OmniHeapMark    *m;
+  u64              base;       // Heap index the buffer is written back at
+  OmniTermBuf      buf;
+  OmniHeapFwd      fwd;
+  OmniHeapPending *todo;
+  u32              todo_len;
+  u32              todo_cap;
+  u64             *patch_at;   // Retained cells to rewrite after the reset
+  Term            *patch_val;
+  u32              patch_len;
+  u32              patch_cap;
+  int              ok;         // Cleared on a term the copy cannot move
+} OmniHeapCopy;
+
+fn void omni_heap_copy_push(OmniHeapCopy *c, u64 src, u64 dst, u32 arity) {
+  if (c->todo_len == c->todo_cap) {
+    c->todo_cap = c->todo_cap ? c->todo_cap * 2 : 256;
+    c->todo = (OmniHeapPending*)realloc(c->todo, c->todo_cap * sizeof(OmniHeapPending));
+  }
+  c->todo[c->todo_len++] = (OmniHeapPending){src, dst, arity};
+}
+
+fn void omni_heap_copy_patch(OmniHeapCopy *c, u64 at, Term val) {
+  if (c->patch_len == c->patch_cap) {
+    c->patch_cap = c->patch_cap ? c->patch_cap * 2 : 64;
+    c->patch_at = (u64*)realloc(c->patch_at, c->patch_cap * sizeof(u64));
+    c->patch_val = (Term*)realloc(c->patch_val, c->patch_cap * sizeof(Term));
+  }
+  c->patch_at[c->patch_len] = at;
+  c->patch_val[c->patch_len] = val;
+  c->patch_len++;
+}
+
+// Forward declarations (pstring.c)
+fn u64 omni_pstr_copy_cells(u64 loc);
+fn void omni_pstr_copy_to(u64 loc, Term *out, u64 at);
+
+// The field of a #PStr: a transient header is copied with its bytes, once
+// however many nodes share it
+fn Term omni_heap_copy_pstr(OmniHeapCopy *c, Term n) {
+  if (term_tag(n) != NUM) {
+    c->ok = 0;
+    return n;
+  }
+  u64 loc = term_val(n);
+  if (!omni_heap_is_transient(c->m, loc)) return n;
+  u64 dst;
+  if (!omni_heap_fwd_get(&c->fwd, loc, &dst)) {
+    dst = omni_term_buf_reserve(&c->buf, omni_pstr_copy_cells(loc));
+    omni_pstr_copy_to(loc, &c->buf.data[dst], c->base + dst);
+    omni_heap_fwd_put(&c->fwd, loc, dst);
+  }
+  return term_new_num((u32)(c->base + dst));
+}
+
+// t as it reads after the commit: a transient node's first visit reserves
+// its copy and queues its fields, a retained constructor's first visit
+// queues its fields for patching
+fn Term omni_heap_copy_term(OmniHeapCopy *c, Term t) {
+  u8 tag = term_tag(t);
+  if (tag == NUM || tag == REF || tag == ERA || tag == C00) return t;
+  u64 loc = term_val(t);
+  int transient = omni_heap_is_transient(c->m, loc);
+  if (tag < C01 || tag > C16) {
+    if (transient) c->ok = 0;
+    return t;
+  }
+
+  u64 dst;
+  if (omni_heap_fwd_get(&c->fwd, loc, &dst)) {
+    return dst == OMNI_HEAP_FWD_KEPT ? t : omni_term_with_loc(t, c->base + dst);
+  }
+  u32 arity = tag - C00;
+  if (!transient) {
+    omni_heap_fwd_put(&c->fwd, loc, OMNI_HEAP_FWD_KEPT);
+    omni_heap_copy_push(c, loc, OMNI_HEAP_FWD_KEPT, arity);
+    return t;
+  }
+  dst = omni_term_buf_reserve(&c->buf, arity);
+  omni_heap_fwd_put(&c->fwd, loc, dst);
+  if (tag == C01 && term_ext(t) == OMNI_NAM_PSTR) {
+    Term n = omni_heap_copy_pstr(c, HEAP[loc]);
+    c->buf.data[dst] = n;
+  } else {
+    omni_heap_copy_push(c, loc, dst, arity);
+  }
+  return omni_term_with_loc(t, c->base + dst);
+}
+
+// Walk queued nodes until none are left or a term cannot be moved
+fn void omni_heap_copy_walk(OmniHeapCopy *c) {
+  while (c->ok && c->todo_len > 0) {
+    OmniHeapPending p = c->todo[--c->todo_len];
+    for (u32 i = 0; i < p.arity && c->ok; i++) {
+      Term old = HEAP[p.src + i];
+      Term moved = omni_heap_copy_term(c, old);
+      if (p.dst != OMNI_HEAP_FWD_KEPT) {
+        c->buf.data[p.dst + i] = moved;
+      } else if (moved != old) {
+        omni_heap_copy_patch(c, p.src + i, moved);
+      }
+    }
+  }
+}
+
+// Roll back to the mark, keeping everything BOOK reaches
+// Survivors are packed into thread 0's slice. Afterwards m marks the new
+// retained top. Returns 1 if transient memory was reclaimed, 0 if a
+// definition holds a term that cannot be moved (nothing is discarded).
+fn int omni_heap_commit(OmniHeapMark *m) {
+  u64 from = m->heap_next[0];
+  OmniHeapCopy c = {.m = m, .base = from, .ok = 1};
+  u32 *ids = NULL;
+  u64 *slots = NULL;
+  u32 count = 0;
+
+  // A BOOK entry is a one-cell node: new entries live above the mark, and
+  // entries updated in place are patched like any retained cell
+  for (u32 id = 0; id < TABLE_LEN && c.ok; id++) {
+    u64 loc = BOOK[id];
+    if (loc == 0) continue;
+    u64 dst;
+    if (omni_heap_fwd_get(&c.fwd, loc, &dst)) {
+      if (dst == OMNI_HEAP_FWD_KEPT) continue;
+    } else if (omni_heap_is_transient(m, loc)) {
+      dst = omni_term_buf_reserve(&c.buf, 1);
+      omni_heap_fwd_put(&c.fwd, loc, dst);
+      omni_heap_copy_push(&c, loc, dst, 1);
+    } else {
+      omni_heap_fwd_put(&c.fwd, loc, OMNI_HEAP_FWD_KEPT);
+      omni_heap_copy_push(&c, loc, OMNI_HEAP_FWD_KEPT, 1);
+      omni_heap_copy_walk(&c);
+      continue;
+    }
+    if ((count & (count - 1)) == 0) {
+      u32 n = count ? count * 2 : 16;
+      ids = (u32*)realloc(ids, n * sizeof(u32));
+      slots = (u64*)realloc(slots, n * sizeof(u64));
+    }
+    ids[count] = id;
+    slots[count] = dst;
+    count++;
+    omni_heap_copy_walk(&c);
+  }
+  if (c.ok && from + c.buf.len > OMNI_HEAP_END(0)) c.ok = 0;
+
+  // Every BOOK entry written since the mark survives, so the tree-shaken
+  // loader's state stays valid and is not rolled back here
+  if (c.ok) {
+    omni_profile_wrap_forget();
+    for (u32 t = 0; t < omni_reducer_count(); t++) {
+      omni_heap_clear(m->heap_next[t], OMNI_HEAP_NEXT(t));
+      OMNI_HEAP_NEXT(t) = m->heap_next[t];
+    }
+    memcpy(&HEAP[from], c.buf.data, c.buf.len * sizeof(Term));
+    for (u32 i = 0; i < c.patch_len; i++) {
+      HEAP[c.patch_at[i]] = c.patch_val[i];
+    }
+    for (u32 i = 0; i < count; i++) {
+      BOOK[ids[i]] = (u32)(from + slots[i]);
+    }
+    OMNI_HEAP_NEXT(0) = from + c.buf.len;
+  }
+
+  free(c.buf.data);
+  free(c.fwd.keys);
+  free(c.fwd.vals);
+  free(c.todo);
+  free(c.patch_at);
+  free(c.patch_val);
+  free(ids);
+  free(slots);
+  omni_heap_mark(m);
+  return c.ok;
+}
@@ -0,0 +1,588 @@
+// OmniLisp Runtime Dependency Index
+// Tree-shaken loading of the .hvm4 runtime
+//
+// Instead of parsing every definition in prelude/runtime/types/kinds.hvm4,
+// the loader indexes each top-level `@name = ...` by byte range and records
+// the @refs and #constructors its body mentions. Only the closure reachable
+// from the requested roots is handed to parse_def.
+//
+// @omni_eval is one 1400-line match over AST constructors, and most of its
+// arms pull in their own helpers. For the definitions in OMNI_DEPS_DISPATCH,
+// a ref inside a `#Name:` arm only counts once #Name is known to be live:
+// it appears in the parsed program, or some loaded definition builds it.
+//
+// The closure is computed before reduction starts: from the evaluator's
+// roots when the index is built, and from the program's AST and user
+// defines before each evaluation. Constructors that only C code builds (a
+// #Dict from json-parse, an #Arr from ffi-map, the #Err of a failed call)
+// never show up in either, so the ones listed in OMNI_DEPS_C_BUILT are live
+// from the start and their arms are part of every closure. Nothing scans
+// FFI results.
+//
+// BkGt (#FRef) can still name a definition outside the closure; it loads
+// the entry on first lookup. That parse runs on the reducer thread, so
+// main.c only shakes with a single reducer (-j 1).
+//
+// Shaking is opt-in (--shake-runtime); by default every definition is parsed.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// Index Structures
+// =============================================================================
+
+#define OMNI_DEPS_MAX_FILES 8
+#define OMNI_DEPS_ALWAYS    0xFFFFFFFF  // Gate for refs outside any arm
+#define OMNI_DEPS_NONE      0xFFFFFFFF  // Unresolved ref / missing name
+
+typedef struct {
+  u32 file;         // Index into OMNI_DEPS.files
+  u32 start;        // Byte offset of '@'
+  u32 end;          // Byte offset where the next definition starts
+  u32 line;         // Line number of start (for parse errors)
+  u32 name_off;     // Name (without '@') as offset/len into the source
+  u32 name_len;
+  u32 ref_first;    // Range in OMNI_DEPS.refs
+  u32 ref_count;
+  u32 ctr_first;    // Range in OMNI_DEPS.ctrs
+  u32 ctr_count;
+  u8  loaded;
+  u8  dispatch;     // Arms of its top-level matches are gated
+} OmniDepsDef;
+
+// A ref or constructor use, gated by the enclosing arm's constructor nick
+typedef struct {
+  u32 target;       // Def index (refs) or constructor nick (ctrs)
+  u32 gate;         // Constructor nick, or OMNI_DEPS_ALWAYS
+} OmniDepsUse;
+
+typedef struct {
+  const char  *paths[OMNI_DEPS_MAX_FILES];
+  char        *srcs[OMNI_DEPS_MAX_FILES];
+  u32          lens[OMNI_DEPS_MAX_FILES];
+  u32          file_count;
+
+  OmniDepsDef *defs;
+  u32          def_count;
+  u32          def_cap;
+
+  OmniDepsUse *refs;
+  u32          ref_count;
+  u32          ref_cap;
+
+  OmniDepsUse *ctrs;
+  u32          ctr_count;
+  u32          ctr_cap;
+
+  u32         *names;       // Open-addressed name -> def index
+  u32          names_cap;
+
+  u64         *live;        // Bitmap over the 24-bit constructor nick space
+  u32         *order;       // Loaded defs in load order (for rollback)
+  u32          loaded_count;
+  u32         *live_order;  // Live constructors in the order they were set
+  u32          live_count;
+  u32          live_cap;
+  int          active;
+} OmniDepsIndex;
+
+static OmniDepsIndex OMNI_DEPS = {0};
+static pthread_mutex_t OMNI_DEPS_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+// Definitions whose arms are gated on constructor liveness
+static const char *OMNI_DEPS_DISPATCH[] = {
+  "omni_eval",
+  NULL
+};
+
+// Constructors built by C code (FFI results, term handlers, the profiler),
+// live before any definition is loaded
+static const char *OMNI_DEPS_C_BUILT[] = {
+  "CON", "NIL", "CHR",
+  "Cst", "Fix", "True", "Fals", "Noth", "Some", "None", "Err",
+  "Arr", "Dict", "Buf", "PStr", "Dt", "Hndl", "Ptr", "Pend",
+  "Rdr", "Wrtr", "PBdy",
+  NULL
+};
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+fn int omni_deps_name_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+      || (c >= '0' && c <= '9') || c == '_' || c == '?' || c == '.' || c == '$';
+}
+
+fn u32 omni_deps_hash(const char *s, u32 len) {
+  u32 h = 2166136261u;
+  for (u32 i = 0; i < len; i++) {
+    h ^= (u8)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Constructor nick as HVM4 assigns it to #Name
+fn u32 omni_deps_ctr_nick(const char *s, u32 len) {
+  u32 k = 0;
+  for (u32 i = 0; i < len; i++) {
+    k = ((k << 6) + nick_letter_to_b64(s[i])) & EXT_MASK;
+  }
+  return k;
+}
+
+fn const char* omni_deps_name(OmniDepsDef *d) {
+  return OMNI_DEPS.srcs[d->file] + d->name_off;
+}
+
+fn int omni_deps_live(u32 nick) {
+  if (nick == OMNI_DEPS_ALWAYS) return 1;
+  return (OMNI_DEPS.live[nick >> 6] >> (nick & 63)) & 1;
+}
+
+// Mark a constructor live; returns 1 if it was not live before
+fn int omni_deps_set_live(u32 nick) {
+  nick &= EXT_MASK;
+  u64 bit = 1ULL << (nick & 63);
+  if (OMNI_DEPS.live[nick >> 6] & bit) return 0;
+  OMNI_DEPS.live[nick >> 6] |= bit;
+  if (OMNI_DEPS.live_count == OMNI_DEPS.live_cap) {
+    OMNI_DEPS.live_cap = OMNI_DEPS.live_cap ? OMNI_DEPS.live_cap * 2 : 256;
+    OMNI_DEPS.live_order = (u32*)realloc(OMNI_DEPS.live_order, OMNI_DEPS.live_cap * sizeof(u32));
+  }
+  OMNI_DEPS.live_order[OMNI_DEPS.live_count++] = nick;
+  return 1;
+}
+
+fn void omni_deps_push_use(OmniDepsUse **arr, u32 *count, u32 *cap, u32 target, u32 gate) {
+  if (*count == *cap) {
+    *cap = *cap ? *cap * 2 : 1024;
+    *arr = (OmniDepsUse*)realloc(*arr, *cap * sizeof(OmniDepsUse));
+  }
+  (*arr)[*count].target = target;
+  (*arr)[*count].gate = gate;
+  (*count)++;
+}
+
+// =============================================================================
+// Name Lookup
+// =============================================================================
+
+fn u32 omni_deps_find(const char *name, u32 len) {
+  if (!OMNI_DEPS.names) return OMNI_DEPS_NONE;
+  u32 mask = OMNI_DEPS.names_cap - 1;
+  for (u32 i = omni_deps_hash(name, len) & mask;; i = (i + 1) & mask) {
+    u32 d = OMNI_DEPS.names[i];
+    if (d == OMNI_DEPS_NONE) return OMNI_DEPS_NONE;
+    OmniDepsDef *def = &OMNI_DEPS.defs[d];
+    if (def->name_len == len && memcmp(omni_deps_name(def), name, len) == 0) return d;
+  }
+}
+
+fn void omni_deps_build_names(void) {
+  u32 cap = 1024;
+  while (cap < OMNI_DEPS.def_count * 2) cap *= 2;
+  free(OMNI_DEPS.names);
+  OMNI_DEPS.names = (u32*)malloc(cap * sizeof(u32));
+  memset(OMNI_DEPS.names, 0xFF, cap * sizeof(u32));
+  OMNI_DEPS.names_cap = cap;
+
+  // Later definitions win, matching parse_def overwriting BOOK entries
+  for (u32 d = 0; d < OMNI_DEPS.def_count; d++) {
+    OmniDepsDef *def = &OMNI_DEPS.defs[d];
+    const char *name = omni_deps_name(def);
+    u32 mask = cap - 1;
+    u32 i = omni_deps_hash(name, def->name_len) & mask;
+    for (;; i = (i + 1) & mask) {
+      u32 e = OMNI_DEPS.names[i];
+      if (e == OMNI_DEPS_NONE) break;
+      OmniDepsDef *other = &OMNI_DEPS.defs[e];
+      if (other->name_len == def->name_len
+          && memcmp(omni_deps_name(other), name, def->name_len) == 0) break;
+    }
+    OMNI_DEPS.names[i] = d;
+  }
+}
+
+// =============================================================================
+// Source Scanning
+// =============================================================================
+
+// Scan one definition body, recording refs (as name offsets, resolved later)
+// and constructed constructors. In dispatch defs, each use is tagged with the
+// outermost `#Name:` arm enclosing it.
+fn void omni_deps_scan_body(u32 d) {
+  OmniDepsDef *def = &OMNI_DEPS.defs[d];
+  const char *src = OMNI_DEPS.srcs[def->file];
+  u32 pos = def->start + 1 + def->name_len;
+  u32 end = def->end;
+
+  // Arm stack: brace depth at which each label was seen, and its gate
+  u32 arm_depth[64];
+  u32 arm_gate[64];
+  u32 arms = 0;
+  u32 depth = 0;
+
+  def->ref_first = OMNI_DEPS.ref_count;
+  def->ctr_first = OMNI_DEPS.ctr_count;
+
+  while (pos < end) {
+    char c = src[pos];
+
+    // Line comments
+    if (c == '/' && pos + 1 < end && src[pos + 1] == '/') {
+      while (pos < end && src[pos] != '\n') pos++;
+      continue;
+    }
+
+    // String literals
+    if (c == '"') {
+      pos++;
+      while (pos < end && src[pos] != '"') {
+        if (src[pos] == '\\') pos++;
+        pos++;
+      }
+      pos++;
+      continue;
+    }
+
+    if (c == '{') { depth++; pos++; continue; }
+    if (c == '}') {
+      if (depth > 0) depth--;
+      while (arms > 0 && arm_depth[arms - 1] > depth) arms--;
+      pos++;
+      continue;
+    }
+
+    u32 gate = arms > 0 ? arm_gate[0] : OMNI_DEPS_ALWAYS;
+
+    // @ref
+    if (c == '@') {
+      u32 s = ++pos;
+      while (pos < end && omni_deps_name_char(src[pos])) pos++;
+      if (pos > s) {
+        // Name offset is stashed in target and resolved by omni_deps_build
+        omni_deps_push_use(&OMNI_DEPS.refs, &OMNI_DEPS.ref_count, &OMNI_DEPS.ref_cap,
+                           s, gate);
+        omni_deps_push_use(&OMNI_DEPS.refs, &OMNI_DEPS.ref_count, &OMNI_DEPS.ref_cap,
+                           pos - s, gate);
+      }
+      continue;
+    }
+
+    // #Ctr (construction) or #Ctr: (match arm)
+    if (c == '#') {
+      u32 s = ++pos;
+      while (pos < end && omni_deps_name_char(src[pos])) pos++;
+      if (pos == s) continue;
+      u32 nick = omni_deps_ctr_nick(src + s, pos - s);
+      u32 p = pos;
+      while (p < end && (src[p] == ' ' || src[p] == '\t')) p++;
+      if (p < end && src[p] == ':') {
+        if (def->dispatch) {
+          while (arms > 0 && arm_depth[arms - 1] >= depth) arms--;
+          if (arms < 64) {
+            arm_depth[arms] = depth;
+            arm_gate[arms] = nick;
+            arms++;
+          }
+        }
+        pos = p + 1;
+      } else {
+        omni_deps_push_use(&OMNI_DEPS.ctrs, &OMNI_DEPS.ctr_count, &OMNI_DEPS.ctr_cap,
+                           nick, gate);
+      }
+      continue;
+    }
+
+    // Default arm: everything under it is reachable whenever the match is
+    if (c == '_' && def->dispatch && (pos == 0 || !omni_deps_name_char(src[pos - 1]))) {
+      u32 p = pos + 1;
+      while (p < end && (src[p] == ' ' || src[p] == '\t')) p++;
+      if (p < end && src[p] == ':') {
+        while (arms > 0 && arm_depth[arms - 1] >= depth) arms--;
+        if (arms < 64) {
+          arm_depth[arms] = depth;
+          arm_gate[arms] = OMNI_DEPS_ALWAYS;
+          arms++;
+        }
+        pos = p + 1;
+        continue;
+      }
+    }
+
+    pos++;
+  }
+
+  def->ref_count = (OMNI_DEPS.ref_count - def->ref_first) / 2;
+  def->ctr_count = OMNI_DEPS.ctr_count - def->ctr_first;
+}
+
+// Index the top-level definitions of one runtime source
+// Takes ownership of src, which must stay alive for lazy loading
+fn void omni_deps_add_file(const char *path, char *src) {
+  if (OMNI_DEPS.file_count >= OMNI_DEPS_MAX_FILES) return;
+
+  u32 file = OMNI_DEPS.file_count++;
+  u32 len = (u32)strlen(src);
+  OMNI_DEPS.paths[file] = strdup(path);
+  OMNI_DEPS.srcs[file] = src;
+  OMNI_DEPS.lens[file] = len;
+
+  u32 line = 1;
+  u32 prev = OMNI_DEPS_NONE;
+  for (u32 pos = 0; pos < len; pos++) {
+    int bol = (pos == 0 || src[pos - 1] == '\n');
+    if (bol && src[pos] == '@') {
+      u32 s = pos + 1;
+      u32 e = s;
+      while (e < len && omni_deps_name_char(src[e])) e++;
+      if (e > s) {
+        if (prev != OMNI_DEPS_NONE) OMNI_DEPS.defs[prev].end = pos;
+        if (OMNI_DEPS.def_count == OMNI_DEPS.def_cap) {
+          OMNI_DEPS.def_cap = OMNI_DEPS.def_cap ? OMNI_DEPS.def_cap * 2 : 512;
+          OMNI_DEPS.defs = (OmniDepsDef*)realloc(OMNI_DEPS.defs,
+                                                 OMNI_DEPS.def_cap * sizeof(OmniDepsDef));
+        }
+        prev = OMNI_DEPS.def_count++;
+        OmniDepsDef *def = &OMNI_DEPS.defs[prev];
+        memset(def, 0, sizeof(*def));
+        def->file = file;
+        def->start = pos;
+        def->line = line;
+        def->name_off = s;
+        def->name_len = e - s;
+        for (u32 i = 0; OMNI_DEPS_DISPATCH[i]; i++) {
+          if (strlen(OMNI_DEPS_DISPATCH[i]) == def->name_len
+              && memcmp(OMNI_DEPS_DISPATCH[i], src + s, def->name_len) == 0) {
+            def->dispatch = 1;
+          }
+        }
+      }
+    }
+    if (src[pos] == '\n') line++;
+  }
+  if (prev != OMNI_DEPS_NONE) OMNI_DEPS.defs[prev].end = len;
+}
+
+// Scan all indexed bodies and resolve refs to definition indices
+fn void omni_deps_build(void) {
+  omni_deps_build_names();
+
+  for (u32 d = 0; d < OMNI_DEPS.def_count; d++) {
+    omni_deps_scan_body(d);
+  }
+
+  // Refs were recorded as (offset, len) pairs; compact them to def indices
+  u32 out = 0;
+  for (u32 d = 0; d < OMNI_DEPS.def_count; d++) {
+    OmniDepsDef *def = &OMNI_DEPS.defs[d];
+    const char *src = OMNI_DEPS.srcs[def->file];
+    u32 first = out;
+    for (u32 i = 0; i < def->ref_count; i++) {
+      OmniDepsUse off = OMNI_DEPS.refs[def->ref_first + 2 * i];
+      OmniDepsUse len = OMNI_DEPS.refs[def->ref_first + 2 * i + 1];
+      u32 target = omni_deps_find(src + off.target, len.target);
+      if (target == OMNI_DEPS_NONE) continue;
+      OMNI_DEPS.refs[out].target = target;
+      OMNI_DEPS.refs[out].gate = off.gate;
+      out++;
+    }
+    def->ref_first = first;
+    def->ref_count = out - first;
+  }
+  OMNI_DEPS.ref_count = out;
+
+  if (!OMNI_DEPS.live) OMNI_DEPS.live = (u64*)calloc((EXT_MASK + 1) / 64, sizeof(u64));
+  for (u32 i = 0; OMNI_DEPS_C_BUILT[i]; i++) {
+    const char *name = OMNI_DEPS_C_BUILT[i];
+    omni_deps_set_live(omni_deps_ctr_nick(name, (u32)strlen(name)));
+  }
+  OMNI_DEPS.order = (u32*)realloc(OMNI_DEPS.order, (OMNI_DEPS.def_count + 1) * sizeof(u32));
+  OMNI_DEPS.active = 1;
+}
+
+// =============================================================================
+// Closure Loading
+// =============================================================================
+
+fn void omni_deps_parse(u32 d) {
+  OmniDepsDef *def = &OMNI_DEPS.defs[d];
+  const char *name = omni_deps_name(def);
+
+  // A user define of the same name takes precedence
+  u32 id = table_find(name, def->name_len);
+  if (BOOK[id] != 0) return;
+
+  PState ps = {
+    .file = (char*)OMNI_DEPS.paths[def->file],
+    .src  = OMNI_DEPS.srcs[def->file],
+    .pos  = def->start,
+    .len  = def->end,
+    .line = def->line,
+    .col  = 1
+  };
+  parse_def(&ps);
+}
+
+// Mark a definition for loading; it is parsed by omni_deps_settle
+fn void omni_deps_mark(u32 d, u32 *queue, u32 *queue_len) {
+  if (OMNI_DEPS.defs[d].loaded) return;
+  OMNI_DEPS.defs[d].loaded = 1;
+  OMNI_DEPS.order[OMNI_DEPS.loaded_count++] = d;
+  queue[(*queue_len)++] = d;
+}
+
+// Grow the loaded set to a fixpoint: follow live refs of loaded definitions
+// and mark the constructors they build, which may open more arms.
+// Parses every newly loaded definition.
+fn void omni_deps_settle(u32 *queue, u32 queue_len) {
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (u32 d = 0; d < OMNI_DEPS.def_count; d++) {
+      OmniDepsDef *def = &OMNI_DEPS.defs[d];
+      if (!def->loaded) continue;
+      for (u32 i = 0; i < def->ctr_count; i++) {
+        OmniDepsUse *u = &OMNI_DEPS.ctrs[def->ctr_first + i];
+        if (omni_deps_live(u->gate) && omni_deps_set_live(u->target)) changed = 1;
+      }
+      for (u32 i = 0; i < def->ref_count; i++) {
+        OmniDepsUse *u = &OMNI_DEPS.refs[def->ref_first + i];
+        if (!OMNI_DEPS.defs[u->target].loaded && omni_deps_live(u->gate)) {
+          omni_deps_mark(u->target, queue, &queue_len);
+          changed = 1;
+        }
+      }
+    }
+  }
+
+  for (u32 i = 0; i < queue_len; i++) {
+    omni_deps_parse(queue[i]);
+  }
+}
+
+// Load a definition by name and everything it reaches
+// Returns 1 if name is a runtime definition (now loaded), 0 otherwise
+fn int omni_deps_require_name(const char *name, u32 len) {
+  if (!OMNI_DEPS.active) return 0;
+  u32 d = omni_deps_find(name, len);
+  if (d == OMNI_DEPS_NONE) return 0;
+
+  pthread_mutex_lock(&OMNI_DEPS_LOCK);
+  if (!OMNI_DEPS.defs[d].loaded) {
+    u32 *queue = (u32*)malloc(OMNI_DEPS.def_count * sizeof(u32));
+    u32 queue_len = 0;
+    omni_deps_mark(d, queue, &queue_len);
+    omni_deps_settle(queue, queue_len);
+    free(queue);
+  }
+  pthread_mutex_unlock(&OMNI_DEPS_LOCK);
+  return 1;
+}
+
+// Load the runtime definition behind a BOOK id (BkGt miss)
+fn int omni_deps_require_id(u32 table_id) {
+  if (!OMNI_DEPS.active || table_id >= TABLE_LEN || !TABLE[table_id]) return 0;
+  const char *name = TABLE[table_id];
+  if (!omni_deps_require_name(name, (u32)strlen(name))) return 0;
+  return BOOK[table_id] != 0;
+}
+
+// Walk a parsed term: mark its constructors live and queue the runtime
+// definitions it refers to
+fn void omni_deps_scan_term(Term root, u32 *queue, u32 *queue_len) {
+  u32 cap = 1024;
+  u32 len = 0;
+  Term *stack = (Term*)malloc(cap * sizeof(Term));
+  stack[len++] = root;
+
+  // Parsed programs are trees; the budget only guards against shared cycles
+  u64 budget = 1u << 24;
+  while (len > 0 && budget-- > 0) {
+    Term t = stack[--len];
+    u8 tag = term_tag(t);
+
+    if (tag == REF) {
+      u32 id = term_val(t);
+      if (id < TABLE_LEN && TABLE[id]) {
+        u32 d = omni_deps_find(TABLE[id], (u32)strlen(TABLE[id]));
+        if (d != OMNI_DEPS_NONE) omni_deps_mark(d, queue, queue_len);
+      }
+      continue;
+    }
+
+    if (tag < C00 || tag > C16) continue;
+    omni_deps_set_live(term_ext(t));
+
+    u32 arity = tag - C00;
+    u32 loc = term_val(t);
+    if (len + arity > cap) {
+      cap = (len + arity) * 2;
+      stack = (Term*)realloc(stack, cap * sizeof(Term));
+    }
+    for (u32 i = 0; i < arity; i++) {
+      stack[len++] = HEAP[loc + i];
+    }
+  }
+  free(stack);
+}
+
+// Load everything a freshly parsed program needs: its AST plus the bodies
+// of user defines, which live in BOOK rather than in the returned AST
+fn void omni_deps_require_ast(Term ast) {
+  if (!OMNI_DEPS.active) return;
+
+  pthread_mutex_lock(&OMNI_DEPS_LOCK);
+  u32 *queue = (u32*)malloc(OMNI_DEPS.def_count * sizeof(u32));
+  u32 queue_len = 0;
+
+  omni_deps_scan_term(ast, queue, &queue_len);
+  for (u32 id = 0; id < TABLE_LEN; id++) {
+    if (BOOK[id] == 0 || !TABLE[id]) continue;
+    u32 d = omni_deps_find(TABLE[id], (u32)strlen(TABLE[id]));
+    if (d != OMNI_DEPS_NONE && OMNI_DEPS.defs[d].loaded) continue;
+    omni_deps_scan_term(HEAP[BOOK[id]], queue, &queue_len);
+  }
+
+  omni_deps_settle(queue, queue_len);
+  free(queue);
+  pthread_mutex_unlock(&OMNI_DEPS_LOCK);
+}
+
+// Forget definitions loaded, and constructors marked live, after a mark
+// taken with omni_deps_loaded_count/omni_deps_live_count. Used when the heap
+// holding those definitions is rolled back.
+fn void omni_deps_rollback(u32 loaded_count, u32 live_count) {
+  while (OMNI_DEPS.loaded_count > loaded_count) {
+    u32 d = OMNI_DEPS.order[--OMNI_DEPS.loaded_count];
+    OMNI_DEPS.defs[d].loaded = 0;
+  }
+  while (OMNI_DEPS.live_count > live_count) {
+    u32 nick = OMNI_DEPS.live_order[--OMNI_DEPS.live_count];
+    OMNI_DEPS.live[nick >> 6] &= ~(1ULL << (nick & 63));
+  }
+}
+
+// =============================================================================
+// Statistics
+// =============================================================================
+
+fn u32 omni_deps_loaded_count(void) {
+  return OMNI_DEPS.loaded_count;
+}
+
+fn u32 omni_deps_live_count(void) {
+  return OMNI_DEPS.live_count;
+}
+
+fn u32 omni_deps_def_count(void) {
+  return OMNI_DEPS.def_count;
+}
@@ -0,0 +1,253 @@
+// OmniLisp Runtime Image
+// Snapshot of the loaded runtime (BOOK, TABLE and the used HEAP prefix)
+//
+// Parsing prelude/runtime/types/kinds.hvm4 dominates startup for short jobs.
+// An image stores the state left behind by omni_load_runtime so later runs
+// can map it instead of parsing:
+// - Header with format version and a content hash of the .hvm4 sources
+// - TABLE names as a NUL-separated blob
+// - BOOK[0..TABLE_LEN)
+// - HEAP[0..HEAP_NEXT) on a page boundary, mapped copy-on-write at load
+//
+// Terms address the heap by index, never by pointer, so the image does not
+// depend on where HEAP lands in memory. It only requires that thread 0's
+// slice starts at the same index, which the header records and checks.
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// =============================================================================
+// Image Format
+// =============================================================================
+
+#define OMNI_IMAGE_MAGIC   "OMNIIMG"
+#define OMNI_IMAGE_VERSION 1
+
+typedef struct {
+  char magic[8];       // OMNI_IMAGE_MAGIC, NUL-padded
+  u32  version;        // OMNI_IMAGE_VERSION
+  u32  term_size;      // sizeof(Term), guards against ABI mismatch
+  u64  src_hash;       // FNV-1a over the runtime sources
+  u64  heap_base;      // HEAP_NEXT[0] before the runtime was loaded
+  u64  heap_next;      // HEAP_NEXT[0] after the runtime was loaded
+  u32  fresh;          // FRESH counter after loading
+  u32  fresh_lab;      // PARSE_FRESH_LAB after loading
+  u32  table_len;      // Number of TABLE/BOOK entries
+  u32  names_len;      // Bytes in the names blob
+  u64  names_off;      // File offset of the names blob
+  u64  book_off;       // File offset of BOOK[0..table_len)
+  u64  heap_off;       // File offset of HEAP[0..heap_next), page aligned
+} OmniImageHeader;
+
+// Heap index where thread 0's slice starts, captured by omni_image_mark
+static u64 OMNI_IMAGE_HEAP_BASE = 0;
+
+// Names blob of a loaded image (TABLE entries point into it)
+static char *OMNI_IMAGE_NAMES = NULL;
+
+// =============================================================================
+// Source Hashing
+// =============================================================================
+
+#define OMNI_FNV_OFFSET 0xcbf29ce484222325ULL
+#define OMNI_FNV_PRIME  0x100000001b3ULL
+
+fn u64 omni_image_hash_bytes(u64 h, const char *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    h ^= (u8)data[i];
+    h *= OMNI_FNV_PRIME;
+  }
+  return h;
+}
+
+// Hash the names and contents of the runtime sources, in load order
+fn u64 omni_image_hash_sources(const char **names, char **srcs, u32 count) {
+  u64 h = OMNI_FNV_OFFSET;
+  for (u32 i = 0; i < count; i++) {
+    h = omni_image_hash_bytes(h, names[i], strlen(names[i]) + 1);
+    h = omni_image_hash_bytes(h, srcs[i], strlen(srcs[i]) + 1);
+  }
+  return h;
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+fn u64 omni_image_page_round(u64 n) {
+  u64 page = (u64)sysconf(_SC_PAGESIZE);
+  return (n + page - 1) & ~(page - 1);
+}
+
+fn int omni_image_write_all(int fd, const void *buf, size_t len) {
+  const char *p = (const char*)buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return 0;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 1;
+}
+
+fn int omni_image_read_at(int fd, void *buf, size_t len, u64 off) {
+  char *p = (char*)buf;
+  while (len > 0) {
+    ssize_t n = pread(fd, p, len, (off_t)off);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+    p += n;
+    off += (u64)n;
+    len -= (size_t)n;
+  }
+  return 1;
+}
+
+// Record the pristine heap position; call before the runtime is loaded
+fn void omni_image_mark(void) {
+  OMNI_IMAGE_HEAP_BASE = HEAP_NEXT[0];
+}
+
+// =============================================================================
+// Image Writing
+// =============================================================================
+
+// Serialize the currently loaded runtime to path
+// Writes to path.tmp first and renames, so readers never see a partial image
+// Returns 0 on success, errno-style code on failure
+fn int omni_image_save(const char *path, u64 src_hash) {
+  OmniImageHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, OMNI_IMAGE_MAGIC, sizeof(OMNI_IMAGE_MAGIC));
+  hdr.version   = OMNI_IMAGE_VERSION;
+  hdr.term_size = (u32)sizeof(Term);
+  hdr.src_hash  = src_hash;
+  hdr.heap_base = OMNI_IMAGE_HEAP_BASE;
+  hdr.heap_next = HEAP_NEXT[0];
+  hdr.fresh     = FRESH;
+  hdr.fresh_lab = PARSE_FRESH_LAB;
+  hdr.table_len = TABLE_LEN;
+
+  for (u32 i = 0; i < TABLE_LEN; i++) {
+    hdr.names_len += (u32)strlen(TABLE[i] ? TABLE[i] : "") + 1;
+  }
+  hdr.names_off = sizeof(hdr);
+  hdr.book_off  = hdr.names_off + hdr.names_len;
+  hdr.heap_off  = omni_image_page_round(hdr.book_off + (u64)TABLE_LEN * sizeof(u32));
+
+  char tmp_path[1024];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return errno;
+
+  int ok = omni_image_write_all(fd, &hdr, sizeof(hdr));
+  for (u32 i = 0; ok && i < TABLE_LEN; i++) {
+    const char *name = TABLE[i] ? TABLE[i] : "";
+    ok = omni_image_write_all(fd, name, strlen(name) + 1);
+  }
+  if (ok) ok = omni_image_write_all(fd, BOOK, (size_t)TABLE_LEN * sizeof(u32));
+
+  // Heap goes at a page-aligned offset, padded to a whole page, so it can
+  // be mapped directly over HEAP
+  u64 heap_bytes = hdr.heap_next * sizeof(Term);
+  if (ok && ftruncate(fd, (off_t)hdr.heap_off) != 0) ok = 0;
+  if (ok && lseek(fd, (off_t)hdr.heap_off, SEEK_SET) < 0) ok = 0;
+  if (ok) ok = omni_image_write_all(fd, HEAP, heap_bytes);
+  if (ok && ftruncate(fd, (off_t)(hdr.heap_off + omni_image_page_round(heap_bytes))) != 0) ok = 0;
+
+  int err = ok ? 0 : errno;
+  if (close(fd) != 0 && ok) err = errno;
+  if (err == 0 && rename(tmp_path, path) != 0) err = errno;
+  if (err != 0) unlink(tmp_path);
+  return err;
+}
+
+// =============================================================================
+// Image Loading
+// =============================================================================
+
+// Map an image over a pristine runtime
+// Returns 1 if the image was loaded; 0 if it is missing, stale or unusable,
+// in which case nothing has been modified and the caller parses the sources
+fn int omni_image_load(const char *path, u64 src_hash) {
+  // The image replaces the whole runtime state, so nothing may be loaded yet
+  if (TABLE_LEN != 0 || HEAP_NEXT[0] != OMNI_IMAGE_HEAP_BASE) return 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return 0;
+
+  OmniImageHeader hdr;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !omni_image_read_at(fd, &hdr, sizeof(hdr), 0)) {
+    close(fd);
+    return 0;
+  }
+
+  u64 heap_map = omni_image_page_round(hdr.heap_next * sizeof(Term));
+  if (memcmp(hdr.magic, OMNI_IMAGE_MAGIC, sizeof(OMNI_IMAGE_MAGIC)) != 0
+      || hdr.version != OMNI_IMAGE_VERSION
+      || hdr.term_size != sizeof(Term)
+      || hdr.src_hash != src_hash
+      || hdr.heap_base != OMNI_IMAGE_HEAP_BASE
+      || hdr.heap_next > HEAP_END[0]
+      || hdr.table_len >= BOOK_CAP
+      || hdr.heap_off + heap_map > (u64)st.st_size) {
+    close(fd);
+    return 0;
+  }
+
+  char *names = (char*)malloc(hdr.names_len ? hdr.names_len : 1);
+  if (!names
+      || !omni_image_read_at(fd, names, hdr.names_len, hdr.names_off)
+      || !omni_image_read_at(fd, BOOK, (size_t)hdr.table_len * sizeof(u32), hdr.book_off)) {
+    memset(BOOK, 0, (size_t)hdr.table_len * sizeof(u32));
+    free(names);
+    close(fd);
+    return 0;
+  }
+
+  // Map the heap prefix copy-on-write: pages are shared with the page cache
+  // until the evaluator writes to them. Fall back to a plain read when HEAP
+  // is not page aligned.
+  int mapped = 0;
+  if (heap_map > 0 && ((uintptr_t)HEAP & ((uintptr_t)sysconf(_SC_PAGESIZE) - 1)) == 0) {
+    void *p = mmap(HEAP, heap_map, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_FIXED, fd, (off_t)hdr.heap_off);
+    mapped = (p != MAP_FAILED);
+  }
+  if (!mapped && !omni_image_read_at(fd, HEAP, hdr.heap_next * sizeof(Term), hdr.heap_off)) {
+    memset(BOOK, 0, (size_t)hdr.table_len * sizeof(u32));
+    free(names);
+    close(fd);
+    return 0;
+  }
+  close(fd);
+
+  // TABLE entries point into the names blob, which lives for the process
+  char *name = names;
+  for (u32 i = 0; i < hdr.table_len; i++) {
+    TABLE[i] = name;
+    name += strlen(name) + 1;
+  }
+  free(OMNI_IMAGE_NAMES);
+  OMNI_IMAGE_NAMES = names;
+
+  TABLE_LEN       = hdr.table_len;
+  HEAP_NEXT[0]    = hdr.heap_next;
+  FRESH           = hdr.fresh;
+  PARSE_FRESH_LAB = hdr.fresh_lab;
+  return 1;
+}
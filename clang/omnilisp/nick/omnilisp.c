@@ -161,6 +161,8 @@ static u32 OMNI_NAM_IFLT;  // Lazy filter wrapper: #IFlt{iter, pred}
 static u32 OMNI_NAM_ITKN;  // Lazy take wrapper: #ITkn{iter, n}
 static u32 OMNI_NAM_IDRP;  // Lazy drop wrapper: #IDrp{iter, n}
 static u32 OMNI_NAM_DONE;  // Iterator done marker: #Done
+static u32 OMNI_NAM_SOME;  // Iterator step: #Some{value, rest}
+static u32 OMNI_NAM_NONE;  // Iterator exhausted: #None{}
 static u32 OMNI_NAM_IZIP;  // Lazy zip wrapper: #IZip{iters}
 static u32 OMNI_NAM_ICHN;  // Lazy chain wrapper: #IChn{iters}
 static u32 OMNI_NAM_IENM;  // Lazy enumerate wrapper: #IEnm{iter}
@@ -214,14 +216,52 @@ static u32 OMNI_NAM_LSDR;  // list-dir: #LsDr{path}
 static u32 OMNI_NAM_DLFL;  // delete-file: #DlFl{path}
 static u32 OMNI_NAM_RNFL;  // rename-file: #RnFl{from, to}
 static u32 OMNI_NAM_CPFL;  // copy-file: #CpFl{from, to}
+static u32 OMNI_NAM_RDFS;  // read-file-stream: #RdFS{path, chunk}
+static u32 OMNI_NAM_FSNX;  // FFI step of a file stream
 
 // JSON operations (FFI-backed)
 static u32 OMNI_NAM_JPRS;  // json-parse: #JPrs{str}
 static u32 OMNI_NAM_JSTR;  // json-stringify: #JStr{val}
+static u32 OMNI_NAM_JSLN;  // json-lines: #JsLn{src}
+static u32 OMNI_NAM_JLNX;  // FFI step of a json-lines stream
 static u32 OMNI_NAM_JARR;  // JSON array marker: #JArr (for type distinction)
 static u32 OMNI_NAM_JOBJ;  // JSON object marker: #JObj (for type distinction)
 static u32 OMNI_NAM_JNUL;  // JSON null: #JNul
 
+// Byte buffers (FFI-backed)
+static u32 OMNI_NAM_BUF;   // Buffer value: #Buf{#Hndl}
+static u32 OMNI_NAM_STBF;  // string->buf: #StBf{str}
+static u32 OMNI_NAM_BFST;  // buf->string: #BfSt{buf}
+static u32 OMNI_NAM_BFLN;  // buf-length: #BfLn{buf}
+static u32 OMNI_NAM_BFRF;  // buf-ref: #BfRf{buf, index}
+static u32 OMNI_NAM_BFSL;  // buf-slice: #BfSl{buf, start, end}
+static u32 OMNI_NAM_RDFB;  // read-file-buf: #RdFB{path}
+
+// Packed strings (FFI-backed)
+static u32 OMNI_NAM_PSTR;  // Packed string value: #PStr{heap index}
+static u32 OMNI_NAM_PSPK;  // pack-string: #PsPk{str}
+static u32 OMNI_NAM_PSLS;  // unpack-string: #PsLs{str}
+static u32 OMNI_NAM_PSLN;  // FFI str-length on a packed string
+static u32 OMNI_NAM_PSAT;  // FFI str-char-at
+static u32 OMNI_NAM_PSSL;  // FFI str-slice
+static u32 OMNI_NAM_PSIX;  // FFI str-index-of
+static u32 OMNI_NAM_PSEQ;  // FFI equality
+
+// File streams (FFI-backed)
+static u32 OMNI_NAM_WRTR;  // Writer value: #Wrtr{#Hndl}
+static u32 OMNI_NAM_RDR;   // Reader value: #Rdr{#Hndl}
+static u32 OMNI_NAM_OPWR;  // open-writer: #OpWr{path, mode}
+static u32 OMNI_NAM_OPRD;  // open-reader: #OpRd{path}
+static u32 OMNI_NAM_STWR;  // write!: #StWr{writer, val}
+static u32 OMNI_NAM_STFL;  // flush: #StFl{writer}
+static u32 OMNI_NAM_STCL;  // close: #StCl{stream}
+static u32 OMNI_NAM_STRL;  // read-line on a reader: #StRl{reader}
+static u32 OMNI_NAM_STRC;  // read-chunk: #StRc{reader, n}
+
+// Native libraries (FFI-backed)
+static u32 OMNI_NAM_DLOP;  // ffi-load: #DlOp{path}
+static u32 OMNI_NAM_DLDC;  // ffi-declare: #DlDc{name, symbol, signature}
+
 // DateTime operations (FFI-backed)
 static u32 OMNI_NAM_DTNW;  // datetime-now: #DtNw{}
 static u32 OMNI_NAM_DTPR;  // datetime-parse: #DtPr{str, fmt}
@@ -251,6 +291,9 @@ static u32 OMNI_NAM_REFL;  // reflect: #Refl{val} - reflect value as code
 static u32 OMNI_NAM_REIF;  // reify: #Reif{code} - reify code as value
 static u32 OMNI_NAM_FREF;  // forward reference: #FRef{table_id} - lazy BOOK lookup
 static u32 OMNI_NAM_BKGT;  // book_get: FFI to retrieve term from BOOK[id]
+static u32 OMNI_NAM_PBDY;  // profiled body: #PBdy{table_id, body} (--profile)
+static u32 OMNI_NAM_PFIN;  // profile: FFI run before a #PBdy body
+static u32 OMNI_NAM_PFOU;  // profile: FFI run once a #PBdy body is in WNF
 static u32 OMNI_NAM_MLVL;  // meta-level: #MLvl{level} - current meta-level
 static u32 OMNI_NAM_LPAR;  // lazy-parent: #LPar{thunk} - lazy parent reference
 
@@ -331,7 +374,25 @@ static u32 OMNI_NAM_CNVR;  // Contravariance marker: #Cnvr{tvar}
 static u32 OMNI_NAM_FFI;   // FFI call: #FFI{name, args}
 static u32 OMNI_NAM_HNDL;  // Handle: #Hndl{idx, gen}
 static u32 OMNI_NAM_PTR;   // Raw pointer: #Ptr{hi, lo}
-static u32 OMNI_NAM_PEND;  // Pending future: #Pend{id}
+static u32 OMNI_NAM_HSCP;  // Handle scope (AST): #HScp{body}
+static u32 OMNI_NAM_HSCB;  // FFI: open a handle scope, yields its id
+static u32 OMNI_NAM_HSCE;  // FFI: close a handle scope, [id value] -> value
+static u32 OMNI_NAM_PEND;  // Pending future: #Pend{#Hndl{...}}
+static u32 OMNI_NAM_ASYN;  // Async FFI call (AST): #Asyn{name, args}
+static u32 OMNI_NAM_ASYB;  // Async FFI batch (AST): #AsyB{calls}
+static u32 OMNI_NAM_AWIT;  // Await (AST): #Awit{expr}
+static u32 OMNI_NAM_AWAL;  // Await all (AST): #AwAl{expr}
+static u32 OMNI_NAM_AWAN;  // Await any (AST): #AwAn{expr}
+static u32 OMNI_NAM_FASY;  // Async FFI submission: #FAsy{name, args}
+static u32 OMNI_NAM_FASB;  // Batched submission: #FAsB{[#FReq{name, args} ...]}
+static u32 OMNI_NAM_FREQ;  // One call of a batch: #FReq{name, args}
+static u32 OMNI_NAM_FAWT;  // Await a future: #FAwt{future}
+static u32 OMNI_NAM_FAWA;  // Await a list of futures: #FAwA{futures}
+static u32 OMNI_NAM_FAWN;  // Await the first of a list: #FAwN{futures}
+static u32 OMNI_NAM_FFMP;  // FFI map (AST): #FfMp{name, [coll args...]}
+static u32 OMNI_NAM_FFRD;  // FFI reduce (AST): #FfRd{name, [init coll args...]}
+static u32 OMNI_NAM_FMAP;  // FFI call per element: #FMap{name, [coll args...]}
+static u32 OMNI_NAM_FRED;  // FFI fold: #FRed{name, [init coll args...]}
 
 // Algebraic effects
 static u32 OMNI_NAM_PERF;  // Perform: #Perf{tag, payload}
@@ -494,6 +555,9 @@ static u32 OMNI_NAM_MAP;   // Map: #Map{fn, coll} - generic dispatch
 static u32 OMNI_NAM_FILT;  // Filter: #Filt{pred, coll} - generic dispatch
 static u32 OMNI_NAM_FOLD;  // Fold: #Fold{fn, init, coll} - generic dispatch
 static u32 OMNI_NAM_FLDR;  // Foldr: #FldR{fn, init, coll} - right fold
+static u32 OMNI_NAM_RTRE;  // Reduce-tree: #RTre{fn, init, coll} - halves in parallel
+static u32 OMNI_NAM_PEVL;  // FFI: reduce a list's elements on the reducer threads
+static u32 OMNI_NAM_SPLN;  // FFI: a list's length, if known without reducing it
 static u32 OMNI_NAM_TAKE;  // Take: #Take{n, coll} - generic dispatch
 static u32 OMNI_NAM_DROP;  // Drop: #Drop{n, coll} - generic dispatch
 static u32 OMNI_NAM_REV;   // Reverse: #Rev{coll}
@@ -724,6 +788,8 @@ fn void omni_names_init(void) {
   OMNI_NAM_ITKN = omni_nick("ITkn");
   OMNI_NAM_IDRP = omni_nick("IDrp");
   OMNI_NAM_DONE = omni_nick("Done");
+  OMNI_NAM_SOME = omni_nick("Some");
+  OMNI_NAM_NONE = omni_nick("None");
   OMNI_NAM_IZIP = omni_nick("IZip");
   OMNI_NAM_ICHN = omni_nick("IChn");
   OMNI_NAM_IENM = omni_nick("IEnm");
@@ -777,14 +843,52 @@ fn void omni_names_init(void) {
   OMNI_NAM_DLFL = omni_nick("DlFl");
   OMNI_NAM_RNFL = omni_nick("RnFl");
   OMNI_NAM_CPFL = omni_nick("CpFl");
+  OMNI_NAM_RDFS = omni_nick("RdFS");
+  OMNI_NAM_FSNX = omni_nick("FsNx");
 
   // JSON operations
   OMNI_NAM_JPRS = omni_nick("JPrs");
   OMNI_NAM_JSTR = omni_nick("JStr");
+  OMNI_NAM_JSLN = omni_nick("JsLn");
+  OMNI_NAM_JLNX = omni_nick("JlNx");
   OMNI_NAM_JARR = omni_nick("JArr");
   OMNI_NAM_JOBJ = omni_nick("JObj");
   OMNI_NAM_JNUL = omni_nick("JNul");
 
+  // Byte buffers
+  OMNI_NAM_BUF  = omni_nick("Buf");
+  OMNI_NAM_STBF = omni_nick("StBf");
+  OMNI_NAM_BFST = omni_nick("BfSt");
+  OMNI_NAM_BFLN = omni_nick("BfLn");
+  OMNI_NAM_BFRF = omni_nick("BfRf");
+  OMNI_NAM_BFSL = omni_nick("BfSl");
+  OMNI_NAM_RDFB = omni_nick("RdFB");
+
+  // Packed strings
+  OMNI_NAM_PSTR = omni_nick("PStr");
+  OMNI_NAM_PSPK = omni_nick("PsPk");
+  OMNI_NAM_PSLS = omni_nick("PsLs");
+  OMNI_NAM_PSLN = omni_nick("PsLn");
+  OMNI_NAM_PSAT = omni_nick("PsAt");
+  OMNI_NAM_PSSL = omni_nick("PsSl");
+  OMNI_NAM_PSIX = omni_nick("PsIx");
+  OMNI_NAM_PSEQ = omni_nick("PsEq");
+
+  // File streams
+  OMNI_NAM_WRTR = omni_nick("Wrtr");
+  OMNI_NAM_RDR  = omni_nick("Rdr");
+  OMNI_NAM_OPWR = omni_nick("OpWr");
+  OMNI_NAM_OPRD = omni_nick("OpRd");
+  OMNI_NAM_STWR = omni_nick("StWr");
+  OMNI_NAM_STFL = omni_nick("StFl");
+  OMNI_NAM_STCL = omni_nick("StCl");
+  OMNI_NAM_STRL = omni_nick("StRl");
+  OMNI_NAM_STRC = omni_nick("StRc");
+
+  // Native libraries
+  OMNI_NAM_DLOP = omni_nick("DlOp");
+  OMNI_NAM_DLDC = omni_nick("DlDc");
+
   // DateTime operations
   OMNI_NAM_DTNW = omni_nick("DtNw");
   OMNI_NAM_DTPR = omni_nick("DtPr");
@@ -814,6 +918,9 @@ fn void omni_names_init(void) {
   OMNI_NAM_REIF = omni_nick("Reif");
   OMNI_NAM_FREF = omni_nick("FRef");
   OMNI_NAM_BKGT = omni_nick("BkGt");
+  OMNI_NAM_PBDY = omni_nick("PBdy");
+  OMNI_NAM_PFIN = omni_nick("PfIn");
+  OMNI_NAM_PFOU = omni_nick("PfOu");
   OMNI_NAM_MLVL = omni_nick("MLvl");
   OMNI_NAM_LPAR = omni_nick("LPar");
 
@@ -890,7 +997,25 @@ fn void omni_names_init(void) {
   OMNI_NAM_FFI  = omni_nick("FFI");
   OMNI_NAM_HNDL = omni_nick("Hndl");
   OMNI_NAM_PTR  = omni_nick("Ptr");
+  OMNI_NAM_HSCP = omni_nick("HScp");
+  OMNI_NAM_HSCB = omni_nick("HScB");
+  OMNI_NAM_HSCE = omni_nick("HScE");
   OMNI_NAM_PEND = omni_nick("Pend");
+  OMNI_NAM_ASYN = omni_nick("Asyn");
+  OMNI_NAM_ASYB = omni_nick("AsyB");
+  OMNI_NAM_AWIT = omni_nick("Awit");
+  OMNI_NAM_AWAL = omni_nick("AwAl");
+  OMNI_NAM_AWAN = omni_nick("AwAn");
+  OMNI_NAM_FASY = omni_nick("FAsy");
+  OMNI_NAM_FASB = omni_nick("FAsB");
+  OMNI_NAM_FREQ = omni_nick("FReq");
+  OMNI_NAM_FAWT = omni_nick("FAwt");
+  OMNI_NAM_FAWA = omni_nick("FAwA");
+  OMNI_NAM_FAWN = omni_nick("FAwN");
+  OMNI_NAM_FFMP = omni_nick("FfMp");
+  OMNI_NAM_FFRD = omni_nick("FfRd");
+  OMNI_NAM_FMAP = omni_nick("FMap");
+  OMNI_NAM_FRED = omni_nick("FRed");
 
   // Effects
   OMNI_NAM_PERF = omni_nick("Perf");
@@ -1041,6 +1166,9 @@ fn void omni_names_init(void) {
   OMNI_NAM_FILT = omni_nick("Filt");
   OMNI_NAM_FOLD = omni_nick("Fold");
   OMNI_NAM_FLDR = omni_nick("FldR");
+  OMNI_NAM_RTRE = omni_nick("RTre");
+  OMNI_NAM_PEVL = omni_nick("PEvl");
+  OMNI_NAM_SPLN = omni_nick("SpLn");
   OMNI_NAM_TAKE = omni_nick("Take");
   OMNI_NAM_DROP = omni_nick("Drop");
   OMNI_NAM_REV  = omni_nick("Rev");
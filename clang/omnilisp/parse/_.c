@@ -2147,9 +2147,14 @@ fn Term parse_omni_atom(PState *s) {
     return omni_ctr1(OMNI_NAM_SET, elements);
   }
 
-  // String: "..."
+  // String: "...", packed with OMNI_PACKED_STRINGS=1
   if (c == '"') {
-    return parse_omni_string(s);
+    Term str = parse_omni_string(s);
+    if (OMNI_PSTR_ENABLED) {
+      OmniBuf *b = omni_pstr_from_list(str);
+      if (b) return omni_pstr_term(b);
+    }
+    return str;
   }
 
   // Type annotation: {Type}
@@ -2339,6 +2344,69 @@ fn Term parse_omni_atom(PState *s) {
   return omni_nil();
 }
 
+// =============================================================================
+// FFI Calls
+// =============================================================================
+
+// "lib" "func" args...) of an FFI form; returns the function name, the
+// argument list in *args
+fn Term parse_omni_ffi_call(PState *s, Term *args) {
+  Term lib_name = parse_omni_expr(s);
+  Term func_name = parse_omni_expr(s);
+  (void)lib_name;
+
+  *args = omni_nil();
+  Term *tail = args;
+  while (parse_peek(s) != ')') {
+    Term arg = parse_omni_expr(s);
+    Term cell = omni_cons(arg, omni_nil());
+    *tail = cell;
+    tail = &HEAP[term_val(cell) + 1];
+  }
+  omni_expect_char(s, ')');
+  return func_name;
+}
+
+// Rest of (ffi [^:async] "lib" "func" args...) after the ffi symbol
+// Returns #FFI{name, args}, or #Asyn{name, args} when async is set or the
+// call is marked ^:async
+fn Term parse_omni_ffi_rest(PState *s, int async) {
+  omni_skip(s);
+  if (parse_peek(s) == '^') {
+    u32 saved = s->pos;
+    parse_advance(s);  // skip ^
+    u32 meta_start, meta_len;
+    if (parse_peek(s) == ':') {
+      parse_advance(s);  // skip :
+      if (omni_parse_symbol_raw(s, &meta_start, &meta_len) &&
+          omni_symbol_is(s, meta_start, meta_len, "async")) {
+        async = 1;
+      } else {
+        s->pos = saved;
+      }
+    } else {
+      s->pos = saved;
+    }
+  }
+
+  Term args;
+  Term func_name = parse_omni_ffi_call(s, &args);
+
+  // FFI name is library + function combined
+  return async ? omni_ctr2(OMNI_NAM_ASYN, func_name, args) : omni_ffi(func_name, args);
+}
+
+// An (ffi ...) form that must follow async / async-batch, parsed as async
+fn Term parse_omni_async_call(PState *s) {
+  omni_expect_char(s, '(');
+  u32 sym_start, sym_len;
+  if (!omni_parse_symbol_raw(s, &sym_start, &sym_len) ||
+      !omni_symbol_is(s, sym_start, sym_len, "ffi")) {
+    parse_error(s, "(ffi ...) call", parse_peek(s));
+  }
+  return parse_omni_ffi_rest(s, 1);
+}
+
 // =============================================================================
 // S-Expression Parsing (special forms)
 // =============================================================================
@@ -4236,23 +4304,92 @@ fn Term parse_omni_sexp(PState *s) {
     return omni_ctr1(OMNI_NAM_COMP, fns);
   }
 
-  // ffi: (ffi "lib" "func" args...)
+  // ffi: (ffi "lib" "func" args...), (ffi ^:async "lib" "func" args...)
   if (omni_symbol_is(s, sym_start, sym_len, "ffi")) {
-    Term lib_name = parse_omni_expr(s);
-    Term func_name = parse_omni_expr(s);
+    return parse_omni_ffi_rest(s, 0);
+  }
+
+  // with-handle-scope: (with-handle-scope body) -> #HScp{body}
+  // Owned handles allocated while body is evaluated are released after it
+  if (omni_symbol_is(s, sym_start, sym_len, "with-handle-scope")) {
+    Term body = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_HSCP, body);
+  }
+
+  // ffi-load: (ffi-load "libfoo.so") -> #DlOp{path}
+  if (omni_symbol_is(s, sym_start, sym_len, "ffi-load")) {
+    Term path = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_DLOP, path);
+  }
+
+  // ffi-declare: (ffi-declare "name" "symbol" "sig") -> #DlDc{name, symbol, sig}
+  if (omni_symbol_is(s, sym_start, sym_len, "ffi-declare")) {
+    Term name = parse_omni_expr(s);
+    Term symbol = parse_omni_expr(s);
+    Term sig = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr3(OMNI_NAM_DLDC, name, symbol, sig);
+  }
 
-    Term args = omni_nil();
-    Term *tail = &args;
+  // ffi-map: (ffi-map "lib" "func" coll args...) -> #FfMp{name, [coll args...]},
+  // func applied to each element in one FFI call, an array of the results
+  if (omni_symbol_is(s, sym_start, sym_len, "ffi-map")) {
+    Term args;
+    Term func_name = parse_omni_ffi_call(s, &args);
+    return omni_ctr2(OMNI_NAM_FFMP, func_name, args);
+  }
+
+  // ffi-reduce: (ffi-reduce "lib" "func" init coll args...)
+  // -> #FfRd{name, [init coll args...]}, a left fold of func over coll
+  if (omni_symbol_is(s, sym_start, sym_len, "ffi-reduce")) {
+    Term args;
+    Term func_name = parse_omni_ffi_call(s, &args);
+    return omni_ctr2(OMNI_NAM_FFRD, func_name, args);
+  }
+
+  // async: (async (ffi ...)) -> #Asyn{name, args}, evaluates to a future
+  if (omni_symbol_is(s, sym_start, sym_len, "async")) {
+    Term call = parse_omni_async_call(s);
+    omni_expect_char(s, ')');
+    return call;
+  }
+
+  // async-batch: (async-batch (ffi ...) ...) -> #AsyB{calls}, a list of
+  // futures submitted together
+  if (omni_symbol_is(s, sym_start, sym_len, "async-batch")) {
+    Term calls = omni_nil();
+    Term *tail = &calls;
     while (parse_peek(s) != ')') {
-      Term arg = parse_omni_expr(s);
-      Term cell = omni_cons(arg, omni_nil());
+      Term cell = omni_cons(parse_omni_async_call(s), omni_nil());
       *tail = cell;
       tail = &HEAP[term_val(cell) + 1];
     }
     omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_ASYB, calls);
+  }
+
+  // await: (await future) -> #Awit{future}
+  if (omni_symbol_is(s, sym_start, sym_len, "await")) {
+    Term fut = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_AWIT, fut);
+  }
+
+  // await-all: (await-all futures) -> #AwAl{futures}, the results in order
+  if (omni_symbol_is(s, sym_start, sym_len, "await-all")) {
+    Term futs = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_AWAL, futs);
+  }
 
-    // FFI name is library + function combined
-    return omni_ffi(func_name, args);
+  // await-any: (await-any futures) -> #AwAn{futures}, the first to finish
+  // as (index result remaining)
+  if (omni_symbol_is(s, sym_start, sym_len, "await-any")) {
+    Term futs = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_AWAN, futs);
   }
 
   // Arithmetic operators
@@ -5723,6 +5860,85 @@ fn Term parse_omni_sexp(PState *s) {
     omni_expect_char(s, ')');
     return omni_ctr2(OMNI_NAM_APFL, path, content);
   }
+  if (omni_symbol_is(s, sym_start, sym_len, "read-file-buf")) {
+    Term path = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_RDFB, path);
+  }
+
+  // read-file-stream: (read-file-stream path) lines, (read-file-stream path n)
+  // n-byte chunks -> #RdFS{path, n}, n = 0 for lines
+  if (omni_symbol_is(s, sym_start, sym_len, "read-file-stream")) {
+    Term path = parse_omni_expr(s);
+    Term chunk = parse_peek(s) == ')' ? omni_lit(0) : parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr2(OMNI_NAM_RDFS, path, chunk);
+  }
+
+  // File streams: buffered reader and writer handles
+  if (omni_symbol_is(s, sym_start, sym_len, "open-writer")) {
+    Term path = parse_omni_expr(s);
+    Term mode = parse_peek(s) == ')' ? omni_nil() : parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr2(OMNI_NAM_OPWR, path, mode);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "open-reader")) {
+    Term path = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_OPRD, path);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "write!")) {
+    Term writer = parse_omni_expr(s);
+    Term val = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr2(OMNI_NAM_STWR, writer, val);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "flush")) {
+    Term writer = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_STFL, writer);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "close")) {
+    Term stream = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_STCL, stream);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "read-chunk")) {
+    Term reader = parse_omni_expr(s);
+    Term n = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr2(OMNI_NAM_STRC, reader, n);
+  }
+
+  // Byte buffers: raw bytes behind a handle, converted only on request
+  if (omni_symbol_is(s, sym_start, sym_len, "string->buf")) {
+    Term str = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_STBF, str);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "buf->string")) {
+    Term buf = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_BFST, buf);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "buf-length")) {
+    Term buf = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_BFLN, buf);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "buf-ref")) {
+    Term buf = parse_omni_expr(s);
+    Term idx = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr2(OMNI_NAM_BFRF, buf, idx);
+  }
+  if (omni_symbol_is(s, sym_start, sym_len, "buf-slice")) {
+    Term buf = parse_omni_expr(s);
+    Term start = parse_omni_expr(s);
+    Term end = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr3(OMNI_NAM_BFSL, buf, start, end);
+  }
   if (omni_symbol_is(s, sym_start, sym_len, "read-lines")) {
     Term path = parse_omni_expr(s);
     omni_expect_char(s, ')');
@@ -5748,7 +5964,14 @@ fn Term parse_omni_sexp(PState *s) {
     omni_expect_char(s, ')');
     return omni_ctr1(OMNI_NAM_DGMT, val);
   }
+  // read-line: (read-line) from stdin, (read-line r) from a reader
   if (omni_symbol_is(s, sym_start, sym_len, "read-line")) {
+    parse_skip_whitespace(s);
+    if (parse_peek(s) != ')') {
+      Term reader = parse_omni_expr(s);
+      omni_expect_char(s, ')');
+      return omni_ctr1(OMNI_NAM_STRL, reader);
+    }
     omni_expect_char(s, ')');
     return omni_ctr0(OMNI_NAM_RDLN2);
   }
@@ -5829,6 +6052,13 @@ fn Term parse_omni_sexp(PState *s) {
     return omni_ctr1(OMNI_NAM_JSTR, val);
   }
 
+  // json-lines: (json-lines path-or-buf) - lazy stream of one document per line
+  if (omni_symbol_is(s, sym_start, sym_len, "json-lines")) {
+    Term src = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_JSLN, src);
+  }
+
   // json-get: (json-get json key) - shorthand for (get (json-parse str) key)
   if (omni_symbol_is(s, sym_start, sym_len, "json-get")) {
     Term json = parse_omni_expr(s);
@@ -6617,6 +6847,15 @@ fn Term parse_omni_sexp(PState *s) {
     return omni_ctr3(OMNI_NAM_FLDR, f, acc, xs);
   }
 
+  // reduce-tree: (reduce-tree f init xs) -> #RTre{f, init, xs}
+  if (omni_symbol_is(s, sym_start, sym_len, "reduce-tree")) {
+    Term f = parse_omni_expr(s);
+    Term init = parse_omni_expr(s);
+    Term xs = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr3(OMNI_NAM_RTRE, f, init, xs);
+  }
+
   // len/length: (len xs) -> #Len{xs}
   if (omni_symbol_is(s, sym_start, sym_len, "len") ||
       omni_symbol_is(s, sym_start, sym_len, "length")) {
@@ -6645,6 +6884,20 @@ fn Term parse_omni_sexp(PState *s) {
   // String Operations
   // ==========================================================================
 
+  // pack-string: (pack-string str) -> #PsPk{str}, UTF-8 bytes behind a handle
+  if (omni_symbol_is(s, sym_start, sym_len, "pack-string")) {
+    Term str = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_PSPK, str);
+  }
+
+  // unpack-string: (unpack-string str) -> #PsLs{str}, back to a char list
+  if (omni_symbol_is(s, sym_start, sym_len, "unpack-string")) {
+    Term str = parse_omni_expr(s);
+    omni_expect_char(s, ')');
+    return omni_ctr1(OMNI_NAM_PSLS, str);
+  }
+
   // str-length: (str-length str) -> #SLen{str}
   if (omni_symbol_is(s, sym_start, sym_len, "str-length") ||
       omni_symbol_is(s, sym_start, sym_len, "string-length")) {
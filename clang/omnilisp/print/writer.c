@@ -0,0 +1,178 @@
+// OmniLisp Buffered Writer
+// Output sink for the result printer
+//
+// Printing a result emits many tiny pieces (one per character of a string,
+// one per list separator). The writer batches them in a large buffer and
+// hands whole blocks to write(2)/send(2), or keeps everything in memory when
+// the caller needs the text as a string (batch JSON, tests).
+
+// hvm4.c is already included by main.c before this file
+// #include "../../../hvm4/clang/hvm4.c"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// =============================================================================
+// Writer
+// =============================================================================
+
+#define OMNI_WRITER_BUF_SIZE (64 * 1024)
+
+typedef enum {
+  OMNI_WRITER_MEM    = 0,  // Grow in memory; take the text with omni_writer_take
+  OMNI_WRITER_FD     = 1,  // Flush to a file descriptor with write(2)
+  OMNI_WRITER_SOCKET = 2,  // Flush to a socket with send(2), no SIGPIPE
+} OmniWriterKind;
+
+typedef struct {
+  OmniWriterKind kind;
+  int    fd;
+  char  *buf;
+  size_t len;
+  size_t cap;
+  int    error;          // errno of the first failed flush; later output is dropped
+} OmniWriter;
+
+fn void omni_writer_init(OmniWriter *w, OmniWriterKind kind, int fd) {
+  w->kind  = kind;
+  w->fd    = fd;
+  w->len   = 0;
+  w->cap   = OMNI_WRITER_BUF_SIZE;
+  w->buf   = (char*)malloc(w->cap);
+  w->error = w->buf ? 0 : ENOMEM;
+}
+
+// In-memory writer
+fn void omni_writer_mem(OmniWriter *w) {
+  omni_writer_init(w, OMNI_WRITER_MEM, -1);
+}
+
+// Writer on fd; flushes when the buffer fills and on omni_writer_flush
+fn void omni_writer_fd(OmniWriter *w, int fd) {
+  omni_writer_init(w, OMNI_WRITER_FD, fd);
+}
+
+fn void omni_writer_socket(OmniWriter *w, int fd) {
+  omni_writer_init(w, OMNI_WRITER_SOCKET, fd);
+}
+
+// =============================================================================
+// Flushing
+// =============================================================================
+
+fn void omni_writer_flush(OmniWriter *w) {
+  if (w->kind == OMNI_WRITER_MEM || w->error) return;
+
+  const char *p = w->buf;
+  size_t left = w->len;
+  while (left > 0) {
+    ssize_t n = w->kind == OMNI_WRITER_SOCKET
+              ? send(w->fd, p, left, MSG_NOSIGNAL)
+              : write(w->fd, p, left);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      w->error = errno;
+      break;
+    }
+    p += n;
+    left -= (size_t)n;
+  }
+  w->len = 0;
+}
+
+// Make room for n more bytes
+fn int omni_writer_reserve(OmniWriter *w, size_t n) {
+  if (w->error) return 0;
+  if (w->len + n <= w->cap) return 1;
+
+  if (w->kind != OMNI_WRITER_MEM) {
+    omni_writer_flush(w);
+    if (w->error) return 0;
+    if (n <= w->cap) return 1;
+  }
+
+  size_t cap = w->cap;
+  while (w->len + n > cap) cap *= 2;
+  char *buf = (char*)realloc(w->buf, cap);
+  if (!buf) {
+    w->error = ENOMEM;
+    return 0;
+  }
+  w->buf = buf;
+  w->cap = cap;
+  return 1;
+}
+
+// =============================================================================
+// Output
+// =============================================================================
+
+fn void omni_writer_put(OmniWriter *w, const char *data, size_t n) {
+  if (!omni_writer_reserve(w, n)) return;
+  memcpy(w->buf + w->len, data, n);
+  w->len += n;
+}
+
+fn void omni_writer_putc(OmniWriter *w, char c) {
+  if (w->len < w->cap) {
+    w->buf[w->len++] = c;
+    return;
+  }
+  omni_writer_put(w, &c, 1);
+}
+
+fn void omni_writer_puts(OmniWriter *w, const char *s) {
+  omni_writer_put(w, s, strlen(s));
+}
+
+fn void omni_writer_printf(OmniWriter *w, const char *fmt, ...) {
+  char small[128];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(small, sizeof(small), fmt, ap);
+  va_end(ap);
+  if (n < 0) return;
+
+  if ((size_t)n < sizeof(small)) {
+    omni_writer_put(w, small, (size_t)n);
+    return;
+  }
+  if (!omni_writer_reserve(w, (size_t)n + 1)) return;
+  va_start(ap, fmt);
+  vsnprintf(w->buf + w->len, (size_t)n + 1, fmt, ap);
+  va_end(ap);
+  w->len += (size_t)n;
+}
+
+// =============================================================================
+// Teardown
+// =============================================================================
+
+// Detach the text of an in-memory writer (NUL-terminated, caller frees)
+fn char* omni_writer_take(OmniWriter *w, size_t *len) {
+  omni_writer_putc(w, '\0');
+  if (w->error) {
+    free(w->buf);
+    w->buf = NULL;
+    if (len) *len = 0;
+    return strdup("");
+  }
+  char *out = w->buf;
+  if (len) *len = w->len - 1;
+  w->buf = NULL;
+  w->len = w->cap = 0;
+  return out;
+}
+
+// Flush and release the buffer (the fd stays open)
+fn void omni_writer_close(OmniWriter *w) {
+  omni_writer_flush(w);
+  free(w->buf);
+  w->buf = NULL;
+  w->len = w->cap = 0;
+}
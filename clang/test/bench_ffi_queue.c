@@ -0,0 +1,96 @@
+// OmniLisp FFI Pool Microbenchmark
+// Calls/sec through the async FFI pool with 1..N producer threads
+//
+//   make bench-ffi                          producers 1..cores
+//   ./bench_ffi_queue [MAX_PRODUCERS] [CALLS_PER_PRODUCER]
+//
+// Producers submit no-op native calls straight to the pool, one at a time
+// (omni_ffi_submit, global ring) or in batches (omni_ffi_submit_batch,
+// workers' local rings), keeping OMNI_BENCH_WINDOW calls in flight and
+// waiting for them as await-all does. That measures queueing, wake-up and
+// completion; nothing here touches the HVM4 heap. The worker count comes
+// from $OMNI_FFI_WORKERS (default: one per core).
+
+#define main omni_main
+#include "../main.c"
+#undef main
+
+#define OMNI_BENCH_WINDOW 64
+
+typedef struct {
+  u32 calls;
+  int batch;
+} OmniBenchArgs;
+
+static int omni_bench_nop(int x) {
+  return x + 1;
+}
+
+static void* omni_bench_producer(void *arg) {
+  OmniBenchArgs *a = (OmniBenchArgs*)arg;
+  OmniFFIFuture futures[OMNI_BENCH_WINDOW];
+  OmniFFIFuture *tasks[OMNI_BENCH_WINDOW];
+
+  for (u32 done = 0; done < a->calls; done += OMNI_BENCH_WINDOW) {
+    u32 n = a->calls - done < OMNI_BENCH_WINDOW ? a->calls - done : OMNI_BENCH_WINDOW;
+    for (u32 i = 0; i < n; i++) {
+      memset(&futures[i], 0, sizeof(OmniFFIFuture));
+      futures[i].fn_ptr = (void*)omni_bench_nop;
+      futures[i].call_type = OMNI_FFI_INT_INT;
+      futures[i].args[0] = (intptr_t)i;
+      futures[i].arg_count = 1;
+      tasks[i] = &futures[i];
+    }
+    if (a->batch) {
+      omni_ffi_submit_batch(tasks, n);
+    } else {
+      for (u32 i = 0; i < n; i++) omni_ffi_submit(tasks[i]);
+    }
+    omni_ffi_wait(tasks, n, 1);
+  }
+  return NULL;
+}
+
+// Calls per second for p producers of `calls` each
+static double omni_bench_run(u32 p, u32 calls, int batch) {
+  pthread_t threads[OMNI_FFI_MAX_WORKERS];
+  OmniBenchArgs args = {calls, batch};
+
+  u64 start = omni_stats_now_ns();
+  for (u32 i = 0; i < p; i++) {
+    pthread_create(&threads[i], NULL, omni_bench_producer, &args);
+  }
+  for (u32 i = 0; i < p; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  u64 ns = omni_stats_now_ns() - start;
+  return (double)p * calls / (ns / 1e9);
+}
+
+int main(int argc, char *argv[]) {
+  u32 max_producers = argc > 1 ? (u32)atoi(argv[1]) : omni_ffi_workers_wanted(0);
+  u32 calls = argc > 2 ? (u32)atoi(argv[2]) : 200000;
+  if (max_producers < 1) max_producers = 1;
+  if (max_producers > OMNI_FFI_MAX_WORKERS) max_producers = OMNI_FFI_MAX_WORKERS;
+
+  omni_ffi_pool_configure(omni_ffi_workers_wanted(0));
+  omni_ffi_pool_init();
+  printf("FFI pool: %u workers, %u calls per producer, window %u\n",
+         OMNI_FFI_POOL.started, calls, OMNI_BENCH_WINDOW);
+  printf("%10s %16s %16s\n", "producers", "single calls/s", "batch calls/s");
+
+  // Powers of two below the maximum, then the maximum itself
+  u32 sweep[32];
+  u32 steps = 0;
+  for (u32 p = 1; p < max_producers; p *= 2) sweep[steps++] = p;
+  sweep[steps++] = max_producers;
+
+  for (u32 i = 0; i < steps; i++) {
+    double single = omni_bench_run(sweep[i], calls, 0);
+    double batch = omni_bench_run(sweep[i], calls, 1);
+    printf("%10u %16.0f %16.0f\n", sweep[i], single, batch);
+  }
+
+  omni_ffi_pool_shutdown();
+  return 0;
+}
@@ -0,0 +1,137 @@
+// OmniLisp File I/O Microbenchmark
+// read-file / write-file throughput: blocking, FFI workers, io_uring
+//
+//   make bench-io                           1000 files of 16 KiB
+//   ./bench_io_uring [FILES] [BYTES] [DIR]
+//
+// Each mode handles the same files through the same jobs (OmniIOJob, io.c):
+//   blocking  omni_io_read_path / omni_io_write_path, one file after another
+//   workers   staged calls on the FFI pool, OMNI_BENCH_WINDOW in flight
+//   io_uring  the same calls through the start stage (uring.c); calls it
+//             declines go to the workers, as in async-batch
+// Set OMNI_IO_URING=0 to see the io_uring row fall back.
+
+#define main omni_main
+#include "../main.c"
+#undef main
+
+#define OMNI_BENCH_WINDOW 256
+
+typedef enum { OMNI_BENCH_BLOCKING, OMNI_BENCH_WORKERS, OMNI_BENCH_URING } OmniBenchMode;
+
+static char **omni_bench_paths;
+static char  *omni_bench_content;
+static size_t omni_bench_bytes;
+
+// Run one window of jobs through the pool or the start stage and wait
+static void omni_bench_window(OmniFFIEntry *entry, OmniIOJob **jobs, u32 n) {
+  OmniFFIFuture *futures[OMNI_BENCH_WINDOW];
+  OmniFFIFuture *pooled[OMNI_BENCH_WINDOW];
+  u32 p = 0;
+  for (u32 i = 0; i < n; i++) {
+    futures[i] = (OmniFFIFuture*)calloc(1, sizeof(OmniFFIFuture));
+    futures[i]->entry = entry;
+    futures[i]->payload = jobs[i];
+  }
+  for (u32 i = 0; i < n; i++) {
+    if (!omni_ffi_start(futures[i], i + 1 < n)) pooled[p++] = futures[i];
+  }
+  if (p > 0) omni_ffi_submit_batch(pooled, p);
+  omni_ffi_wait(futures, n, 1);
+  for (u32 i = 0; i < n; i++) free(futures[i]);
+}
+
+// Files per second over count files
+static double omni_bench_run(OmniBenchMode mode, int write, u32 count, int *errors) {
+  OmniFFIEntry entry = {
+    .run = write ? omni_ffi_io_write_file_run : omni_ffi_io_read_file_run,
+    .start = mode == OMNI_BENCH_URING
+           ? (write ? omni_uring_start_write : omni_uring_start_read)
+           : NULL,
+  };
+  OmniIOJob *jobs[OMNI_BENCH_WINDOW];
+  *errors = 0;
+
+  u64 start = omni_stats_now_ns();
+  for (u32 base = 0; base < count; base += OMNI_BENCH_WINDOW) {
+    u32 n = count - base < OMNI_BENCH_WINDOW ? count - base : OMNI_BENCH_WINDOW;
+    for (u32 i = 0; i < n; i++) {
+      jobs[i] = (OmniIOJob*)calloc(1, sizeof(OmniIOJob));
+      jobs[i]->path = strdup(omni_bench_paths[base + i]);
+      if (write) {
+        jobs[i]->data = (char*)malloc(omni_bench_bytes);
+        memcpy(jobs[i]->data, omni_bench_content, omni_bench_bytes);
+        jobs[i]->len = omni_bench_bytes;
+      }
+    }
+
+    if (mode == OMNI_BENCH_BLOCKING) {
+      for (u32 i = 0; i < n; i++) entry.run(jobs[i]);
+    } else {
+      omni_bench_window(&entry, jobs, n);
+    }
+
+    for (u32 i = 0; i < n; i++) {
+      if (jobs[i]->err || (!write && jobs[i]->len != omni_bench_bytes &&
+                           strlen(jobs[i]->data) != omni_bench_bytes)) {
+        (*errors)++;
+      }
+      omni_io_job_free(jobs[i]);
+    }
+  }
+  u64 ns = omni_stats_now_ns() - start;
+  return count / (ns / 1e9);
+}
+
+int main(int argc, char *argv[]) {
+  u32 count = argc > 1 ? (u32)atoi(argv[1]) : 1000;
+  omni_bench_bytes = argc > 2 ? (size_t)atol(argv[2]) : 16384;
+  const char *dir = argc > 3 ? argv[3] : "/tmp/omni_bench_io";
+  if (count < 1) count = 1;
+
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Error: cannot create %s: %s\n", dir, strerror(errno));
+    return 1;
+  }
+  omni_bench_content = (char*)malloc(omni_bench_bytes);
+  for (size_t i = 0; i < omni_bench_bytes; i++) {
+    omni_bench_content[i] = (i % 64 == 63) ? '\n' : (char)('a' + i % 26);
+  }
+  omni_bench_paths = (char**)malloc(count * sizeof(char*));
+  for (u32 i = 0; i < count; i++) {
+    omni_bench_paths[i] = (char*)malloc(strlen(dir) + 32);
+    sprintf(omni_bench_paths[i], "%s/f%06u.txt", dir, i);
+  }
+
+  omni_ffi_pool_configure(omni_ffi_workers_wanted(0));
+  omni_ffi_pool_init();
+  pthread_once(&OMNI_URING_ONCE, omni_uring_setup);
+  printf("%u files of %zu bytes in %s; %u FFI workers; io_uring %s\n",
+         count, omni_bench_bytes, dir, OMNI_FFI_POOL.started,
+         OMNI_URING.ready ? "available" : "unavailable (falls back to workers)");
+  printf("%-10s %16s %16s\n", "mode", "write files/s", "read files/s");
+
+  const char *names[] = {"blocking", "workers", "io_uring"};
+  int failed = 0;
+  for (int mode = OMNI_BENCH_BLOCKING; mode <= OMNI_BENCH_URING; mode++) {
+    int werr, rerr;
+    double w = omni_bench_run((OmniBenchMode)mode, 1, count, &werr);
+    double r = omni_bench_run((OmniBenchMode)mode, 0, count, &rerr);
+    printf("%-10s %16.0f %16.0f", names[mode], w, r);
+    if (werr || rerr) printf("  (%d write, %d read errors)", werr, rerr);
+    printf("\n");
+    failed |= werr || rerr;
+  }
+
+  for (u32 i = 0; i < count; i++) {
+    unlink(omni_bench_paths[i]);
+    free(omni_bench_paths[i]);
+  }
+  free(omni_bench_paths);
+  free(omni_bench_content);
+  rmdir(dir);
+
+  omni_uring_shutdown();
+  omni_ffi_pool_shutdown();
+  return failed;
+}
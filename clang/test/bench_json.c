@@ -0,0 +1,200 @@
+// OmniLisp JSON Parser Microbenchmark
+// Structural indexing and json-parse throughput, in GB/s of JSON text
+//
+//   make bench-json                         synthetic corpus, compact and pretty
+//   ./bench_json [MIB | FILE...]
+//
+// A number gives the size of the synthetic corpus in MiB (default 16):
+// records of ids, names with escapes, decimals, tag arrays and nested
+// objects, written once compact and once pretty-printed. Otherwise each
+// argument is a JSON file to measure as it is.
+//
+// The stage1 rows time omni_json_index alone with each kernel this CPU can
+// run. The parse rows time omni_json_parse_bytes down to Terms: bytewise is
+// the parser without an index (what inputs under OMNI_JSON_INDEX_MIN get),
+// the others index with that kernel first. Each figure is the best of
+// several runs, with the heap rolled back between parses. Strings are
+// built as OMNI_PACKED_STRINGS says, which changes the parse rows a lot.
+
+#define main omni_main
+#include "../main.c"
+#undef main
+
+#define OMNI_BENCH_BYTES_PER_ROW ((size_t)256 << 20)   // Work per row, in bytes parsed
+
+typedef struct {
+  const char    *name;
+  OmniJsonStage1 kernel;
+} OmniBenchKernel;
+
+static char  *omni_bench_text;
+static size_t omni_bench_len;
+static size_t omni_bench_cap;
+
+static void omni_bench_put(const char *s, size_t n) {
+  if (omni_bench_len + n + 1 > omni_bench_cap) {
+    omni_bench_cap = (omni_bench_cap + n) * 2;
+    omni_bench_text = (char*)realloc(omni_bench_text, omni_bench_cap);
+  }
+  memcpy(omni_bench_text + omni_bench_len, s, n);
+  omni_bench_len += n;
+}
+
+static void omni_bench_puts(const char *s) {
+  omni_bench_put(s, strlen(s));
+}
+
+static void omni_bench_indent(int pretty, int depth) {
+  static const char spaces[] = "                ";
+  if (!pretty) return;
+  omni_bench_put("\n", 1);
+  omni_bench_put(spaces, (size_t)(depth * 2) < sizeof(spaces) - 1 ? (size_t)depth * 2 : sizeof(spaces) - 1);
+}
+
+// An array of records until the text reaches bytes
+static void omni_bench_corpus(size_t bytes, int pretty) {
+  const char *sep = pretty ? ": " : ":";
+  char num[96];
+  omni_bench_len = 0;
+  omni_bench_puts("[");
+  for (u32 i = 0; omni_bench_len < bytes; i++) {
+    if (i) omni_bench_puts(",");
+    omni_bench_indent(pretty, 1);
+    omni_bench_puts("{");
+    omni_bench_indent(pretty, 2);
+    snprintf(num, sizeof(num), "\"id\"%s%u,", sep, i * 2654435761u);
+    omni_bench_puts(num);
+    omni_bench_indent(pretty, 2);
+    snprintf(num, sizeof(num), "\"name\"%s\"user \\\"%u\\\" caf\\u00e9\",", sep, i);
+    omni_bench_puts(num);
+    omni_bench_indent(pretty, 2);
+    snprintf(num, sizeof(num), "\"score\"%s-%u.%02u,", sep, i % 1000, i % 100);
+    omni_bench_puts(num);
+    omni_bench_indent(pretty, 2);
+    snprintf(num, sizeof(num), "\"tags\"%s[\"alpha\", \"beta\", \"gamma\"],", sep);
+    omni_bench_puts(num);
+    omni_bench_indent(pretty, 2);
+    snprintf(num, sizeof(num), "\"geo\"%s{\"lat\"%s48.8566, \"lon\"%s2.3522},", sep, sep, sep);
+    omni_bench_puts(num);
+    omni_bench_indent(pretty, 2);
+    snprintf(num, sizeof(num), "\"active\"%s%s, \"parent\"%snull", sep, i % 3 ? "true" : "false", sep);
+    omni_bench_puts(num);
+    omni_bench_indent(pretty, 1);
+    omni_bench_puts("}");
+  }
+  omni_bench_indent(pretty, 0);
+  omni_bench_puts("]");
+  omni_bench_text[omni_bench_len] = '\0';
+}
+
+static int omni_bench_load(const char *path) {
+  char *data;
+  size_t len;
+  int err = omni_io_read_path(path, &data, &len);
+  if (err) {
+    fprintf(stderr, "Error: cannot read %s: %s\n", path, strerror(err));
+    return 0;
+  }
+  free(omni_bench_text);
+  omni_bench_text = data;
+  omni_bench_len = len;
+  omni_bench_cap = len;
+  return 1;
+}
+
+static u32 omni_bench_runs(void) {
+  size_t runs = OMNI_BENCH_BYTES_PER_ROW / (omni_bench_len ? omni_bench_len : 1);
+  return runs < 3 ? 3 : (u32)runs;
+}
+
+static double omni_bench_gbps(u64 ns) {
+  return ns ? omni_bench_len / (double)ns : 0;
+}
+
+// Best GB/s of stage one alone; *tokens gets the index size
+static double omni_bench_stage1(OmniJsonStage1 kernel, size_t *tokens) {
+  u64 best = ~(u64)0;
+  OMNI_JSON_STAGE1 = kernel;
+  for (u32 r = omni_bench_runs(); r > 0; r--) {
+    u64 start = omni_stats_now_ns();
+    u32 *idx = omni_json_index(omni_bench_text, omni_bench_len, tokens);
+    u64 ns = omni_stats_now_ns() - start;
+    free(idx);
+    if (ns < best) best = ns;
+  }
+  return omni_bench_gbps(best);
+}
+
+// Best GB/s of a full parse; kernel NULL parses bytewise
+static double omni_bench_parse(OmniJsonStage1 kernel, int *failed) {
+  OmniHeapMark base = {0};
+  u64 best = ~(u64)0;
+  OMNI_JSON_INDEX_MIN = kernel ? 0 : SIZE_MAX;
+  if (kernel) OMNI_JSON_STAGE1 = kernel;
+  omni_heap_mark(&base);
+  for (u32 r = omni_bench_runs(); r > 0; r--) {
+    u32 scope = omni_ffi_handle_scope_begin();  // packed strings' handles
+    u64 start = omni_stats_now_ns();
+    Term t = omni_json_parse_bytes(omni_bench_text, omni_bench_len, NULL);
+    u64 ns = omni_stats_now_ns() - start;
+    if (omni_json_is_error(t)) *failed = 1;
+    omni_ffi_handle_scope_end(scope);
+    omni_heap_reset(&base);
+    if (ns < best) best = ns;
+  }
+  omni_heap_mark_free(&base);
+  return omni_bench_gbps(best);
+}
+
+static int omni_bench_report(const char *label, OmniBenchKernel *kernels, u32 nk) {
+  int failed = 0;
+  size_t tokens = 0;
+  printf("\n%s: %.1f MiB\n", label, omni_bench_len / 1048576.0);
+  printf("%-8s %-9s %10s\n", "stage", "kernel", "GB/s");
+  for (u32 k = 0; k < nk; k++) {
+    double g = omni_bench_stage1(kernels[k].kernel, &tokens);
+    printf("%-8s %-9s %10.2f\n", "stage1", kernels[k].name, g);
+  }
+  printf("%-8s %-9s %10.2f\n", "parse", "bytewise", omni_bench_parse(NULL, &failed));
+  for (u32 k = 0; k < nk; k++) {
+    double g = omni_bench_parse(kernels[k].kernel, &failed);
+    printf("%-8s %-9s %10.2f\n", "parse", kernels[k].name, g);
+  }
+  printf("%zu tokens%s\n", tokens, failed ? "; PARSE FAILED" : "");
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  OmniBenchKernel kernels[3];
+  u32 nk = 0;
+  kernels[nk++] = (OmniBenchKernel){"table", omni_json_stage1_table};
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  kernels[nk++] = (OmniBenchKernel){"sse2", omni_json_stage1_sse2};
+  if (__builtin_cpu_supports("avx2")) kernels[nk++] = (OmniBenchKernel){"avx2", omni_json_stage1_avx2};
+#endif
+
+  omni_runtime_init(1);
+
+  int failed = 0;
+  int files = argc > 1 && atoi(argv[1]) <= 0;
+  if (files) {
+    for (int i = 1; i < argc; i++) {
+      if (!omni_bench_load(argv[i])) {
+        failed = 1;
+        continue;
+      }
+      failed |= omni_bench_report(argv[i], kernels, nk);
+    }
+  } else {
+    size_t mib = argc > 1 ? (size_t)atoi(argv[1]) : 16;
+    omni_bench_corpus(mib << 20, 0);
+    failed |= omni_bench_report("compact", kernels, nk);
+    omni_bench_corpus(mib << 20, 1);
+    failed |= omni_bench_report("pretty", kernels, nk);
+  }
+
+  free(omni_bench_text);
+  omni_runtime_cleanup();
+  return failed;
+}
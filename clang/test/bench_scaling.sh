@@ -0,0 +1,59 @@
+#!/bin/bash
+# OmniLisp Reducer Scaling Report
+# Times the bench_parallel_*.omni programs at -j 1/2/4 and prints the
+# wall-clock speedup over a single reducer thread. map and reduce-tree hand
+# their elements to the reducer threads as they evaluate; filter and fold
+# have nothing to split and are the baseline for the threads' overhead.
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+CLANG_DIR="$(dirname "$SCRIPT_DIR")"
+OMNILISP="$CLANG_DIR/main"
+
+THREADS="${THREADS:-1 2 4}"
+RUNS="${RUNS:-5}"
+
+if [[ ! -x "$OMNILISP" ]]; then
+    echo "Error: $OMNILISP not found (build with 'make' in $CLANG_DIR)"
+    exit 1
+fi
+
+# Best wall time in ms over $RUNS runs
+best_ms() {
+    local jobs="$1"
+    local file="$2"
+    local best=""
+    local i
+    for (( i=0; i<RUNS; i++ )); do
+        local start end ms
+        start=$(date +%s%N)
+        "$OMNILISP" -j "$jobs" "$file" > /dev/null 2>&1
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [[ -z "$best" || "$ms" -lt "$best" ]]; then
+            best="$ms"
+        fi
+    done
+    echo "$best"
+}
+
+printf "%-28s" "benchmark"
+for j in $THREADS; do
+    printf "%14s" "-j $j"
+done
+echo
+
+for file in "$SCRIPT_DIR"/bench_parallel_*.omni; do
+    printf "%-28s" "$(basename "$file" .omni)"
+    base=""
+    for j in $THREADS; do
+        ms=$(best_ms "$j" "$file")
+        if [[ -z "$base" ]]; then
+            base="$ms"
+            printf "%14s" "${ms}ms"
+        else
+            speedup=$(awk -v b="$base" -v m="$ms" 'BEGIN { printf "%.2fx", (m > 0 ? b / m : 0) }')
+            printf "%14s" "${ms}ms ${speedup}"
+        fi
+    done
+    echo
+done
@@ -40,6 +40,10 @@ run_test_file() {
     local balance=0
     local file_passed=0
     local file_failed=0
+    local flags=()
+
+    # Optional ";; FLAGS: ..." line: extra options for every test in the file
+    read -r -a flags <<< "$(grep -m1 -E '^[[:space:]]*;;[[:space:]]*FLAGS:' "$test_file" | sed 's/.*FLAGS:[[:space:]]*//')"
 
     echo -e "\n${YELLOW}=== Testing: $(basename "$test_file") ===${NC}"
 
@@ -77,7 +81,7 @@ run_test_file() {
             if [[ $collecting -eq 1 && $balance -eq 0 && -n "$expr" ]]; then
                 # Run the expression using -e flag
                 local actual
-                actual=$("$OMNILISP" -e "$expr" 2>&1)
+                actual=$("$OMNILISP" "${flags[@]}" -e "$expr" 2>&1)
                 local exit_code=$?
 
                 # Strip "Result:" prefix and trim whitespace